@@ -0,0 +1,340 @@
+
+#include "ballistic.h"
+#include "particle_system.h"
+#include "sdf.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Đường cong nguội
+
+float BallisticSolver::CoolingCurve::temperatureAt(float cool) const {
+    float f = max(cool, 0.0f) / step;
+    size_t i = (size_t)f;
+    if (i + 1 >= temp.size()) return temp.back();
+    return temp[i] + (temp[i + 1] - temp[i]) * (f - i);
+}
+
+// temp giảm dần nên tra ngược bằng chia đôi
+float BallisticSolver::CoolingCurve::timeAt(float temperature) const {
+    if (temperature >= temp.front()) return 0.0f;
+    if (temperature <= temp.back()) return (temp.size() - 1) * step;
+    size_t lo = 0, hi = temp.size() - 1;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (temp[mid] > temperature) lo = mid; else hi = mid;
+    }
+    return (lo + (temp[lo] - temperature) / (temp[lo] - temp[hi])) * step;
+}
+
+// Tích phân dT/dt = rate(T) bằng RK4 từ tempMax cho tới dưới nhiệt độ đông đặc
+template<typename Rate>
+static void buildCurve(vector<float> &out, float tempMax, float stopTemp, float step, Rate rate) {
+    out.clear();
+    double T = tempMax;
+    out.push_back((float)T);
+    const size_t MAX_SAMPLES = 200000;
+    while (T > stopTemp && out.size() < MAX_SAMPLES) {
+        double k1 = rate(T);
+        double k2 = rate(T + 0.5 * step * k1);
+        double k3 = rate(T + 0.5 * step * k2);
+        double k4 = rate(T + step * k3);
+        T += step * (k1 + 2 * k2 + 2 * k3 + k4) / 6.0;
+        out.push_back((float)T);
+    }
+}
+
+void BallisticSolver::init(const LavaThermalParams &thermal, const BallisticParams &p) {
+    params = p;
+    solidusTemp = thermal.solidusTemp;
+    double ambientK = thermal.ambientTemp + 273.15;
+    double ambientK4 = ambientK * ambientK * ambientK * ambientK;
+    auto radiative = [&](double T) {
+        double tk = T + 273.15;
+        return -thermal.emissivity * (tk * tk * tk * tk - ambientK4);
+    };
+    auto contact = [&](double T) {
+        return radiative(T) - thermal.contactCooling * (T - thermal.ambientTemp);
+    };
+    // Bắt đầu cao hơn nhiệt độ phun lớn nhất một chút để mọi hạt đều nằm trên đường cong
+    float tempMax = thermal.eruptionTemp + thermal.eruptionSpread + 50.0f;
+    float stopTemp = thermal.solidusTemp - 1.0f;
+    flightCurve.tempMax = restCurve.tempMax = tempMax;
+    buildCurve(flightCurve.temp, tempMax, stopTemp, flightCurve.step, radiative);
+    buildCurve(restCurve.temp, tempMax, stopTemp, restCurve.step, contact);
+    clear();
+}
+
+void BallisticSolver::clear() {
+    particles.clear();
+    queue = decltype(queue)();
+    firstId = 0;
+    firstTime = 0.0f;
+    now = 0.0f;
+    maxDuration = 0.0f;
+}
+
+const BallisticSolver::Track* BallisticSolver::track(uint32_t id) const {
+    if (id < firstId || id - firstId >= particles.size()) return nullptr;
+    return &particles[id - firstId];
+}
+
+BallisticSolver::Track* BallisticSolver::track(uint32_t id) {
+    if (id < firstId || id - firstId >= particles.size()) return nullptr;
+    return &particles[id - firstId];
+}
+
+// Bỏ các hạt đầu mảng đã kết thúc trước now - historySeconds. Hạt xếp theo
+// thời điểm phun nên chỉ cần cắt phần đầu; đợi phần bỏ được chiếm nửa mảng
+// mới cắt để chi phí dời mảng được chia đều
+void BallisticSolver::compact() {
+    float cutoff = now - params.historySeconds;
+    size_t n = 0;
+    while (n < particles.size() && particles[n].ended && particles[n].endTime < cutoff) n++;
+    if (n == 0 || n < particles.size() / 2) return;
+    particles.erase(particles.begin(), particles.begin() + n);
+    firstId += (uint32_t)n;
+    firstTime = max(firstTime, cutoff);
+}
+
+// ---------------------------------------------------------------------------
+// Sự kiện
+
+// Thời gian tới lần va chạm kế tiếp (mặt đất hoặc SDF) tính từ đầu đoạn
+float BallisticSolver::impactTime(const Segment &s) const {
+    float tau = groundImpactTime(s);
+    return collider ? sdfImpactTime(s, tau) : tau;
+}
+
+// Thời gian tới lúc chạm đất. Mặt đất phẳng thì nghiệm của phương trình bậc 2
+// là đúng ngay; mặt đất cong thì lặp lại với độ cao tại điểm chạm vừa tìm,
+// không hội tụ (sườn dốc) thì dò dọc parabol rồi chia đôi.
+float BallisticSolver::groundImpactTime(const Segment &s) const {
+    const float g = params.gravity;
+    auto height = [&](float tau) { return s.pos[1] + (s.vel[1] + 0.5f * g * tau) * tau; };
+    auto groundAt = [&](float tau) { return ground(s.pos[0] + s.vel[0] * tau, s.pos[2] + s.vel[2] * tau); };
+    // Nghiệm sau của y(τ) = h
+    auto solve = [&](float h) {
+        float d = s.vel[1] * s.vel[1] - 2.0f * g * (s.pos[1] - h);
+        if (d < 0.0f) return 0.0f;
+        return max((s.vel[1] + sqrtf(d)) / -g, 0.0f);
+    };
+
+    float h = ground(s.pos[0], s.pos[2]);
+    float tau = solve(h);
+    for (int it = 0; it < 4; it++) {
+        float hn = groundAt(tau);
+        if (fabsf(hn - h) < 1e-4f) return tau;
+        h = hn;
+        tau = solve(h);
+    }
+
+    const float STEP = 1.0f / 30.0f;
+    const float MAX_FLIGHT = 120.0f;
+    float a = 0.0f, b = STEP;
+    while (height(b) > groundAt(b)) {
+        a = b;
+        b += STEP;
+        if (b > MAX_FLIGHT) return b;
+    }
+    for (int it = 0; it < 12; it++) {
+        float m = 0.5f * (a + b);
+        if (height(m) > groundAt(m)) a = m; else b = m;
+    }
+    return b;
+}
+
+// Thời gian tới lúc vào lớp da của SDF, không quá limit. Dò dọc parabol với
+// bước bằng khoảng cách tới SDF (ngoài dải band SDF chỉ trả về ±band nên bước
+// không vượt band), gặp điểm trong lớp da thì chia đôi. Đoạn bắt đầu sẵn trong
+// lớp da (vừa nảy khỏi sườn núi) thì chỉ tính từ lúc hạt ra ngoài.
+float BallisticSolver::sdfImpactTime(const Segment &s, float limit) const {
+    const float g = params.gravity;
+    const float skin = params.sdfSkin;
+    float grad[3];
+    auto dist = [&](float tau) {
+        return collider->sample(s.pos[0] + s.vel[0] * tau, s.pos[1] + (s.vel[1] + 0.5f * g * tau) * tau,
+                                s.pos[2] + s.vel[2] * tau, grad);
+    };
+
+    float a = 0.0f, d = dist(0.0f);
+    bool outside = d >= skin;
+    while (a < limit) {
+        // Bước thời gian để quãng đi (kể cả phần tăng tốc do trọng lực) không quá travel
+        float vy = s.vel[1] + g * a;
+        float speed = sqrtf(s.vel[0] * s.vel[0] + vy * vy + s.vel[2] * s.vel[2]);
+        float travel = max(fabsf(d) - skin, params.sdfMinStep);
+        float step = (sqrtf(speed * speed + 2.0f * fabsf(g) * travel) - speed) / fabsf(g);
+        float b = min(a + step, limit);
+        float db = dist(b);
+        if (outside && db < skin) {
+            for (int it = 0; it < 12; it++) {
+                float m = 0.5f * (a + b);
+                if (dist(m) < skin) b = m; else a = m;
+            }
+            return b;
+        }
+        outside = outside || db >= skin;
+        a = b;
+        d = db;
+    }
+    return limit;
+}
+
+void BallisticSolver::schedule(uint32_t id) {
+    Track &p = *track(id);
+    const Segment &s = p.segments[p.segmentCount - 1];
+    const CoolingCurve &curve = s.resting ? restCurve : flightCurve;
+    float solid = s.t0 + max(curve.timeAt(solidusTemp) - s.cool, 0.0f);
+    p.eventIsImpact = false;
+    p.eventTime = solid;
+    if (!s.resting) {
+        float impact = s.t0 + impactTime(s);
+        if (impact < solid) {
+            p.eventTime = impact;
+            p.eventIsImpact = true;
+        }
+    }
+    maxDuration = max(maxDuration, p.eventTime - p.spawnTime);
+    queue.push({p.eventTime, id});
+}
+
+void BallisticSolver::startSegment(uint32_t id, float t, const float pos[3], const float vel[3], float temperature, bool resting) {
+    Track &p = *track(id);
+    Segment &s = p.segments[p.segmentCount++];
+    s.t0 = t;
+    for (int k = 0; k < 3; k++) {
+        s.pos[k] = pos[k];
+        s.vel[k] = resting ? 0.0f : vel[k];
+    }
+    s.resting = resting;
+    s.cool = (resting ? restCurve : flightCurve).timeAt(temperature);
+    schedule(id);
+}
+
+uint32_t BallisticSolver::launch(float t, const float pos[3], const float vel[3], float temperature, uint8_t seed, uint8_t sizeLevel) {
+    uint32_t id = firstId + (uint32_t)particles.size();
+    particles.emplace_back();
+    Track &p = particles.back();
+    p.spawnTime = t;
+    p.endTime = numeric_limits<float>::infinity();
+    p.segmentCount = 0;
+    p.seed = seed;
+    p.sizeLevel = sizeLevel;
+    p.ended = false;
+    startSegment(id, t, pos, vel, temperature, false);
+    return id;
+}
+
+void BallisticSolver::finish(uint32_t id, float t) {
+    Track &p = *track(id);
+    p.ended = true;
+    p.endTime = t;
+    maxDuration = max(maxDuration, t - p.spawnTime);
+}
+
+void BallisticSolver::retire(uint32_t id, float t) {
+    const Track* p = track(id);
+    if (p && !p->ended) finish(id, t);
+}
+
+void BallisticSolver::advanceTo(float t, vector<BallisticEvent>* events) {
+    while (!queue.empty() && queue.top().time <= t) {
+        QueueEntry e = queue.top();
+        queue.pop();
+        Track* tp = track(e.id);
+        // Hạt đã bị giao lại cho mô phỏng từng bước (hoặc đã bị bỏ) thì bỏ qua sự kiện cũ
+        if (!tp || tp->ended || e.time != tp->eventTime) continue;
+        Track &p = *tp;
+        now = max(now, e.time);
+
+        BallisticState s;
+        segmentState(p.segments[p.segmentCount - 1], e.time, s);
+        if (!p.eventIsImpact) {
+            finish(e.id, e.time);
+            if (events) events->push_back({BallisticEvent::SOLIDIFIED, e.time, {s.pos[0], s.pos[1], s.pos[2]}, s.temperature});
+            continue;
+        }
+
+        // Nảy như update(): trên mặt đất thì đảo và giảm vận tốc dọc, giảm vận
+        // tốc ngang; trên SDF thì tách theo pháp tuyến như resolveSdfContact()
+        float h = ground(s.pos[0], s.pos[2]);
+        float vel[3];
+        bool rest;
+        if (collider && s.pos[1] > h + 1e-3f) {
+            float grad[3];
+            float d = collider->sample(s.pos[0], s.pos[1], s.pos[2], grad);
+            float len = sqrtf(grad[0] * grad[0] + grad[1] * grad[1] + grad[2] * grad[2]);
+            float n[3] = {0.0f, 1.0f, 0.0f};
+            if (len > 1e-4f) for (int k = 0; k < 3; k++) n[k] = grad[k] / len;
+            float push = max(params.sdfSkin - d, 0.0f);
+            float vn = s.vel[0] * n[0] + s.vel[1] * n[1] + s.vel[2] * n[2];
+            for (int k = 0; k < 3; k++) {
+                s.pos[k] += n[k] * push;
+                vel[k] = vn < 0.0f ? (s.vel[k] - n[k] * vn) * params.friction - n[k] * vn * params.restitution : s.vel[k];
+            }
+            rest = vel[0] * vel[0] + vel[1] * vel[1] + vel[2] * vel[2] < params.restSpeed * params.restSpeed;
+        } else {
+            s.pos[1] = h;
+            vel[0] = s.vel[0] * params.friction;
+            vel[1] = -s.vel[1] * params.restitution;
+            vel[2] = s.vel[2] * params.friction;
+            rest = vel[1] < params.restSpeed;
+        }
+        rest = rest || p.segmentCount + 1 == MAX_SEGMENTS;
+        if (rest && params.landOnRest) {
+            finish(e.id, e.time);
+            if (events) events->push_back({BallisticEvent::LANDED, e.time, {s.pos[0], s.pos[1], s.pos[2]}, s.temperature});
+            continue;
+        }
+        startSegment(e.id, e.time, s.pos, vel, s.temperature, rest);
+    }
+    now = max(now, t);
+    compact();
+}
+
+// ---------------------------------------------------------------------------
+// Truy vấn
+
+void BallisticSolver::segmentState(const Segment &s, float t, BallisticState &out) const {
+    float dt = max(t - s.t0, 0.0f);
+    if (s.resting) {
+        for (int k = 0; k < 3; k++) { out.pos[k] = s.pos[k]; out.vel[k] = 0.0f; }
+        out.temperature = restCurve.temperatureAt(s.cool + dt);
+        return;
+    }
+    const float g = params.gravity;
+    out.pos[0] = s.pos[0] + s.vel[0] * dt;
+    out.pos[1] = s.pos[1] + (s.vel[1] + 0.5f * g * dt) * dt;
+    out.pos[2] = s.pos[2] + s.vel[2] * dt;
+    out.vel[0] = s.vel[0];
+    out.vel[1] = s.vel[1] + g * dt;
+    out.vel[2] = s.vel[2];
+    out.temperature = flightCurve.temperatureAt(s.cool + dt);
+}
+
+bool BallisticSolver::evaluate(uint32_t id, float t, BallisticState &out) const {
+    const Track* tp = track(id);
+    if (!tp || t < tp->spawnTime || t >= tp->endTime) return false;
+    const Track &p = *tp;
+    // Chưa xử lý tới sự kiện kế tiếp thì dừng ở thời điểm sự kiện
+    t = min(t, p.eventTime);
+    int k = p.segmentCount - 1;
+    while (k > 0 && p.segments[k].t0 > t) k--;
+    segmentState(p.segments[k], t, out);
+    out.seed = p.seed;
+    out.sizeLevel = p.sizeLevel;
+    return true;
+}
+
+void BallisticSolver::aliveAt(float t, vector<uint32_t> &ids) const {
+    ids.clear();
+    auto first = lower_bound(particles.begin(), particles.end(), t - maxDuration,
+                             [](const Track &p, float v) { return p.spawnTime < v; });
+    for (auto it = first; it != particles.end() && it->spawnTime <= t; ++it) {
+        if (t < it->endTime) ids.push_back(firstId + (uint32_t)(it - particles.begin()));
+    }
+}
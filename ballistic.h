@@ -0,0 +1,157 @@
+#ifndef BALLISTIC_H
+#define BALLISTIC_H
+
+#include <vector>
+#include <queue>
+#include <cstdint>
+#include <functional>
+
+struct LavaThermalParams;
+class SparseSdf;
+
+// Lời giải giải tích cho hạt dung nham để tua nhanh/tua lại không cần mô phỏng
+// từng bước.
+// - Giữa 2 lần chạm đất hạt bay theo parabol: chỉ lưu trạng thái lúc bắt đầu
+//   mỗi đoạn, vị trí tại thời điểm bất kỳ tính trực tiếp.
+// - Nhiệt độ theo đường cong nguội tính sẵn một lần (khi bay: bức xạ, khi nằm
+//   trên đất: bức xạ + tiếp xúc). Mô hình nguội không phụ thuộc thời gian nên
+//   chỉ cần biết vị trí trên đường cong lúc bắt đầu đoạn.
+// - Mỗi hạt có đúng một sự kiện kế tiếp (chạm đất hoặc đông cứng) trong hàng đợi
+//   ưu tiên; chạm đất hoặc SDF thì nảy (như update()), nảy yếu thì nằm yên.
+// Hạt được giữ lại thêm historySeconds sau khi kết thúc nên có thể lấy trạng
+// thái ở thời điểm bất kỳ từ historyStart() tới time() với chi phí O(1) mỗi hạt;
+// hạt cũ hơn bị bỏ để bộ nhớ không tăng mãi.
+// Đồng hồ của bộ giải chỉ chạy trong advanceTo(): các lần tua nhanh nối tiếp
+// nhau trên trục thời gian này, còn mô phỏng từng bước giữa các lần tua không
+// được ghi lại nên không xem lại được.
+
+// Trạng thái một hạt tại một thời điểm
+struct BallisticState {
+    float pos[3];
+    float vel[3];
+    float temperature;
+    uint8_t seed;
+    uint8_t sizeLevel;
+};
+
+// Hạt kết thúc trong lúc advanceTo()
+struct BallisticEvent {
+    enum Type : uint8_t { LANDED, SOLIDIFIED };
+    Type type;
+    float time;
+    float pos[3];
+    float temperature;
+};
+
+struct BallisticParams {
+    float gravity = -8.0f;
+    float restitution = 0.2f;  // vận tốc dọc khi nảy, như update()
+    float friction = 0.3f;     // vận tốc ngang giữ lại khi nảy
+    float restSpeed = 0.3f;    // nảy lên chậm hơn thế này thì nằm yên
+    bool landOnRest = false;   // true: nằm yên là kết thúc (tan vào dòng chảy) thay vì nguội tại chỗ
+    float sdfSkin = 0.01f;     // khoảng cách tới SDF coi là chạm, như update()
+    float sdfMinStep = 0.02f;  // bước dò dọc parabol nhỏ nhất khi gần SDF
+    float historySeconds = 120.0f;  // giữ hạt đã kết thúc bao lâu để xem lại
+};
+
+class BallisticSolver {
+public:
+    static const int MAX_SEGMENTS = 4;  // bay, 2 lần nảy, nằm yên
+
+    // Tính sẵn 2 đường cong nguội và xóa các hạt cũ
+    void init(const LavaThermalParams &thermal, const BallisticParams &params = BallisticParams());
+    void clear();
+
+    // Độ cao mặt đất, không gán thì dùng y = -0.5 như update()
+    std::function<float(float, float)> groundHeight;
+    // SDF của núi lửa (có thể null): hạt va vào sườn/thành miệng núi cũng nảy
+    const SparseSdf* collider = nullptr;
+    BallisticParams params;
+
+    // Thêm một hạt phun tại thời điểm t (>= time()); trả về chỉ số của hạt
+    // (tăng dần, không dùng lại kể cả khi hạt cũ đã bị bỏ)
+    // seed và sizeLevel chỉ được giữ lại để trả về trong BallisticState
+    uint32_t launch(float t, const float pos[3], const float vel[3], float temperature, uint8_t seed, uint8_t sizeLevel);
+
+    // Xử lý mọi sự kiện tới thời điểm t theo đúng thứ tự thời gian; hạt kết
+    // thúc được ghi vào events (nếu khác null). Hạt kết thúc trước
+    // t - historySeconds bị bỏ.
+    void advanceTo(float t, std::vector<BallisticEvent>* events = nullptr);
+
+    // Trạng thái hạt id tại t (historyStart() <= t <= time()); false nếu lúc
+    // đó hạt chưa phun, đã kết thúc hoặc đã bị bỏ
+    bool evaluate(uint32_t id, float t, BallisticState &out) const;
+
+    // Kết thúc hạt id tại thời điểm t mà không sinh sự kiện (giao lại cho
+    // mô phỏng từng bước)
+    void retire(uint32_t id, float t);
+
+    // Các hạt còn sống tại t (hạt được đánh số theo thứ tự phun nên chỉ cần
+    // xét những hạt phun trong khoảng thời gian sống dài nhất trước t)
+    void aliveAt(float t, std::vector<uint32_t> &ids) const;
+
+    float time() const { return now; }
+    // Thời điểm sớm nhất còn đầy đủ dữ liệu để xem lại
+    float historyStart() const { return firstTime; }
+    size_t particleCount() const { return particles.size(); }
+    size_t pendingCount() const { return queue.size(); }
+
+private:
+    // Một đoạn chuyển động: parabol (bay) hoặc đứng yên (nằm trên đất)
+    struct Segment {
+        float t0;
+        float pos[3];
+        float vel[3];
+        float cool;  // vị trí trên đường cong nguội tương ứng lúc t0 (giây)
+        bool resting;
+    };
+    struct Track {
+        float spawnTime;
+        float endTime;
+        float eventTime;   // sự kiện kế tiếp (chạm đất/đông cứng)
+        uint8_t segmentCount;
+        uint8_t seed;
+        uint8_t sizeLevel;
+        bool ended;
+        bool eventIsImpact;
+        Segment segments[MAX_SEGMENTS];
+    };
+    struct QueueEntry {
+        float time;
+        uint32_t id;
+        bool operator>(const QueueEntry &o) const { return time > o.time || (time == o.time && id > o.id); }
+    };
+
+    // Nhiệt độ theo thời gian, lấy mẫu đều; thời gian theo nhiệt độ tra ngược
+    struct CoolingCurve {
+        float step = 0.01f;
+        float tempMax = 0.0f;
+        std::vector<float> temp;  // temp[i] = nhiệt độ sau i*step giây từ tempMax
+        float temperatureAt(float cool) const;
+        float timeAt(float temperature) const;
+    };
+    CoolingCurve flightCurve, restCurve;
+    float solidusTemp = 0.0f;
+
+    std::vector<Track> particles;       // hạt firstId, firstId + 1, ...
+    uint32_t firstId = 0;
+    float firstTime = 0.0f;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    float now = 0.0f;
+    float maxDuration = 0.0f;  // thời gian sống dài nhất đã biết của một hạt
+
+    float ground(float x, float z) const { return groundHeight ? groundHeight(x, z) : -0.5f; }
+    // null nếu id đã bị bỏ
+    const Track* track(uint32_t id) const;
+    Track* track(uint32_t id);
+    float impactTime(const Segment &s) const;
+    float groundImpactTime(const Segment &s) const;
+    float sdfImpactTime(const Segment &s, float limit) const;
+    void compact();
+    void schedule(uint32_t id);
+    void startSegment(uint32_t id, float t, const float pos[3], const float vel[3], float temperature, bool resting);
+    void finish(uint32_t id, float t);
+    void segmentState(const Segment &s, float t, BallisticState &out) const;
+};
+
+#endif
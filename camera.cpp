@@ -0,0 +1,127 @@
+
+#include "camera.h"
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void Camera::markDirty(unsigned flags) {
+    dirty |= flags | DIRTY_INVERSE | DIRTY_PLANES;
+    transformDirty = true;
+}
+
+void Camera::setRotation(float x, float y) {
+    if (x > 1.5f) x = 1.5f;
+    if (x < -1.5f) x = -1.5f;
+    if (x == rotX && y == rotY) return;
+    rotX = x;
+    rotY = y;
+    markDirty(DIRTY_MODEL);
+}
+
+void Camera::setEye(float x, float y, float z) {
+    if (x == eye.x && y == eye.y && z == eye.z) return;
+    eye = vec3(x, y, z);
+    markDirty(DIRTY_VIEW);
+}
+
+void Camera::setZoom(float z) {
+    if (z == zoomValue) return;
+    zoomValue = z;
+    markDirty(DIRTY_PROJ);
+}
+
+void Camera::setPerspective(bool on) {
+    if (on == isPerspective) return;
+    isPerspective = on;
+    markDirty(DIRTY_PROJ);
+}
+
+bool Camera::setViewport(int w, int h) {
+    if (w == width && h == height) return false;
+    width = w;
+    height = h;
+    markDirty(DIRTY_PROJ);
+    return true;
+}
+
+const Mat4 &Camera::model() {
+    if (dirty & DIRTY_MODEL) {
+        rotMat = rotateXY(rotX, rotY);
+        // Dịch chuyển núi lửa xuống 1 chút để tâm xoay ở gốc 0,0,0
+        modelMat = multiply(translate(0.0f, -0.5f, 0.0f), rotMat);
+        dirty &= ~DIRTY_MODEL;
+    }
+    return modelMat;
+}
+
+const Mat4 &Camera::view() {
+    if (dirty & DIRTY_VIEW) {
+        viewMat = lookAt(eye, center, up);
+        dirty &= ~DIRTY_VIEW;
+    }
+    return viewMat;
+}
+
+const Mat4 &Camera::projection() {
+    if (dirty & DIRTY_PROJ) {
+        float ratio = (float)width / (height > 0 ? height : 1);
+        if (isPerspective) {
+            // Phép chiếu phối cảnh
+            float fovy = (45.0f / zoomValue) * M_PI / 180.0f;
+
+            // Giới hạn fov để tránh bị lật hình (quá zoom)
+            if (fovy < 0.01f) fovy = 0.01f;
+            if (fovy > 3.0f) fovy = 3.0f;
+            projMat = ::perspective(fovy, ratio, NEAR_PLANE, FAR_PLANE);
+        } else {
+            // Phép chiếu song song
+            float s = 2.0f / zoomValue;
+            projMat = ortho(-s * ratio, s * ratio, -s, s, NEAR_PLANE, FAR_PLANE);
+        }
+        dirty &= ~DIRTY_PROJ;
+    }
+    return projMat;
+}
+
+const Mat4 &Camera::viewProj() {
+    if (dirty & (DIRTY_VIEW | DIRTY_PROJ)) viewProjMat = multiply(view(), projection());
+    return viewProjMat;
+}
+
+const Mat4 &Camera::transform() {
+    if (transformDirty) {
+        const Mat4 &vp = viewProj();
+        transformMat = multiply(model(), vp);
+        transformDirty = false;
+        rev++;
+    }
+    return transformMat;
+}
+
+const Mat4 &Camera::inverseTransform() {
+    const Mat4 &t = transform();
+    if (dirty & DIRTY_INVERSE) {
+        if (!inverse(t, inverseMat)) inverseMat = Mat4::identity();
+        dirty &= ~DIRTY_INVERSE;
+    }
+    return inverseMat;
+}
+
+const Vec4* Camera::frustumPlanes() {
+    const Mat4 &t = transform();
+    if (dirty & DIRTY_PLANES) {
+        extractFrustumPlanes(t, planes);
+        dirty &= ~DIRTY_PLANES;
+    }
+    return planes;
+}
+
+Vec3 Camera::eyeInModel() {
+    // eye * R^-1 * T^-1, T chỉ dịch theo Y nên x, z chỉ cần R^T
+    model();
+    return vec3(rotMat.m[0] * eye.x + rotMat.m[1] * eye.y + rotMat.m[2] * eye.z,
+                rotMat.m[4] * eye.x + rotMat.m[5] * eye.y + rotMat.m[6] * eye.z + 0.5f,
+                rotMat.m[8] * eye.x + rotMat.m[9] * eye.y + rotMat.m[10] * eye.z);
+}
@@ -0,0 +1,83 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <cstdint>
+#include "vmath.h"
+
+// Camera "lười": giữ trạng thái nhìn (vị trí mắt, góc xoay vật thể, zoom,
+// loại phép chiếu, kích thước viewport) và chỉ tính lại ma trận khi đầu vào
+// của nó thay đổi. Setter so sánh giá trị mới với cũ nên gọi lại với cùng giá
+// trị không làm bẩn gì.
+// Cảnh được xoay như một vật thể (model = T * R) nên transform() = model * view * proj,
+// frustumPlanes() tính trong không gian model - cùng không gian với núi lửa,
+// địa hình, dòng dung nham và hạt.
+
+class Camera {
+public:
+    // Mặt phẳng cắt gần/xa của cả 2 phép chiếu
+    static constexpr float NEAR_PLANE = 0.01f;
+    static constexpr float FAR_PLANE = 100.0f;
+
+    // Xoay quanh X bị kẹp trong [-1.5, 1.5] như trước
+    void setRotation(float x, float y);
+    void rotate(float dx, float dy) { setRotation(rotX + dx, rotY + dy); }
+    void setEye(float x, float y, float z);
+    void move(float dx, float dy, float dz) { setEye(eye.x + dx, eye.y + dy, eye.z + dz); }
+    void setZoom(float z);
+    void setPerspective(bool on);
+    // Trả về true nếu kích thước khác lần trước (khi đó cần gọi glViewport)
+    bool setViewport(int width, int height);
+
+    float rotationX() const { return rotX; }
+    float rotationY() const { return rotY; }
+    float zoom() const { return zoomValue; }
+    bool perspective() const { return isPerspective; }
+    Vec3 eyePosition() const { return eye; }
+
+    const Mat4 &model();
+    const Mat4 &view();
+    const Mat4 &projection();
+    const Mat4 &viewProj();          // view * proj
+    const Mat4 &transform();         // model * view * proj (uTransform)
+    const Mat4 &inverseTransform();  // clip -> không gian model
+    const Vec4* frustumPlanes();     // 6 mặt phẳng trong không gian model
+    Vec3 eyeInModel();               // vị trí mắt trong không gian model
+
+    // Tăng mỗi khi transform() đổi, để nơi khác biết dữ liệu đã cache còn dùng được không
+    uint32_t revision() const { return rev; }
+
+private:
+    enum {
+        DIRTY_MODEL = 1,
+        DIRTY_VIEW = 2,
+        DIRTY_PROJ = 4,
+        DIRTY_INVERSE = 8,
+        DIRTY_PLANES = 16,
+        DIRTY_ALL = 31
+    };
+
+    float rotX = 0.2f, rotY = 0.0f;
+    Vec3 eye = vec3(0.0f, 4.0f, 12.0f);
+    Vec3 center = vec3(0.0f, 0.0f, 0.0f);
+    Vec3 up = vec3(0.0f, 1.0f, 0.0f);
+    float zoomValue = 1.0f;
+    bool isPerspective = true;
+    int width = 0, height = 0;
+
+    unsigned dirty = DIRTY_ALL;
+    bool transformDirty = true;
+    uint32_t rev = 0;
+
+    Mat4 rotMat = Mat4::identity();
+    Mat4 modelMat = Mat4::identity();
+    Mat4 viewMat = Mat4::identity();
+    Mat4 projMat = Mat4::identity();
+    Mat4 viewProjMat = Mat4::identity();
+    Mat4 transformMat = Mat4::identity();
+    Mat4 inverseMat = Mat4::identity();
+    Vec4 planes[6];
+
+    void markDirty(unsigned flags);
+};
+
+#endif
@@ -0,0 +1,487 @@
+
+#include "lava_flow.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Lớp phủ dung nham: lưới không có VBO, vị trí suy ra từ gl_VertexID,
+// độ cao + độ dày + nhiệt độ đọc từ texture của mô phỏng
+static const char* lavaFlowVertexShaderSrc = R"(
+#version 330 core
+uniform mat4 uTransform;
+uniform sampler2D uData;   // mặt trên, độ dày lỏng, nhiệt độ, crust
+uniform int uResolution;
+uniform float uExtent;
+
+out vec2 vUV;
+
+void main() {
+    int row = uResolution + 1;
+    vec2 uv = vec2(gl_VertexID % row, gl_VertexID / row) / float(uResolution);
+    vec4 d = textureLod(uData, uv, 0.0);
+    vUV = uv;
+    vec3 pos = vec3((uv.x - 0.5) * uExtent, d.x + 0.01, (uv.y - 0.5) * uExtent);
+    gl_Position = uTransform * vec4(pos, 1.0);
+}
+)";
+
+static const char* lavaFlowFragmentShaderSrc = R"(
+#version 330 core
+uniform sampler2D uData;
+uniform vec2 uTempRange;   // nhiệt độ đông đặc, nhiệt độ phun
+
+in vec2 vUV;
+out vec4 FragColor;
+
+void main() {
+    vec4 d = texture(uData, vUV);
+    float liquid = d.y;
+    float rock = d.w;
+    if (liquid < 0.002 && rock < 0.002) discard;
+
+    vec3 rockColor = vec3(0.13, 0.11, 0.10);
+    if (liquid < 0.002) {
+        FragColor = vec4(rockColor, 1.0);
+        return;
+    }
+
+    // Đỏ sẫm -> cam -> vàng theo nhiệt độ, sắp đông thì có vỏ tối
+    float heat = clamp((d.z - uTempRange.x) / (uTempRange.y - uTempRange.x), 0.0, 1.0);
+    vec3 hot = mix(vec3(0.5, 0.05, 0.0), vec3(1.0, 0.45, 0.05), smoothstep(0.0, 0.6, heat));
+    hot = mix(hot, vec3(1.0, 0.85, 0.4), smoothstep(0.6, 1.0, heat));
+    FragColor = vec4(mix(rockColor, hot, smoothstep(0.0, 0.25, heat)), 1.0);
+}
+)";
+
+LavaFlow::~LavaFlow() {
+    shutdown();
+}
+
+void LavaFlow::init(const GroundFn &ground, const LavaFlowParams &p) {
+    if (initialized) shutdown();
+    params = p;
+    groundFn = ground;
+    n = params.gridSize;
+    cellSize = params.extent / n;
+    tilesPerSide = (n + params.tileSize - 1) / params.tileSize;
+    accumulator = 0.0f;
+
+    size_t cells = (size_t)n * n;
+    this->ground.assign(cells, 0.0f);
+    crust.assign(cells, 0.0f);
+    thickness.assign(cells, 0.0f);
+    temperature.assign(cells, params.ambientTemp);
+    srcTemp.assign(cells, params.ambientTemp);
+    flux.assign(cells * 4, 0.0f);
+
+    int tileCount = tilesPerSide * tilesPerSide;
+    tileActive.assign(tileCount, 0);
+    tileFluxWritten.assign(tileCount, 0);
+    tileDirty.assign(tileCount, 1);
+    tileMark.assign(tileCount, 0);
+    activeList.clear();
+    deposits.clear();
+
+    // Luồng chính cũng tham gia mỗi pass
+    quit = false;
+    generation = 0;
+    int threadCount = max(0, (int)thread::hardware_concurrency() - 1);
+    for (int i = 0; i < threadCount; i++) workers.emplace_back(&LavaFlow::workerLoop, this);
+
+    // Lấy mẫu mặt đất song song theo tile
+    workList.resize(tileCount);
+    for (int t = 0; t < tileCount; t++) workList[t] = t;
+    runTiles(&LavaFlow::sampleGroundTile);
+
+    initGpu();
+    initialized = true;
+    cout << "Lava flow initialized (" << n << "x" << n << ", "
+         << threadCount + 1 << " threads)" << endl;
+}
+
+void LavaFlow::shutdown() {
+    if (!initialized) return;
+    {
+        lock_guard<mutex> lock(mtx);
+        quit = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers) w.join();
+    workers.clear();
+
+    if (program) glDeleteProgram(program);
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    if (dataTexture) glDeleteTextures(1, &dataTexture);
+    program = vao = indexBuffer = dataTexture = 0;
+    initialized = false;
+}
+
+// ---------------------------------------------------------------------------
+// Nhóm worker: runTiles() chạy fn trên mọi tile trong workList rồi mới trả về
+
+void LavaFlow::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        runJob();
+        {
+            lock_guard<mutex> lock(mtx);
+            if (++finishedWorkers == (int)workers.size()) doneCv.notify_one();
+        }
+    }
+}
+
+void LavaFlow::runJob() {
+    for (;;) {
+        int i = nextJob.fetch_add(1);
+        if (i >= (int)workList.size()) break;
+        (this->*job)(workList[i]);
+    }
+}
+
+void LavaFlow::runTiles(void (LavaFlow::*fn)(int)) {
+    if (workList.empty()) return;
+    {
+        lock_guard<mutex> lock(mtx);
+        job = fn;
+        nextJob = 0;
+        finishedWorkers = 0;
+        generation++;
+    }
+    cv.notify_all();
+    runJob();
+    unique_lock<mutex> lock(mtx);
+    doneCv.wait(lock, [&] { return finishedWorkers == (int)workers.size(); });
+}
+
+// ---------------------------------------------------------------------------
+// Mô phỏng
+
+void LavaFlow::sampleGroundTile(int tile) {
+    int x0 = (tile % tilesPerSide) * params.tileSize, z0 = (tile / tilesPerSide) * params.tileSize;
+    int x1 = min(x0 + params.tileSize, n), z1 = min(z0 + params.tileSize, n);
+    float origin = -0.5f * params.extent + 0.5f * cellSize;
+    int w = x1 - x0;
+    vector<float> px(w), pz(w);
+    for (int z = z0; z < z1; z++) {
+        for (int x = x0; x < x1; x++) {
+            px[x - x0] = origin + x * cellSize;
+            pz[x - x0] = origin + z * cellSize;
+        }
+        groundFn(px.data(), pz.data(), &ground[(size_t)z * n + x0], w);
+    }
+}
+
+float LavaFlow::surfaceAt(float x, float z) const {
+    float half = 0.5f * params.extent;
+    int cx = (int)floorf((x + half) / cellSize);
+    int cz = (int)floorf((z + half) / cellSize);
+    if (!initialized || cx < 0 || cz < 0 || cx >= n || cz >= n) {
+        float h;
+        groundFn(&x, &z, &h, 1);
+        return h;
+    }
+    size_t i = (size_t)cz * n + cx;
+    return ground[i] + crust[i] + thickness[i];
+}
+
+// Pass 1: lượng chảy từ mỗi ô sang 4 lân cận. Chỉ đọc độ dày, không ghi,
+// nên các tile chạy song song không đụng nhau.
+void LavaFlow::fluxTile(int tile) {
+    int x0 = (tile % tilesPerSide) * params.tileSize, z0 = (tile / tilesPerSide) * params.tileSize;
+    int x1 = min(x0 + params.tileSize, n), z1 = min(z0 + params.tileSize, n);
+    float tempSpan = params.eruptionTemp - params.solidusTemp;
+    float maxRate = 0.2f;  // mỗi hướng tối đa 1/5 chênh lệch -> ổn định với 4 lân cận
+    bool any = false;
+
+    for (int z = z0; z < z1; z++) {
+        for (int x = x0; x < x1; x++) {
+            size_t i = (size_t)z * n + x;
+            float* f = &flux[i * 4];
+            srcTemp[i] = temperature[i];
+            f[0] = f[1] = f[2] = f[3] = 0.0f;
+
+            float h = thickness[i];
+            if (h <= 0.0f) continue;
+            float heat = min(max((temperature[i] - params.solidusTemp) / tempSpan, 0.0f), 1.0f);
+            float mobile = h - (params.yieldCold + (params.yieldHot - params.yieldCold) * heat);
+            if (mobile <= 0.0f) continue;
+
+            float level = ground[i] + crust[i] + h;
+            auto drop = [&](size_t j) {
+                return max(level - (ground[j] + crust[j] + thickness[j]), 0.0f);
+            };
+            float d0 = x + 1 < n ? drop(i + 1) : 0.0f;
+            float d1 = x > 0 ? drop(i - 1) : 0.0f;
+            float d2 = z + 1 < n ? drop(i + n) : 0.0f;
+            float d3 = z > 0 ? drop(i - n) : 0.0f;
+            float sum = d0 + d1 + d2 + d3;
+            if (sum <= 0.0f) continue;
+
+            float rate = min(params.fluidity * heat * params.stepDt, 1.0f) * maxRate;
+            if (sum * rate > mobile) rate = mobile / sum;
+            f[0] = d0 * rate;
+            f[1] = d1 * rate;
+            f[2] = d2 * rate;
+            f[3] = d3 * rate;
+            any = true;
+        }
+    }
+    tileFluxWritten[tile] = any;
+}
+
+// Pass 2: mỗi ô tự cộng dòng vào từ lân cận (chỉ ghi ô của mình), trộn nhiệt,
+// làm nguội và đông đặc
+void LavaFlow::applyTile(int tile) {
+    int x0 = (tile % tilesPerSide) * params.tileSize, z0 = (tile / tilesPerSide) * params.tileSize;
+    int x1 = min(x0 + params.tileSize, n), z1 = min(z0 + params.tileSize, n);
+    float dt = params.stepDt;
+    bool active = false, changed = false;
+
+    for (int z = z0; z < z1; z++) {
+        for (int x = x0; x < x1; x++) {
+            size_t i = (size_t)z * n + x;
+            const float* f = &flux[i * 4];
+            float out = f[0] + f[1] + f[2] + f[3];
+            float in = 0.0f, inHeat = 0.0f;
+            auto gather = [&](size_t j, int dir) {
+                float v = flux[j * 4 + dir];
+                in += v;
+                inHeat += v * srcTemp[j];
+            };
+            if (x > 0) gather(i - 1, 0);
+            if (x + 1 < n) gather(i + 1, 1);
+            if (z > 0) gather(i - n, 2);
+            if (z + 1 < n) gather(i + n, 3);
+
+            float h = thickness[i];
+            if (h <= 0.0f && in <= 0.0f) continue;
+
+            float rest = h - out;
+            float newH = rest + in;
+            float T = newH > 1e-6f ? (rest * temperature[i] + inHeat) / newH : params.ambientTemp;
+
+            // Lớp mỏng mất nhiệt nhanh hơn lớp dày
+            float k = params.coolingRate / max(newH, 0.005f) * dt;
+            T = params.ambientTemp + (T - params.ambientTemp) * max(1.0f - k, 0.0f);
+
+            if (T < params.solidusTemp || newH < 1e-5f) {
+                crust[i] += newH;
+                newH = 0.0f;
+                T = params.ambientTemp;
+            }
+            thickness[i] = newH;
+            temperature[i] = T;
+            active |= newH > 0.0f;
+            changed = true;
+        }
+    }
+    tileActive[tile] = active;
+    if (changed) tileDirty[tile] = 1;
+}
+
+void LavaFlow::addLava(float x, float z, float volume, float temp) {
+    if (!initialized) return;
+    float half = 0.5f * params.extent;
+    int cx = (int)floorf((x + half) / cellSize);
+    int cz = (int)floorf((z + half) / cellSize);
+    if (cx < 0 || cz < 0 || cx >= n || cz >= n) return;
+    lock_guard<mutex> lock(depositMtx);
+    deposits.push_back({cz * n + cx, volume, temp});
+}
+
+void LavaFlow::clear() {
+    if (!initialized) return;
+    {
+        lock_guard<mutex> lock(depositMtx);
+        deposits.clear();
+    }
+    fill(crust.begin(), crust.end(), 0.0f);
+    fill(thickness.begin(), thickness.end(), 0.0f);
+    fill(temperature.begin(), temperature.end(), params.ambientTemp);
+    fill(flux.begin(), flux.end(), 0.0f);
+    fill(tileActive.begin(), tileActive.end(), 0);
+    fill(tileFluxWritten.begin(), tileFluxWritten.end(), 0);
+    fill(tileDirty.begin(), tileDirty.end(), 1);
+    activeList.clear();
+    anyLava = false;
+}
+
+void LavaFlow::step() {
+    // Dung nham mới (hạt rơi xuống)
+    {
+        lock_guard<mutex> lock(depositMtx);
+        float cellArea = cellSize * cellSize;
+        for (const Deposit &d : deposits) {
+            float h = thickness[d.cell];
+            float add = d.volume / cellArea;
+            temperature[d.cell] = (h * temperature[d.cell] + add * d.temperature) / (h + add);
+            thickness[d.cell] = h + add;
+            int tile = (d.cell / n / params.tileSize) * tilesPerSide + (d.cell % n) / params.tileSize;
+            tileActive[tile] = 1;
+            tileDirty[tile] = 1;
+            anyLava = true;
+        }
+        deposits.clear();
+    }
+
+    // Pass 1: tile có dung nham, và tile vừa hết dung nham để xóa flux cũ
+    int tileCount = tilesPerSide * tilesPerSide;
+    workList.clear();
+    for (int t = 0; t < tileCount; t++) {
+        if (tileActive[t] || tileFluxWritten[t]) workList.push_back(t);
+    }
+    if (workList.empty()) return;
+    runTiles(&LavaFlow::fluxTile);
+
+    // Pass 2: tile có dung nham và 4 tile kề (có thể nhận dòng chảy vào)
+    fill(tileMark.begin(), tileMark.end(), 0);
+    for (int t = 0; t < tileCount; t++) {
+        if (!tileActive[t]) continue;
+        int tx = t % tilesPerSide, tz = t / tilesPerSide;
+        tileMark[t] = 1;
+        if (tx > 0) tileMark[t - 1] = 1;
+        if (tx + 1 < tilesPerSide) tileMark[t + 1] = 1;
+        if (tz > 0) tileMark[t - tilesPerSide] = 1;
+        if (tz + 1 < tilesPerSide) tileMark[t + tilesPerSide] = 1;
+    }
+    workList.clear();
+    for (int t = 0; t < tileCount; t++) {
+        if (tileMark[t]) workList.push_back(t);
+    }
+    runTiles(&LavaFlow::applyTile);
+
+    activeList.clear();
+    for (int t = 0; t < tileCount; t++) {
+        if (tileActive[t]) activeList.push_back(t);
+    }
+}
+
+void LavaFlow::update(float dt) {
+    if (!initialized) return;
+    accumulator += dt;
+    int steps = 0;
+    while (accumulator >= params.stepDt && steps < params.maxStepsPerFrame) {
+        step();
+        accumulator -= params.stepDt;
+        steps++;
+    }
+    // Quá tải thì bỏ phần thời gian còn lại thay vì dồn sang frame sau
+    if (steps == params.maxStepsPerFrame) accumulator = min(accumulator, params.stepDt);
+}
+
+// ---------------------------------------------------------------------------
+// GPU
+
+void LavaFlow::initGpu() {
+    auto compile = [](GLenum type, const char* src) {
+        GLuint s = glCreateShader(type);
+        glShaderSource(s, 1, &src, nullptr);
+        glCompileShader(s);
+        GLint ok;
+        glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[2048];
+            glGetShaderInfoLog(s, 2048, nullptr, log);
+            cerr << "Lava flow shader error: " << log << endl;
+        }
+        return s;
+    };
+    GLuint vs = compile(GL_VERTEX_SHADER, lavaFlowVertexShaderSrc);
+    GLuint fs = compile(GL_FRAGMENT_SHADER, lavaFlowFragmentShaderSrc);
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    // Lưới vẽ: chỉ có index, đỉnh thứ k nằm ở (k % (res+1), k / (res+1))
+    int res = params.renderResolution;
+    int row = res + 1;
+    vector<uint32_t> indices;
+    indices.reserve((size_t)res * res * 6);
+    for (int z = 0; z < res; z++) {
+        for (int x = 0; x < res; x++) {
+            uint32_t i0 = z * row + x, i1 = i0 + 1, i2 = i0 + row, i3 = i2 + 1;
+            indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+        }
+    }
+    indexCount = (int)indices.size();
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &dataTexture);
+    glBindTexture(GL_TEXTURE_2D, dataTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, n, n, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Texture đang được bind
+void LavaFlow::uploadTile(int tile) {
+    int x0 = (tile % tilesPerSide) * params.tileSize, z0 = (tile / tilesPerSide) * params.tileSize;
+    int w = min(params.tileSize, n - x0), h = min(params.tileSize, n - z0);
+    staging.resize((size_t)w * h * 4);
+    float* out = staging.data();
+    for (int z = z0; z < z0 + h; z++) {
+        for (int x = x0; x < x0 + w; x++, out += 4) {
+            size_t i = (size_t)z * n + x;
+            out[0] = ground[i] + crust[i] + thickness[i];
+            out[1] = thickness[i];
+            out[2] = temperature[i];
+            out[3] = crust[i];
+        }
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, w, h, GL_RGBA, GL_FLOAT, staging.data());
+}
+
+void LavaFlow::render(const float* transformMatrix) {
+    if (!initialized) return;
+
+    // Chỉ upload tile đã thay đổi
+    glBindTexture(GL_TEXTURE_2D, dataTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (size_t t = 0; t < tileDirty.size(); t++) {
+        if (!tileDirty[t]) continue;
+        uploadTile((int)t);
+        tileDirty[t] = 0;
+    }
+    if (!anyLava) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uTransform"), 1, GL_FALSE, transformMatrix);
+    glUniform1i(glGetUniformLocation(program, "uData"), 0);
+    glUniform1i(glGetUniformLocation(program, "uResolution"), params.renderResolution);
+    glUniform1f(glGetUniformLocation(program, "uExtent"), params.extent);
+    glUniform2f(glGetUniformLocation(program, "uTempRange"), params.solidusTemp, params.eruptionTemp);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Đẩy lớp phủ lên trước mặt đất bên dưới để tránh z-fighting
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(-1.0f, -2.0f);
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,131 @@
+#ifndef LAVA_FLOW_H
+#define LAVA_FLOW_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Mô phỏng dòng dung nham trên lưới độ cao (cellular automaton).
+// Mỗi ô có độ dày dung nham lỏng, nhiệt độ và lớp đá đã đông (crust).
+// Mỗi bước:
+//   1. tính lượng chảy sang 4 ô lân cận theo chênh lệch mặt dung nham,
+//      chỉ phần dày hơn ngưỡng chảy (ngưỡng tăng khi nguội - Bingham)
+//   2. cộng dòng vào/ra, trộn nhiệt, làm nguội; dưới nhiệt độ đông đặc thì
+//      dung nham thành crust và nâng mặt đất lên
+// Lưới chia thành tile, chỉ tile có dung nham (và lân cận) được xử lý, phân
+// việc cho một nhóm worker cố định. Kết quả vẽ thành lớp phủ trên địa hình,
+// độ cao và màu lấy từ texture cập nhật theo tile thay đổi.
+
+struct LavaFlowParams {
+    int gridSize = 1024;            // số ô mỗi cạnh
+    float extent = 48.0f;           // cạnh vùng mô phỏng (đơn vị thế giới), tâm ở gốc
+    int tileSize = 32;              // số ô mỗi cạnh tile khi chia việc
+    int renderResolution = 256;     // lưới vẽ lớp phủ
+    float stepDt = 1.0f / 60.0f;    // bước mô phỏng cố định
+    int maxStepsPerFrame = 4;
+    float fluidity = 6.0f;          // tốc độ chảy khi nóng nhất (1/s)
+    float eruptionTemp = 1150.0f;   // °C
+    float solidusTemp = 700.0f;     // dưới nhiệt độ này dung nham đông cứng
+    float ambientTemp = 20.0f;
+    float coolingRate = 0.003f;     // làm nguội bề mặt, lớp mỏng nguội nhanh hơn
+    float yieldHot = 0.004f;        // độ dày tối thiểu để chảy khi nóng nhất
+    float yieldCold = 0.06f;        // ... khi sắp đông
+    float particleVolume = 0.0006f; // thể tích mỗi hạt dung nham rơi xuống
+};
+
+class LavaFlow {
+public:
+    // Độ cao mặt đất cho một dãy điểm (x, z) trong không gian model,
+    // được gọi đồng thời từ nhiều thread
+    typedef std::function<void(const float* x, const float* z, float* out, size_t count)> GroundFn;
+
+    ~LavaFlow();
+
+    void init(const GroundFn &ground, const LavaFlowParams &params = LavaFlowParams());
+    void shutdown();
+
+    // Thêm dung nham tại (x, z); được áp dụng ở đầu bước mô phỏng kế tiếp
+    void addLava(float x, float z, float volume, float temperature);
+    void addParticle(float x, float z) { addLava(x, z, params.particleVolume, params.eruptionTemp); }
+    void addParticle(float x, float z, float temperature) { addLava(x, z, params.particleVolume, temperature); }
+    void clear();
+
+    void update(float dt);
+    // Vẽ lớp phủ với ma trận biến đổi model (giống núi lửa)
+    void render(const float* transformMatrix);
+
+    // Mặt trên (đất + crust + dung nham lỏng) tại ô chứa (x, z);
+    // ngoài lưới thì hỏi lại hàm mặt đất
+    float surfaceAt(float x, float z) const;
+
+    int activeTiles() const { return (int)activeList.size(); }
+    const LavaFlowParams &getParams() const { return params; }
+
+private:
+    struct Deposit { int cell; float volume, temperature; };
+
+    LavaFlowParams params;
+    GroundFn groundFn;
+    bool initialized = false;
+    int n = 0;              // gridSize
+    int tilesPerSide = 0;
+    float cellSize = 0.0f;
+    float accumulator = 0.0f;
+
+    // Trạng thái lưới (n*n)
+    std::vector<float> ground;      // mặt đất gốc
+    std::vector<float> crust;       // đá đã đông
+    std::vector<float> thickness;   // dung nham lỏng
+    std::vector<float> temperature;
+    std::vector<float> srcTemp;     // nhiệt độ lúc tính dòng chảy (đọc bởi tile lân cận)
+    std::vector<float> flux;        // 4 hướng mỗi ô: +x, -x, +z, -z
+
+    // Trạng thái tile
+    std::vector<uint8_t> tileActive;     // có dung nham lỏng
+    std::vector<uint8_t> tileFluxWritten;// flux của tile khác 0 từ bước trước
+    std::vector<uint8_t> tileDirty;      // cần upload lại texture
+    std::vector<uint8_t> tileMark;
+    std::vector<int> activeList;
+    std::vector<int> workList;
+    std::vector<Deposit> deposits;
+    std::mutex depositMtx;
+
+    // Worker: mỗi lượt chạy một pass trên workList
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::condition_variable doneCv;
+    void (LavaFlow::*job)(int) = nullptr;
+    std::atomic<int> nextJob{0};
+    uint64_t generation = 0;
+    int finishedWorkers = 0;
+    bool quit = false;
+
+    // GPU
+    unsigned int program = 0;
+    unsigned int vao = 0;
+    unsigned int indexBuffer = 0;
+    unsigned int dataTexture = 0;   // RGBA32F: mặt trên, độ dày lỏng, nhiệt độ, crust
+    int indexCount = 0;
+    bool anyLava = false;
+    std::vector<float> staging;
+
+    void workerLoop();
+    void runJob();
+    void runTiles(void (LavaFlow::*fn)(int));
+
+    void sampleGroundTile(int tile);
+    void fluxTile(int tile);
+    void applyTile(int tile);
+    void step();
+
+    void initGpu();
+    void uploadTile(int tile);
+};
+
+#endif
@@ -0,0 +1,231 @@
+
+#include "lava_lights.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Texture unit của 3 texture buffer (đèn, cụm, chỉ số); 0..2 dành cho hạt và LowResPass
+static const int LIGHT_TEXTURE_UNIT = 3;
+
+LavaLights::~LavaLights() {
+    shutdown();
+}
+
+void LavaLights::clear() {
+    points.clear();
+    lights.clear();
+    directLights = 0;
+}
+
+void LavaLights::addPoint(Vec3 pos, Vec3 color) {
+    points.push_back({pos, color});
+}
+
+void LavaLights::addLight(Vec3 pos, float radius, Vec3 color) {
+    // Đèn riêng luôn nằm trước các đèn gộp
+    lights.insert(lights.begin() + directLights, Light{pos, color, radius});
+    directLights++;
+}
+
+// Các điểm cùng ô lưới thành một đèn: vị trí là trọng tâm theo độ sáng, màu
+// là tổng, bán kính tăng theo căn bậc hai số điểm
+void LavaLights::mergePoints() {
+    lights.resize(directLights);
+    if (points.empty()) return;
+
+    float invCell = 1.0f / params.mergeCell;
+    cells.clear();
+    cells.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        const Vec3 &p = points[i].pos;
+        // 21 bit mỗi trục, lệch 2^20 để tọa độ ô âm vẫn dương
+        uint64_t cx = (uint64_t)((int64_t)floorf(p.x * invCell) + (1 << 20)) & 0x1FFFFF;
+        uint64_t cy = (uint64_t)((int64_t)floorf(p.y * invCell) + (1 << 20)) & 0x1FFFFF;
+        uint64_t cz = (uint64_t)((int64_t)floorf(p.z * invCell) + (1 << 20)) & 0x1FFFFF;
+        cells.push_back({(cx << 42) | (cy << 21) | cz, (uint32_t)i});
+    }
+    sort(cells.begin(), cells.end());
+
+    for (size_t a = 0; a < cells.size();) {
+        size_t b = a;
+        Vec3 center = vec3(0.0f, 0.0f, 0.0f), color = vec3(0.0f, 0.0f, 0.0f);
+        float weight = 0.0f;
+        for (; b < cells.size() && cells[b].first == cells[a].first; b++) {
+            const Point &p = points[cells[b].second];
+            float w = p.color.x + p.color.y + p.color.z;
+            center = center + p.pos * w;
+            color = color + p.color;
+            weight += w;
+        }
+        size_t count = b - a;
+        a = b;
+        // Dung nham đã nguội gần hết thì không còn sáng
+        if (weight < 1e-3f) continue;
+        float radius = min(params.pointRadius * sqrtf((float)count), params.maxRadius);
+        lights.push_back({center * (1.0f / weight), color * params.pointIntensity, radius});
+    }
+
+    // Quá nhiều đèn: giữ các đèn gộp sáng nhất
+    size_t maxMerged = (size_t)max(params.maxLights - (int)directLights, 0);
+    if (lights.size() - directLights > maxMerged) {
+        auto brightness = [](const Light &l) { return l.color.x + l.color.y + l.color.z; };
+        nth_element(lights.begin() + directLights, lights.begin() + directLights + maxMerged, lights.end(),
+                    [&](const Light &l, const Light &r) { return brightness(l) > brightness(r); });
+        lights.resize(directLights + maxMerged);
+    }
+}
+
+// Chiếu hộp bao của từng đèn lên màn hình (8 góc) để lấy khoảng ô x, y và
+// khoảng lớp độ sâu, rồi đếm - cộng dồn - điền như counting sort
+void LavaLights::assignClusters(const Mat4 &transform) {
+    const int total = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+    clusterData.assign(total * 2, 0);
+    lightRange.resize(lights.size() * 6);
+    float logScale = (CLUSTER_Z - 1) / logf(zFar / params.sliceNear);
+    auto slice = [&](float d) {
+        if (d <= params.sliceNear) return 0;
+        return min(CLUSTER_Z - 1, 1 + (int)(logf(d / params.sliceNear) * logScale));
+    };
+    auto tile = [](float ndc, int n) {
+        return min(max((int)floorf((ndc * 0.5f + 0.5f) * n), 0), n - 1);
+    };
+
+    size_t assigned = 0;
+    for (size_t i = 0; i < lights.size(); i++) {
+        const Light &l = lights[i];
+        uint32_t* range = &lightRange[i * 6];
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+        float minD = 1e30f, maxD = -1e30f;
+        bool behind = false;
+        for (int c = 0; c < 8; c++) {
+            Vec3 corner = vec3(l.pos.x + ((c & 1) ? l.radius : -l.radius),
+                               l.pos.y + ((c & 2) ? l.radius : -l.radius),
+                               l.pos.z + ((c & 4) ? l.radius : -l.radius));
+            Vec4 clip = transformPoint(transform, corner);
+            float d;
+            if (perspective) {
+                d = clip.w;
+                // Góc nằm sau mặt phẳng gần: không chiếu được, phủ cả màn hình
+                if (clip.w <= zNear) { behind = true; minD = min(minD, zNear); maxD = max(maxD, d); continue; }
+            } else {
+                d = zNear + (clip.z * 0.5f + 0.5f) * (zFar - zNear);
+            }
+            float invW = 1.0f / clip.w;
+            minX = min(minX, clip.x * invW); maxX = max(maxX, clip.x * invW);
+            minY = min(minY, clip.y * invW); maxY = max(maxY, clip.y * invW);
+            minD = min(minD, d); maxD = max(maxD, d);
+        }
+        if (behind) { minX = minY = -1.0f; maxX = maxY = 1.0f; }
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || maxD < zNear || minD > zFar) {
+            range[0] = 1; range[1] = 0;  // ngoài frustum
+            continue;
+        }
+        range[0] = tile(minX, CLUSTER_X); range[1] = tile(maxX, CLUSTER_X);
+        range[2] = tile(minY, CLUSTER_Y); range[3] = tile(maxY, CLUSTER_Y);
+        range[4] = slice(max(minD, zNear)); range[5] = slice(min(maxD, zFar));
+        for (uint32_t z = range[4]; z <= range[5]; z++)
+            for (uint32_t y = range[2]; y <= range[3]; y++)
+                for (uint32_t x = range[0]; x <= range[1]; x++)
+                    clusterData[((z * CLUSTER_Y + y) * CLUSTER_X + x) * 2 + 1]++;
+        assigned += (size_t)(range[1] - range[0] + 1) * (range[3] - range[2] + 1) * (range[5] - range[4] + 1);
+    }
+
+    uint32_t offset = 0;
+    for (int c = 0; c < total; c++) {
+        clusterData[c * 2] = offset;
+        offset += clusterData[c * 2 + 1];
+        clusterData[c * 2 + 1] = 0;  // dùng lại làm con trỏ điền
+    }
+    indices.resize(assigned);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const uint32_t* range = &lightRange[i * 6];
+        if (range[0] > range[1]) continue;
+        for (uint32_t z = range[4]; z <= range[5]; z++)
+            for (uint32_t y = range[2]; y <= range[3]; y++)
+                for (uint32_t x = range[0]; x <= range[1]; x++) {
+                    uint32_t* cl = &clusterData[((z * CLUSTER_Y + y) * CLUSTER_X + x) * 2];
+                    indices[cl[0] + cl[1]++] = (uint32_t)i;
+                }
+    }
+}
+
+void LavaLights::build(const Mat4 &transform, bool persp, float nearPlane, float farPlane, int w, int h) {
+    perspective = persp;
+    zNear = nearPlane;
+    zFar = farPlane;
+    width = max(w, 1);
+    height = max(h, 1);
+    if (!enabled) {
+        lights.clear();
+        indices.clear();
+        return;
+    }
+    mergePoints();
+    assignClusters(transform);
+    dirty = true;
+}
+
+void LavaLights::initGpu() {
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+}
+
+void LavaLights::upload() {
+    if (textures[0] == 0) initGpu();
+
+    lightData.resize(max(lights.size(), (size_t)1) * 8, 0.0f);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const Light &l = lights[i];
+        float* d = &lightData[i * 8];
+        d[0] = l.pos.x; d[1] = l.pos.y; d[2] = l.pos.z; d[3] = l.radius;
+        d[4] = l.color.x; d[5] = l.color.y; d[6] = l.color.z; d[7] = 0.0f;
+    }
+    // Texture buffer không được rỗng
+    static const uint32_t noIndex = 0;
+
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    const void* data[3] = {lightData.data(), clusterData.data(), indices.empty() ? &noIndex : indices.data()};
+    size_t sizes[3] = {lightData.size() * sizeof(float), clusterData.size() * sizeof(uint32_t),
+                       max(indices.size(), (size_t)1) * sizeof(uint32_t)};
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LavaLights::bind(unsigned int program) {
+    // Chưa build lần nào: vẫn cần texture hợp lệ cho các sampler
+    if (clusterData.empty()) clusterData.assign(CLUSTER_X * CLUSTER_Y * CLUSTER_Z * 2, 0);
+    // Upload một lần sau mỗi build(), các program sau dùng lại
+    if (dirty || textures[0] == 0) {
+        upload();
+        dirty = false;
+    }
+    const char* names[3] = {"uLights", "uLightClusters", "uLightIndices"};
+    for (int i = 0; i < 3; i++) {
+        glUniform1i(glGetUniformLocation(program, names[i]), LIGHT_TEXTURE_UNIT + i);
+        glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    float logScale = (CLUSTER_Z - 1) / logf(zFar / params.sliceNear);
+    glUniform1i(glGetUniformLocation(program, "uLightCount"), enabled ? (int)lights.size() : 0);
+    glUniform3i(glGetUniformLocation(program, "uClusterGrid"), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+    glUniform2f(glGetUniformLocation(program, "uClusterViewport"), (float)width, (float)height);
+    glUniform4f(glGetUniformLocation(program, "uClusterDepth"), zNear, zFar, params.sliceNear, logScale);
+    glUniform1i(glGetUniformLocation(program, "uClusterPerspective"), perspective ? 1 : 0);
+}
+
+void LavaLights::shutdown() {
+    if (textures[0] == 0) return;
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+    for (int i = 0; i < 3; i++) textures[i] = buffers[i] = 0;
+}
@@ -0,0 +1,104 @@
+#ifndef LAVA_LIGHTS_H
+#define LAVA_LIGHTS_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "vmath.h"
+
+// Đèn điểm từ dung nham (hạt dung nham, hồ dung nham trong miệng núi) chiếu
+// lên núi lửa và địa hình, chia theo cụm (clustered shading):
+// - Mỗi frame CPU gộp các điểm phát sáng gần nhau thành một đèn theo ô lưới
+//   (nhiều hạt -> ít đèn), rồi gán từng đèn vào các cụm của lưới
+//   CLUSTER_X x CLUSTER_Y ô màn hình x CLUSTER_Z lớp độ sâu (chia theo log).
+// - Danh sách đèn, (offset, số đèn) của từng cụm và chỉ số đèn được upload qua
+//   3 texture buffer; fragment shader chỉ duyệt các đèn thuộc cụm của nó.
+// Mọi vị trí trong không gian model (cùng không gian với Camera::transform()).
+//
+// Uniform mà fragment shader cần khai báo (bind() gán):
+//   samplerBuffer uLights        2 texel mỗi đèn: (vị trí, bán kính), (màu, 0)
+//   usamplerBuffer uLightClusters (offset, số đèn) mỗi cụm
+//   usamplerBuffer uLightIndices  chỉ số đèn
+//   int uLightCount               0: không có đèn, bỏ qua
+//   ivec3 uClusterGrid; vec2 uClusterViewport;
+//   vec4 uClusterDepth            near, far, độ sâu hết lớp 0, số lớp / log(far / độ sâu đó)
+//   int uClusterPerspective
+
+struct LavaLightsParams {
+    float mergeCell = 0.5f;        // ô gộp điểm phát sáng (đơn vị model)
+    float pointRadius = 0.8f;      // bán kính ảnh hưởng của một điểm
+    float pointIntensity = 0.15f;  // độ sáng của một điểm
+    float maxRadius = 2.5f;        // đèn gộp từ nhiều điểm to dần theo căn bậc hai số điểm
+    int maxLights = 1024;          // nhiều hơn thì giữ các đèn sáng nhất
+    float sliceNear = 0.5f;        // lớp độ sâu đầu tiên phủ [near, sliceNear]
+};
+
+class LavaLights {
+public:
+    static const int CLUSTER_X = 16;
+    static const int CLUSTER_Y = 9;
+    static const int CLUSTER_Z = 16;
+
+    ~LavaLights();
+
+    LavaLightsParams params;
+    bool enabled = true;
+
+    void clear();
+    // Điểm phát sáng, gộp với các điểm cùng ô lưới
+    void addPoint(Vec3 pos, Vec3 color);
+    // Đèn riêng, không gộp (vd. hồ dung nham trong miệng núi)
+    void addLight(Vec3 pos, float radius, Vec3 color);
+
+    // Gộp điểm, gán đèn vào cụm theo transform (model -> clip); chỉ chạy trên
+    // CPU, dữ liệu được upload ở lần bind() kế tiếp
+    void build(const Mat4 &transform, bool perspective, float zNear, float zFar, int width, int height);
+    // Gán uniform + texture cho program đang dùng (gọi sau glUseProgram, mỗi
+    // program vẽ bằng fragment shader có chiếu sáng dung nham đều phải gọi)
+    void bind(unsigned int program);
+    void shutdown();
+
+    size_t lightCount() const { return lights.size(); }
+    size_t pointCount() const { return points.size(); }
+    size_t assignmentCount() const { return indices.size(); }
+
+    struct Light {
+        Vec3 pos;
+        Vec3 color;
+        float radius;
+    };
+    // Kết quả build() (để kiểm tra): đèn riêng rồi đèn gộp, (offset, số đèn)
+    // của cụm (z * CLUSTER_Y + y) * CLUSTER_X + x, chỉ số đèn của các cụm
+    const std::vector<Light> &lightList() const { return lights; }
+    const std::vector<uint32_t> &clusterTable() const { return clusterData; }
+    const std::vector<uint32_t> &lightIndices() const { return indices; }
+
+private:
+    struct Point {
+        Vec3 pos;
+        Vec3 color;
+    };
+
+    std::vector<Point> points;
+    std::vector<Light> lights;          // đèn riêng + đèn gộp
+    size_t directLights = 0;            // số đèn riêng ở đầu lights
+    std::vector<std::pair<uint64_t, uint32_t>> cells;  // (ô lưới, chỉ số điểm)
+    std::vector<float> lightData;       // 8 float mỗi đèn
+    std::vector<uint32_t> clusterData;  // (offset, số đèn) mỗi cụm
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> lightRange;   // tạm: 6 chỉ số cụm min/max mỗi đèn
+    bool perspective = true;
+    float zNear = 0.01f, zFar = 100.0f;
+    int width = 1, height = 1;
+    bool dirty = false;                 // build() xong, chưa upload
+
+    unsigned int buffers[3] = {0, 0, 0};   // đèn, cụm, chỉ số
+    unsigned int textures[3] = {0, 0, 0};
+
+    void mergePoints();
+    void assignClusters(const Mat4 &transform);
+    void upload();
+    void initGpu();
+};
+
+#endif
@@ -0,0 +1,282 @@
+
+#include "lowres_pass.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// Tam giác phủ kín màn hình, không cần VBO
+static const char* lowResVertexShaderSrc = R"(
+#version 330 core
+void main() {
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Thu nhỏ độ sâu: mỗi texel nhỏ lấy điểm xa nhất trong khối factor x factor,
+// ghi vào depth buffer của FBO nhỏ và bản tuyến tính cho bước ghép
+static const char* lowResDownsampleShaderSrc = R"(
+#version 330 core
+uniform sampler2D uDepth;
+uniform int uFactor;
+uniform vec2 uNearFar;
+uniform int uPerspective;
+
+out float LinearDepth;
+
+float linearDepth(float d) {
+    float n = uNearFar.x, f = uNearFar.y;
+    return uPerspective != 0 ? n * f / (f - d * (f - n)) : n + d * (f - n);
+}
+
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * uFactor;
+    ivec2 maxCoord = textureSize(uDepth, 0) - 1;
+    float d = 0.0;
+    for (int j = 0; j < uFactor; j++)
+        for (int i = 0; i < uFactor; i++)
+            d = max(d, texelFetch(uDepth, min(base + ivec2(i, j), maxCoord), 0).r);
+    gl_FragDepth = d;
+    LinearDepth = linearDepth(d);
+}
+)";
+
+// Ghép: nội suy song tuyến 4 texel nhỏ quanh pixel. Nếu độ sâu của cả 4 gần
+// với độ sâu pixel (phần lớn màn hình) thì dùng luôn kết quả lọc tuyến tính của
+// phần cứng; ở mép núi thì trọng số song tuyến được nhân thêm độ giống nhau về
+// độ sâu để texel thuộc bề mặt khác gần như không được tính.
+// Màu đã nhân alpha, a = độ trong suốt còn lại: blend ONE, SRC_ALPHA.
+static const char* lowResCompositeShaderSrc = R"(
+#version 330 core
+uniform sampler2D uColor;
+uniform sampler2D uLowDepth;
+uniform sampler2D uDepth;
+uniform int uFactor;
+uniform vec2 uNearFar;
+uniform int uPerspective;
+uniform float uTolerance;
+
+out vec4 FragColor;
+
+float linearDepth(float d) {
+    float n = uNearFar.x, f = uNearFar.y;
+    return uPerspective != 0 ? n * f / (f - d * (f - n)) : n + d * (f - n);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 lowSize = textureSize(uColor, 0);
+    vec2 lowPos = (vec2(p) + 0.5) / float(uFactor) - 0.5;
+    vec4 filtered = texture(uColor, (lowPos + 0.5) / vec2(lowSize));
+    // Không có hạt nào quanh đây
+    if (filtered.a > 0.999) discard;
+
+    float z = linearDepth(texelFetch(uDepth, p, 0).r);
+    ivec2 base = ivec2(floor(lowPos));
+    vec2 f = lowPos - vec2(base);
+    ivec2 c0 = clamp(base, ivec2(0), lowSize - 1);
+    ivec2 c1 = clamp(base + 1, ivec2(0), lowSize - 1);
+    ivec2 c[4] = ivec2[4](c0, ivec2(c1.x, c0.y), ivec2(c0.x, c1.y), c1);
+
+    vec4 lowZ = vec4(texelFetch(uLowDepth, c[0], 0).r, texelFetch(uLowDepth, c[1], 0).r,
+                     texelFetch(uLowDepth, c[2], 0).r, texelFetch(uLowDepth, c[3], 0).r);
+    vec4 t = abs(lowZ - z) / (z * uTolerance);
+    if (max(max(t.x, t.y), max(t.z, t.w)) < 1.0) {
+        FragColor = filtered;
+        return;
+    }
+
+    vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    t *= t;
+    w = w / (1.0 + t * t) + 1e-6;
+    vec4 sum = vec4(0.0);
+    for (int k = 0; k < 4; k++) sum += texelFetch(uColor, c[k], 0) * w[k];
+    FragColor = sum / dot(w, vec4(1.0));
+}
+)";
+
+static GLuint compileLowResShader(GLenum type, const char* src) {
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, 1, &src, nullptr);
+    glCompileShader(s);
+    GLint ok;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[2048];
+        glGetShaderInfoLog(s, 2048, nullptr, log);
+        cerr << "Low-res pass shader error: " << log << endl;
+    }
+    return s;
+}
+
+static GLuint linkLowResProgram(GLuint vs, const char* fragmentSrc) {
+    GLuint fs = compileLowResShader(GL_FRAGMENT_SHADER, fragmentSrc);
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+    glDeleteShader(fs);
+    return prog;
+}
+
+static GLuint createTexture(GLint internalFormat, GLenum format, GLenum type, int w, int h) {
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, nullptr);
+    // Đọc bằng texelFetch
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+LowResPass::~LowResPass() {
+    shutdown();
+}
+
+void LowResPass::initGpu() {
+    GLuint vs = compileLowResShader(GL_VERTEX_SHADER, lowResVertexShaderSrc);
+    downsampleProgram = linkLowResProgram(vs, lowResDownsampleShaderSrc);
+    compositeProgram = linkLowResProgram(vs, lowResCompositeShaderSrc);
+    glDeleteShader(vs);
+    glGenVertexArrays(1, &vao);
+}
+
+void LowResPass::allocate(int w, int h) {
+    release();
+    width = w;
+    height = h;
+    allocatedFactor = factor;
+    int lw = max((w + factor - 1) / factor, 1), lh = max((h + factor - 1) / factor, 1);
+
+    sceneDepth = createTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, w, h);
+    lowDepth = createTexture(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, lw, lh);
+    lowLinearDepth = createTexture(GL_R32F, GL_RED, GL_FLOAT, lw, lh);
+    lowColor = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, lw, lh);
+    // Lọc tuyến tính cho phép thử "có hạt quanh đây không" trong bước ghép
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &depthFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lowLinearDepth, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, lowDepth, 0);
+    GLenum depthStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glGenFramebuffers(1, &particleFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, particleFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lowColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, lowDepth, 0);
+    GLenum particleStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    if (depthStatus != GL_FRAMEBUFFER_COMPLETE || particleStatus != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Low-res pass: FBO khong hoan chinh" << endl;
+        release();
+    }
+}
+
+bool LowResPass::begin(int w, int h, bool persp, float n, float f) {
+    if (factor <= 1 || w <= 0 || h <= 0) return false;
+    if (downsampleProgram == 0) initGpu();
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevFbo);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, prevClear);
+    if (w != width || h != height || factor != allocatedFactor || particleFbo == 0) {
+        allocate(w, h);
+        glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+        if (particleFbo == 0) return false;
+    }
+    perspective = persp;
+    zNear = n;
+    zFar = f;
+    int lw = max((w + factor - 1) / factor, 1), lh = max((h + factor - 1) / factor, 1);
+
+    // Độ sâu của cảnh (framebuffer đang đọc) vào texture
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, w, h);
+
+    // Thu nhỏ: ghi mọi texel bất kể độ sâu cũ
+    glBindFramebuffer(GL_FRAMEBUFFER, depthFbo);
+    glViewport(0, 0, lw, lh);
+    glDepthFunc(GL_ALWAYS);
+    glDisable(GL_BLEND);
+    glUseProgram(downsampleProgram);
+    glUniform1i(glGetUniformLocation(downsampleProgram, "uDepth"), 0);
+    glUniform1i(glGetUniformLocation(downsampleProgram, "uFactor"), factor);
+    glUniform2f(glGetUniformLocation(downsampleProgram, "uNearFar"), zNear, zFar);
+    glUniform1i(glGetUniformLocation(downsampleProgram, "uPerspective"), perspective ? 1 : 0);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_BLEND);
+
+    // Chưa có hạt nào: màu 0, độ trong suốt 1
+    glBindFramebuffer(GL_FRAMEBUFFER, particleFbo);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return true;
+}
+
+void LowResPass::end() {
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+    glClearColor(prevClear[0], prevClear[1], prevClear[2], prevClear[3]);
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+
+    glUseProgram(compositeProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lowColor);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, lowLinearDepth);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glUniform1i(glGetUniformLocation(compositeProgram, "uColor"), 0);
+    glUniform1i(glGetUniformLocation(compositeProgram, "uLowDepth"), 1);
+    glUniform1i(glGetUniformLocation(compositeProgram, "uDepth"), 2);
+    glUniform1i(glGetUniformLocation(compositeProgram, "uFactor"), factor);
+    glUniform2f(glGetUniformLocation(compositeProgram, "uNearFar"), zNear, zFar);
+    glUniform1i(glGetUniformLocation(compositeProgram, "uPerspective"), perspective ? 1 : 0);
+    glUniform1f(glGetUniformLocation(compositeProgram, "uTolerance"), params.depthTolerance);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void LowResPass::release() {
+    if (depthFbo) glDeleteFramebuffers(1, &depthFbo);
+    if (particleFbo) glDeleteFramebuffers(1, &particleFbo);
+    GLuint textures[4] = { sceneDepth, lowDepth, lowLinearDepth, lowColor };
+    for (GLuint t : textures) if (t) glDeleteTextures(1, &t);
+    depthFbo = particleFbo = 0;
+    sceneDepth = lowDepth = lowLinearDepth = lowColor = 0;
+    width = height = allocatedFactor = 0;
+}
+
+void LowResPass::shutdown() {
+    if (downsampleProgram == 0) return;
+    release();
+    glDeleteProgram(downsampleProgram);
+    glDeleteProgram(compositeProgram);
+    glDeleteVertexArrays(1, &vao);
+    downsampleProgram = compositeProgram = vao = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef LOWRES_PASS_H
+#define LOWRES_PASS_H
+
+// Vẽ hạt vào FBO có độ phân giải 1/factor rồi ghép lên framebuffer đang bind,
+// giảm số fragment phải tô cho các đám khói lớn chồng lên nhau (fill rate).
+// - begin(): chép độ sâu của cảnh vào texture, thu nhỏ (lấy điểm xa nhất của
+//   mỗi khối factor x factor, để hạt ở mép núi không bị cắt mất) làm depth
+//   buffer của FBO nhỏ rồi bind FBO nhỏ. Hạt vẽ vào đây cần nhân kích thước
+//   điểm với 1/factor và blend sao cho alpha đích là độ trong suốt còn lại
+//   (xem ParticleSystem::renderDownsample).
+// - end(): ghép lại bằng nội suy song tuyến có trọng số theo độ sâu (bilateral
+//   upsample): texel nhỏ có độ sâu khác xa pixel đang tô (hạt sau mép núi) gần
+//   như không được tính.
+// Độ phân giải đầy đủ (factor = 1) thì begin() trả về false và không làm gì.
+
+struct LowResPassParams {
+    float depthTolerance = 0.05f;  // chênh lệch độ sâu tương đối vẫn coi là cùng bề mặt
+};
+
+class LowResPass {
+public:
+    ~LowResPass();
+
+    LowResPassParams params;
+    int factor = 1;  // 1, 2 hoặc 4
+
+    // width/height: kích thước framebuffer hiện tại; phép chiếu dùng để tuyến
+    // tính hóa độ sâu. Trả về true nếu FBO nhỏ đã được bind.
+    bool begin(int width, int height, bool perspective, float zNear, float zFar);
+    // Ghép kết quả lên framebuffer trước begin(), khôi phục viewport và trạng thái
+    void end();
+    void shutdown();
+
+private:
+    unsigned int downsampleProgram = 0;
+    unsigned int compositeProgram = 0;
+    unsigned int vao = 0;           // rỗng: tam giác phủ màn hình sinh từ gl_VertexID
+    unsigned int sceneDepth = 0;    // độ sâu cảnh, đủ độ phân giải
+    unsigned int lowDepth = 0;      // depth buffer của FBO nhỏ
+    unsigned int lowLinearDepth = 0;// độ sâu tuyến tính thu nhỏ (R32F), cho bước ghép
+    unsigned int lowColor = 0;
+    unsigned int depthFbo = 0;      // lowLinearDepth + lowDepth
+    unsigned int particleFbo = 0;   // lowColor + lowDepth
+    int width = 0, height = 0, allocatedFactor = 0;
+
+    // Trạng thái lúc begin() để end() trả lại
+    int prevFbo = 0;
+    int prevViewport[4] = {0, 0, 0, 0};
+    float prevClear[4] = {0, 0, 0, 0};
+    bool perspective = true;
+    float zNear = 0.01f, zFar = 100.0f;
+
+    void initGpu();
+    void allocate(int w, int h);
+    void release();
+};
+
+#endif
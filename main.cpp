@@ -4,7 +4,24 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <random>
 #include "particle_system.h"  // Thêm include cho hệ thống hạt
+#include "offscreen.h"        // Render không cửa sổ + lưu frame
+#include "video_capture.h"    // Ghi hình bất đồng bộ qua PBO
+#include "terrain.h"          // Địa hình tile thay cho mặt phẳng dung nham
+#include "mesh_cache.h"       // Cache lưới nhị phân (mmap)
+#include "noise.h"            // Nhiễu simplex/fBm cho bề mặt núi
+#include "lava_flow.h"        // Mô phỏng dòng dung nham trên mặt đất
+#include "mesh_deform.h"      // Biến dạng cục bộ lưới núi lửa
+#include "vmath.h"            // Vector/ma trận căn lề 16 byte, nhân ma trận SIMD
+#include "camera.h"           // Camera chỉ tính lại ma trận khi đầu vào đổi
+#include "sdf.h"              // SDF thưa cho va chạm hạt với thành miệng núi
+#include "lowres_pass.h"      // Vẽ hạt ở độ phân giải thấp rồi ghép lại
+#include "volcano_field.h"    // Cánh đồng núi lửa phụ vẽ instanced
+#include "lava_lights.h"      // Đèn điểm từ dung nham, chia cụm
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -13,219 +30,283 @@
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 800;
 
-// Buffers
-GLuint VAO, VBO[2];
-std::vector<float> vertices;
-std::vector<float> normals;
+// Buffers (chỉ vị trí: normal phẳng suy ra trong fragment shader)
+GLuint VAO, VBO;
+std::vector<float> vertices;    // lưới vừa sinh khi cache chưa có
+MeshCacheView meshCache;        // cache lưới đã map, giữ tới destroyScene()
+const float* volcanoPositions = nullptr;  // lưới gốc của núi lửa: vùng map của cache hoặc vertices
 GLuint shaderProgram;
+size_t volcanoVertexCount = 0;  // số đỉnh của núi lửa, phần sau là mặt phẳng dung nham
+size_t totalVertexCount = 0;    // tổng số đỉnh trong VBO (lưới có thể đến từ cache)
 
-// Phép chiếu
-bool isPerspective = true;
+// Biến dạng lúc chạy: dung nham bám sườn núi, tro rơi (phím J), sụt miệng núi (phím K)
+MeshDeformer volcanoDeformer;
+bool ashFall = false;
+std::mt19937 deformRng(7);
 
-// Camera controls
-float rotationX = 0.2f; 
-float rotationY = 0.0f;
-float eyeX = 0.0f, eyeY = 4.0f, eyeZ = 12.0f; 
-float centerX = 0.0f, centerY = 0.0f, centerZ = 0.0f;
-float upX = 0.0f, upY = 1.0f, upZ = 0.0f;
-float zoom = 1.0f;
+// Địa hình (phím T bật/tắt, tắt thì dùng lại mặt phẳng dung nham)
+Terrain terrain;
+LavaFlow lavaFlow;
+bool useLavaFlow=true;
+bool useTerrain = true;
+bool terrainBlocking = false;  // headless: chờ tile sinh xong để ảnh lặp lại được
+
+// Núi lửa phụ rải trên địa hình (phím B bật/tắt)
+VolcanoField volcanoField;
+
+// Camera: góc xoay, vị trí mắt, zoom, phép chiếu (phím P)
+Camera camera;
+
+// Hạt vẽ ở độ phân giải 1, 1/2 hoặc 1/4 (phím H)
+LowResPass particlePass;
+
+// Dung nham chiếu sáng núi lửa và địa hình (phím O bật/tắt)
+LavaLights lavaLights;
+std::vector<LavaGlow> lavaGlow;
 bool isWireframe = false;
 
+// Kích thước framebuffer, cập nhật qua callback thay vì hỏi GLFW mỗi frame
+int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
+
+// Ghi hình (phím V)
+VideoCapture videoCapture;
+int recordingCount = 0;
+
 // Mouse state
 bool mousePressed = false;
 double lastX, lastY;
 
-struct Vec3 { float x, y, z; };
+// Helper
+// Thêm tam giác
+void addTriangle(float* v0,float* v1,float* v2){
+    vertices.insert(vertices.end(),{v0[0],v0[1],v0[2], v1[0],v1[1],v1[2], v2[0],v2[1],v2[2]});
+}
 
-Vec3 normalize(Vec3 v) {
-    float len = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
-    if (len > 0.0f) return {v.x / len, v.y / len, v.z / len};
-    return v;
+// Ghi tam giác vào vị trí cố định (dùng khi sinh song song)
+void writeTriangle(float* vOut,const float* v0,const float* v1,const float* v2){
+    for(int k=0;k<3;k++){ vOut[k]=v0[k]; vOut[3+k]=v1[k]; vOut[6+k]=v2[k]; }
 }
 
-Vec3 cross(Vec3 a, Vec3 b) {
-    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+// Tham số sinh lưới núi lửa
+struct VolcanoParams {
+    int baseSegments=64;
+    int heightSegments=8;
+    int craterSegments=32;
+    float baseRadius=2.0f;
+    float craterRadius=0.3f;
+    float volcanoHeight=2.5f;
+    float craterDepth=0.4f;
+    float surfaceNoise=0.2f;      // độ lồi lõm tương đối của sườn núi
+    float noiseFrequency=1.5f;
+    uint32_t noiseSeed=7;
+};
+VolcanoParams volcanoParams;
+
+// Số tam giác núi lửa, tính trước để cấp phát đúng một lần
+size_t volcanoTriangleCount(const VolcanoParams &p){
+    return (size_t)p.heightSegments*p.baseSegments*2   // thân núi
+         + (size_t)p.baseSegments                      // đáy núi
+         + (size_t)p.craterSegments*2                  // miệng núi
+         + (size_t)p.craterSegments;                   // đáy miệng
 }
 
-float dot(Vec3 a, Vec3 b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+// Chạy fn(begin,end) trên các đoạn của [0,count) bằng nhiều thread
+template<typename Fn>
+void parallelFor(int count,Fn fn){
+    int threads=std::max(1,std::min((int)std::thread::hardware_concurrency(),count));
+    if(threads<=1){ fn(0,count); return; }
+    std::vector<std::thread> pool;
+    int chunk=(count+threads-1)/threads;
+    for(int t=0;t<threads;t++){
+        int begin=t*chunk, end=std::min(count,begin+chunk);
+        if(begin>=end) break;
+        pool.emplace_back(fn,begin,end);
+    }
+    for(auto &th:pool) th.join();
+}
 
-struct Matrix4x4 {
-    float m[16];
-    Matrix4x4() {
-        m[0]=1; m[1]=0; m[2]=0; m[3]=0;
-        m[4]=0; m[5]=1; m[6]=0; m[7]=0;
-        m[8]=0; m[9]=0; m[10]=1; m[11]=0;
-        m[12]=0; m[13]=0; m[14]=0; m[15]=1;
+// Nhiễu bề mặt sườn núi: bán kính tại góc a, độ cao h được nhân với
+// 1 + surfaceNoise * fbm3(cos a, h, sin a)
+NoiseParams volcanoNoiseParams(const VolcanoParams &P){
+    NoiseParams noise;
+    noise.seed=P.noiseSeed;
+    noise.octaves=4;
+    noise.frequency=P.noiseFrequency;
+    return noise;
+}
+
+// Độ cao sườn núi tại (x, z), xấp xỉ lưới của createDetailedVolcano.
+// Trả về -1e30 nếu (x, z) nằm ngoài chân núi.
+float volcanoSurfaceHeight(float x,float z){
+    const VolcanoParams &P=volcanoParams;
+    float r=sqrtf(x*x+z*z);
+    if(r>P.baseRadius*(1.0f+P.surfaceNoise)) return -1e30f;
+    // Trong vành miệng lấy độ cao đáy miệng, thành miệng do SDF xử lý
+    if(r<P.craterRadius) return P.volcanoHeight-P.craterDepth;
+    float c=r>0.0f?x/r:1.0f, s=r>0.0f?z/r:0.0f;
+
+    // Bán kính theo độ cao: R(h) = baseRadius - slope*h. Giải r = R(h)*noise(h)
+    // bằng vài vòng lặp điểm bất động
+    NoiseParams noise=volcanoNoiseParams(P);
+    float slope=(P.baseRadius-P.craterRadius)/P.volcanoHeight;
+    float h=(P.baseRadius-r)/slope;
+    for(int it=0;it<4;it++){
+        float hc=std::min(std::max(h,0.0f),P.volcanoHeight);
+        float scale=1.0f+P.surfaceNoise*fbm3(c,hc,s,noise);
+        h=(P.baseRadius-r/scale)/slope;
     }
-};
+    return h>0.0f?std::min(h,P.volcanoHeight):-1e30f;
+}
+
+// Mặt đất của cảnh: địa hình (hoặc mặt phẳng dung nham) và sườn núi lửa
+void sceneGroundHeight(const float* x,const float* z,float* out,size_t count){
+    terrain.heightBatch(x,z,out,count);
+    for(size_t i=0;i<count;i++) out[i]=std::max(out[i],volcanoSurfaceHeight(x[i],z[i]));
+}
+
+// Điểm (x, z) nằm trên sườn núi lửa (cao hơn địa hình bên dưới)
+bool onVolcano(float x,float z){
+    return volcanoSurfaceHeight(x,z)>=terrain.heightAt(x,z);
+}
 
-Matrix4x4 multiply(const Matrix4x4 &a,const Matrix4x4 &b){
-    Matrix4x4 r;
-    for(int i=0;i<4;i++){
-        for(int j=0;j<4;j++){
-            r.m[i*4+j] = a.m[i*4+0]*b.m[0*4+j] + a.m[i*4+1]*b.m[1*4+j]
-                        + a.m[i*4+2]*b.m[2*4+j] + a.m[i*4+3]*b.m[3*4+j];
+// Tro rơi đều quanh núi: nhiều lần sửa nhỏ mỗi frame, lên sườn núi hoặc địa hình
+void dropAsh(float dt){
+    static float acc=0.0f;
+    acc+=60.0f*dt;  // số lần rơi mỗi giây
+    std::uniform_real_distribution<float> angle(0.0f,2.0f*M_PI), dist(0.0f,1.0f);
+    for(;acc>=1.0f;acc-=1.0f){
+        float a=angle(deformRng), r=12.0f*sqrtf(dist(deformRng));
+        float x=r*cosf(a), z=r*sinf(a);
+        if(onVolcano(x,z)){
+            float c[3]={x,volcanoSurfaceHeight(x,z),z};
+            volcanoDeformer.displace(c,0.3f,0.001f,0.0f);
+        }else{
+            terrain.deform(x,z,0.8f,0.004f);
         }
     }
-    return r;
-}
-
-Matrix4x4 rotateXY(float ax,float ay){
-    Matrix4x4 rx, ry;
-    float cx=cosf(ax), sx=sinf(ax);
-    rx.m[5]=cx; rx.m[6]=-sx; rx.m[9]=sx; rx.m[10]=cx;
-    float cy=cosf(ay), sy=sinf(ay);
-    ry.m[0]=cy; ry.m[2]=sy; ry.m[8]=-sy; ry.m[10]=cy;
-    return multiply(ry, rx);
-}
-
-Matrix4x4 scale(float sx,float sy,float sz){
-    Matrix4x4 s;
-    s.m[0]=sx; s.m[5]=sy; s.m[10]=sz;
-    return s;
-}
-
-Matrix4x4 translate(float tx,float ty,float tz){
-    Matrix4x4 t;
-    t.m[12]=tx; t.m[13]=ty; t.m[14]=tz;
-    return t;
-}
-
-Matrix4x4 ortho(float left, float right, float bottom, float top, float nearVal, float farVal) {
-    Matrix4x4 r;
-    r.m[0] = 2.0f / (right - left);
-    r.m[5] = 2.0f / (top - bottom);
-    r.m[10] = -2.0f / (farVal - nearVal);
-    r.m[12] = -(right + left) / (right - left);
-    r.m[13] = -(top + bottom) / (top - bottom);
-    r.m[14] = -(farVal + nearVal) / (farVal - nearVal);
-    r.m[15] = 1.0f;
-    return r;
-}
-
-Matrix4x4 perspective(float fovy, float aspect, float nearVal, float farVal) {
-    Matrix4x4 r;
-    float f = 1.0f / tanf(fovy / 2.0f);
-    r.m[0] = f / aspect;
-    r.m[5] = f;
-    r.m[10] = (farVal + nearVal) / (nearVal - farVal);
-    r.m[11] = -1.0f;
-    r.m[14] = (2.0f * farVal * nearVal) / (nearVal - farVal);
-    r.m[15] = 0.0f; 
-    return r;
-}
-
-Matrix4x4 lookAt(Vec3 eye, Vec3 center, Vec3 up) {
-    Vec3 f = normalize({center.x - eye.x, center.y - eye.y, center.z - eye.z});
-    Vec3 s = normalize(cross(f, up));
-    Vec3 u = cross(s, f);
-    Matrix4x4 r;
-    r.m[0] = s.x; r.m[4] = s.y; r.m[8] = s.z; r.m[12] = -dot(s, eye);
-    r.m[1] = u.x; r.m[5] = u.y; r.m[9] = u.z; r.m[13] = -dot(u, eye);
-    r.m[2] = -f.x; r.m[6] = -f.y; r.m[10] = -f.z; r.m[14] = dot(f, eye);
-    r.m[3] = 0; r.m[7] = 0; r.m[11] = 0; r.m[15] = 1;
-    return r;
-}
-
-// Noise & Helper
-float simpleNoise(float x,float z,float freq){
-    return (sinf(x*freq)*cosf(z*freq))*0.2f;
-}
-
-// Tính normal cho 3 đỉnh
-void computeNormal(const float* v0,const float* v1,const float* v2,float* outNormal){
-    float U[3]={v1[0]-v0[0],v1[1]-v0[1],v1[2]-v0[2]};
-    float V[3]={v2[0]-v0[0],v2[1]-v0[1],v2[2]-v0[2]};
-    outNormal[0]=U[1]*V[2]-U[2]*V[1];
-    outNormal[1]=U[2]*V[0]-U[0]*V[2];
-    outNormal[2]=U[0]*V[1]-U[1]*V[0];
-    float len = sqrtf(outNormal[0]*outNormal[0]+outNormal[1]*outNormal[1]+outNormal[2]*outNormal[2]);
-    if(len>0){ outNormal[0]/=len; outNormal[1]/=len; outNormal[2]/=len;}
-}
-
-// Thêm tam giác và normal
-void addTriangle(float* v0,float* v1,float* v2){
-    vertices.insert(vertices.end(),{v0[0],v0[1],v0[2], v1[0],v1[1],v1[2], v2[0],v2[1],v2[2]});
-    float n[3]; computeNormal(v0,v1,v2,n);
-    for(int i=0;i<3;i++) normals.insert(normals.end(),{n[0],n[1],n[2]});
+}
+
+// Sụt một đoạn miệng núi: hạ và thu hẹp vành tại một góc ngẫu nhiên
+void collapseCrater(){
+    const VolcanoParams &P=volcanoParams;
+    std::uniform_real_distribution<float> angle(0.0f,2.0f*M_PI);
+    float a=angle(deformRng);
+    float c[3]={P.craterRadius*cosf(a),P.volcanoHeight,P.craterRadius*sinf(a)};
+    volcanoDeformer.displace(c,0.6f,-0.04f,-0.12f);
 }
 
 void createDetailedVolcano(){
-    const int BASE_SEGMENTS=64;
-    const int HEIGHT_SEGMENTS=8;
-    const float BASE_RADIUS=2.0f;
-    const float CRATER_RADIUS=0.3f;
-    const float VOLCANO_HEIGHT=2.5f;
-    const float CRATER_DEPTH=0.4f;
+    const VolcanoParams &P=volcanoParams;
+    const int BASE_SEGMENTS=P.baseSegments;
+    const int HEIGHT_SEGMENTS=P.heightSegments;
+    const float BASE_RADIUS=P.baseRadius;
+    const float CRATER_RADIUS=P.craterRadius;
+    const float VOLCANO_HEIGHT=P.volcanoHeight;
+    const float CRATER_DEPTH=P.craterDepth;
+    const int CRATER_SEGMENTS=P.craterSegments;
+
+    // Cấp phát đúng kích thước một lần, mỗi dải ghi vào phần riêng của nó
+    size_t start=vertices.size();
+    size_t floats=volcanoTriangleCount(P)*9;
+    vertices.resize(start+floats);
+    float* vOut=vertices.data()+start;
+
+    // Lượng giác của mỗi góc chỉ tính một lần
+    std::vector<float> cosA(BASE_SEGMENTS+1), sinA(BASE_SEGMENTS+1);
+    for(int i=0;i<=BASE_SEGMENTS;i++){
+        float a=2.0f*M_PI*i/BASE_SEGMENTS;
+        cosA[i]=cosf(a); sinA[i]=sinf(a);
+    }
+    // Nhiễu theo vòng: điểm lấy mẫu nằm trên mặt trụ (cos, h, sin) nên liền mạch
+    // quanh núi; vòng trên của layer chính là vòng dưới của layer+1
+    const int RING=BASE_SEGMENTS+1;
+    std::vector<float> ringNoise((size_t)(HEIGHT_SEGMENTS+1)*RING);
+    NoiseParams noise=volcanoNoiseParams(P);
+    parallelFor(HEIGHT_SEGMENTS+1,[&](int begin,int end){
+        std::vector<float> ys(RING);
+        for(int layer=begin;layer<end;layer++){
+            float* out=&ringNoise[(size_t)layer*RING];
+            std::fill(ys.begin(),ys.end(),(VOLCANO_HEIGHT/HEIGHT_SEGMENTS)*layer);
+            fbm3Batch(cosA.data(),ys.data(),sinA.data(),out,RING,noise);
+            for(int i=0;i<RING;i++) out[i]=1.0f+P.surfaceNoise*out[i];
+        }
+    });
+    // Vòng trên cùng khớp đúng vành miệng núi để lưới kín (SDF cần biết trong/ngoài)
+    std::fill(ringNoise.end()-RING,ringNoise.end(),1.0f);
 
     // Thân núi
-    for(int layer=0;layer<HEIGHT_SEGMENTS;layer++){
-        float h0=(VOLCANO_HEIGHT/HEIGHT_SEGMENTS)*layer;
-        float h1=(VOLCANO_HEIGHT/HEIGHT_SEGMENTS)*(layer+1);
-        float r0=BASE_RADIUS-(BASE_RADIUS-CRATER_RADIUS)*(h0/VOLCANO_HEIGHT);
-        float r1=BASE_RADIUS-(BASE_RADIUS-CRATER_RADIUS)*(h1/VOLCANO_HEIGHT);
-        for(int i=0;i<BASE_SEGMENTS;i++){
-            float a0=2.0f*M_PI*i/BASE_SEGMENTS;
-            float a1=2.0f*M_PI*(i+1)/BASE_SEGMENTS;
-            float n0=1.0f+simpleNoise(cosf(a0),sinf(a0),3.0f+layer);
-            float n1=1.0f+simpleNoise(cosf(a1),sinf(a1),3.0f+layer);
-            float n2=1.0f+simpleNoise(cosf(a0),sinf(a0),3.0f+layer+1);
-            float n3=1.0f+simpleNoise(cosf(a1),sinf(a1),3.0f+layer+1);
-
-            float v0[3]={r0*n0*cosf(a0),h0,r0*n0*sinf(a0)};
-            float v1[3]={r1*n3*cosf(a1),h1,r1*n3*sinf(a1)};
-            float v2[3]={r0*n1*cosf(a1),h0,r0*n1*sinf(a1)};
-            addTriangle(v0,v1,v2);
-
-            float v3[3]={r0*n0*cosf(a0),h0,r0*n0*sinf(a0)};
-            float v4[3]={r1*n2*cosf(a0),h1,r1*n2*sinf(a0)};
-            float v5[3]={r1*n3*cosf(a1),h1,r1*n3*sinf(a1)};
-            addTriangle(v3,v4,v5);
+    parallelFor(HEIGHT_SEGMENTS,[&](int begin,int end){
+        for(int layer=begin;layer<end;layer++){
+            float h0=(VOLCANO_HEIGHT/HEIGHT_SEGMENTS)*layer;
+            float h1=(VOLCANO_HEIGHT/HEIGHT_SEGMENTS)*(layer+1);
+            float r0=BASE_RADIUS-(BASE_RADIUS-CRATER_RADIUS)*(h0/VOLCANO_HEIGHT);
+            float r1=BASE_RADIUS-(BASE_RADIUS-CRATER_RADIUS)*(h1/VOLCANO_HEIGHT);
+            const float* lo=&ringNoise[(size_t)layer*RING];
+            const float* hi=&ringNoise[(size_t)(layer+1)*RING];
+            size_t tri=(size_t)layer*BASE_SEGMENTS*2;
+            for(int i=0;i<BASE_SEGMENTS;i++,tri+=2){
+                float c0=cosA[i], s0=sinA[i], c1=cosA[i+1], s1=sinA[i+1];
+                float n0=lo[i], n1=lo[i+1], n2=hi[i], n3=hi[i+1];
+
+                float v0[3]={r0*n0*c0,h0,r0*n0*s0};
+                float v1[3]={r1*n3*c1,h1,r1*n3*s1};
+                float v2[3]={r0*n1*c1,h0,r0*n1*s1};
+                writeTriangle(vOut+tri*9,v0,v1,v2);
+
+                float v4[3]={r1*n2*c0,h1,r1*n2*s0};
+                writeTriangle(vOut+(tri+1)*9,v0,v4,v1);
+            }
         }
-    }
+    });
+    size_t tri=(size_t)HEIGHT_SEGMENTS*BASE_SEGMENTS*2;
 
-    // Đáy núi
-    for(int i=0;i<BASE_SEGMENTS;i++){
-        float a0=2.0f*M_PI*i/BASE_SEGMENTS;
-        float a1=2.0f*M_PI*(i+1)/BASE_SEGMENTS;
+    // Đáy núi, theo đúng vòng dưới cùng của thân núi
+    for(int i=0;i<BASE_SEGMENTS;i++,tri++){
+        float n0=ringNoise[i], n1=ringNoise[i+1];
         float v0[3]={0,0,0};
-        float v1[3]={BASE_RADIUS*cosf(a0),0,BASE_RADIUS*sinf(a0)};
-        float v2[3]={BASE_RADIUS*cosf(a1),0,BASE_RADIUS*sinf(a1)};
-        addTriangle(v0,v1,v2);
+        float v1[3]={BASE_RADIUS*n0*cosA[i],0,BASE_RADIUS*n0*sinA[i]};
+        float v2[3]={BASE_RADIUS*n1*cosA[i+1],0,BASE_RADIUS*n1*sinA[i+1]};
+        writeTriangle(vOut+tri*9,v0,v1,v2);
     }
 
-    // Miệng núi
-    const int CRATER_SEGMENTS=32;
+    // Miệng núi: thành và đáy quay mặt về phía trong miệng (lên trên), như thân
+    // núi quay mặt ra ngoài, để normal và SDF va chạm biết phía nào là đá
+    std::vector<float> cosC(CRATER_SEGMENTS+1), sinC(CRATER_SEGMENTS+1);
+    for(int i=0;i<=CRATER_SEGMENTS;i++){
+        float a=2.0f*M_PI*i/CRATER_SEGMENTS;
+        cosC[i]=cosf(a); sinC[i]=sinf(a);
+    }
     float cTop=VOLCANO_HEIGHT;
     float cBot=VOLCANO_HEIGHT-CRATER_DEPTH;
-    for(int i=0;i<CRATER_SEGMENTS;i++){
-        float a0=2.0f*M_PI*i/CRATER_SEGMENTS;
-        float a1=2.0f*M_PI*(i+1)/CRATER_SEGMENTS;
-        float v0[3]={CRATER_RADIUS*cosf(a0),cTop,CRATER_RADIUS*sinf(a0)};
-        float v1[3]={CRATER_RADIUS*cosf(a1),cTop,CRATER_RADIUS*sinf(a1)};
-        float v2[3]={CRATER_RADIUS*0.8f*cosf(a0),cBot,CRATER_RADIUS*0.8f*sinf(a0)};
-        addTriangle(v0,v1,v2);
-
-        float v3[3]={CRATER_RADIUS*cosf(a1),cTop,CRATER_RADIUS*sinf(a1)};
-        float v4[3]={CRATER_RADIUS*0.8f*cosf(a1),cBot,CRATER_RADIUS*0.8f*sinf(a1)};
-        float v5[3]={CRATER_RADIUS*0.8f*cosf(a0),cBot,CRATER_RADIUS*0.8f*sinf(a0)};
-        addTriangle(v3,v4,v5);
+    for(int i=0;i<CRATER_SEGMENTS;i++,tri+=2){
+        float v0[3]={CRATER_RADIUS*cosC[i],cTop,CRATER_RADIUS*sinC[i]};
+        float v1[3]={CRATER_RADIUS*cosC[i+1],cTop,CRATER_RADIUS*sinC[i+1]};
+        float v2[3]={CRATER_RADIUS*0.8f*cosC[i],cBot,CRATER_RADIUS*0.8f*sinC[i]};
+        writeTriangle(vOut+tri*9,v0,v2,v1);
+
+        float v4[3]={CRATER_RADIUS*0.8f*cosC[i+1],cBot,CRATER_RADIUS*0.8f*sinC[i+1]};
+        writeTriangle(vOut+(tri+1)*9,v1,v2,v4);
     }
 
     // Đáy miệng (dung nham)
-    for(int i=0;i<CRATER_SEGMENTS;i++){
-        float a0=2.0f*M_PI*i/CRATER_SEGMENTS;
-        float a1=2.0f*M_PI*(i+1)/CRATER_SEGMENTS;
+    for(int i=0;i<CRATER_SEGMENTS;i++,tri++){
         float v0[3]={0,cBot,0};
-        float v1[3]={CRATER_RADIUS*0.8f*cosf(a0),cBot,CRATER_RADIUS*0.8f*sinf(a0)};
-        float v2[3]={CRATER_RADIUS*0.8f*cosf(a1),cBot,CRATER_RADIUS*0.8f*sinf(a1)};
-        addTriangle(v0,v1,v2);
+        float v1[3]={CRATER_RADIUS*0.8f*cosC[i],cBot,CRATER_RADIUS*0.8f*sinC[i]};
+        float v2[3]={CRATER_RADIUS*0.8f*cosC[i+1],cBot,CRATER_RADIUS*0.8f*sinC[i+1]};
+        writeTriangle(vOut+tri*9,v0,v2,v1);
     }
 }
 
+// Tham số mặt phẳng dung nham
+struct LavaPlaneParams {
+    float size=5.0f;
+    float y=-0.01f;
+};
+LavaPlaneParams lavaPlaneParams;
+
 void createLavaPlane() {
-    const float SIZE = 5.0f;
-    const float Y = -0.01f; 
+    const float SIZE = lavaPlaneParams.size;
+    const float Y = lavaPlaneParams.y; 
     float v0[3] = {-SIZE, Y, -SIZE};
     float v1[3] = { SIZE, Y, -SIZE};
     float v2[3] = { SIZE, Y,  SIZE};
@@ -235,7 +316,7 @@ void createLavaPlane() {
     addTriangle(v0, v2, v3);
 }
 
-// Vertex shader
+// Vertex shader (aNormal chỉ địa hình có, xem uFlatNormals)
 const char* vertexShaderSource = R"(
 #version 330 core
 layout(location=0) in vec3 aPos;
@@ -243,20 +324,64 @@ layout(location=1) in vec3 aNormal;
 uniform mat4 uTransform;
 out vec3 vNormal;
 out vec3 vPos;
+out vec3 vWorldPos;
 void main(){
     vPos = aPos;
+    vWorldPos = aPos;
     vNormal = aNormal;
     gl_Position = uTransform*vec4(aPos,1.0);
 }
 )";
 
 // Fragment shader
+// vPos: tọa độ trên lưới gốc (dải màu theo độ cao), vWorldPos: tọa độ model
+// để chiếu sáng. Đèn dung nham chia cụm, xem LavaLights (lava_lights.h).
+// uFlatNormals = 1: lưới không có normal (núi lửa, mặt phẳng dung nham), normal
+// phẳng của tam giác = tích có hướng đạo hàm màn hình của vWorldPos, luôn quay
+// về phía camera. Địa hình có normal trơn riêng nên đặt 0.
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec3 vNormal;
 in vec3 vPos;          
+in vec3 vWorldPos;
 out vec4 FragColor;
 
+uniform samplerBuffer uLights;
+uniform usamplerBuffer uLightClusters;
+uniform usamplerBuffer uLightIndices;
+uniform int uLightCount;
+uniform ivec3 uClusterGrid;
+uniform vec2 uClusterViewport;
+uniform vec4 uClusterDepth;
+uniform int uClusterPerspective;
+uniform int uFlatNormals;
+
+// Tổng ánh sáng của các đèn dung nham thuộc cụm chứa fragment này
+vec3 lavaLighting(vec3 pos, vec3 n){
+    if (uLightCount == 0) return vec3(0.0);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / uClusterViewport * vec2(uClusterGrid.xy)), ivec2(0), uClusterGrid.xy - 1);
+    float depth = uClusterPerspective != 0 ? 1.0 / gl_FragCoord.w
+                                           : mix(uClusterDepth.x, uClusterDepth.y, gl_FragCoord.z);
+    int slice = depth <= uClusterDepth.z ? 0
+              : min(uClusterGrid.z - 1, 1 + int(log(depth / uClusterDepth.z) * uClusterDepth.w));
+    int cluster = (slice * uClusterGrid.y + tile.y) * uClusterGrid.x + tile.x;
+    uvec2 range = texelFetch(uLightClusters, cluster).xy;
+    vec3 sum = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int l = int(texelFetch(uLightIndices, int(range.x + i)).x);
+        vec4 posRadius = texelFetch(uLights, 2 * l);
+        vec3 d = posRadius.xyz - pos;
+        float r2 = posRadius.w * posRadius.w;
+        float dist2 = dot(d, d);
+        if (dist2 >= r2) continue;
+        // Tắt dần mượt về 0 ở bán kính, mặt quay đi vẫn nhận chút ánh sáng (bọc 0.3)
+        float fade = 1.0 - dist2 / r2;
+        float ndl = max((dot(n, d * inversesqrt(max(dist2, 1e-6))) + 0.3) / 1.3, 0.0);
+        sum += texelFetch(uLights, 2 * l + 1).rgb * (fade * fade * ndl);
+    }
+    return sum;
+}
+
 vec3 getVolcanoColor(float height){
     vec3 deepBrown = vec3(0.3,0.15,0.05);
     vec3 earthBrown = vec3(0.5,0.25,0.1);
@@ -270,14 +395,17 @@ vec3 getVolcanoColor(float height){
 }
 
 void main(){
+    // Đạo hàm phải tính trước nhánh return bên dưới
+    vec3 faceNormal = cross(dFdx(vWorldPos), dFdy(vWorldPos));
     if (vPos.y < 0.0) { 
         FragColor = vec4(0.8, 0.25, 0.05, 1.0); 
         return; 
     }
+    vec3 n = normalize(uFlatNormals != 0 ? faceNormal : vNormal);
     vec3 lightDir = normalize(vec3(0.5, 1.0, 0.5));
-    float diff = max(dot(normalize(vNormal), lightDir), 0.3);
+    float diff = max(dot(n, lightDir), 0.3);
     vec3 objectColor = getVolcanoColor(vPos.y);
-    FragColor = vec4(objectColor * diff, 1.0);
+    FragColor = vec4(objectColor * (diff + lavaLighting(vWorldPos, n)), 1.0);
 }
 )";
 
@@ -291,23 +419,21 @@ GLuint compileShader(){
 }
 
 // Setup buffers
-void setupBuffers(){
+// positions: vertexCount*3 float, có thể trỏ thẳng vào vùng mmap của cache.
+// DYNAMIC_DRAW vì phần núi lửa được sửa cục bộ lúc chạy (xem MeshDeformer).
+// Không có thuộc tính normal (location 1): shader dùng normal phẳng (uFlatNormals)
+void setupBuffers(const float* positions,size_t vertexCount){
     glGenVertexArrays(1,&VAO);
-    glGenBuffers(2,VBO);
+    glGenBuffers(1,&VBO);
     glBindVertexArray(VAO);
+    totalVertexCount=vertexCount;
 
     // Vertex
-    glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-    glBufferData(GL_ARRAY_BUFFER,vertices.size()*sizeof(float),vertices.data(),GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,VBO);
+    glBufferData(GL_ARRAY_BUFFER,vertexCount*3*sizeof(float),positions,GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,(void*)0);
     glEnableVertexAttribArray(0);
 
-    // Normal
-    glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER,normals.size()*sizeof(float),normals.data(),GL_STATIC_DRAW);
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-    glEnableVertexAttribArray(1);
-
     glBindVertexArray(0);
 }
 
@@ -320,17 +446,19 @@ void mouseButtonCallback(GLFWwindow* w,int b,int a,int m){
 }
 void cursorPosCallback(GLFWwindow* w,double x,double y){
     if(mousePressed){
-        rotationY += (x-lastX)*0.01f;
-        rotationX += (y-lastY)*0.01f;
-        if(rotationX>1.5f) rotationX=1.5f;
-        if(rotationX<-1.5f) rotationX=-1.5f;
+        camera.rotate((y-lastY)*0.01f, (x-lastX)*0.01f);
         lastX=x; lastY=y;
     }
 }
 void scrollCallback(GLFWwindow* w,double xoffset,double yoffset){
-    zoom += yoffset*0.1f;
+    float zoom = camera.zoom() + yoffset*0.1f;
     if(zoom<0.2f) zoom=0.2f;
     if(zoom>3.0f) zoom=3.0f;
+    camera.setZoom(zoom);
+}
+void framebufferSizeCallback(GLFWwindow* w,int width,int height){
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -340,8 +468,8 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         //  'P' để chuyển đổi phép chiếu
         if (key == GLFW_KEY_P)
         {
-            isPerspective = !isPerspective;
-            std::cout << "Phep chieu: " << (isPerspective ? "Phoi Canh" : "Song Song") << std::endl;
+            camera.setPerspective(!camera.perspective());
+            std::cout << "Phep chieu: " << (camera.perspective() ? "Phoi Canh" : "Song Song") << std::endl;
         }
 
         //  'M' để chuyển đổi chế độ vẽ
@@ -351,6 +479,99 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
             std::cout << "Che do: " << (isWireframe ? "Khung Day (Wireframe)" : "Mat Da Giac (Solid)") << std::endl;
         }
 
+        //  'T' để bật/tắt địa hình
+        if (key == GLFW_KEY_T)
+        {
+            useTerrain = !useTerrain;
+            std::cout << "Dia hinh: " << (useTerrain ? "Bat" : "Tat (mat phang dung nham)") << std::endl;
+        }
+
+        //  'V' để bắt đầu/dừng ghi hình
+        if (key == GLFW_KEY_V)
+        {
+            if (videoCapture.isRecording()) {
+                videoCapture.stop();
+            } else {
+                std::string path = "eruption_" + std::to_string(++recordingCount) + ".y4m";
+                videoCapture.start(path, framebufferWidth, framebufferHeight);
+            }
+        }
+
+        //  'J' để bật/tắt tro rơi
+        if (key == GLFW_KEY_J)
+        {
+            ashFall = !ashFall;
+            std::cout << "Tro roi: " << (ashFall ? "Bat" : "Tat") << std::endl;
+        }
+
+        //  'K' để sụt một phần miệng núi
+        if (key == GLFW_KEY_K)
+        {
+            collapseCrater();
+        }
+
+        //  'L' để bật/tắt dòng dung nham, Shift+L để xóa
+        if (key == GLFW_KEY_L)
+        {
+            if (mods & GLFW_MOD_SHIFT) {
+                lavaFlow.clear();
+                std::cout << "Da xoa dong dung nham" << std::endl;
+            } else {
+                useLavaFlow = !useLavaFlow;
+                particleSystem.collectLandings = useLavaFlow;
+                std::cout << "Dong dung nham: " << (useLavaFlow ? "Bat" : "Tat") << std::endl;
+            }
+        }
+
+        //  'H' để đổi độ phân giải vẽ hạt: đầy đủ -> 1/2 -> 1/4
+        if (key == GLFW_KEY_H)
+        {
+            particlePass.factor = particlePass.factor >= 4 ? 1 : particlePass.factor * 2;
+            std::cout << "Do phan giai hat: 1/" << particlePass.factor << std::endl;
+        }
+
+        //  'O' để bật/tắt ánh sáng từ dung nham
+        if (key == GLFW_KEY_O)
+        {
+            lavaLights.enabled = !lavaLights.enabled;
+            std::cout << "Den dung nham: " << (lavaLights.enabled ? "BAT" : "TAT") << std::endl;
+        }
+
+        //  'B' để bật/tắt cánh đồng núi lửa phụ
+        if (key == GLFW_KEY_B)
+        {
+            if (volcanoField.instanceCount() > 0) {
+                volcanoField.clear();
+                std::cout << "Canh dong nui lua: TAT" << std::endl;
+            } else {
+                auto t0 = std::chrono::steady_clock::now();
+                volcanoField.generate([](float x, float z) { return terrain.heightAt(x, z); });
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                std::cout << "Canh dong nui lua: " << volcanoField.instanceCount() << " nui, " << ms << " ms" << std::endl;
+            }
+        }
+
+        //  'N' để tua nhanh dung nham 60 giây (lời giải giải tích)
+        if (key == GLFW_KEY_N)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            particleSystem.fastForward(60.0f, 0.0f, 2.5f, 0.0f);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "Tua nhanh 60s: " << particleSystem.ballistic.particleCount() << " hat, " << ms << " ms" << std::endl;
+        }
+
+        //  ',' / '.' để xem lại các lần tua nhanh (lùi/tiến 1 giây), '/' để quay lại
+        if (key == GLFW_KEY_COMMA || key == GLFW_KEY_PERIOD)
+        {
+            float t = particleSystem.isScrubbing() ? particleSystem.scrubPosition() : particleSystem.ballistic.time();
+            particleSystem.scrubTo(t + (key == GLFW_KEY_COMMA ? -1.0f : 1.0f));
+            std::cout << "Xem lai: t = " << particleSystem.scrubPosition() << "s" << std::endl;
+        }
+        if (key == GLFW_KEY_SLASH)
+        {
+            particleSystem.endScrub();
+        }
+
         // Xử lý input cho hệ thống hạt
         particleSystem.handleInput(key);
 
@@ -370,33 +591,305 @@ void processInput(GLFWwindow *window)
     float zoomSpeed = 0.01f;  
 
     //  Di chuyển camera (W,A,S,D,R,F)
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) eyeZ -= moveSpeed; // Đi tới
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) eyeZ += moveSpeed; // Lùi lại
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) eyeX -= moveSpeed; // Sang trái
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) eyeX += moveSpeed; // Sang phải
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) eyeY += moveSpeed; // Lên trên
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) eyeY -= moveSpeed; // Xuống dưới
+    float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) dz -= moveSpeed; // Đi tới
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) dz += moveSpeed; // Lùi lại
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) dx -= moveSpeed; // Sang trái
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) dx += moveSpeed; // Sang phải
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) dy += moveSpeed; // Lên trên
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) dy -= moveSpeed; // Xuống dưới
+    if (dx != 0.0f || dy != 0.0f || dz != 0.0f) camera.move(dx, dy, dz);
 
     // Xoay vật thể (Các phím mũi tên)
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) rotationX += rotSpeed;
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) rotationX -= rotSpeed;
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) rotationY += rotSpeed;
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) rotationY -= rotSpeed;
+    float rx = 0.0f, ry = 0.0f;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) rx += rotSpeed;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) rx -= rotSpeed;
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) ry += rotSpeed;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) ry -= rotSpeed;
+    if (rx != 0.0f || ry != 0.0f) camera.rotate(rx, ry);
 
     //  Zoom (Phím +/-)
+    float zoom = camera.zoom();
     if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS) zoom += zoomSpeed; // Phím + (dấu =)
     if (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS) zoom -= zoomSpeed; // Phím -
     
     // Giữ giới hạn zoom
     if(zoom<0.1f) zoom=0.1f;
     if(zoom>5.0f) zoom=5.0f;
+    camera.setZoom(zoom);
+}
+
+// Vẽ một frame của cảnh vào framebuffer đang bind
+void renderFrame(float deltaTime, int width, int height){
+    // Chỉ báo cho OpenGL khi kích thước thật sự đổi
+    if (camera.setViewport(width, height)) glViewport(0, 0, width, height);
+
+    glClearColor(0.2f,0.2f,0.2f,1.0f);
+    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+
+    // Cập nhật hệ thống hạt - phun từ miệng núi lửa (0, 2.5, 0)
+    Vec3 eyeModel = camera.eyeInModel();
+    Vec3 toVent = eyeModel - vec3(0.0f, 2.5f, 0.0f);
+    particleSystem.viewDistance = sqrtf(dot(toVent, toVent)) / camera.zoom();
+    particleSystem.viewEye = ParticleVec3(eyeModel.x, eyeModel.y, eyeModel.z);
+    particleSystem.viewZoom = camera.zoom();
+    particleSystem.update(deltaTime, 0.0f, 2.5f, 0.0f);
+
+    // Hạt dung nham rơi xuống đất chảy thành dòng, rơi trên sườn núi thì bám lại
+    if (useLavaFlow) {
+        for (const LavaLanding &l : particleSystem.landings) {
+            lavaFlow.addParticle(l.pos.x, l.pos.z, l.temperature);
+            if (onVolcano(l.pos.x, l.pos.z)) {
+                float c[3]={l.pos.x,l.pos.y,l.pos.z};
+                volcanoDeformer.displace(c,0.2f,0.002f,0.0f);
+            }
+        }
+        lavaFlow.update(deltaTime);
+    }
+    particleSystem.landings.clear();
+
+    // Hạt đông cứng trước khi kịp chảy thì bồi thẳng lên sườn núi/địa hình
+    for (const ParticleVec3 &p : particleSystem.solidified) {
+        if (onVolcano(p.x, p.z)) {
+            float c[3]={p.x,p.y,p.z};
+            volcanoDeformer.displace(c,0.2f,0.002f,0.0f);
+        } else {
+            terrain.deform(p.x,p.z,0.3f,0.002f);
+        }
+    }
+    particleSystem.solidified.clear();
+    if (ashFall) dropAsh(deltaTime);
+
+    // Chỉ upload phần lưới núi lửa vừa bị sửa
+    volcanoDeformer.flush();
+
+    // Đèn dung nham: các hạt dung nham + hồ dung nham trong miệng núi
+    lavaLights.clear();
+    lavaGlow.clear();
+    particleSystem.collectGlow(lavaGlow);
+    for (const LavaGlow &g : lavaGlow) lavaLights.addPoint(vec3(g.pos.x, g.pos.y, g.pos.z), vec3(g.r, g.g, g.b));
+    float crater[3];
+    blackbodyColor(particleSystem.thermal.eruptionTemp, crater);
+    lavaLights.addLight(vec3(0.0f, volcanoParams.volcanoHeight - 0.5f * volcanoParams.craterDepth, 0.0f), 3.0f,
+                        vec3(crater[0], crater[1], crater[2]));
+    lavaLights.build(camera.transform(), camera.perspective(), Camera::NEAR_PLANE, Camera::FAR_PLANE, width, height);
+
+    glUseProgram(shaderProgram);
+    glBindVertexArray(VAO);
+
+    // Chế độ wireframe
+    if (isWireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    } else {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+
+    // FINAL Matrix (M * V * P), camera chỉ tính lại khi góc xoay/mắt/zoom/kích thước đổi
+    const Mat4 &finalMat = camera.transform();
+
+    // Gửi ma trận lên Shader
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram,"uTransform"),1,GL_FALSE, finalMat.m);
+    lavaLights.bind(shaderProgram);
+    GLint flatNormalsLoc = glGetUniformLocation(shaderProgram,"uFlatNormals");
+    glUniform1i(flatNormalsLoc, 1);
     
-    // Giữ giới hạn xoay
-    if(rotationX>1.5f) rotationX=1.5f;
-    if(rotationX<-1.5f) rotationX=-1.5f;
+    if (useTerrain) {
+        // Vẽ núi lửa (bỏ mặt phẳng dung nham) + địa hình
+        glDrawArrays(GL_TRIANGLES,0,volcanoVertexCount);
+
+        Vec3 eye = camera.eyeInModel();
+        terrain.update(eye.x, eye.z);
+        if (terrainBlocking) terrain.finishPending();
+        glUniform1i(flatNormalsLoc, 0);
+        terrain.render();
+
+        // Núi lửa phụ: lọc frustum trên CPU, một lần vẽ instanced
+        volcanoField.render(finalMat.m, camera.frustumPlanes(), camera.revision());
+    } else {
+        // Vẽ núi lửa
+        glDrawArrays(GL_TRIANGLES,0,totalVertexCount);
+    }
+
+    // Lớp phủ dòng dung nham trên mặt đất
+    if (useLavaFlow) lavaFlow.render(finalMat.m);
+
+    // Vẽ hệ thống hạt (sử dụng cùng ma trận transform), có thể ở độ phân giải thấp
+    bool lowRes = particlePass.begin(width, height, camera.perspective(), Camera::NEAR_PLANE, Camera::FAR_PLANE);
+    particleSystem.renderDownsample = lowRes ? particlePass.factor : 1;
+    particleSystem.render(finalMat.m);
+    if (lowRes) particlePass.end();
+}
+
+// Đổi giá trị này khi thay đổi thuật toán sinh lưới để cache cũ tự bị bỏ
+const uint32_t MESH_GENERATOR_VERSION = 3;
+const char* MESH_CACHE_PATH = "volcano_mesh.cache";
+
+uint64_t meshParamsHash(){
+    uint64_t h=hashValue(MESH_GENERATOR_VERSION);
+    const VolcanoParams &v=volcanoParams;
+    h=hashValue(v.baseSegments,h); h=hashValue(v.heightSegments,h); h=hashValue(v.craterSegments,h);
+    h=hashValue(v.baseRadius,h); h=hashValue(v.craterRadius,h);
+    h=hashValue(v.volcanoHeight,h); h=hashValue(v.craterDepth,h);
+    h=hashValue(v.surfaceNoise,h); h=hashValue(v.noiseFrequency,h); h=hashValue(v.noiseSeed,h);
+    h=hashValue(lavaPlaneParams.size,h); h=hashValue(lavaPlaneParams.y,h);
+    return h;
+}
+
+// Nạp lưới núi lửa + mặt phẳng dung nham từ cache (mmap, upload thẳng lên VBO),
+// nếu cache không có hoặc đã cũ thì sinh lại và ghi cache mới
+void loadSceneMesh(){
+    uint64_t hash=meshParamsHash();
+    if(openMeshCache(MESH_CACHE_PATH,hash,meshCache)){
+        volcanoVertexCount=meshCache.volcanoVertexCount;
+        setupBuffers(meshCache.positions,meshCache.vertexCount);
+        // Không chép ra bộ nhớ riêng: SDF, núi lửa phụ và biến dạng (chép khi
+        // sửa lần đầu) đọc thẳng từ vùng map
+        volcanoPositions=meshCache.positions;
+        std::cout << "Mesh cache: nap " << totalVertexCount << " dinh tu " << MESH_CACHE_PATH << std::endl;
+        return;
+    }
+
+    createDetailedVolcano();
+    volcanoVertexCount = vertices.size()/3;
+    createLavaPlane();
+    writeMeshCache(MESH_CACHE_PATH,hash,vertices.data(),vertices.size()/3,volcanoVertexCount);
+    setupBuffers(vertices.data(),vertices.size()/3);
+    volcanoPositions=vertices.data();
+}
+
+const char* SDF_CACHE_PATH = "volcano_sdf.cache";
+SparseSdf volcanoSdf;
+
+// SDF va chạm của núi lửa, tính từ lưới lúc khởi tạo (không theo biến dạng lúc
+// chạy); cache theo cùng hash với lưới
+void loadVolcanoSdf(){
+    uint64_t hash=meshParamsHash();
+    if(volcanoSdf.load(SDF_CACHE_PATH,hash)){
+        std::cout << "SDF cache: nap " << volcanoSdf.brickCount() << " brick tu " << SDF_CACHE_PATH << std::endl;
+        return;
+    }
+    auto t0=std::chrono::steady_clock::now();
+    volcanoSdf.bake(volcanoPositions,volcanoVertexCount);
+    double ms=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count();
+    std::cout << "SDF: " << volcanoSdf.brickCount() << " brick, " << ms << " ms" << std::endl;
+    volcanoSdf.save(SDF_CACHE_PATH,hash);
 }
 
-int main(){
+// Khởi tạo tài nguyên của cảnh (cần context OpenGL đang active)
+void initScene(){
+    // Khởi tạo hệ thống hạt
+    particleSystem.init();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    loadSceneMesh();
+    loadVolcanoSdf();
+    shaderProgram = compileShader();
+    terrain.init();
+    // Núi lửa phụ dùng lưới gốc (biến dạng lúc chạy sửa trên bản riêng)
+    volcanoField.init(volcanoPositions,volcanoVertexCount,fragmentShaderSource);
+    volcanoField.onBind = [](unsigned int program) { lavaLights.bind(program); };
+
+    // Mặt đất của dòng dung nham lấy mẫu một lần lúc khởi tạo; hạt dung nham
+    // va chạm với mặt trên của dòng chảy (kể cả phần đã đông)
+    volcanoDeformer.init(VBO,volcanoPositions,volcanoVertexCount);
+    lavaFlow.init(sceneGroundHeight);
+    particleSystem.groundHeight = [](float x, float z) { return lavaFlow.surfaceAt(x, z); };
+    particleSystem.collectLandings = useLavaFlow;
+    particleSystem.collider = &volcanoSdf;
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void destroyScene(){
+    particlePass.shutdown();
+    volcanoField.shutdown();
+    lavaLights.shutdown();
+    particleSystem.shutdown();
+    lavaFlow.shutdown();
+    terrain.shutdown();
+    glDeleteVertexArrays(1,&VAO);
+    glDeleteBuffers(1,&VBO);
+    glDeleteProgram(shaderProgram);
+    closeMeshCache(meshCache);
+    volcanoPositions=nullptr;
+}
+
+// Render N frame vào FBO không cần cửa sổ, lưu các frame được chọn
+int runHeadless(const HeadlessOptions &opt){
+    if(!createOffscreenContext(opt.width, opt.height)){
+        std::cerr << "Khong tao duoc context headless" << std::endl;
+        return -1;
+    }
+
+    particleSystem.setSeed(opt.seed);
+    particleSystem.useGpu = opt.gpuParticles;
+    particlePass.factor = opt.particleDownsample;
+    terrainBlocking = true;
+    initScene();
+    if(opt.volcanoField > 0){
+        VolcanoFieldParams fp;
+        fp.count = opt.volcanoField;
+        volcanoField.generate([](float x, float z) { return terrain.heightAt(x, z); }, fp);
+    }
+    if(opt.fastForward > 0.0f){
+        auto t0 = std::chrono::steady_clock::now();
+        particleSystem.fastForward(opt.fastForward, 0.0f, 2.5f, 0.0f);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "Tua nhanh " << opt.fastForward << "s: " << particleSystem.ballistic.particleCount()
+                  << " hat, " << ms << " ms" << std::endl;
+    }
+
+    OffscreenTarget target;
+    if(!createOffscreenTarget(target, opt.width, opt.height)){
+        destroyOffscreenContext();
+        return -1;
+    }
+
+    if(!opt.recordPath.empty()) videoCapture.start(opt.recordPath, opt.width, opt.height);
+
+    std::vector<unsigned char> pixels;
+    double renderMs = 0.0;
+    int saved = 0;
+
+    for(int frame = 1; frame <= opt.frames; frame++){
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+        auto t0 = std::chrono::steady_clock::now();
+        renderFrame(opt.dt, opt.width, opt.height);
+        glFinish();
+        auto t1 = std::chrono::steady_clock::now();
+        renderMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        videoCapture.captureFrame();
+
+        if(shouldCaptureFrame(opt, frame)){
+            readOffscreenPixels(target, pixels);
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "_%05d.%s", frame, opt.rawFormat ? "rgba" : "png");
+            std::string path = opt.outPrefix + suffix;
+            bool ok = opt.rawFormat
+                ? writeRawRGBA(path, opt.width, opt.height, pixels.data())
+                : writePNG(path, opt.width, opt.height, pixels.data());
+            if(ok) saved++;
+        }
+    }
+
+    std::cout << "Headless: " << opt.frames << " frame " << opt.width << "x" << opt.height
+              << ", " << renderMs / opt.frames << " ms/frame, luu " << saved << " anh" << std::endl;
+
+    videoCapture.stop();
+    destroyOffscreenTarget(target);
+    destroyScene();
+    destroyOffscreenContext();
+    return 0;
+}
+
+int main(int argc, char** argv){
+    HeadlessOptions headless;
+    if(!parseHeadlessArgs(argc, argv, headless)) return -1;
+    if(headless.enabled) return runHeadless(headless);
+
     if(!glfwInit()){return -1;}
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
@@ -406,22 +899,14 @@ int main(){
     glfwMakeContextCurrent(window);
     if(glewInit()!=GLEW_OK){return -1;}
 
-    // Khởi tạo hệ thống hạt
-    particleSystem.init();
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    createDetailedVolcano();
-    createLavaPlane();
-    setupBuffers();
-    shaderProgram = compileShader();
+    initScene();
 
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetCursorPosCallback(window, cursorPosCallback);
     glfwSetScrollCallback(window, scrollCallback);
     glfwSetKeyCallback(window, keyCallback); 
-
-    glEnable(GL_DEPTH_TEST);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
     double lastTime = glfwGetTime();
 
@@ -432,74 +917,21 @@ int main(){
         lastTime = currentTime;
 
         processInput(window);
-        
-        glClearColor(0.2f,0.2f,0.2f,1.0f);
-        glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-
-        // Cập nhật hệ thống hạt - phun từ miệng núi lửa (0, 2.5, 0)
-        particleSystem.update(deltaTime, 0.0f, 2.5f, 0.0f);
-
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
 
-        // Chế độ wireframe
-        if (isWireframe) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        } else {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+        renderFrame(deltaTime, framebufferWidth, framebufferHeight);
 
-        // MODEL Matrix (Xoay và Phóng to vật thể)
-        Matrix4x4 rotMat = rotateXY(rotationX, rotationY);
-        // Dịch chuyển núi lửa xuống 1 chút để tâm xoay ở gốc 0,0,0
-        Matrix4x4 transMat = translate(0.0f, -0.5f, 0.0f); 
-        Matrix4x4 modelMat = multiply(transMat, rotMat);
-
-        // CAMERA (VIEW) Matrix and Phép CHIẾU (PROJECTION) Matrix
-        Matrix4x4 viewMat = lookAt({eyeX, eyeY, eyeZ}, {centerX, centerY, centerZ}, {upX, upY, upZ});
-        Matrix4x4 projMat;
-
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height); // Lấy kích thước thực tế hiện tại
-        glViewport(0, 0, width, height); // Báo cho OpenGL biết kích thước mới
-        
-        float ratio = (float)width / (height > 0 ? height : 1);
-
-        float nearVal = 0.01f; 
-        float farVal = 100.0f;
-
-        if (isPerspective) {
-            // Phép chiếu phối cảnh
-            float fovy = (45.0f / zoom) * M_PI / 180.0f; 
-            
-            // Giới hạn fov để tránh bị lật hình (quá zoom)
-            if (fovy < 0.01f) fovy = 0.01f; if (fovy > 3.0f) fovy = 3.0f;
-            projMat = perspective(fovy, ratio, 0.01f, 100.0f);
-        } else {
-            // Phép chiếu song song
-            float s = 2.0f / zoom;
-            projMat = ortho(-s*ratio, s*ratio, -s, s, 0.01f, 100.0f);
+        if (videoCapture.isRecording()) {
+            // Y4M cần kích thước cố định - dừng ghi khi cửa sổ đổi kích thước
+            if (framebufferWidth != videoCapture.width() || framebufferHeight != videoCapture.height()) videoCapture.stop();
+            else videoCapture.captureFrame();
         }
 
-        // FINAL Matrix (M * V * P)
-        Matrix4x4 finalMat = multiply(modelMat, multiply(viewMat, projMat));
-
-        // Gửi ma trận lên Shader
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram,"uTransform"),1,GL_FALSE, finalMat.m);
-        
-        // Vẽ núi lửa
-        glDrawArrays(GL_TRIANGLES,0,vertices.size()/3);
-
-        // Vẽ hệ thống hạt (sử dụng cùng ma trận transform)
-        particleSystem.render(finalMat.m);
-
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1,&VAO);
-    glDeleteBuffers(2,VBO);
-    glDeleteProgram(shaderProgram);
+    videoCapture.stop();
+    destroyScene();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,150 @@
+
+#include "mesh_cache.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t h) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t alignUp(uint64_t v) {
+    return (v + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+}
+
+// ---------------------------------------------------------------------------
+// Map file
+
+static bool mapFile(const string &path, MeshCacheView &view) {
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(f, &size) || size.QuadPart == 0) { CloseHandle(f); return false; }
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m) { CloseHandle(f); return false; }
+    void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (!p) { CloseHandle(m); CloseHandle(f); return false; }
+    view.fileHandle = f;
+    view.mapHandle = m;
+    view.mapping = p;
+    view.mappingSize = (size_t)size.QuadPart;
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // vùng map vẫn còn hiệu lực sau khi đóng fd
+    if (p == MAP_FAILED) return false;
+    view.mapping = p;
+    view.mappingSize = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+void closeMeshCache(MeshCacheView &view) {
+    if (view.mapping) {
+#ifdef _WIN32
+        UnmapViewOfFile(view.mapping);
+        CloseHandle((HANDLE)view.mapHandle);
+        CloseHandle((HANDLE)view.fileHandle);
+#else
+        munmap(view.mapping, view.mappingSize);
+#endif
+    }
+    view = MeshCacheView();
+}
+
+bool openMeshCache(const string &path, uint64_t paramHash, MeshCacheView &view) {
+    view = MeshCacheView();
+    if (!mapFile(path, view)) return false;
+
+    const unsigned char* base = (const unsigned char*)view.mapping;
+    MeshCacheHeader h;
+    bool ok = view.mappingSize >= sizeof(h);
+    if (ok) {
+        memcpy(&h, base, sizeof(h));
+        uint64_t posEnd = h.positionOffset + h.positionBytes;
+        ok = memcmp(h.magic, "VMSH", 4) == 0
+          && h.version == MESH_CACHE_VERSION
+          && h.paramHash == paramHash
+          && h.fileSize == view.mappingSize
+          && h.positionBytes == h.vertexCount * 3 * sizeof(float)
+          && h.volcanoVertexCount <= h.vertexCount
+          && h.positionOffset % MESH_CACHE_ALIGN == 0
+          && posEnd <= h.fileSize;
+    }
+    if (!ok) {
+        cout << "Mesh cache cu hoac hong: " << path << endl;
+        closeMeshCache(view);
+        return false;
+    }
+
+    view.positions = (const float*)(base + h.positionOffset);
+    view.vertexCount = (size_t)h.vertexCount;
+    view.volcanoVertexCount = (size_t)h.volcanoVertexCount;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Ghi file
+
+bool writeMeshCache(const string &path, uint64_t paramHash,
+                    const float* positions, size_t vertexCount, size_t volcanoVertexCount) {
+    MeshCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "VMSH", 4);
+    h.version = MESH_CACHE_VERSION;
+    h.paramHash = paramHash;
+    h.vertexCount = vertexCount;
+    h.volcanoVertexCount = volcanoVertexCount;
+    h.positionBytes = (uint64_t)vertexCount * 3 * sizeof(float);
+    h.positionOffset = alignUp(sizeof(h));
+    h.fileSize = h.positionOffset + h.positionBytes;
+
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        cerr << "Khong ghi duoc mesh cache: " << tmp << endl;
+        return false;
+    }
+
+    static const char zeros[MESH_CACHE_ALIGN] = {};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && fwrite(zeros, 1, h.positionOffset - sizeof(h), f) == h.positionOffset - sizeof(h);
+    ok = ok && fwrite(positions, 1, h.positionBytes, f) == h.positionBytes;
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok) {
+#ifdef _WIN32
+        ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+    }
+    if (!ok) {
+        remove(tmp.c_str());
+        cerr << "Khong ghi duoc mesh cache: " << path << endl;
+        return false;
+    }
+    return true;
+}
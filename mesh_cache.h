@@ -0,0 +1,55 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Cache nhị phân cho lưới tam giác (chỉ vị trí) để khỏi sinh lại mỗi lần chạy.
+// File: header cố định, sau đó là blob vị trí căn lề MESH_CACHE_ALIGN byte.
+// File được mmap và dữ liệu upload thẳng lên VBO từ vùng map.
+// Cache bị coi là cũ nếu magic/version/hash tham số/kích thước không khớp.
+// Version 2: bỏ blob normal (normal phẳng suy ra trong fragment shader).
+
+const uint32_t MESH_CACHE_VERSION = 2;
+const size_t MESH_CACHE_ALIGN = 64;
+
+struct MeshCacheHeader {
+    char magic[4];                // "VMSH"
+    uint32_t version;
+    uint64_t paramHash;           // hash tham số sinh lưới
+    uint64_t vertexCount;
+    uint64_t volcanoVertexCount;  // phần đầu là núi lửa, phần còn lại là mặt phẳng dung nham
+    uint64_t positionOffset;
+    uint64_t positionBytes;
+    uint64_t fileSize;
+};
+
+// Vùng nhớ đã map của một file cache hợp lệ
+struct MeshCacheView {
+    const float* positions = nullptr;
+    size_t vertexCount = 0;
+    size_t volcanoVertexCount = 0;
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mapHandle = nullptr;
+#endif
+};
+
+// FNV-1a, dùng để ghép hash các tham số
+uint64_t hashBytes(const void* data, size_t size, uint64_t h = 1469598103934665603ull);
+template<typename T>
+uint64_t hashValue(const T &v, uint64_t h = 1469598103934665603ull) { return hashBytes(&v, sizeof(T), h); }
+
+// Trả về false nếu file không có hoặc đã cũ
+bool openMeshCache(const std::string &path, uint64_t paramHash, MeshCacheView &view);
+void closeMeshCache(MeshCacheView &view);
+
+// Ghi ra file tạm rồi đổi tên, để không bao giờ để lại file cache dở dang
+bool writeMeshCache(const std::string &path, uint64_t paramHash,
+                    const float* positions, size_t vertexCount, size_t volcanoVertexCount);
+
+#endif
@@ -0,0 +1,148 @@
+
+#include "mesh_deform.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Hai tam giác bị sửa cách nhau không quá chừng này tam giác thì upload chung
+// một lần (đỡ số lệnh gọi, đổi lại upload thừa vài byte)
+static const size_t MERGE_GAP = 8;
+
+void MeshDeformer::init(unsigned int positionVbo, const float* pos, size_t vertexCount, float cell) {
+    vbo = positionVbo;
+    source = pos;
+    positions.clear();
+    triangleCount = vertexCount / 3;
+    cellSize = cell;
+    totalUploadBytes = 0;
+    rebuildCells();
+    triangleDirty.assign(triangleCount, 0);
+    dirtyTriangles.clear();
+    vertexDone.assign(triangleCount * 3, 0);
+}
+
+// Chia tam giác vào ô theo trọng tâm hiện tại (đếm rồi xếp, không cấp phát từng ô)
+void MeshDeformer::rebuildCells() {
+    const float* positions = vertexData();
+    float bmin[3] = {1e30f, 1e30f, 1e30f}, bmax[3] = {-1e30f, -1e30f, -1e30f};
+    for (size_t v = 0; v < triangleCount * 3; v++) {
+        for (int k = 0; k < 3; k++) {
+            bmin[k] = min(bmin[k], positions[v * 3 + k]);
+            bmax[k] = max(bmax[k], positions[v * 3 + k]);
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        boundsMin[k] = triangleCount ? bmin[k] : 0.0f;
+        dims[k] = triangleCount ? max(1, (int)ceilf((bmax[k] - bmin[k]) / cellSize) + 1) : 1;
+    }
+
+    vector<uint32_t> triCell(triangleCount);
+    cellStart.assign((size_t)dims[0] * dims[1] * dims[2] + 1, 0);
+    maxTriangleExtent = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const float* p = positions + t * 9;
+        float c[3];
+        int ci[3];
+        for (int k = 0; k < 3; k++) {
+            c[k] = (p[k] + p[3 + k] + p[6 + k]) / 3.0f;
+            ci[k] = min(max((int)((c[k] - boundsMin[k]) / cellSize), 0), dims[k] - 1);
+        }
+        for (int v = 0; v < 3; v++) {
+            float dx = p[v * 3] - c[0], dy = p[v * 3 + 1] - c[1], dz = p[v * 3 + 2] - c[2];
+            maxTriangleExtent = max(maxTriangleExtent, sqrtf(dx * dx + dy * dy + dz * dz));
+        }
+        triCell[t] = cellIndex(ci[0], ci[1], ci[2]);
+        cellStart[triCell[t] + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    cellTriangles.resize(triangleCount);
+    vector<uint32_t> fillPos(cellStart.begin(), cellStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) cellTriangles[fillPos[triCell[t]]++] = (uint32_t)t;
+
+    vertexShift.assign(triangleCount * 3, 0.0f);
+    maxDisplacement = 0.0f;
+}
+
+void MeshDeformer::displace(const float center[3], float radius, float radial, float vertical) {
+    if (triangleCount == 0 || radius <= 0.0f) return;
+
+    // Vùng ô cần duyệt: hộp của brush nới thêm kích thước tam giác và độ dịch
+    // đã tích lũy từ lần xếp ô gần nhất
+    float reach = radius + maxTriangleExtent + maxDisplacement;
+    int lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+        lo[k] = max((int)floorf((center[k] - reach - boundsMin[k]) / cellSize), 0);
+        hi[k] = min((int)floorf((center[k] + reach - boundsMin[k]) / cellSize), dims[k] - 1);
+        if (lo[k] > hi[k]) return;
+    }
+
+    // Sửa lần đầu: chép lưới gốc ra bản riêng
+    if (positions.empty()) positions.assign(source, source + triangleCount * 9);
+
+    float r2 = radius * radius;
+    float magnitude = sqrtf(radial * radial + vertical * vertical);
+    vector<uint32_t> touched;
+    for (int z = lo[2]; z <= hi[2]; z++) {
+        for (int y = lo[1]; y <= hi[1]; y++) {
+            for (int x = lo[0]; x <= hi[0]; x++) {
+                int c = cellIndex(x, y, z);
+                for (uint32_t i = cellStart[c]; i < cellStart[c + 1]; i++) {
+                    uint32_t t = cellTriangles[i];
+                    bool moved = false;
+                    for (int v = 0; v < 3; v++) {
+                        uint32_t vi = t * 3 + v;
+                        if (vertexDone[vi]) continue;
+                        float* p = &positions[(size_t)vi * 3];
+                        float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+                        float d2 = dx * dx + dy * dy + dz * dz;
+                        if (d2 >= r2) continue;
+
+                        // (1 - (d/r)^2)^2: trơn và bằng 0 ở mép
+                        float w = 1.0f - d2 / r2;
+                        w *= w;
+                        float h = sqrtf(p[0] * p[0] + p[2] * p[2]);
+                        if (h > 1e-6f) {
+                            p[0] += p[0] / h * radial * w;
+                            p[2] += p[2] / h * radial * w;
+                        }
+                        p[1] += vertical * w;
+                        vertexShift[vi] += magnitude * w;
+                        maxDisplacement = max(maxDisplacement, vertexShift[vi]);
+                        vertexDone[vi] = 1;
+                        touched.push_back(vi);
+                        moved = true;
+                    }
+                    if (moved && !triangleDirty[t]) {
+                        triangleDirty[t] = 1;
+                        dirtyTriangles.push_back(t);
+                    }
+                }
+            }
+        }
+    }
+    for (uint32_t vi : touched) vertexDone[vi] = 0;
+    if (maxDisplacement > cellSize) rebuildCells();
+}
+
+void MeshDeformer::flush() {
+    if (dirtyTriangles.empty()) return;
+    sort(dirtyTriangles.begin(), dirtyTriangles.end());
+    for (uint32_t t : dirtyTriangles) triangleDirty[t] = 0;
+
+    // Gộp thành các đoạn liên tiếp, mỗi đoạn một glBufferSubData
+    const size_t triBytes = 9 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    size_t i = 0;
+    while (i < dirtyTriangles.size()) {
+        size_t first = dirtyTriangles[i], last = first;
+        while (i + 1 < dirtyTriangles.size() && dirtyTriangles[i + 1] - last <= MERGE_GAP) last = dirtyTriangles[++i];
+        i++;
+        size_t offset = first * triBytes, bytes = (last - first + 1) * triBytes;
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, (const char*)positions.data() + offset);
+        totalUploadBytes += bytes;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    dirtyTriangles.clear();
+}
@@ -0,0 +1,62 @@
+#ifndef MESH_DEFORM_H
+#define MESH_DEFORM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Biến dạng cục bộ lưới tam giác rời (triangle soup, chỉ vị trí) đang nằm
+// trên GPU: bồi dung nham, sụt miệng núi, tro tích tụ...
+// - Tam giác được chia vào lưới ô 3D theo trọng tâm, mỗi lần sửa chỉ duyệt
+//   các ô giao với vùng ảnh hưởng (dirty box).
+// - Độ dịch chỉ phụ thuộc vị trí đỉnh, nên các đỉnh trùng nhau của tam giác
+//   kề nhau luôn dịch như nhau, lưới không bị hở.
+// - flush() gộp các tam giác bị sửa thành các đoạn liên tiếp và chỉ upload các
+//   đoạn byte đó bằng glBufferSubData. Normal phẳng do fragment shader tự suy
+//   ra từ vị trí nên không phải tính lại.
+
+class MeshDeformer {
+public:
+    // positions: nội dung ban đầu của VBO (vertexCount*3 float, vd. vùng mmap
+    // của cache lưới), chỉ đọc và phải sống tới lần displace() đầu tiên; lúc đó
+    // deformer mới chép ra bản CPU riêng để sửa. Chỉ vertexCount đỉnh đầu tiên
+    // (bội của 3) được biến dạng.
+    void init(unsigned int positionVbo, const float* positions, size_t vertexCount, float cellSize = 0.25f);
+
+    // Dịch các đỉnh trong bán kính radius quanh center: radial theo hướng ngang
+    // ra xa trục Y, vertical theo trục Y. Trọng số giảm mượt về 0 ở mép.
+    void displace(const float center[3], float radius, float radial, float vertical);
+
+    // Upload phần thay đổi
+    void flush();
+
+    bool pending() const { return !dirtyTriangles.empty(); }
+    size_t uploadedBytes() const { return totalUploadBytes; }
+
+private:
+    unsigned int vbo = 0;
+    const float* source = nullptr;       // lưới gốc, dùng tới khi bị sửa lần đầu
+    std::vector<float> positions;        // bản CPU đang sửa, rỗng khi chưa sửa
+    size_t triangleCount = 0;
+
+    // Lưới ô (CSR): cellStart[c]..cellStart[c+1] là chỉ số trong cellTriangles
+    float boundsMin[3] = {0, 0, 0};
+    float cellSize = 0.25f;
+    int dims[3] = {1, 1, 1};
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> cellTriangles;
+    float maxTriangleExtent = 0.0f;  // khoảng cách xa nhất từ trọng tâm tới đỉnh
+    float maxDisplacement = 0.0f;    // độ dịch lớn nhất của một đỉnh từ lần xếp ô gần nhất
+    std::vector<float> vertexShift;  // độ dịch tích lũy từng đỉnh, vượt 1 ô thì xếp lại
+
+    std::vector<uint8_t> triangleDirty;
+    std::vector<uint32_t> dirtyTriangles;
+    std::vector<uint8_t> vertexDone;  // tránh dịch một đỉnh 2 lần trong một lần sửa
+    size_t totalUploadBytes = 0;
+
+    const float* vertexData() const { return positions.empty() ? source : positions.data(); }
+    int cellIndex(int x, int y, int z) const { return (z * dims[1] + y) * dims[0] + x; }
+    void rebuildCells();
+};
+
+#endif
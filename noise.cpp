@@ -0,0 +1,445 @@
+
+#include "noise.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_SSE2 1
+#endif
+
+using namespace std;
+
+// Hằng số lưới simplex 2D/3D
+static const float F2 = 0.366025403f;  // (sqrt(3) - 1) / 2
+static const float G2 = 0.211324865f;  // (3 - sqrt(3)) / 6
+static const float F3 = 1.0f / 3.0f;
+static const float G3 = 1.0f / 6.0f;
+
+// Số điểm mỗi khối khi tính fBm theo mảng (bộ đệm trên stack)
+static const size_t BATCH_CHUNK = 256;
+
+// ---------------------------------------------------------------------------
+// Bản vô hướng
+
+static inline int fastFloor(float x) {
+    int i = (int)x;
+    return x < (float)i ? i - 1 : i;
+}
+
+static inline uint32_t hash2(int32_t i, int32_t j, uint32_t seed) {
+    uint32_t h = ((uint32_t)i * 0x8DA6B343u) ^ ((uint32_t)j * 0xD8163841u) ^ (seed * 0xCB1AB31Fu);
+    h ^= h >> 13;
+    h *= 0x5BD1E995u;
+    h ^= h >> 15;
+    return h;
+}
+
+static inline uint32_t hash3(int32_t i, int32_t j, int32_t k, uint32_t seed) {
+    uint32_t h = ((uint32_t)i * 0x8DA6B343u) ^ ((uint32_t)j * 0xD8163841u)
+               ^ ((uint32_t)k * 0xCB1AB31Fu) ^ (seed * 0x165667B1u);
+    h ^= h >> 13;
+    h *= 0x5BD1E995u;
+    h ^= h >> 15;
+    return h;
+}
+
+// 8 hướng gradient 2D (Gustavson)
+static inline float grad2(uint32_t h, float x, float y) {
+    h &= 7;
+    float u = h < 4 ? x : y;
+    float v = h < 4 ? y : x;
+    return ((h & 1) ? -u : u) + ((h & 2) ? -2.0f * v : 2.0f * v);
+}
+
+// 12 hướng cạnh khối lập phương (+4 lặp lại) cho 3D
+static inline float grad3(uint32_t h, float x, float y, float z) {
+    h &= 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+float simplex2(float x, float y, uint32_t seed) {
+    float s = (x + y) * F2;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    float t = (float)(i + j) * G2;
+    float x0 = x - ((float)i - t);
+    float y0 = y - ((float)j - t);
+
+    int i1 = x0 > y0 ? 1 : 0;
+    int j1 = 1 - i1;
+    float x1 = x0 - (float)i1 + G2;
+    float y1 = y0 - (float)j1 + G2;
+    float x2 = x0 - 1.0f + 2.0f * G2;
+    float y2 = y0 - 1.0f + 2.0f * G2;
+
+    float n0 = 0.0f, n1 = 0.0f, n2 = 0.0f;
+    float t0 = 0.5f - x0 * x0 - y0 * y0;
+    if (t0 > 0.0f) { t0 *= t0; n0 = t0 * t0 * grad2(hash2(i, j, seed), x0, y0); }
+    float t1 = 0.5f - x1 * x1 - y1 * y1;
+    if (t1 > 0.0f) { t1 *= t1; n1 = t1 * t1 * grad2(hash2(i + i1, j + j1, seed), x1, y1); }
+    float t2 = 0.5f - x2 * x2 - y2 * y2;
+    if (t2 > 0.0f) { t2 *= t2; n2 = t2 * t2 * grad2(hash2(i + 1, j + 1, seed), x2, y2); }
+
+    return 40.0f * (n0 + n1 + n2);
+}
+
+float simplex3(float x, float y, float z, uint32_t seed) {
+    float s = (x + y + z) * F3;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    int k = fastFloor(z + s);
+    float t = (float)(i + j + k) * G3;
+    float x0 = x - ((float)i - t);
+    float y0 = y - ((float)j - t);
+    float z0 = z - ((float)k - t);
+
+    // Chọn simplex chứa điểm
+    int i1, j1, k1, i2, j2, k2;
+    if (x0 >= y0) {
+        if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+        else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+        else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+    } else {
+        if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+        else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+        else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+    }
+
+    float x1 = x0 - i1 + G3, y1 = y0 - j1 + G3, z1 = z0 - k1 + G3;
+    float x2 = x0 - i2 + 2.0f * G3, y2 = y0 - j2 + 2.0f * G3, z2 = z0 - k2 + 2.0f * G3;
+    float x3 = x0 - 1.0f + 3.0f * G3, y3 = y0 - 1.0f + 3.0f * G3, z3 = z0 - 1.0f + 3.0f * G3;
+
+    float n = 0.0f;
+    float t0 = 0.6f - x0 * x0 - y0 * y0 - z0 * z0;
+    if (t0 > 0.0f) { t0 *= t0; n += t0 * t0 * grad3(hash3(i, j, k, seed), x0, y0, z0); }
+    float t1 = 0.6f - x1 * x1 - y1 * y1 - z1 * z1;
+    if (t1 > 0.0f) { t1 *= t1; n += t1 * t1 * grad3(hash3(i + i1, j + j1, k + k1, seed), x1, y1, z1); }
+    float t2 = 0.6f - x2 * x2 - y2 * y2 - z2 * z2;
+    if (t2 > 0.0f) { t2 *= t2; n += t2 * t2 * grad3(hash3(i + i2, j + j2, k + k2, seed), x2, y2, z2); }
+    float t3 = 0.6f - x3 * x3 - y3 * y3 - z3 * z3;
+    if (t3 > 0.0f) { t3 *= t3; n += t3 * t3 * grad3(hash3(i + 1, j + 1, k + 1, seed), x3, y3, z3); }
+
+    return 32.0f * n;
+}
+
+// Tham số cho 2 trường lệch của domain warping
+static NoiseParams warpParams(const NoiseParams &p, uint32_t salt) {
+    NoiseParams w = p;
+    w.seed = p.seed + salt;
+    w.octaves = p.warpOctaves;
+    w.frequency = p.warpFrequency;
+    w.warpStrength = 0.0f;
+    return w;
+}
+
+float fbm2(float x, float y, const NoiseParams &p) {
+    if (p.warpStrength > 0.0f) {
+        float wx = fbm2(x, y, warpParams(p, 101));
+        float wy = fbm2(x, y, warpParams(p, 211));
+        x = x + p.warpStrength * wx;
+        y = y + p.warpStrength * wy;
+    }
+    float sum = 0.0f, amp = 1.0f, freq = p.frequency, norm = 0.0f;
+    for (int o = 0; o < p.octaves; o++) {
+        sum = sum + amp * simplex2(x * freq, y * freq, p.seed + o);
+        norm += amp;
+        amp *= p.gain;
+        freq *= p.lacunarity;
+    }
+    return norm > 0.0f ? sum / norm : 0.0f;
+}
+
+float fbm3(float x, float y, float z, const NoiseParams &p) {
+    if (p.warpStrength > 0.0f) {
+        float wx = fbm3(x, y, z, warpParams(p, 101));
+        float wy = fbm3(x, y, z, warpParams(p, 211));
+        float wz = fbm3(x, y, z, warpParams(p, 307));
+        x = x + p.warpStrength * wx;
+        y = y + p.warpStrength * wy;
+        z = z + p.warpStrength * wz;
+    }
+    float sum = 0.0f, amp = 1.0f, freq = p.frequency, norm = 0.0f;
+    for (int o = 0; o < p.octaves; o++) {
+        sum = sum + amp * simplex3(x * freq, y * freq, z * freq, p.seed + o);
+        norm += amp;
+        amp *= p.gain;
+        freq *= p.lacunarity;
+    }
+    return norm > 0.0f ? sum / norm : 0.0f;
+}
+
+// ---------------------------------------------------------------------------
+// Bản SSE2: 4 điểm mỗi lần, cùng thứ tự phép tính với bản vô hướng
+
+#ifdef NOISE_SSE2
+
+// Nhân 32 bit lấy phần thấp (SSE2 không có _mm_mullo_epi32)
+static inline __m128i mullo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i floorToInt(__m128 v) {
+    __m128i i = _mm_cvttps_epi32(v);
+    __m128 f = _mm_cvtepi32_ps(i);
+    // f > v -> trừ 1 (mask = -1)
+    return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(f, v)));
+}
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i hash2x4(__m128i i, __m128i j, __m128i seedMul) {
+    __m128i h = _mm_xor_si128(_mm_xor_si128(mullo32(i, _mm_set1_epi32((int)0x8DA6B343u)),
+                                            mullo32(j, _mm_set1_epi32((int)0xD8163841u))), seedMul);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = mullo32(h, _mm_set1_epi32(0x5BD1E995));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    return h;
+}
+
+static inline __m128 grad2x4(__m128i h, __m128 x, __m128 y) {
+    h = _mm_and_si128(h, _mm_set1_epi32(7));
+    __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m128 u = select(lt4, x, y);
+    __m128 v = select(lt4, y, x);
+    __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+    __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(_mm_mul_ps(_mm_set1_ps(2.0f), v), signV));
+}
+
+static inline __m128 corner2x4(__m128 x, __m128 y, __m128i h) {
+    __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+    __m128 positive = _mm_cmpgt_ps(t, _mm_setzero_ps());
+    t = _mm_mul_ps(t, t);
+    __m128 n = _mm_mul_ps(_mm_mul_ps(t, t), grad2x4(h, x, y));
+    return _mm_and_ps(positive, n);
+}
+
+static inline __m128 simplex2x4(__m128 x, __m128 y, __m128i seedMul) {
+    const __m128 g2 = _mm_set1_ps(G2);
+    __m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+    __m128i i = floorToInt(_mm_add_ps(x, s));
+    __m128i j = floorToInt(_mm_add_ps(y, s));
+    __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), g2);
+    __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+    __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+    __m128 m = _mm_cmpgt_ps(x0, y0);  // i1 = 1, j1 = 0
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 i1 = _mm_and_ps(m, one);
+    __m128 j1 = _mm_andnot_ps(m, one);
+    __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), g2);
+    __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), g2);
+    __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(2.0f * G2));
+    __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(2.0f * G2));
+
+    __m128i mi = _mm_castps_si128(m);  // -1 khi i1 = 1
+    __m128i ione = _mm_set1_epi32(1);
+    __m128i h0 = hash2x4(i, j, seedMul);
+    __m128i h1 = hash2x4(_mm_sub_epi32(i, mi), _mm_add_epi32(_mm_add_epi32(j, ione), mi), seedMul);
+    __m128i h2 = hash2x4(_mm_add_epi32(i, ione), _mm_add_epi32(j, ione), seedMul);
+
+    __m128 n0 = corner2x4(x0, y0, h0);
+    __m128 n1 = corner2x4(x1, y1, h1);
+    __m128 n2 = corner2x4(x2, y2, h2);
+    return _mm_mul_ps(_mm_set1_ps(40.0f), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+}
+
+static inline __m128i hash3x4(__m128i i, __m128i j, __m128i k, __m128i seedMul) {
+    __m128i h = _mm_xor_si128(_mm_xor_si128(mullo32(i, _mm_set1_epi32((int)0x8DA6B343u)),
+                                            mullo32(j, _mm_set1_epi32((int)0xD8163841u))),
+                              _mm_xor_si128(mullo32(k, _mm_set1_epi32((int)0xCB1AB31Fu)), seedMul));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = mullo32(h, _mm_set1_epi32(0x5BD1E995));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    return h;
+}
+
+static inline __m128 grad3x4(__m128i h, __m128 x, __m128 y, __m128 z) {
+    h = _mm_and_si128(h, _mm_set1_epi32(15));
+    __m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+    __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+    __m128 useX = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+                                                _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+    __m128 u = select(lt8, x, y);
+    __m128 v = select(lt4, y, select(useX, x, z));
+    __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+    __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+    return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(v, signV));
+}
+
+static inline __m128 corner3x4(__m128 x, __m128 y, __m128 z, __m128i h) {
+    __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)),
+                          _mm_mul_ps(z, z));
+    __m128 positive = _mm_cmpgt_ps(t, _mm_setzero_ps());
+    t = _mm_mul_ps(t, t);
+    __m128 n = _mm_mul_ps(_mm_mul_ps(t, t), grad3x4(h, x, y, z));
+    return _mm_and_ps(positive, n);
+}
+
+static inline __m128 simplex3x4(__m128 x, __m128 y, __m128 z, __m128i seedMul) {
+    const __m128 g3 = _mm_set1_ps(G3);
+    __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+    __m128i i = floorToInt(_mm_add_ps(x, s));
+    __m128i j = floorToInt(_mm_add_ps(y, s));
+    __m128i k = floorToInt(_mm_add_ps(z, s));
+    __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), g3);
+    __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+    __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+    __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+    // Chọn simplex như nhánh if của bản vô hướng: góc thứ 2 lấy trục lớn nhất,
+    // góc thứ 3 bỏ trục nhỏ nhất (i2 + j2 + k2 = 2)
+    __m128 xy = _mm_cmpge_ps(x0, y0), yz = _mm_cmpge_ps(y0, z0), xz = _mm_cmpge_ps(x0, z0);
+    const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 mi1 = _mm_and_ps(xy, xz);
+    __m128 mj1 = _mm_andnot_ps(xy, yz);
+    __m128 mk1 = _mm_andnot_ps(_mm_or_ps(mi1, mj1), all);
+    __m128 mi2 = _mm_or_ps(xy, xz);
+    __m128 mj2 = _mm_or_ps(_mm_andnot_ps(xy, all), yz);
+    __m128 mk2 = _mm_andnot_ps(_mm_and_ps(mi2, mj2), all);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(mi1, one)), g3);
+    __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(mj1, one)), g3);
+    __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(mk1, one)), g3);
+    __m128 g3x2 = _mm_set1_ps(2.0f * G3);
+    __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(mi2, one)), g3x2);
+    __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(mj2, one)), g3x2);
+    __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(mk2, one)), g3x2);
+    __m128 g3x3 = _mm_set1_ps(3.0f * G3);
+    __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, one), g3x3);
+    __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, one), g3x3);
+    __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, one), g3x3);
+
+    // Mặt nạ -1 nên i - mặt nạ = i + 1
+    __m128i ione = _mm_set1_epi32(1);
+    __m128i h0 = hash3x4(i, j, k, seedMul);
+    __m128i h1 = hash3x4(_mm_sub_epi32(i, _mm_castps_si128(mi1)), _mm_sub_epi32(j, _mm_castps_si128(mj1)),
+                         _mm_sub_epi32(k, _mm_castps_si128(mk1)), seedMul);
+    __m128i h2 = hash3x4(_mm_sub_epi32(i, _mm_castps_si128(mi2)), _mm_sub_epi32(j, _mm_castps_si128(mj2)),
+                         _mm_sub_epi32(k, _mm_castps_si128(mk2)), seedMul);
+    __m128i h3 = hash3x4(_mm_add_epi32(i, ione), _mm_add_epi32(j, ione), _mm_add_epi32(k, ione), seedMul);
+
+    // Cộng dồn từ 0 theo đúng thứ tự như n += ... (giữ cả dấu của số 0)
+    __m128 n = _mm_add_ps(_mm_setzero_ps(), corner3x4(x0, y0, z0, h0));
+    n = _mm_add_ps(n, corner3x4(x1, y1, z1, h1));
+    n = _mm_add_ps(n, corner3x4(x2, y2, z2, h2));
+    n = _mm_add_ps(n, corner3x4(x3, y3, z3, h3));
+    return _mm_mul_ps(_mm_set1_ps(32.0f), n);
+}
+
+void simplex2Batch(const float* x, const float* y, float* out, size_t n, uint32_t seed) {
+    __m128i seedMul = _mm_set1_epi32((int)(seed * 0xCB1AB31Fu));
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        _mm_storeu_ps(out + k, simplex2x4(_mm_loadu_ps(x + k), _mm_loadu_ps(y + k), seedMul));
+    }
+    for (; k < n; k++) out[k] = simplex2(x[k], y[k], seed);
+}
+
+void simplex3Batch(const float* x, const float* y, const float* z, float* out, size_t n, uint32_t seed) {
+    __m128i seedMul = _mm_set1_epi32((int)(seed * 0x165667B1u));
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        _mm_storeu_ps(out + k, simplex3x4(_mm_loadu_ps(x + k), _mm_loadu_ps(y + k), _mm_loadu_ps(z + k), seedMul));
+    }
+    for (; k < n; k++) out[k] = simplex3(x[k], y[k], z[k], seed);
+}
+
+#else
+
+void simplex2Batch(const float* x, const float* y, float* out, size_t n, uint32_t seed) {
+    for (size_t k = 0; k < n; k++) out[k] = simplex2(x[k], y[k], seed);
+}
+
+void simplex3Batch(const float* x, const float* y, const float* z, float* out, size_t n, uint32_t seed) {
+    for (size_t k = 0; k < n; k++) out[k] = simplex3(x[k], y[k], z[k], seed);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// fBm theo mảng
+
+void fbm2Batch(const float* x, const float* y, float* out, size_t n, const NoiseParams &p) {
+    float xs[BATCH_CHUNK], ys[BATCH_CHUNK], tmp[BATCH_CHUNK];
+    float wx[BATCH_CHUNK], wy[BATCH_CHUNK];
+    NoiseParams wpx = warpParams(p, 101), wpy = warpParams(p, 211);
+
+    for (size_t base = 0; base < n; base += BATCH_CHUNK) {
+        size_t m = min(BATCH_CHUNK, n - base);
+        const float* px = x + base;
+        const float* py = y + base;
+        float* po = out + base;
+
+        if (p.warpStrength > 0.0f) {
+            fbm2Batch(px, py, wx, m, wpx);
+            fbm2Batch(px, py, wy, m, wpy);
+            for (size_t k = 0; k < m; k++) {
+                wx[k] = px[k] + p.warpStrength * wx[k];
+                wy[k] = py[k] + p.warpStrength * wy[k];
+            }
+            px = wx;
+            py = wy;
+        }
+
+        for (size_t k = 0; k < m; k++) po[k] = 0.0f;
+        float amp = 1.0f, freq = p.frequency, norm = 0.0f;
+        for (int o = 0; o < p.octaves; o++) {
+            for (size_t k = 0; k < m; k++) { xs[k] = px[k] * freq; ys[k] = py[k] * freq; }
+            simplex2Batch(xs, ys, tmp, m, p.seed + o);
+            for (size_t k = 0; k < m; k++) po[k] = po[k] + amp * tmp[k];
+            norm += amp;
+            amp *= p.gain;
+            freq *= p.lacunarity;
+        }
+        for (size_t k = 0; k < m; k++) po[k] = norm > 0.0f ? po[k] / norm : 0.0f;
+    }
+}
+
+void fbm3Batch(const float* x, const float* y, const float* z, float* out, size_t n, const NoiseParams &p) {
+    float xs[BATCH_CHUNK], ys[BATCH_CHUNK], zs[BATCH_CHUNK], tmp[BATCH_CHUNK];
+    float wx[BATCH_CHUNK], wy[BATCH_CHUNK], wz[BATCH_CHUNK];
+    NoiseParams wpx = warpParams(p, 101), wpy = warpParams(p, 211), wpz = warpParams(p, 307);
+
+    for (size_t base = 0; base < n; base += BATCH_CHUNK) {
+        size_t m = min(BATCH_CHUNK, n - base);
+        const float* px = x + base;
+        const float* py = y + base;
+        const float* pz = z + base;
+        float* po = out + base;
+
+        if (p.warpStrength > 0.0f) {
+            fbm3Batch(px, py, pz, wx, m, wpx);
+            fbm3Batch(px, py, pz, wy, m, wpy);
+            fbm3Batch(px, py, pz, wz, m, wpz);
+            for (size_t k = 0; k < m; k++) {
+                wx[k] = px[k] + p.warpStrength * wx[k];
+                wy[k] = py[k] + p.warpStrength * wy[k];
+                wz[k] = pz[k] + p.warpStrength * wz[k];
+            }
+            px = wx;
+            py = wy;
+            pz = wz;
+        }
+
+        for (size_t k = 0; k < m; k++) po[k] = 0.0f;
+        float amp = 1.0f, freq = p.frequency, norm = 0.0f;
+        for (int o = 0; o < p.octaves; o++) {
+            for (size_t k = 0; k < m; k++) { xs[k] = px[k] * freq; ys[k] = py[k] * freq; zs[k] = pz[k] * freq; }
+            simplex3Batch(xs, ys, zs, tmp, m, p.seed + o);
+            for (size_t k = 0; k < m; k++) po[k] = po[k] + amp * tmp[k];
+            norm += amp;
+            amp *= p.gain;
+            freq *= p.lacunarity;
+        }
+        for (size_t k = 0; k < m; k++) po[k] = norm > 0.0f ? po[k] / norm : 0.0f;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Thư viện nhiễu gradient (simplex) dùng cho địa hình và bề mặt núi lửa.
+// - Gradient lấy từ hash số nguyên của điểm lưới + seed, không dùng bảng hoán vị,
+//   nên cùng seed luôn cho cùng kết quả.
+// - Hàm *Batch tính cả mảng điểm trong một lần gọi; trên x86 dùng SSE2 (4 điểm/lệnh),
+//   kết quả giống hệt bản vô hướng.
+// Giá trị trả về nằm trong khoảng xấp xỉ [-1, 1].
+
+struct NoiseParams {
+    uint32_t seed = 0;
+    int octaves = 5;
+    float frequency = 1.0f;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    // Domain warping: p += warpStrength * fbm(p * warpFrequency), 0 = tắt
+    float warpStrength = 0.0f;
+    float warpFrequency = 1.0f;
+    int warpOctaves = 2;
+};
+
+float simplex2(float x, float y, uint32_t seed);
+float simplex3(float x, float y, float z, uint32_t seed);
+
+// fBm (tổng các octave), có domain warping nếu warpStrength > 0
+float fbm2(float x, float y, const NoiseParams &p);
+float fbm3(float x, float y, float z, const NoiseParams &p);
+
+void simplex2Batch(const float* x, const float* y, float* out, size_t n, uint32_t seed);
+void simplex3Batch(const float* x, const float* y, const float* z, float* out, size_t n, uint32_t seed);
+void fbm2Batch(const float* x, const float* y, float* out, size_t n, const NoiseParams &p);
+void fbm3Batch(const float* x, const float* y, const float* z, float* out, size_t n, const NoiseParams &p);
+
+#endif
@@ -0,0 +1,354 @@
+
+#include "offscreen.h"
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define OFFSCREEN_HAS_EGL 1
+#endif
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Tham số dòng lệnh
+
+bool parseHeadlessArgs(int argc, char** argv, HeadlessOptions &opt) {
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool hasNext = i + 1 < argc;
+        if (a == "--headless" && hasNext) {
+            opt.enabled = true;
+            opt.frames = atoi(argv[++i]);
+        } else if (a == "--size" && hasNext) {
+            if (sscanf(argv[++i], "%dx%d", &opt.width, &opt.height) != 2) {
+                cerr << "--size phai co dang WxH" << endl;
+                return false;
+            }
+        } else if (a == "--capture" && hasNext) {
+            stringstream ss(argv[++i]);
+            string item;
+            while (getline(ss, item, ',')) {
+                if (!item.empty()) opt.captureFrames.push_back(atoi(item.c_str()));
+            }
+        } else if (a == "--capture-every" && hasNext) {
+            opt.captureEvery = atoi(argv[++i]);
+        } else if (a == "--out" && hasNext) {
+            opt.outPrefix = argv[++i];
+        } else if (a == "--format" && hasNext) {
+            string f = argv[++i];
+            if (f != "png" && f != "raw") {
+                cerr << "--format chi nhan png hoac raw" << endl;
+                return false;
+            }
+            opt.rawFormat = (f == "raw");
+        } else if (a == "--seed" && hasNext) {
+            opt.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        } else if (a == "--record" && hasNext) {
+            opt.recordPath = argv[++i];
+        } else if (a == "--fast-forward" && hasNext) {
+            opt.fastForward = (float)atof(argv[++i]);
+        } else if (a == "--particle-downsample" && hasNext) {
+            opt.particleDownsample = atoi(argv[++i]);
+            if (opt.particleDownsample != 1 && opt.particleDownsample != 2 && opt.particleDownsample != 4) {
+                cerr << "--particle-downsample chi nhan 1, 2 hoac 4" << endl;
+                return false;
+            }
+        } else if (a == "--volcano-field" && hasNext) {
+            opt.volcanoField = atoi(argv[++i]);
+        } else if (a == "--gpu-particles") {
+            opt.gpuParticles = true;
+        } else {
+            cerr << "Tham so khong hop le: " << a << endl;
+            return false;
+        }
+    }
+    if (opt.enabled && (opt.frames <= 0 || opt.width <= 0 || opt.height <= 0)) {
+        cerr << "So frame va kich thuoc phai lon hon 0" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool shouldCaptureFrame(const HeadlessOptions &opt, int frame) {
+    if (opt.captureEvery > 0 && frame % opt.captureEvery == 0) return true;
+    for (int f : opt.captureFrames) {
+        if (f == frame) return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Context
+
+#ifdef OFFSCREEN_HAS_EGL
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+static EGLSurface eglSurface = EGL_NO_SURFACE;
+
+// Ưu tiên EGL surfaceless (Mesa), nếu không có thì dùng pbuffer 1x1 -
+// mọi thứ đều được vẽ vào FBO nên kích thước surface không quan trọng
+static bool createEGLContext() {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY) eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) {
+        eglDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs);
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    const char* exts = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    bool surfaceless = exts && strstr(exts, "EGL_KHR_surfaceless_context");
+    bool noConfig = exts && strstr(exts, "EGL_KHR_no_config_context");
+
+    if (numConfigs == 0 && !noConfig) return false;
+    eglContext = eglCreateContext(eglDisplay, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR,
+                                  EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT) return false;
+
+    if (!surfaceless && numConfigs > 0) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, pbufferAttribs);
+        if (eglSurface == EGL_NO_SURFACE) return false;
+    }
+    return eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext) == EGL_TRUE;
+}
+#endif
+
+static GLFWwindow* hiddenWindow = nullptr;
+
+bool createOffscreenContext(int width, int height) {
+    bool ok = false;
+#ifdef OFFSCREEN_HAS_EGL
+    ok = createEGLContext();
+    if (ok) cout << "Headless: EGL " << (eglSurface == EGL_NO_SURFACE ? "surfaceless" : "pbuffer") << endl;
+#endif
+    if (!ok) {
+        // Dự phòng: cửa sổ GLFW ẩn (vẫn cần display)
+        if (!glfwInit()) return false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        hiddenWindow = glfwCreateWindow(width, height, "Nui Lua 3D (headless)", NULL, NULL);
+        if (!hiddenWindow) { glfwTerminate(); return false; }
+        glfwMakeContextCurrent(hiddenWindow);
+        cout << "Headless: cua so GLFW an" << endl;
+    }
+
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW bản GLX báo lỗi khi không có X display, nhưng hàm GL core đã được nạp
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+    if (err != GLEW_OK) return false;
+
+    cout << "Renderer: " << glGetString(GL_RENDERER) << endl;
+    return true;
+}
+
+void destroyOffscreenContext() {
+#ifdef OFFSCREEN_HAS_EGL
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglSurface != EGL_NO_SURFACE) eglDestroySurface(eglDisplay, eglSurface);
+        if (eglContext != EGL_NO_CONTEXT) eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        eglContext = EGL_NO_CONTEXT;
+        eglSurface = EGL_NO_SURFACE;
+    }
+#endif
+    if (hiddenWindow) {
+        glfwDestroyWindow(hiddenWindow);
+        glfwTerminate();
+        hiddenWindow = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// FBO
+
+bool createOffscreenTarget(OffscreenTarget &t, int width, int height) {
+    t.width = width;
+    t.height = height;
+
+    glGenFramebuffers(1, &t.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+
+    glGenRenderbuffers(1, &t.colorRb);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.colorRb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, t.colorRb);
+
+    glGenRenderbuffers(1, &t.depthRb);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.depthRb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, t.depthRb);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "FBO khong hoan chinh: 0x" << hex << status << dec << endl;
+        return false;
+    }
+    return true;
+}
+
+void destroyOffscreenTarget(OffscreenTarget &t) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (t.depthRb) glDeleteRenderbuffers(1, &t.depthRb);
+    if (t.colorRb) glDeleteRenderbuffers(1, &t.colorRb);
+    if (t.fbo) glDeleteFramebuffers(1, &t.fbo);
+    t = OffscreenTarget();
+}
+
+void readOffscreenPixels(const OffscreenTarget &t, vector<unsigned char> &pixels) {
+    size_t rowBytes = (size_t)t.width * 4;
+    pixels.resize(rowBytes * t.height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, t.fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, t.width, t.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    // OpenGL trả về dòng dưới cùng trước - lật lại cho đúng chiều ảnh
+    vector<unsigned char> row(rowBytes);
+    for (int y = 0; y < t.height / 2; y++) {
+        unsigned char* a = &pixels[y * rowBytes];
+        unsigned char* b = &pixels[(t.height - 1 - y) * rowBytes];
+        memcpy(row.data(), a, rowBytes);
+        memcpy(a, b, rowBytes);
+        memcpy(b, row.data(), rowBytes);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Ghi ảnh
+
+static uint32_t crc32Table[256];
+
+static void initCrc32Table() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32Table[n] = c;
+    }
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t len) {
+    if (crc32Table[1] == 0) initCrc32Table();
+    crc ^= 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) crc = crc32Table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void putBE32(vector<unsigned char> &out, uint32_t v) {
+    out.push_back((v >> 24) & 0xFF);
+    out.push_back((v >> 16) & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back(v & 0xFF);
+}
+
+static void writeChunk(ofstream &f, const char* type, const vector<unsigned char> &data) {
+    vector<unsigned char> buf;
+    putBE32(buf, (uint32_t)data.size());
+    buf.insert(buf.end(), type, type + 4);
+    buf.insert(buf.end(), data.begin(), data.end());
+    uint32_t crc = crc32(0, &buf[4], buf.size() - 4);
+    putBE32(buf, crc);
+    f.write((const char*)buf.data(), buf.size());
+}
+
+// PNG không nén (deflate dạng stored block) - không cần zlib, đủ cho so sánh ảnh
+bool writePNG(const string &path, int width, int height, const unsigned char* rgba) {
+    ofstream f(path, ios::binary);
+    if (!f) {
+        cerr << "Khong mo duoc file: " << path << endl;
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    f.write((const char*)signature, 8);
+
+    vector<unsigned char> ihdr;
+    putBE32(ihdr, width);
+    putBE32(ihdr, height);
+    ihdr.push_back(8);  // 8 bit mỗi kênh
+    ihdr.push_back(6);  // RGBA
+    ihdr.push_back(0); ihdr.push_back(0); ihdr.push_back(0);
+    writeChunk(f, "IHDR", ihdr);
+
+    // Dữ liệu ảnh: mỗi dòng bắt đầu bằng byte filter 0
+    size_t rowBytes = (size_t)width * 4;
+    vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+    }
+
+    vector<unsigned char> z;
+    z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    z.push_back(0x78); z.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t len = min(raw.size() - pos, (size_t)65535);
+        bool last = pos + len == raw.size();
+        z.push_back(last ? 1 : 0);
+        z.push_back(len & 0xFF); z.push_back((len >> 8) & 0xFF);
+        z.push_back(~len & 0xFF); z.push_back((~len >> 8) & 0xFF);
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+
+    uint32_t s1 = 1, s2 = 0;
+    for (unsigned char c : raw) {
+        s1 = (s1 + c) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    putBE32(z, (s2 << 16) | s1);
+    writeChunk(f, "IDAT", z);
+    writeChunk(f, "IEND", vector<unsigned char>());
+    return (bool)f;
+}
+
+bool writeRawRGBA(const string &path, int width, int height, const unsigned char* rgba) {
+    ofstream f(path, ios::binary);
+    if (!f) {
+        cerr << "Khong mo duoc file: " << path << endl;
+        return false;
+    }
+    f.write((const char*)rgba, (size_t)width * height * 4);
+    return (bool)f;
+}
@@ -0,0 +1,59 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <string>
+#include <vector>
+
+// Chế độ render không cửa sổ (headless) để chạy trên máy build không có màn hình:
+// tạo context OpenGL 3.3 bằng EGL surfaceless (Linux/Mesa), nếu không được thì
+// dùng cửa sổ GLFW ẩn; mọi frame được vẽ vào một FBO.
+
+struct HeadlessOptions {
+    bool enabled = false;
+    int frames = 60;
+    int width = 1200;
+    int height = 800;
+    float dt = 1.0f / 60.0f;        // Bước thời gian cố định để kết quả lặp lại được
+    unsigned int seed = 12345;      // Seed RNG của hệ thống hạt
+    std::vector<int> captureFrames; // Các frame cần lưu (đánh số từ 1)
+    int captureEvery = 0;           // > 0: lưu mỗi K frame
+    std::string outPrefix = "frame";
+    bool rawFormat = false;         // true: RGBA thô (.rgba), false: PNG
+    bool gpuParticles = false;
+    std::string recordPath;         // Ghi hình bất đồng bộ (.y4m hoặc tiền tố PNG)
+    float fastForward = 0.0f;       // Tua nhanh dung nham (giây) trước frame đầu
+    int particleDownsample = 1;     // Vẽ hạt ở độ phân giải 1/N (1, 2 hoặc 4)
+    int volcanoField = 0;           // > 0: rải N núi lửa phụ (VolcanoField)
+};
+
+// Đọc các tham số --headless N, --size WxH, --capture a,b,c, --capture-every K,
+// --out PREFIX, --format png|raw, --seed N, --gpu-particles, --record PATH,
+// --fast-forward SECONDS, --particle-downsample N, --volcano-field N.
+// Trả về false nếu tham số sai.
+bool parseHeadlessArgs(int argc, char** argv, HeadlessOptions &opt);
+
+bool shouldCaptureFrame(const HeadlessOptions &opt, int frame);
+
+// Tạo và kích hoạt context OpenGL 3.3 core không cần màn hình
+bool createOffscreenContext(int width, int height);
+void destroyOffscreenContext();
+
+struct OffscreenTarget {
+    unsigned int fbo = 0;
+    unsigned int colorRb = 0;
+    unsigned int depthRb = 0;
+    int width = 0;
+    int height = 0;
+};
+
+bool createOffscreenTarget(OffscreenTarget &t, int width, int height);
+void destroyOffscreenTarget(OffscreenTarget &t);
+
+// Đọc FBO đang bind (RGBA8, dòng trên cùng trước) vào pixels
+void readOffscreenPixels(const OffscreenTarget &t, std::vector<unsigned char> &pixels);
+
+// Ghi ảnh RGBA8 (dòng trên cùng trước)
+bool writePNG(const std::string &path, int width, int height, const unsigned char* rgba);
+bool writeRawRGBA(const std::string &path, int width, int height, const unsigned char* rgba);
+
+#endif
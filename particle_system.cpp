@@ -1,339 +1,1153 @@
-
-#include "particle_system.h"
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
-#include <random>
-#include <iostream>
-#include <cmath>
-
-using namespace std;
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// RNG
-mt19937 g_rng(random_device{}());
-
-float ParticleSystem::randFloat(float a, float b) {
-    uniform_real_distribution<float> d(a, b);
-    return d(g_rng);
-}
-
-void ParticleSystem::init() {
-    lavaParticles.resize(MAX_PARTICLES);
-    smokeParticles.resize(MAX_SMOKE);
-    cout << "Particle system initialized" << endl;
-}
-
-void ParticleSystem::emitLava(Particle &p, float volcanoX, float volcanoY, float volcanoZ) {
-    p.alive = true;
-    
-    // Phun từ miệng núi lửa - điều chỉnh tọa độ cho phù hợp với núi lửa 3D
-    float angle = randFloat(0, 2 * M_PI);
-    float radius = randFloat(0, 0.2f); // Miệng núi nhỏ
-    p.pos.x = volcanoX + radius * cos(angle);
-    p.pos.y = volcanoY;  // Đỉnh núi lửa (cao khoảng 2.5)
-    p.pos.z = volcanoZ + radius * sin(angle);
-
-    // Vận tốc: bay lên và tỏa ra xung quanh
-    float speed = randFloat(3.0f, 8.0f) * eruptionPower;
-    float verticalAngle = randFloat(M_PI * 0.1f, M_PI * 0.4f); // Góc bay lên
-    
-    p.vel.x = cos(angle) * sin(verticalAngle) * speed;
-    p.vel.y = cos(verticalAngle) * speed; // Bay lên
-    p.vel.z = sin(angle) * sin(verticalAngle) * speed;
-
-    p.maxLife = randFloat(2.0f, 4.0f);
-    p.life = p.maxLife;
-    p.size = randFloat(0.1f, 0.3f) * globalSizeMul;  // Kích thước nhỏ hơn cho 3D
-
-    // Màu dung nham
-    p.r = 1.0f; p.g = 0.3f; p.b = 0.0f; p.a = 1.0f;
-}
-
-void ParticleSystem::emitSmoke(Particle &p, float volcanoX, float volcanoY, float volcanoZ) {
-    p.alive = true;
-
-    float angle = randFloat(0, 2 * M_PI);
-    float radius = randFloat(0, 0.3f);
-    p.pos.x = volcanoX + radius * cos(angle);
-    p.pos.y = volcanoY + 0.1f;  // Trên miệng núi một chút
-    p.pos.z = volcanoZ + radius * sin(angle);
-
-    // Khói bay thẳng lên với độ ngẫu nhiên nhỏ
-    p.vel.x = randFloat(-0.2f, 0.2f);
-    p.vel.y = randFloat(1.0f, 3.0f) + 1.0f * eruptionPower;
-    p.vel.z = randFloat(-0.2f, 0.2f);
-
-    p.maxLife = randFloat(3.0f, 6.0f);
-    p.life = p.maxLife;
-    p.size = randFloat(0.2f, 0.5f) * (0.8f + 0.4f * eruptionPower / 2.0f);
-
-    p.r = 0.3f; p.g = 0.3f; p.b = 0.3f; p.a = 0.6f;
-}
-
-void ParticleSystem::update(float dt, float volcanoX, float volcanoY, float volcanoZ) {
-    // LAVA EMISSION
-    static float emitAcc = 0.0f;
-    int emitRate = int(baseEmitRate * eruptionPower);
-
-    if (emitting) {
-        emitAcc += emitRate * dt;
-        int toEmit = (int)emitAcc;
-        emitAcc -= toEmit;
-
-        for (auto &p : lavaParticles) {
-            if (toEmit <= 0) break;
-            if (!p.alive) { 
-                emitLava(p, volcanoX, volcanoY, volcanoZ); 
-                --toEmit; 
-            }
-        }
-    }
-
-    // SMOKE EMISSION - luôn phun khói từ miệng núi
-    static float smokeAcc = 0.0f;
-    float smokeRate = 100.0f * eruptionPower;
-    smokeAcc += smokeRate * dt;
-
-    int toSmoke = (int)smokeAcc;
-    smokeAcc -= toSmoke;
-
-    for (int i = 0; i < toSmoke; i++) {
-        for (auto &s : smokeParticles) {
-            if (!s.alive) { 
-                emitSmoke(s, volcanoX, volcanoY, volcanoZ); 
-                break; 
-            }
-        }
-    }
-
-    // UPDATE LAVA
-    float gravity = -8.0f;  // Giảm trọng lực cho 3D
-    for (auto &p : lavaParticles) {
-        if (!p.alive) continue;
-
-        p.life -= dt;
-        if (p.life <= 0.0f) { p.alive = false; continue; }
-
-        p.vel.y += gravity * dt;
-        p.pos.x += p.vel.x * dt;
-        p.pos.y += p.vel.y * dt;
-        p.pos.z += p.vel.z * dt;
-
-        // Va chạm với mặt đất
-        float ground = -0.5f;
-        if (p.pos.y < ground) {
-            p.pos.y = ground;
-            p.vel.y *= -0.2f;  // Giảm độ nảy
-            p.vel.x *= 0.3f;
-            p.vel.z *= 0.3f;
-            p.life -= 1.0f * dt;  // Chết nhanh hơn khi chạm đất
-            
-            // Tạo khói khi chạm đất
-            for (auto &s : smokeParticles) {
-                if (!s.alive) {
-                    s.alive = true;
-                    s.pos.x = p.pos.x;
-                    s.pos.y = ground + 0.1f;
-                    s.pos.z = p.pos.z;
-                    s.vel.x = randFloat(-0.2f, 0.2f);
-                    s.vel.y = randFloat(0.5f, 1.5f);
-                    s.vel.z = randFloat(-0.2f, 0.2f);
-                    s.maxLife = randFloat(1.0f, 2.0f);
-                    s.life = s.maxLife;
-                    s.size = randFloat(0.1f, 0.3f);
-                    s.r = 0.2f; s.g = 0.2f; s.b = 0.2f; s.a = 0.4f;
-                    break;
-                }
-            }
-        }
-    }
-
-    // UPDATE SMOKE
-    for (auto &s : smokeParticles) {
-        if (!s.alive) continue;
-
-        s.life -= dt;
-        if (s.life <= 0.0f) { s.alive = false; continue; }
-
-        s.vel.y += 0.5f * dt;  // Khói bay lên
-        s.pos.x += s.vel.x * dt;
-        s.pos.y += s.vel.y * dt;
-        s.pos.z += s.vel.z * dt;
-
-        s.vel.x *= (1.0f - 0.5f * dt);
-        s.vel.z *= (1.0f - 0.5f * dt);
-
-        float lifeRatio = s.life / s.maxLife;
-        s.a = 0.4f * lifeRatio;
-        s.size *= (1.0f + 0.1f * dt);  // Khói phình to
-    }
-}
-
-// Shaders cho hệ thống hạt 3D
-const char* particleVertexShaderSrc = R"(
-#version 330 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in float aSize;
-layout(location = 2) in vec4 aColor;
-
-uniform mat4 uTransform;
-
-out vec4 vColor;
-
-void main() {
-    vColor = aColor;
-    gl_Position = uTransform * vec4(aPos, 1.0);
-    gl_PointSize = aSize * 50.0; // Scale điểm cho phù hợp
-}
-)";
-
-const char* particleFragmentShaderSrc = R"(
-#version 330 core
-in vec4 vColor;
-
-out vec4 FragColor;
-
-void main() {
-    vec2 coord = gl_PointCoord * 2.0 - 1.0;
-    float dist = length(coord);
-    if (dist > 1.0) discard;
-
-    float alpha = vColor.a * smoothstep(1.0, 0.6, dist);
-    FragColor = vec4(vColor.rgb, alpha);
-}
-)";
-
-GLuint compileParticleShader(GLenum type, const char* src) {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-
-    GLint ok;
-    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        char log[2048];
-        glGetShaderInfoLog(s, 2048, nullptr, log);
-        cerr << "Particle Shader error: " << log << endl;
-    }
-    return s;
-}
-
-GLuint particleShaderProgram = 0;
-GLuint particleVAO = 0, particleVBO = 0;
-
-void ParticleSystem::render(const float* transformMatrix) {
-    if (particleShaderProgram == 0) {
-        // Khởi tạo shader và buffer lần đầu
-        GLuint vs = compileParticleShader(GL_VERTEX_SHADER, particleVertexShaderSrc);
-        GLuint fs = compileParticleShader(GL_FRAGMENT_SHADER, particleFragmentShaderSrc);
-
-        particleShaderProgram = glCreateProgram();
-        glAttachShader(particleShaderProgram, vs);
-        glAttachShader(particleShaderProgram, fs);
-        glLinkProgram(particleShaderProgram);
-        glDeleteShader(vs);
-        glDeleteShader(fs);
-
-        glGenVertexArrays(1, &particleVAO);
-        glGenBuffers(1, &particleVBO);
-
-        glBindVertexArray(particleVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-
-        // Cấu trúc: pos3 + size1 + color4 = 8 floats
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
-
-        glBindVertexArray(0);
-    }
-
-    // Chuẩn bị dữ liệu hạt
-    std::vector<float> particleData;
-    
-    // Thêm dung nham
-    for (const auto &p : lavaParticles) {
-        if (!p.alive) continue;
-        particleData.insert(particleData.end(), {p.pos.x, p.pos.y, p.pos.z});
-        particleData.push_back(p.size);
-        particleData.insert(particleData.end(), {p.r, p.g, p.b, p.a});
-    }
-    
-    // Thêm khói
-    for (const auto &s : smokeParticles) {
-        if (!s.alive) continue;
-        particleData.insert(particleData.end(), {s.pos.x, s.pos.y, s.pos.z});
-        particleData.push_back(s.size);
-        particleData.insert(particleData.end(), {s.r, s.g, s.b, s.a});
-    }
-
-    if (particleData.empty()) return;
-
-    // Render
-    glUseProgram(particleShaderProgram);
-    glBindVertexArray(particleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
-    glBufferData(GL_ARRAY_BUFFER, particleData.size() * sizeof(float), particleData.data(), GL_STREAM_DRAW);
-
-    // Sử dụng ma trận transform được truyền vào
-    GLint transformLoc = glGetUniformLocation(particleShaderProgram, "uTransform");
-    glUniformMatrix4fv(transformLoc, 1, GL_FALSE, transformMatrix);
-
-    glEnable(GL_PROGRAM_POINT_SIZE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glDrawArrays(GL_POINTS, 0, particleData.size() / 8);
-    
-    glBindVertexArray(0);
-}
-
-// Giữ nguyên phương thức render cũ để tương thích
-void ParticleSystem::render() {
-    // Tạo ma trận identity mặc định
-    float identity[16] = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f, 
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-    render(identity);
-}
-
-void ParticleSystem::handleInput(int key) {
-    if (key == GLFW_KEY_SPACE) {
-        emitting = !emitting;
-        cout << "Particle Emitting: " << (emitting ? "ON" : "OFF") << endl;
-    }
-    else if (key == GLFW_KEY_C) {
-        for (auto &p : lavaParticles) p.alive = false;
-        for (auto &s : smokeParticles) s.alive = false;
-        cout << "Particles Cleared\n";
-    }
-    else if (key == GLFW_KEY_EQUAL) {
-        baseEmitRate = min(baseEmitRate + 50, 5000);
-        cout << "EmitRate: " << baseEmitRate << endl;
-    }
-    else if (key == GLFW_KEY_MINUS) {
-        baseEmitRate = max(baseEmitRate - 50, 0);
-        cout << "EmitRate: " << baseEmitRate << endl;
-    }
-    else if (key == GLFW_KEY_LEFT_BRACKET) {
-        eruptionPower = max(0.1f, eruptionPower - 0.1f);
-        cout << "EruptionPower: " << eruptionPower << endl;
-    }
-    else if (key == GLFW_KEY_RIGHT_BRACKET) {
-        eruptionPower = min(5.0f, eruptionPower + 0.1f);
-        cout << "EruptionPower: " << eruptionPower << endl;
-    }
-}
-
-ParticleSystem particleSystem;
+
+#include "particle_system.h"
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <random>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// RNG
+mt19937 g_rng(random_device{}());
+
+void ParticleSystem::setSeed(uint32_t seed) {
+    g_rng.seed(seed);
+}
+
+float ParticleSystem::randFloat(float a, float b) {
+    uniform_real_distribution<float> d(a, b);
+    return d(g_rng);
+}
+
+// Bảng thuộc tính hiển thị theo loại hạt. Shader giữ bản sao dưới dạng uniform,
+// CPU chỉ dùng lifeMin/lifeMax để tính maxLife từ seed.
+struct ParticleTypeDesc {
+    float r, g, b;
+    float alphaStart, alphaEnd;  // alpha theo tuổi chuẩn hóa 0 -> 1
+    float sizeMin, sizeMax;
+    float growth;                // size *= exp(growth * tuổi tính bằng giây)
+    float lifeMin, lifeMax;
+};
+
+const ParticleTypeDesc PARTICLE_TYPES[PARTICLE_TYPE_COUNT] = {
+    // Dung nham (màu thật lấy theo nhiệt độ, thời gian sống không dùng - hạt chết khi đông cứng)
+    { 1.0f, 0.3f, 0.0f,  1.0f, 1.0f,  0.1f, 0.3f,  0.0f,  2.0f, 4.0f },
+    // Khói từ miệng núi
+    { 0.3f, 0.3f, 0.3f,  0.4f, 0.0f,  0.2f, 0.5f,  0.1f,  3.0f, 6.0f },
+    // Khói khi dung nham chạm đất
+    { 0.2f, 0.2f, 0.2f,  0.4f, 0.0f,  0.1f, 0.3f,  0.1f,  1.0f, 2.0f },
+    // Cụm khói gộp ở xa (alpha lấy từ tuổi, kích thước sizeMin..sizeMax theo thang log của seed)
+    { 0.28f, 0.28f, 0.28f,  1.0f, 1.0f,  0.1f, 12.8f,  0.0f,  0.0f, 0.0f },
+};
+
+// Tốc độ vận tốc ngang của khói bám theo gió (1/s)
+const float SMOKE_WIND_COUPLING = 1.5f;
+
+// Khói ở xa thay đổi chậm trên màn hình: cứ mỗi SMOKE_LOD_DISTANCE đơn vị
+// khoảng cách nhìn thì cập nhật khói thưa thêm một bước (tối đa MAX_SMOKE_GROUPS)
+const float SMOKE_LOD_DISTANCE = 8.0f;
+
+// Hạt dung nham chạm đất với tốc độ nhỏ hơn thế này thì nằm yên (ngủ)
+const float LAVA_REST_SPEED = 0.25f;
+// Chỉ tạo khói mặt đất khi va chạm đủ mạnh, không phải mỗi lần nảy nhẹ
+const float GROUND_SMOKE_SPEED = 1.0f;
+// Mặt đất dưới hạt ngủ được kiểm tra lại sau mỗi chừng này frame, đổi quá
+// SLEEP_WAKE_HEIGHT thì hạt thức dậy
+const size_t SLEEP_RECHECK_FRAMES = 8;
+const float SLEEP_WAKE_HEIGHT = 0.01f;
+
+// Độ dày lớp da quanh bề mặt SDF: hạt gần hơn thế này coi như chạm
+const float SDF_SKIN = 0.01f;
+
+// Đẩy hạt ra khỏi lớp da theo gradient SDF; thành phần vận tốc hướng vào bề
+// mặt bị phản xạ với hệ số restitution, thành phần tiếp tuyến giữ lại friction.
+// Trả về true nếu hạt chạm bề mặt.
+static bool resolveSdfContact(Particle &p, const ParticleSdfBatch &b, size_t k, float restitution, float friction) {
+    float d = b.dist[k];
+    if (d >= SDF_SKIN) return false;
+    float len2 = b.gx[k] * b.gx[k] + b.gy[k] * b.gy[k] + b.gz[k] * b.gz[k];
+    if (len2 < 1e-8f) return false;  // sâu trong vật rắn hoặc ngoài dải, để mặt đất xử lý
+    float inv = 1.0f / sqrtf(len2);
+    float nx = b.gx[k] * inv, ny = b.gy[k] * inv, nz = b.gz[k] * inv;
+
+    float push = SDF_SKIN - d;
+    p.pos.x += nx * push;
+    p.pos.y += ny * push;
+    p.pos.z += nz * push;
+
+    float vn = p.vel.x * nx + p.vel.y * ny + p.vel.z * nz;
+    if (vn < 0.0f) {
+        float tx = p.vel.x - nx * vn, ty = p.vel.y - ny * vn, tz = p.vel.z - nz * vn;
+        p.vel.x = tx * friction - nx * vn * restitution;
+        p.vel.y = ty * friction - ny * vn * restitution;
+        p.vel.z = tz * friction - nz * vn * restitution;
+    }
+    return true;
+}
+
+// Hash số nguyên -> [0,1]. Phải giống hệt seedRand() trong vertex shader.
+static float seedRand(uint32_t seed, uint32_t channel) {
+    uint32_t h = (seed * 0x9E3779B1u) ^ (channel * 0x85EBCA77u);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return float(h & 0xFFFFu) / 65535.0f;
+}
+
+// Hệ số kích thước <-> mức lưu theo hạt (PARTICLE_SIZE_LEVEL_ONE). Phải giống
+// sizeMul() trong particleCommonGlsl
+static uint8_t packSizeMul(float mul) {
+    float level = PARTICLE_SIZE_LEVEL_ONE + PARTICLE_SIZE_LEVELS_PER_OCTAVE * log2f(max(mul, 1e-6f));
+    return (uint8_t)min(max((int)roundf(level), 0), PARTICLE_SIZE_LEVEL_COUNT - 1);
+}
+
+static float sizeMulOf(uint8_t level) {
+    return exp2f((level - PARTICLE_SIZE_LEVEL_ONE) / PARTICLE_SIZE_LEVELS_PER_OCTAVE);
+}
+
+// Bảng màu phát xạ của vật đen theo nhiệt độ, dùng chung cho cả 2 backend
+const int BLACKBODY_TABLE_SIZE = 32;
+const float BLACKBODY_MIN_TEMP = 500.0f;   // °C
+const float BLACKBODY_MAX_TEMP = 1400.0f;
+const double BLACKBODY_EXPOSURE = 30.0;
+static float g_blackbody[BLACKBODY_TABLE_SIZE * 3];
+
+// Hàm khớp màu CIE 1931 dạng tổng Gauss (Wyman, Sloan, Shirley 2013)
+static float cieLobe(float l, float mu, float s1, float s2) {
+    float t = (l - mu) / (l < mu ? s1 : s2);
+    return expf(-0.5f * t * t);
+}
+
+// Tích phân phổ Planck với hàm khớp màu -> XYZ -> sRGB tuyến tính. Sắc độ
+// chuẩn hóa theo kênh lớn nhất, độ sáng = 1 - exp(-k * Y / Y(nhiệt độ lớn nhất)),
+// cuối cùng mã hóa gamma vì framebuffer không phải sRGB. Với k = 30, hạt vừa
+// phun (~1150 °C) gần sáng hết cỡ, còn ~800 °C thì gần như tối hẳn.
+static void buildBlackbodyTable() {
+    double refY = 0.0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = BLACKBODY_TABLE_SIZE - 1; i >= 0; i--) {
+            double t = BLACKBODY_MIN_TEMP + (BLACKBODY_MAX_TEMP - BLACKBODY_MIN_TEMP) * i / (BLACKBODY_TABLE_SIZE - 1) + 273.15;
+            double X = 0.0, Y = 0.0, Z = 0.0;
+            for (int nm = 380; nm <= 780; nm += 5) {
+                double l = nm * 1e-9;
+                double b = 1.0 / (pow(l, 5.0) * (exp(1.4388e-2 / (l * t)) - 1.0));
+                X += b * (1.056 * cieLobe(nm, 599.8f, 37.9f, 31.0f) + 0.362 * cieLobe(nm, 442.0f, 16.0f, 26.7f)
+                          - 0.065 * cieLobe(nm, 501.1f, 20.4f, 26.2f));
+                Y += b * (0.821 * cieLobe(nm, 568.8f, 46.9f, 40.5f) + 0.286 * cieLobe(nm, 530.9f, 16.3f, 31.1f));
+                Z += b * (1.217 * cieLobe(nm, 437.0f, 11.8f, 36.0f) + 0.681 * cieLobe(nm, 459.0f, 26.0f, 13.8f));
+            }
+            if (pass == 0) { refY = Y; break; }
+            double rgb[3] = {
+                 3.2406 * X - 1.5372 * Y - 0.4986 * Z,
+                -0.9689 * X + 1.8758 * Y + 0.0415 * Z,
+                 0.0557 * X - 0.2040 * Y + 1.0570 * Z
+            };
+            double m = max(rgb[0], max(rgb[1], rgb[2]));
+            double brightness = 1.0 - exp(-BLACKBODY_EXPOSURE * Y / refY);
+            for (int k = 0; k < 3; k++) g_blackbody[i * 3 + k] = (float)pow(max(rgb[k], 0.0) / m * brightness, 1.0 / 2.2);
+        }
+    }
+}
+
+// Chọn seed ngẫu nhiên và suy ra thời gian sống tương ứng
+void ParticleSystem::spawn(Particle &p, ParticleType type) {
+    const ParticleTypeDesc &d = PARTICLE_TYPES[type];
+    p.alive = true;
+    p.type = type;
+    p.seed = (uint8_t)(g_rng() % PARTICLE_SEED_COUNT);
+    p.maxLife = d.lifeMin + (d.lifeMax - d.lifeMin) * seedRand(p.seed, 1);
+    p.life = p.maxLife;
+    p.sizeLevel = packSizeMul(typeSizeMul(type));
+    if (type == PARTICLE_LAVA) {
+        float temp = thermal.eruptionTemp + thermal.eruptionSpread * (2.0f * seedRand(p.seed, 3) - 1.0f);
+        p.heat = (uint16_t)(temp * PARTICLE_HEAT_SCALE + 0.5f);
+    }
+    // Backend GPU: slot được ghi lên buffer trước bước tích phân/vẽ tiếp theo
+    if (useGpu) markGpuDirty(p);
+}
+
+void ParticleSystem::init() {
+    lavaParticles.resize(MAX_PARTICLES);
+    smokeParticles.resize(MAX_SMOKE);
+    wind.init();
+    ballistic.init(thermal);
+    buildBlackbodyTable();
+    cout << "Particle system initialized" << endl;
+}
+
+void ParticleSystem::emitLava(Particle &p, float volcanoX, float volcanoY, float volcanoZ) {
+    spawn(p, PARTICLE_LAVA);
+    
+    // Phun từ miệng núi lửa - điều chỉnh tọa độ cho phù hợp với núi lửa 3D
+    float angle = randFloat(0, 2 * M_PI);
+    float radius = randFloat(0, 0.2f); // Miệng núi nhỏ
+    p.pos.x = volcanoX + radius * cos(angle);
+    p.pos.y = volcanoY;  // Đỉnh núi lửa (cao khoảng 2.5)
+    p.pos.z = volcanoZ + radius * sin(angle);
+
+    // Vận tốc: bay lên và tỏa ra xung quanh
+    float speed = randFloat(3.0f, 8.0f) * eruptionPower;
+    float verticalAngle = randFloat(M_PI * 0.1f, M_PI * 0.4f); // Góc bay lên
+    
+    p.vel.x = cos(angle) * sin(verticalAngle) * speed;
+    p.vel.y = cos(verticalAngle) * speed; // Bay lên
+    p.vel.z = sin(angle) * sin(verticalAngle) * speed;
+    // Màu, kích thước và thời gian sống được suy ra từ seed (xem PARTICLE_TYPES)
+}
+
+void ParticleSystem::emitSmoke(Particle &p, float volcanoX, float volcanoY, float volcanoZ) {
+    spawn(p, PARTICLE_SMOKE);
+
+    float angle = randFloat(0, 2 * M_PI);
+    float radius = randFloat(0, 0.3f);
+    p.pos.x = volcanoX + radius * cos(angle);
+    p.pos.y = volcanoY + 0.1f;  // Trên miệng núi một chút
+    p.pos.z = volcanoZ + radius * sin(angle);
+
+    // Khói bay thẳng lên với độ ngẫu nhiên nhỏ
+    p.vel.x = randFloat(-0.2f, 0.2f);
+    p.vel.y = randFloat(1.0f, 3.0f) + 1.0f * eruptionPower;
+    p.vel.z = randFloat(-0.2f, 0.2f);
+    backdateSmoke(p);
+}
+
+// Hạt khói mới sinh sẽ được tích phân lần đầu cùng cả thời gian đang chờ của
+// nhóm nó; lùi thời điểm sinh lại đúng bấy nhiêu để nó không vọt lên trước
+void ParticleSystem::backdateSmoke(Particle &s) {
+    float lag = smokeSchedule.lag((size_t)(&s - smokeParticles.data()));
+    s.pos.x -= s.vel.x * lag;
+    s.pos.y -= s.vel.y * lag;
+    s.pos.z -= s.vel.z * lag;
+    s.life += lag;
+}
+
+// Khói khi dung nham va chạm mạnh tại pos: lấy slot khói chết đầu tiên
+void ParticleSystem::spawnGroundSmoke(const ParticleVec3 &pos) {
+    for (auto &s : smokeParticles) {
+        if (s.alive) continue;
+        spawn(s, PARTICLE_GROUND_SMOKE);
+        s.pos.x = pos.x;
+        s.pos.y = pos.y + 0.1f;
+        s.pos.z = pos.z;
+        s.vel.x = randFloat(-0.2f, 0.2f);
+        s.vel.y = randFloat(0.5f, 1.5f);
+        s.vel.z = randFloat(-0.2f, 0.2f);
+        backdateSmoke(s);
+        return;
+    }
+}
+
+void ParticleSystem::update(float dt, float volcanoX, float volcanoY, float volcanoZ) {
+    if (scrubbing) return;
+    wind.update(dt);
+
+    // LAVA EMISSION
+    static float emitAcc = 0.0f;
+    int emitRate = int(baseEmitRate * eruptionPower);
+
+    if (emitting) {
+        emitAcc += emitRate * dt;
+        int toEmit = (int)emitAcc;
+        emitAcc -= toEmit;
+        // Hạt đang ngủ vẫn tính vào giới hạn số hạt dung nham
+        toEmit = min(toEmit, max(MAX_PARTICLES - lavaAwake - (int)sleeping.size(), 0));
+
+        for (auto &p : lavaParticles) {
+            if (toEmit <= 0) break;
+            if (!p.alive) { 
+                emitLava(p, volcanoX, volcanoY, volcanoZ); 
+                --toEmit; 
+            }
+        }
+    }
+
+    // SMOKE EMISSION - luôn phun khói từ miệng núi
+    static float smokeAcc = 0.0f;
+    float smokeRate = 100.0f * eruptionPower;
+    smokeAcc += smokeRate * dt;
+
+    int toSmoke = (int)smokeAcc;
+    smokeAcc -= toSmoke;
+
+    for (int i = 0; i < toSmoke; i++) {
+        for (auto &s : smokeParticles) {
+            if (!s.alive) { 
+                emitSmoke(s, volcanoX, volcanoY, volcanoZ); 
+                break; 
+            }
+        }
+    }
+
+    // Backend GPU: phun như trên (slot chết đầu tiên), phần còn lại chạy trên GPU
+    if (useGpu) { updateGpu(dt, volcanoX, volcanoZ); return; }
+
+    // UPDATE LAVA
+    float gravity = -8.0f;  // Giảm trọng lực cho 3D
+    float ambientK = thermal.ambientTemp + 273.15f;
+    float ambientK4 = ambientK * ambientK * ambientK * ambientK;
+    // Tích phân trước, gom vị trí mới để tra SDF cả loạt (4 hạt mỗi lần)
+    sdfBatch.clear();
+    for (size_t i = 0; i < lavaParticles.size(); i++) {
+        Particle &p = lavaParticles[i];
+        if (!p.alive) continue;
+
+        p.vel.y += gravity * dt;
+        p.pos.x += p.vel.x * dt;
+        p.pos.y += p.vel.y * dt;
+        p.pos.z += p.vel.z * dt;
+        sdfBatch.push((uint32_t)i, p.pos);
+    }
+    if (collider) sdfBatch.query(*collider);
+
+    int awake = 0;
+    for (size_t k = 0; k < sdfBatch.index.size(); k++) {
+        Particle &p = lavaParticles[sdfBatch.index[k]];
+
+        // Nguội do bức xạ
+        float temp = p.heat * (1.0f / PARTICLE_HEAT_SCALE);
+        float tk = temp + 273.15f;
+        temp -= thermal.emissivity * (tk * tk * tk * tk - ambientK4) * dt;
+
+        // Va chạm với thành miệng/sườn núi (SDF), rồi với mặt đất
+        float impactSpeed2 = p.vel.x * p.vel.x + p.vel.y * p.vel.y + p.vel.z * p.vel.z;
+        bool contact = collider && resolveSdfContact(p, sdfBatch, k, 0.2f, 0.3f);
+        float ground = groundHeight ? groundHeight(p.pos.x, p.pos.z) : -0.5f;
+        if (p.pos.y < ground) {
+            p.pos.y = ground;
+            p.vel.y *= -0.2f;  // Giảm độ nảy
+            p.vel.x *= 0.3f;
+            p.vel.z *= 0.3f;
+            contact = true;
+        }
+        // Tạo khói khi chạm đất (bỏ qua các lần nảy nhẹ)
+        if (contact && impactSpeed2 >= GROUND_SMOKE_SPEED * GROUND_SMOKE_SPEED) spawnGroundSmoke(p.pos);
+
+        // Nằm trên mặt đất (kể cả lúc nảy nhẹ) thì nguội nhanh hơn nhiều
+        if (contact || p.pos.y < ground + 0.02f) temp -= thermal.contactCooling * (temp - thermal.ambientTemp) * dt;
+
+        if (temp <= thermal.solidusTemp) {
+            solidified.push_back(p.pos);
+            p.alive = false;
+            continue;
+        }
+
+        // Gần như đứng yên trên mặt đất thì chuyển sang tập hạt ngủ, hoặc tan
+        // vào dòng chảy nếu đang bật (nảy/lăn trước đó vẫn mô phỏng từng bước)
+        float speed2 = p.vel.x * p.vel.x + p.vel.y * p.vel.y + p.vel.z * p.vel.z;
+        if (contact && speed2 < LAVA_REST_SPEED * LAVA_REST_SPEED) {
+            if (collectLandings) landings.push_back({p.pos, temp});
+            else sleeping.push_back({p.pos, ground, temp, p.seed, p.sizeLevel});
+            p.alive = false;
+            continue;
+        }
+        p.heat = (uint16_t)(temp * PARTICLE_HEAT_SCALE + 0.5f);
+        awake++;
+    }
+    lavaAwake = awake;
+
+    updateSleeping(dt);
+
+    // UPDATE SMOKE: chia khói thành K nhóm xen kẽ (SmokeSchedule)
+    smokeSchedule.regroup(SmokeSchedule::groupsFor(viewDistance),
+                          [this](int g, int groups, float t) { updateSmokeGroup(g, groups, t); });
+    float groupDt = dt;
+    int group = smokeSchedule.next(groupDt);
+    updateSmokeGroup(group, smokeSchedule.groups, groupDt);
+}
+
+int SmokeSchedule::groupsFor(float viewDistance) {
+    return min(max(1 + (int)(viewDistance / SMOKE_LOD_DISTANCE), 1), MAX_SMOKE_GROUPS);
+}
+
+void SmokeSchedule::regroup(int n, const std::function<void(int, int, float)> &flush) {
+    if (n == groups) return;
+    for (int g = 0; g < groups; g++) {
+        if (pending[g] > 0.0f) flush(g, groups, pending[g]);
+        pending[g] = 0.0f;
+    }
+    groups = n;
+    phase = 0;
+}
+
+int SmokeSchedule::next(float &dt) {
+    for (int g = 0; g < groups; g++) pending[g] += dt;
+    int group = phase;
+    phase = (phase + 1) % groups;
+    dt = pending[group];
+    pending[group] = 0.0f;
+    return group;
+}
+
+// Cập nhật các hạt khói i = group, group + groups, ...
+void ParticleSystem::updateSmokeGroup(int group, int groups, float dt) {
+    float drag = SMOKE_WIND_COUPLING * dt;
+    sdfBatch.clear();
+    for (size_t i = group; i < smokeParticles.size(); i += groups) {
+        Particle &s = smokeParticles[i];
+        if (!s.alive) continue;
+
+        s.life -= dt;
+        if (s.life <= 0.0f) { s.alive = false; continue; }
+
+        // Gió tại vị trí hạt: một lần nội suy trong lưới tính sẵn
+        alignas(16) float w[4];
+        wind.sample(s.pos.x, s.pos.y, s.pos.z, w);
+
+        s.vel.y += 0.5f * dt + w[1] * drag;  // Khói bay lên, gió dọc cộng thêm
+        s.pos.x += s.vel.x * dt;
+        s.pos.y += s.vel.y * dt;
+        s.pos.z += s.vel.z * dt;
+
+        // Kéo vận tốc ngang về vận tốc gió (không gió thì chỉ là lực cản như cũ)
+        s.vel.x += (w[0] - s.vel.x) * drag;
+        s.vel.z += (w[2] - s.vel.z) * drag;
+        // Alpha mờ dần và khói phình to được tính trong vertex shader theo tuổi
+        if (collider) sdfBatch.push((uint32_t)i, s.pos);
+    }
+
+    // Khói trượt dọc thành miệng/sườn núi thay vì xuyên qua
+    if (collider) {
+        sdfBatch.query(*collider);
+        for (size_t k = 0; k < sdfBatch.index.size(); k++)
+            resolveSdfContact(smokeParticles[sdfBatch.index[k]], sdfBatch, k, 0.0f, 1.0f);
+    }
+}
+
+// Hạt ngủ chỉ nguội (bức xạ + tiếp xúc như khi nằm trên đất). Mỗi frame kiểm
+// tra lại mặt đất của một phần tập ngủ, mặt đất đổi thì đánh thức hạt.
+void ParticleSystem::updateSleeping(float dt) {
+    float ambientK = thermal.ambientTemp + 273.15f;
+    float ambientK4 = ambientK * ambientK * ambientK * ambientK;
+    for (size_t i = 0; i < sleeping.size();) {
+        SleepingLava &s = sleeping[i];
+        float tk = s.temperature + 273.15f;
+        s.temperature -= (thermal.emissivity * (tk * tk * tk * tk - ambientK4)
+                        + thermal.contactCooling * (s.temperature - thermal.ambientTemp)) * dt;
+        if (s.temperature <= thermal.solidusTemp) {
+            solidified.push_back(s.pos);
+            s = sleeping.back();
+            sleeping.pop_back();
+            continue;
+        }
+        i++;
+    }
+
+    if (sleeping.empty() || !groundHeight) return;
+    size_t checks = (sleeping.size() + SLEEP_RECHECK_FRAMES - 1) / SLEEP_RECHECK_FRAMES;
+    for (size_t n = 0; n < checks && !sleeping.empty(); n++) {
+        if (sleepCursor >= sleeping.size()) sleepCursor = 0;
+        SleepingLava &s = sleeping[sleepCursor];
+        if (fabsf(groundHeight(s.pos.x, s.pos.z) - s.ground) <= SLEEP_WAKE_HEIGHT) { sleepCursor++; continue; }
+
+        auto slot = find_if(lavaParticles.begin(), lavaParticles.end(), [](const Particle &p) { return !p.alive; });
+        if (slot == lavaParticles.end()) { sleepCursor++; continue; }
+        spawn(*slot, PARTICLE_LAVA);
+        slot->seed = s.seed;
+        slot->sizeLevel = s.sizeLevel;
+        slot->pos = s.pos;
+        slot->vel = ParticleVec3();
+        slot->heat = (uint16_t)(s.temperature * PARTICLE_HEAT_SCALE + 0.5f);
+        s = sleeping.back();
+        sleeping.pop_back();
+    }
+}
+
+void ParticleSystem::fastForward(float seconds, float volcanoX, float volcanoY, float volcanoZ) {
+    if (scrubbing || seconds <= 0.0f) return;
+    // Backend GPU: lấy trạng thái hiện tại về, cuối cùng ghi đè cả buffer
+    if (useGpu) downloadGpu(0, MAX_PARTICLES + MAX_SMOKE);
+    ballistic.groundHeight = groundHeight;
+    ballistic.collider = collider;
+    ballistic.params.landOnRest = collectLandings;
+    float start = ballistic.time();
+    float end = start + seconds;
+
+    // Hạt đang bay và hạt đang ngủ giao cho bộ giải
+    for (auto &p : lavaParticles) {
+        if (!p.alive) continue;
+        float pos[3] = {p.pos.x, p.pos.y, p.pos.z}, vel[3] = {p.vel.x, p.vel.y, p.vel.z};
+        ballistic.launch(start, pos, vel, p.heat * (1.0f / PARTICLE_HEAT_SCALE), p.seed, p.sizeLevel);
+        p.alive = false;
+    }
+    for (const SleepingLava &s : sleeping) {
+        float pos[3] = {s.pos.x, s.pos.y, s.pos.z}, vel[3] = {0.0f, 0.0f, 0.0f};
+        ballistic.launch(start, pos, vel, s.temperature, s.seed, s.sizeLevel);
+    }
+    sleeping.clear();
+
+    // Phun đều theo nhịp của update(), xử lý sự kiện tới lúc phun trước để mặt
+    // đất của các hạt sau phản ánh đúng thứ tự
+    ballisticEvents.clear();
+    float emitRate = baseEmitRate * eruptionPower;
+    if (emitting && emitRate > 0.0f) {
+        int count = (int)(emitRate * seconds);
+        Particle p;
+        for (int i = 0; i < count; i++) {
+            float t = start + (i + 0.5f) / emitRate;
+            ballistic.advanceTo(t, &ballisticEvents);
+            emitLava(p, volcanoX, volcanoY, volcanoZ);
+            float pos[3] = {p.pos.x, p.pos.y, p.pos.z}, vel[3] = {p.vel.x, p.vel.y, p.vel.z};
+            ballistic.launch(t, pos, vel, p.heat * (1.0f / PARTICLE_HEAT_SCALE), p.seed, p.sizeLevel);
+        }
+    }
+    ballistic.advanceTo(end, &ballisticEvents);
+
+    for (const BallisticEvent &e : ballisticEvents) {
+        ParticleVec3 pos(e.pos[0], e.pos[1], e.pos[2]);
+        if (e.type == BallisticEvent::LANDED) landings.push_back({pos, e.temperature});
+        else solidified.push_back(pos);
+    }
+
+    // Hạt còn sống trở lại mô phỏng từng bước (quá số slot thì bỏ)
+    ballistic.aliveAt(end, ballisticIds);
+    size_t slot = 0;
+    for (uint32_t id : ballisticIds) {
+        BallisticState st;
+        if (!ballistic.evaluate(id, end, st)) continue;
+        ballistic.retire(id, end);
+        while (slot < lavaParticles.size() && lavaParticles[slot].alive) slot++;
+        if (slot == lavaParticles.size()) continue;
+        Particle &p = lavaParticles[slot];
+        spawn(p, PARTICLE_LAVA);
+        p.seed = st.seed;
+        p.sizeLevel = st.sizeLevel;
+        p.pos = ParticleVec3(st.pos[0], st.pos[1], st.pos[2]);
+        p.vel = ParticleVec3(st.vel[0], st.vel[1], st.vel[2]);
+        p.heat = (uint16_t)(st.temperature * PARTICLE_HEAT_SCALE + 0.5f);
+    }
+    if (useGpu) gpu.uploadAll = true;
+}
+
+void ParticleSystem::scrubTo(float t) {
+    if (!scrubbing) {
+        // Backend GPU dừng trong lúc xem (update() không chạy), bản sao trên
+        // CPU được vẽ thay
+        if (useGpu) downloadGpu(0, MAX_PARTICLES + MAX_SMOKE);
+        scrubSaved = lavaParticles;
+        scrubbing = true;
+    }
+    scrubTime = min(max(t, ballistic.historyStart()), ballistic.time());
+
+    for (auto &p : lavaParticles) p.alive = false;
+    ballistic.aliveAt(scrubTime, ballisticIds);
+    size_t slot = 0;
+    for (uint32_t id : ballisticIds) {
+        BallisticState st;
+        if (slot == lavaParticles.size()) break;
+        if (!ballistic.evaluate(id, scrubTime, st)) continue;
+        Particle &p = lavaParticles[slot++];
+        p.alive = true;
+        p.type = PARTICLE_LAVA;
+        p.seed = st.seed;
+        p.sizeLevel = st.sizeLevel;
+        p.pos = ParticleVec3(st.pos[0], st.pos[1], st.pos[2]);
+        p.vel = ParticleVec3(st.vel[0], st.vel[1], st.vel[2]);
+        p.heat = (uint16_t)(max(st.temperature, 0.0f) * PARTICLE_HEAT_SCALE + 0.5f);
+    }
+}
+
+void ParticleSystem::endScrub() {
+    if (!scrubbing) return;
+    lavaParticles.swap(scrubSaved);
+    scrubSaved.clear();
+    scrubbing = false;
+}
+
+void blackbodyColor(float temp, float rgb[3]) {
+    float f = min(max((temp - BLACKBODY_MIN_TEMP) / (BLACKBODY_MAX_TEMP - BLACKBODY_MIN_TEMP), 0.0f), 1.0f)
+              * (BLACKBODY_TABLE_SIZE - 1);
+    int i = min((int)f, BLACKBODY_TABLE_SIZE - 2);
+    float t = f - i;
+    for (int k = 0; k < 3; k++)
+        rgb[k] = g_blackbody[i * 3 + k] + (g_blackbody[(i + 1) * 3 + k] - g_blackbody[i * 3 + k]) * t;
+}
+
+static void resetBounds(float bmin[3], float bmax[3]) {
+    for (int k = 0; k < 3; k++) { bmin[k] = 1e30f; bmax[k] = -1e30f; }
+}
+
+static void growBounds(float bmin[3], float bmax[3], const ParticleVec3 &p) {
+    const float v[3] = {p.x, p.y, p.z};
+    for (int k = 0; k < 3; k++) { bmin[k] = min(bmin[k], v[k]); bmax[k] = max(bmax[k], v[k]); }
+}
+
+void ParticleSystem::stats(ParticleStats &out) {
+    out = ParticleStats();
+    resetBounds(out.lavaMin, out.lavaMax);
+    resetBounds(out.smokeMin, out.smokeMax);
+    if (useGpu && !scrubbing) downloadGpu(0, MAX_PARTICLES + MAX_SMOKE);
+    for (const Particle &p : lavaParticles) {
+        if (!p.alive) continue;
+        out.lava++;
+        growBounds(out.lavaMin, out.lavaMax, p.pos);
+    }
+    for (const SleepingLava &s : sleeping) {
+        out.lava++;
+        growBounds(out.lavaMin, out.lavaMax, s.pos);
+    }
+    for (const Particle &s : smokeParticles) {
+        if (!s.alive) continue;
+        out.smoke++;
+        growBounds(out.smokeMin, out.smokeMax, s.pos);
+    }
+}
+
+void ParticleSystem::collectGlow(std::vector<LavaGlow> &out) {
+    if (useGpu && !scrubbing) downloadGpu(0, MAX_PARTICLES);
+    float rgb[3];
+    for (const Particle &p : lavaParticles) {
+        if (!p.alive) continue;
+        blackbodyColor(p.heat * (1.0f / PARTICLE_HEAT_SCALE), rgb);
+        out.push_back({p.pos, rgb[0], rgb[1], rgb[2]});
+    }
+    // Lúc xem lại thì dung nham nằm yên không thuộc thời điểm đang xem
+    if (scrubbing) return;
+    for (const SleepingLava &s : sleeping) {
+        blackbodyColor(s.temperature, rgb);
+        out.push_back({s.pos, rgb[0], rgb[1], rgb[2]});
+    }
+}
+
+// Phần GLSL dùng chung giữa backend CPU và GPU: bảng thuộc tính theo loại hạt
+// (PARTICLE_TYPES) và cách suy ra màu/kích thước từ tuổi + seed.
+// Được chèn ngay sau dòng #version bởi compileParticleShader().
+const char* particleCommonGlsl = R"(
+uniform vec3 uTypeColor[4];
+uniform vec2 uTypeAlpha[4];  // alpha đầu, alpha cuối
+uniform vec3 uTypeSize[4];   // sizeMin, sizeMax, tốc độ phình
+uniform vec2 uTypeLife[4];   // lifeMin, lifeMax
+uniform vec3 uBlackbody[32]; // màu phát xạ theo nhiệt độ
+uniform vec2 uBlackbodyRange;// nhiệt độ (°C) của phần tử đầu và cuối bảng
+uniform vec2 uLavaHeatRange; // nhiệt độ đông đặc, nhiệt độ phun cao nhất (°C)
+uniform float uPointScale;   // pixel cho một đơn vị kích thước hạt
+uniform vec2 uViewportSize;  // pixel
+
+// Hạt vẽ bằng quad (instance) luôn quay mặt về camera: đỉnh góc lệch khỏi tâm
+// trong không gian clip đúng sizePx pixel, không bị giới hạn như gl_PointSize
+// và không bị cắt khi tâm ra khỏi màn hình
+vec4 spriteVertex(vec4 center, vec2 corner, float sizePx) {
+    center.xy += corner * sizePx / uViewportSize * center.w;
+    return center;
+}
+
+// Phải giống hệt seedRand() trên CPU
+float seedRand(uint seed, uint channel) {
+    uint h = (seed * 0x9E3779B1u) ^ (channel * 0x85EBCA77u);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return float(h & 0xFFFFu) / 65535.0;
+}
+
+// Hệ số kích thước lúc phun của hạt, giống sizeMulOf() trên CPU
+float sizeMul(uint level) {
+    return exp2((float(level) - 16.0) / 6.0);
+}
+
+float particleMaxLife(uint type, uint seed) {
+    return mix(uTypeLife[type].x, uTypeLife[type].y, seedRand(seed, 1u));
+}
+
+vec3 blackbody(float temp) {
+    float f = clamp((temp - uBlackbodyRange.x) / (uBlackbodyRange.y - uBlackbodyRange.x), 0.0, 1.0) * 31.0;
+    int i = min(int(f), 30);
+    return mix(uBlackbody[i], uBlackbody[i + 1], f - float(i));
+}
+
+// age: tuổi chuẩn hóa 0 = vừa sinh, 1 = sắp chết.
+// Riêng dung nham: age = nhiệt độ chuẩn hóa trong uLavaHeatRange (1 = nóng nhất)
+vec4 particleAppearance(uint type, uint seed, uint sizeLevel, float age, out float size) {
+    vec3 sz = uTypeSize[type];
+    vec2 alpha = uTypeAlpha[type];
+    if (type == 0u) {
+        size = mix(sz.x, sz.y, seedRand(seed, 2u)) * sizeMul(sizeLevel);
+        return vec4(blackbody(mix(uLavaHeatRange.x, uLavaHeatRange.y, age)), alpha.x);
+    }
+    if (type == 3u) {
+        size = sz.x * pow(sz.y / sz.x, float(seed) / 63.0);
+        return vec4(uTypeColor[type], age);
+    }
+    float ageSec = age * particleMaxLife(type, seed);
+    size = mix(sz.x, sz.y, seedRand(seed, 2u)) * sizeMul(sizeLevel) * exp(sz.z * ageSec);
+    return vec4(uTypeColor[type], mix(alpha.x, alpha.y, age));
+}
+)";
+
+// Shaders cho hệ thống hạt 3D
+const char* particleVertexShaderSrc = R"(
+layout(location = 0) in uvec3 aPos;      // 14 bit vị trí trong AABB của emitter + 2 bit mức kích thước
+layout(location = 1) in float aAge;      // tuổi chuẩn hóa: 0 = vừa sinh, 1 = sắp chết
+layout(location = 2) in uint aTypeSeed;  // 2 bit loại hạt + 6 bit seed
+layout(location = 3) in vec2 aCorner;    // góc quad (-1..1), 3 thuộc tính trên theo instance
+
+uniform mat4 uTransform;
+uniform vec3 uBoundsMin;
+uniform vec3 uBoundsSize;
+
+out vec4 vColor;
+out vec2 vCoord;
+
+void main() {
+    uint type = aTypeSeed >> 6;
+    uint seed = aTypeSeed & 63u;
+    uint sizeLevel = (aPos.x & 3u) | ((aPos.y & 3u) << 2) | ((aPos.z & 3u) << 4);
+
+    float size;
+    vColor = particleAppearance(type, seed, sizeLevel, aAge, size);
+
+    vec3 pos = uBoundsMin + vec3(aPos >> 2u) / 16383.0 * uBoundsSize;
+    gl_Position = spriteVertex(uTransform * vec4(pos, 1.0), aCorner, size * uPointScale);
+    vCoord = aCorner;
+}
+)";
+
+const char* particleFragmentShaderSrc = R"(
+#version 330 core
+in vec4 vColor;
+in vec2 vCoord;
+
+out vec4 FragColor;
+
+void main() {
+    float dist = length(vCoord);
+    if (dist > 1.0) discard;
+
+    float alpha = vColor.a * smoothstep(1.0, 0.6, dist);
+    FragColor = vec4(vColor.rgb, alpha);
+}
+)";
+
+// Quad đơn vị dùng chung cho mọi lần vẽ hạt (triangle strip, 4 góc -1..1)
+static GLuint particleQuadVBO = 0;
+
+void bindParticleQuad(unsigned int location) {
+    if (particleQuadVBO == 0) {
+        const float corners[8] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+        glGenBuffers(1, &particleQuadVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, particleQuadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, particleQuadVBO);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(location, 0);
+}
+
+// common != nullptr: ghép "#version 330 core" + common + src (src không có #version)
+GLuint compileParticleShader(GLenum type, const char* src, const char* common) {
+    GLuint s = glCreateShader(type);
+    if (common) {
+        const char* parts[3] = { "#version 330 core\n", common, src };
+        glShaderSource(s, 3, parts, nullptr);
+    } else {
+        glShaderSource(s, 1, &src, nullptr);
+    }
+    glCompileShader(s);
+
+    GLint ok;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[2048];
+        glGetShaderInfoLog(s, 2048, nullptr, log);
+        cerr << "Particle Shader error: " << log << endl;
+    }
+    return s;
+}
+
+// Định dạng đỉnh nén cho hạt: 8 byte/hạt
+// pos: 14 bit trong AABB của emitter, 2 bit thấp mỗi trục ghép thành mức kích
+// thước 6 bit; tuổi: unorm8, loại + seed: uint8
+// Màu, alpha và kích thước được shader suy ra từ tuổi, loại, seed và mức kích thước
+struct PackedParticle {
+    uint16_t x, y, z;
+    uint8_t age;
+    uint8_t typeSeed;
+};
+static_assert(sizeof(PackedParticle) == 8, "PackedParticle phai dung 8 byte");
+
+GLuint particleShaderProgram = 0;
+ParticleUniforms particleUniforms;
+GLuint particleVAO = 0, particleVBO = 0;
+std::vector<PackedParticle> particleData;
+
+// x, y, z chuẩn hóa [0,1] trong AABB
+static inline void packPosition(PackedParticle &q, float x, float y, float z, uint8_t sizeLevel) {
+    auto coord = [](float v, int bits) {
+        v = min(max(v, 0.0f), 1.0f);
+        return (uint16_t)(((int)(v * 16383.0f + 0.5f) << 2) | (bits & 3));
+    };
+    q.x = coord(x, sizeLevel);
+    q.y = coord(y, sizeLevel >> 2);
+    q.z = coord(z, sizeLevel >> 4);
+}
+
+static inline uint8_t packUnorm8(float v) {
+    v = min(max(v, 0.0f), 1.0f);
+    return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+// Hệ số kích thước theo loại hạt với tham số hiện tại, spawn() lưu lại vào hạt
+float ParticleSystem::typeSizeMul(int type) const {
+    if (type == PARTICLE_LAVA) return globalSizeMul;  // Kích thước nhỏ hơn cho 3D
+    if (type == PARTICLE_SMOKE) return 0.8f + 0.4f * eruptionPower / 2.0f;
+    return 1.0f;
+}
+
+void ParticleUniforms::locate(unsigned int program) {
+    auto at = [program](const char* name) { return (int)glGetUniformLocation(program, name); };
+    typeColor = at("uTypeColor"); typeAlpha = at("uTypeAlpha"); typeSize = at("uTypeSize"); typeLife = at("uTypeLife");
+    blackbody = at("uBlackbody"); blackbodyRange = at("uBlackbodyRange"); lavaHeatRange = at("uLavaHeatRange");
+    pointScale = at("uPointScale"); viewportSize = at("uViewportSize");
+    transform = at("uTransform"); boundsMin = at("uBoundsMin"); boundsSize = at("uBoundsSize");
+    lavaCount = at("uLavaCount"); smokeGroups = at("uSmokeGroups"); smokeLag = at("uSmokeLag");
+    lavaDt = at("uLavaDt"); smokeGroup = at("uSmokeGroup"); smokeDt = at("uSmokeDt");
+    lavaCooling = at("uLavaCooling"); ambientTemp = at("uAmbientTemp");
+    wind = at("uWind"); windMin = at("uWindMin"); windInvCell = at("uWindInvCell"); windRes = at("uWindRes");
+    ground = at("uGround"); groundMin = at("uGroundMin"); groundInvCell = at("uGroundInvCell");
+    groundRes = at("uGroundRes"); groundCenter = at("uGroundCenter"); groundFar = at("uGroundFar");
+    sdf = at("uSdf"); hasSdf = at("uHasSdf"); sdfMin = at("uSdfMin"); sdfInvCell = at("uSdfInvCell"); sdfRes = at("uSdfRes");
+}
+
+// Gửi bảng thuộc tính theo loại hạt và kích thước viewport lên shader
+void ParticleSystem::uploadTypeTable(const ParticleUniforms &u) {
+    float typeColor[PARTICLE_TYPE_COUNT * 3], typeAlpha[PARTICLE_TYPE_COUNT * 2];
+    float typeSize[PARTICLE_TYPE_COUNT * 3], typeLife[PARTICLE_TYPE_COUNT * 2];
+    for (int t = 0; t < PARTICLE_TYPE_COUNT; t++) {
+        const ParticleTypeDesc &d = PARTICLE_TYPES[t];
+        typeColor[t*3+0] = d.r; typeColor[t*3+1] = d.g; typeColor[t*3+2] = d.b;
+        typeAlpha[t*2+0] = d.alphaStart; typeAlpha[t*2+1] = d.alphaEnd;
+        typeSize[t*3+0] = d.sizeMin; typeSize[t*3+1] = d.sizeMax; typeSize[t*3+2] = d.growth;
+        typeLife[t*2+0] = d.lifeMin; typeLife[t*2+1] = d.lifeMax;
+    }
+    glUniform3fv(u.typeColor, PARTICLE_TYPE_COUNT, typeColor);
+    glUniform2fv(u.typeAlpha, PARTICLE_TYPE_COUNT, typeAlpha);
+    glUniform3fv(u.typeSize, PARTICLE_TYPE_COUNT, typeSize);
+    glUniform2fv(u.typeLife, PARTICLE_TYPE_COUNT, typeLife);
+    glUniform3fv(u.blackbody, BLACKBODY_TABLE_SIZE, g_blackbody);
+    glUniform2f(u.blackbodyRange, BLACKBODY_MIN_TEMP, BLACKBODY_MAX_TEMP);
+    glUniform2f(u.lavaHeatRange, thermal.solidusTemp, lavaMaxTemp());
+    glUniform1f(u.pointScale, 50.0f / max(renderDownsample, 1));
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glUniform2f(u.viewportSize, (float)viewport[2], (float)viewport[3]);
+}
+
+// Vẽ thẳng lên cảnh: blend alpha thường. Vẽ vào pass độ phân giải thấp: màu
+// cộng dồn như cũ, alpha đích nhân (1 - alpha) để thành độ trong suốt còn lại.
+void ParticleSystem::setupBlend() const {
+    glEnable(GL_BLEND);
+    if (renderDownsample > 1)
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    else
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Hạt ở gần vẽ riêng, hạt ở xa gom theo ô lưới để gộp
+void ParticleSystem::clusterSmoke(const float* transformMatrix, int viewportHeight, std::vector<SmokeSprite> &out) {
+    out.clear();
+    auto single = [&](const Particle &s, float lag) {
+        out.push_back({s.pos.x + s.vel.x * lag, s.pos.y + s.vel.y * lag, s.pos.z + s.vel.z * lag,
+                       1.0f - (s.life - lag) / s.maxLife, s.type, s.seed, s.sizeLevel});
+    };
+
+    float clusterCell = smokeClusterCell * max(viewDistance, smokeClusterDistance) / max(smokeClusterDistance, 1e-3f);
+    float invCell = 1.0f / clusterCell;
+    float clusterDist2 = smokeClusterDistance * viewZoom * smokeClusterDistance * viewZoom;
+    smokeCells.clear();
+    for (size_t i = 0; i < smokeParticles.size(); i++) {
+        const Particle &s = smokeParticles[i];
+        if (!s.alive) continue;
+        float lag = smokeSchedule.lag(i);
+        float x = s.pos.x + s.vel.x * lag, y = s.pos.y + s.vel.y * lag, z = s.pos.z + s.vel.z * lag;
+        float dx = x - viewEye.x, dy = y - viewEye.y, dz = z - viewEye.z;
+        if (smokeClusterDistance <= 0.0f || dx * dx + dy * dy + dz * dz < clusterDist2) {
+            single(s, lag);
+            continue;
+        }
+        // 21 bit mỗi trục, lệch 2^20 để tọa độ ô âm vẫn dương
+        uint64_t cx = (uint64_t)((int64_t)floorf(x * invCell) + (1 << 20)) & 0x1FFFFF;
+        uint64_t cy = (uint64_t)((int64_t)floorf(y * invCell) + (1 << 20)) & 0x1FFFFF;
+        uint64_t cz = (uint64_t)((int64_t)floorf(z * invCell) + (1 << 20)) & 0x1FFFFF;
+        smokeCells.push_back({(cx << 42) | (cy << 21) | cz, (uint32_t)i});
+    }
+    smokeClustered = (int)smokeCells.size();
+    smokePuffs = 0;
+    if (smokeCells.empty()) return;
+    sort(smokeCells.begin(), smokeCells.end());
+
+    // Số pixel cho một đơn vị độ dài tại điểm có tọa độ clip w (đủ chính
+    // xác để đổi độ tản của cụm sang kích thước điểm)
+    const float* m = transformMatrix;
+    float rowScale = sqrtf(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]) * 0.5f * viewportHeight;
+    const ParticleTypeDesc &puffDesc = PARTICLE_TYPES[PARTICLE_SMOKE_PUFF];
+    float puffLogRange = logf(puffDesc.sizeMax / puffDesc.sizeMin);
+
+    for (size_t a = 0, b; a < smokeCells.size(); a = b) {
+        for (b = a + 1; b < smokeCells.size() && smokeCells[b].first == smokeCells[a].first; b++) {}
+        if (b - a == 1) {
+            uint32_t i = smokeCells[a].second;
+            single(smokeParticles[i], smokeSchedule.lag(i));
+            continue;
+        }
+
+        // "Khối lượng" mỗi hạt = alpha * diện tích điểm (giống shader); cụm
+        // giữ tổng khối lượng, đặt ở trọng tâm, to bằng điểm trung bình cộng
+        // độ tản của các hạt trên màn hình
+        double mass = 0, mx = 0, my = 0, mz = 0, mr2 = 0, msize2 = 0;
+        for (size_t k = a; k < b; k++) {
+            uint32_t i = smokeCells[k].second;
+            const Particle &s = smokeParticles[i];
+            float lag = smokeSchedule.lag(i);
+            const ParticleTypeDesc &d = PARTICLE_TYPES[s.type];
+            float age = min(max(1.0f - (s.life - lag) / s.maxLife, 0.0f), 1.0f);
+            float size = (d.sizeMin + (d.sizeMax - d.sizeMin) * seedRand(s.seed, 2)) * sizeMulOf(s.sizeLevel)
+                       * expf(d.growth * age * s.maxLife);
+            float alpha = d.alphaStart + (d.alphaEnd - d.alphaStart) * age;
+            double w = alpha * size * size;
+            float x = s.pos.x + s.vel.x * lag, y = s.pos.y + s.vel.y * lag, z = s.pos.z + s.vel.z * lag;
+            mass += w;
+            mx += w * x; my += w * y; mz += w * z;
+            mr2 += w * (x * x + y * y + z * z);
+            msize2 += w * size * size;
+        }
+        if (mass <= 0.0) continue;
+        float px = (float)(mx / mass), py = (float)(my / mass), pz = (float)(mz / mass);
+        float spread2 = max((float)(mr2 / mass) - (px * px + py * py + pz * pz), 0.0f);
+        float clipW = m[3] * px + m[7] * py + m[11] * pz + m[15];
+        float pixelsPerUnit = rowScale / max(clipW, 1e-3f);
+        // Kích thước tính theo đơn vị của shader (cạnh quad = size * uPointScale pixel)
+        float spread = 2.0f * sqrtf(spread2) * pixelsPerUnit * max(renderDownsample, 1) / 50.0f;
+        float size = sqrtf((float)(msize2 / mass) + spread * spread);
+
+        int level = (int)roundf(63.0f * logf(max(size / puffDesc.sizeMin, 1.0f)) / puffLogRange);
+        level = min(max(level, 0), 63);
+        float quantized = puffDesc.sizeMin * expf(puffLogRange * level / 63.0f);
+
+        out.push_back({px, py, pz, min((float)(mass / (quantized * quantized)), 0.95f), PARTICLE_SMOKE_PUFF, (uint8_t)level,
+                       (uint8_t)PARTICLE_SIZE_LEVEL_ONE});
+        ++smokePuffs;
+    }
+}
+
+void ParticleSystem::render(const float* transformMatrix) {
+    // Backend GPU vẽ thẳng dung nham đang bay (và khói nếu không gộp cụm) từ
+    // buffer; hạt ngủ và khói gộp cụm vẫn đi phần CPU bên dưới. Lúc xem lại
+    // thì mọi hạt đang ở bản sao trên CPU
+    bool gpuLava = useGpu && !scrubbing;
+    bool gpuSmoke = gpuLava && smokeClusterDistance <= 0.0f;
+    if (gpuLava) {
+        renderGpu(transformMatrix, gpuSmoke);
+        if (!gpuSmoke) downloadGpu(MAX_PARTICLES, MAX_SMOKE);
+    }
+
+    if (particleShaderProgram == 0) {
+        // Khởi tạo shader và buffer lần đầu
+        GLuint vs = compileParticleShader(GL_VERTEX_SHADER, particleVertexShaderSrc, particleCommonGlsl);
+        GLuint fs = compileParticleShader(GL_FRAGMENT_SHADER, particleFragmentShaderSrc, nullptr);
+
+        particleShaderProgram = glCreateProgram();
+        glAttachShader(particleShaderProgram, vs);
+        glAttachShader(particleShaderProgram, fs);
+        glLinkProgram(particleShaderProgram);
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        particleUniforms.locate(particleShaderProgram);
+
+        glGenVertexArrays(1, &particleVAO);
+        glGenBuffers(1, &particleVBO);
+
+        glBindVertexArray(particleVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+
+        // Cấu trúc: pos/mức kích thước uint16 x3 + tuổi unorm8 + loại/seed uint8 = 8 byte
+        glEnableVertexAttribArray(0);
+        glVertexAttribIPointer(0, 3, GL_UNSIGNED_SHORT, sizeof(PackedParticle), (void*)offsetof(PackedParticle, x));
+        
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedParticle), (void*)offsetof(PackedParticle, age));
+        
+        glEnableVertexAttribArray(2);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(PackedParticle), (void*)offsetof(PackedParticle, typeSeed));
+
+        // Mỗi hạt là một instance, 4 góc quad lấy từ buffer tĩnh dùng chung
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribDivisor(2, 1);
+        bindParticleQuad(3);
+
+        glBindVertexArray(0);
+    }
+
+    // AABB của các hạt còn sống - vị trí được lượng tử hóa tương đối với hộp này
+    float minX = 1e30f, minY = 1e30f, minZ = 1e30f;
+    float maxX = -1e30f, maxY = -1e30f, maxZ = -1e30f;
+    int aliveCount = 0;
+    // lag: thời gian từ lần cập nhật gần nhất của hạt (khói cập nhật theo nhóm),
+    // vị trí được ngoại suy theo vận tốc để khói không giật
+    auto grow = [&](const Particle &p, float lag) {
+        if (!p.alive) return;
+        float x = p.pos.x + p.vel.x * lag, y = p.pos.y + p.vel.y * lag, z = p.pos.z + p.vel.z * lag;
+        minX = min(minX, x); maxX = max(maxX, x);
+        minY = min(minY, y); maxY = max(maxY, y);
+        minZ = min(minZ, z); maxZ = max(maxZ, z);
+        ++aliveCount;
+    };
+    if (!gpuLava) for (const auto &p : lavaParticles) grow(p, 0.0f);
+    if (!gpuSmoke) for (size_t i = 0; i < smokeParticles.size(); i++) grow(smokeParticles[i], smokeSchedule.lag(i));
+    // Lúc xem lại timeline thì hạt ngủ thuộc về hiện tại, không vẽ
+    size_t sleepingCount = scrubbing ? 0 : sleeping.size();
+    for (size_t i = 0; i < sleepingCount; i++) {
+        const ParticleVec3 &q = sleeping[i].pos;
+        minX = min(minX, q.x); maxX = max(maxX, q.x);
+        minY = min(minY, q.y); maxY = max(maxY, q.y);
+        minZ = min(minZ, q.z); maxZ = max(maxZ, q.z);
+        ++aliveCount;
+    }
+
+    if (aliveCount == 0) return;
+
+    float sizeX = max(maxX - minX, 1e-4f);
+    float sizeY = max(maxY - minY, 1e-4f);
+    float sizeZ = max(maxZ - minZ, 1e-4f);
+
+    // Chuẩn bị dữ liệu hạt (dùng lại bộ nhớ giữa các frame)
+    float heatRange = lavaMaxTemp() - thermal.solidusTemp;
+    particleData.clear();
+    particleData.reserve(aliveCount);
+    auto pack = [&](const Particle &p, float lag) {
+        if (!p.alive) return;
+        PackedParticle q;
+        packPosition(q, (p.pos.x + p.vel.x * lag - minX) / sizeX, (p.pos.y + p.vel.y * lag - minY) / sizeY,
+                     (p.pos.z + p.vel.z * lag - minZ) / sizeZ, p.sizeLevel);
+        if (p.type == PARTICLE_LAVA) {
+            float temp = p.heat * (1.0f / PARTICLE_HEAT_SCALE);
+            q.age = packUnorm8((temp - thermal.solidusTemp) / heatRange);
+        } else {
+            q.age = packUnorm8(1.0f - (p.life - lag) / p.maxLife);
+        }
+        q.typeSeed = (uint8_t)((p.type << 6) | (p.seed & 63));
+        particleData.push_back(q);
+    };
+
+    // Thêm dung nham
+    if (!gpuLava) for (const auto &p : lavaParticles) pack(p, 0.0f);
+    for (size_t i = 0; i < sleepingCount; i++) {
+        const SleepingLava &sl = sleeping[i];
+        PackedParticle q;
+        packPosition(q, (sl.pos.x - minX) / sizeX, (sl.pos.y - minY) / sizeY, (sl.pos.z - minZ) / sizeZ, sl.sizeLevel);
+        q.age = packUnorm8((sl.temperature - thermal.solidusTemp) / heatRange);
+        q.typeSeed = (uint8_t)((PARTICLE_LAVA << 6) | (sl.seed & 63));
+        particleData.push_back(q);
+    }
+    
+    // Thêm khói (hạt ở xa gộp thành cụm)
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    smokeSprites.clear();
+    if (!gpuSmoke) clusterSmoke(transformMatrix, viewport[3], smokeSprites);
+    for (const SmokeSprite &sp : smokeSprites) {
+        PackedParticle q;
+        packPosition(q, (sp.x - minX) / sizeX, (sp.y - minY) / sizeY, (sp.z - minZ) / sizeZ, sp.sizeLevel);
+        q.age = packUnorm8(sp.age);
+        q.typeSeed = (uint8_t)((sp.type << 6) | (sp.seed & 63));
+        particleData.push_back(q);
+    }
+
+    // Render
+    glUseProgram(particleShaderProgram);
+    glBindVertexArray(particleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+    glBufferData(GL_ARRAY_BUFFER, particleData.size() * sizeof(PackedParticle), particleData.data(), GL_STREAM_DRAW);
+
+    // Sử dụng ma trận transform được truyền vào
+    glUniformMatrix4fv(particleUniforms.transform, 1, GL_FALSE, transformMatrix);
+    glUniform3f(particleUniforms.boundsMin, minX, minY, minZ);
+    glUniform3f(particleUniforms.boundsSize, sizeX, sizeY, sizeZ);
+    uploadTypeTable(particleUniforms);
+
+    setupBlend();
+    
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)particleData.size());
+    
+    glBindVertexArray(0);
+}
+
+void ParticleSystem::shutdown() {
+    if (particleShaderProgram) glDeleteProgram(particleShaderProgram);
+    glDeleteVertexArrays(1, &particleVAO);
+    glDeleteBuffers(1, &particleVBO);
+    glDeleteBuffers(1, &particleQuadVBO);
+    particleShaderProgram = particleVAO = particleVBO = particleQuadVBO = 0;
+    gpu.destroy();
+    wind.shutdown();
+}
+
+// Giữ nguyên phương thức render cũ để tương thích
+void ParticleSystem::render() {
+    // Tạo ma trận identity mặc định
+    float identity[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f, 
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    render(identity);
+}
+
+void ParticleSystem::handleInput(int key) {
+    if (key == GLFW_KEY_SPACE) {
+        emitting = !emitting;
+        cout << "Particle Emitting: " << (emitting ? "ON" : "OFF") << endl;
+    }
+    else if (key == GLFW_KEY_C) {
+        for (auto &p : lavaParticles) p.alive = false;
+        for (auto &s : smokeParticles) s.alive = false;
+        sleeping.clear();
+        gpu.uploadAll = true;
+        cout << "Particles Cleared\n";
+    }
+    else if (key == GLFW_KEY_G) {
+        // Về CPU: lấy trạng thái hạt về rồi bỏ hết phần GPU. Sang GPU: lần
+        // cập nhật đầu ghi bản sao CPU lên buffer (initGpu())
+        if (useGpu) {
+            if (!scrubbing) downloadGpu(0, MAX_PARTICLES + MAX_SMOKE);
+            gpu.destroy();
+        }
+        useGpu = !useGpu;
+        cout << "Particle Backend: " << (useGpu ? "GPU (transform feedback)" : "CPU") << endl;
+    }
+    else if (key == GLFW_KEY_I) {
+        ParticleStats st;
+        stats(st);
+        cout << "Alive (" << (useGpu ? "GPU" : "CPU") << "): lava " << st.lava << ", smoke " << st.smoke
+             << ", lava ngu " << sleeping.size() << endl;
+        if (smokeClustered > 0)
+            cout << "Khoi o xa: " << smokeClustered << " hat gop thanh " << smokePuffs << " cum" << endl;
+    }
+    else if (key == GLFW_KEY_EQUAL) {
+        baseEmitRate = min(baseEmitRate + 50, 5000);
+        cout << "EmitRate: " << baseEmitRate << endl;
+    }
+    else if (key == GLFW_KEY_MINUS) {
+        baseEmitRate = max(baseEmitRate - 50, 0);
+        cout << "EmitRate: " << baseEmitRate << endl;
+    }
+    else if (key == GLFW_KEY_LEFT_BRACKET) {
+        eruptionPower = max(0.1f, eruptionPower - 0.1f);
+        cout << "EruptionPower: " << eruptionPower << endl;
+    }
+    else if (key == GLFW_KEY_RIGHT_BRACKET) {
+        eruptionPower = min(5.0f, eruptionPower + 0.1f);
+        cout << "EruptionPower: " << eruptionPower << endl;
+    }
+}
+
+ParticleSystem particleSystem;
@@ -3,6 +3,12 @@
 #define PARTICLE_SYSTEM_H
 
 #include <vector>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include "wind_field.h"
+#include "sdf.h"
+#include "ballistic.h"
 
 // Sửa lại để tránh xung đột với main.cpp
 struct ParticleVec3 { 
@@ -14,41 +20,332 @@ struct ParticleVec3 {
     ParticleVec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
 };
 
+// Loại hạt - chỉ số vào bảng thuộc tính hiển thị (màu, alpha, kích thước) trong shader
+enum ParticleType : uint8_t {
+    PARTICLE_LAVA = 0,
+    PARTICLE_SMOKE = 1,
+    PARTICLE_GROUND_SMOKE = 2,
+    PARTICLE_SMOKE_PUFF = 3,  // chỉ khi vẽ: cụm khói ở xa gộp lại, seed = kích thước, tuổi = alpha
+    PARTICLE_TYPE_COUNT
+};
+
+// Số seed khác nhau cho mỗi hạt (6 bit, đóng gói chung với loại hạt)
+const int PARTICLE_SEED_COUNT = 64;
+
+// Hệ số kích thước lúc phun (globalSizeMul với dung nham, độ mạnh phun trào
+// với khói) lưu theo hạt dạng mức 6 bit trên thang log: mức L ứng với hệ số
+// 2^((L - PARTICLE_SIZE_LEVEL_ONE) / PARTICLE_SIZE_LEVELS_PER_OCTAVE), tức
+// khoảng 0.16..228, hai mức liền nhau hơn kém ~12%
+const int PARTICLE_SIZE_LEVEL_COUNT = 64;
+const int PARTICLE_SIZE_LEVEL_ONE = 16;
+const float PARTICLE_SIZE_LEVELS_PER_OCTAVE = 6.0f;
+
+// Nhiệt độ hạt dung nham lưu dạng số cố định 16 bit (°C * PARTICLE_HEAT_SCALE)
+const float PARTICLE_HEAT_SCALE = 32.0f;
+
+// Mô hình nguội của hạt dung nham (°C). Khi bay chỉ mất nhiệt do bức xạ
+// (tỉ lệ T^4 - Ta^4, T tính bằng K), nằm trên mặt đất thì mất thêm do tiếp xúc.
+// Nguội dưới solidusTemp thì hạt đông cứng và chết.
+struct LavaThermalParams {
+    float eruptionTemp = 1150.0f;
+    float eruptionSpread = 60.0f;   // nhiệt độ lúc phun dao động ± theo seed
+    float solidusTemp = 700.0f;
+    float ambientTemp = 20.0f;
+    float emissivity = 1.0e-11f;    // dT/dt = -emissivity * (T^4 - Ta^4)
+    float contactCooling = 0.6f;    // dT/dt = -contactCooling * (T - Ta) khi chạm đất
+};
+
 struct Particle {
     ParticleVec3 pos;
     ParticleVec3 vel;
     float life = 0.0f;
     float maxLife = 1.0f;
-    float size = 4.0f;
-    float r = 1, g = 1, b = 1, a = 1;
+    uint16_t heat = 0;  // chỉ dung nham: nhiệt độ, thay cho đồng hồ life
+    uint8_t type = PARTICLE_LAVA;
+    uint8_t seed = 0;  // Shader suy ra kích thước và thời gian sống từ seed
+    uint8_t sizeLevel = PARTICLE_SIZE_LEVEL_ONE;  // hệ số kích thước lúc phun
     bool alive = false;
 };
+static_assert(sizeof(Particle) <= 40, "Nhiet do chi duoc them toi da 4 byte moi hat");
+
+// Hạt dung nham nằm yên trên mặt đất: chỉ nguội dần, không tích phân chuyển động.
+// ground là độ cao mặt đất lúc bắt đầu nằm, đổi nhiều thì hạt được đánh thức.
+struct SleepingLava {
+    ParticleVec3 pos;
+    float ground;
+    float temperature;
+    uint8_t seed;
+    uint8_t sizeLevel;
+};
+
+// Điểm phát sáng của dung nham (màu phát xạ theo nhiệt độ) để chiếu sáng cảnh
+struct LavaGlow {
+    ParticleVec3 pos;
+    float r, g, b;
+};
+
+// Hạt dung nham nằm yên trên mặt đất khi còn lỏng
+struct LavaLanding {
+    ParticleVec3 pos;
+    float temperature;
+};
+
+// Vị trí hạt dạng SoA để truy vấn SDF cả loạt, cùng kết quả khoảng cách + gradient
+struct ParticleSdfBatch {
+    std::vector<uint32_t> index;
+    std::vector<float> x, y, z, dist, gx, gy, gz;
+
+    void clear() { index.clear(); x.clear(); y.clear(); z.clear(); }
+    void push(uint32_t i, const ParticleVec3 &p) {
+        index.push_back(i); x.push_back(p.x); y.push_back(p.y); z.push_back(p.z);
+    }
+    void query(const SparseSdf &sdf) {
+        size_t n = index.size();
+        dist.resize(n); gx.resize(n); gy.resize(n); gz.resize(n);
+        sdf.sampleBatch(x.data(), y.data(), z.data(), n, dist.data(), gx.data(), gy.data(), gz.data());
+    }
+};
+
+// Số nhóm khói cập nhật xen kẽ nhiều nhất (khói ở xa cập nhật mỗi K bước)
+const int MAX_SMOKE_GROUPS = 4;
+
+// Lịch cập nhật khói: hạt i thuộc nhóm i % groups, mỗi bước chỉ cập nhật một
+// nhóm với thời gian cộng dồn từ lần trước của nhóm đó
+struct SmokeSchedule {
+    int groups = 1;
+    int phase = 0;                           // nhóm được cập nhật ở bước tới
+    float pending[MAX_SMOKE_GROUPS] = {};    // thời gian chưa tích phân của mỗi nhóm
+
+    // Số nhóm theo khoảng cách nhìn, 1..MAX_SMOKE_GROUPS
+    static int groupsFor(float viewDistance);
+    // Đổi số nhóm: mọi nhóm còn thời gian chờ được bắt kịp trước bằng
+    // flush(nhóm, số nhóm cũ, thời gian) rồi mới chia lại
+    void regroup(int n, const std::function<void(int, int, float)> &flush);
+    // Cộng dt cho mọi nhóm, trả về nhóm cần cập nhật ở bước này; dt nhận
+    // thời gian cộng dồn của nhóm đó
+    int next(float &dt);
+    // Thời gian hạt thứ index còn chờ (vẽ, phun hạt mới đúng thời điểm hiện tại)
+    float lag(size_t index) const { return pending[index % groups]; }
+};
+
+// Vị trí uniform của một chương trình vẽ/cập nhật hạt, tra một lần sau khi
+// link. Uniform chương trình không có thì là -1 (glUniform bỏ qua)
+struct ParticleUniforms {
+    // particleCommonGlsl
+    int typeColor, typeAlpha, typeSize, typeLife;
+    int blackbody, blackbodyRange, lavaHeatRange, pointScale, viewportSize;
+    // Vẽ
+    int transform, boundsMin, boundsSize, lavaCount, smokeGroups, smokeLag;
+    // Cập nhật trên GPU
+    int lavaDt, smokeGroup, smokeDt, lavaCooling, ambientTemp;
+    int wind, windMin, windInvCell, windRes;
+    int ground, groundMin, groundInvCell, groundRes, groundCenter, groundFar;
+    int sdf, hasSdf, sdfMin, sdfInvCell, sdfRes;
+
+    void locate(unsigned int program);
+};
+
+// Trạng thái backend mô phỏng trên GPU (transform feedback, ping-pong 2 buffer).
+// Mỗi hạt: vec4(pos, life) + vec4(vel, loại/seed/mức kích thước). Xem particle_system_gpu.cpp
+//
+// Phun hạt, khói mặt đất, tập hạt ngủ, landings/solidified, chia nhóm và gộp
+// cụm khói, tua nhanh/xem lại dùng chung code với backend CPU; GPU chỉ tích
+// phân hạt đang bay rồi báo sự kiện về. Khác backend CPU:
+// - mặt đất và SDF lấy mẫu thành texture (nội suy tuyến tính, ô mặt đất
+//   0.125 đơn vị, to dần khi ô lưới phải nới ra theo hạt bay xa);
+// - khói mặt đất sinh ở bước sau bước va chạm (sự kiện đọc về sau khi tích phân);
+// - nhiệt độ dung nham là float thay vì số cố định 16 bit;
+// - collectGlow(), stats(), gộp cụm khói, tua nhanh/xem lại và chuyển về CPU
+//   đọc ngược buffer (đồng bộ).
+struct GpuParticleBackend {
+    unsigned int updateProgram = 0;
+    unsigned int renderProgram = 0;
+    unsigned int eventProgram = 0;    // gom slot có sự kiện (geometry shader)
+    ParticleUniforms updateUniforms;
+    ParticleUniforms renderUniforms;
+    unsigned int buffers[2] = {0, 0};
+    unsigned int vaos[2] = {0, 0};        // đầu vào của bước cập nhật (mỗi slot một đỉnh)
+    unsigned int renderVaos[2] = {0, 0};  // vẽ: mỗi slot một instance quad
+    unsigned int eventBuffer = 0;     // sự kiện của bước gần nhất (transform feedback)
+    unsigned int eventQuery = 0;      // đếm số sự kiện (số điểm transform feedback ghi)
+    int src = 0;                      // buffer chứa trạng thái hiện tại
+    std::vector<uint32_t> dirty;      // slot CPU vừa sinh/sửa, chưa ghi lên buffer
+    bool uploadAll = false;           // ghi cả buffer từ bản sao CPU
+    std::vector<float> scratch;
+    std::vector<float> events;
+
+    unsigned int groundTexture = 0;  // R32F: độ cao mặt đất trên lưới quanh núi
+    float groundAge = 0.0f;          // thời gian từ lần lấy mẫu gần nhất
+    float groundCenter[2] = {0, 0};
+    float groundExtent = 0.0f;       // nửa cạnh ô lưới
+    float groundFarthest = 0.0f;     // hạt xa tâm nhất đã báo từ lần lấy mẫu trước
+    unsigned int sdfTexture = 0;     // RGBA32F: gradient (xyz) + khoảng cách (w)
+    const SparseSdf* sdfSource = nullptr;
+    float sdfMin[3] = {0, 0, 0};
+    float sdfInvCell = 1.0f;
+    int sdfRes[3] = {1, 1, 1};
+
+    // Xóa mọi đối tượng GL ở trên và đưa về trạng thái ban đầu (initGpu() lại được)
+    void destroy();
+};
+
+// Số hạt còn sống và hộp bao của chúng. Dung nham gồm cả hạt ngủ, khói gồm cả
+// khói mặt đất; hộp bao rỗng (min > max) nếu không có hạt.
+struct ParticleStats {
+    int lava = 0;
+    int smoke = 0;
+    float lavaMin[3], lavaMax[3];
+    float smokeMin[3], smokeMax[3];
+};
+
+// Một điểm khói để vẽ (không gian model): hạt riêng, hoặc cụm gộp
+// (PARTICLE_SMOKE_PUFF: age là alpha, seed là mức kích thước 0..63)
+struct SmokeSprite {
+    float x, y, z;
+    float age;
+    uint8_t type;
+    uint8_t seed;
+    uint8_t sizeLevel;
+};
 
 class ParticleSystem {
 public:
     void init();
+    void shutdown();  // giải phóng đối tượng GL của cả 2 backend và gió
     void update(float dt, float volcanoX, float volcanoY, float volcanoZ);
     void render();
     void render(const float* transformMatrix); // Thêm phương thức mới
     void handleInput(int key);
+    void setSeed(uint32_t seed);  // Cố định RNG để các lần chạy giống hệt nhau
 
     bool emitting = true;
     int baseEmitRate = 300;
     float eruptionPower = 1.0f;
     float globalSizeMul = 1.0f;
+    // Phím G: chuyển giữa mô phỏng CPU và GPU, hạt đang có được chuyển theo
+    // (xem GpuParticleBackend). Gán trực tiếp chỉ trước frame đầu tiên
+    bool useGpu = false;
+
+    // Độ cao mặt đất cho va chạm của hạt dung nham (cả 2 backend),
+    // không gán thì dùng mặt phẳng y = -0.5
+    std::function<float(float, float)> groundHeight;
+    // SDF của núi lửa (cả 2 backend): hạt dung nham và khói va chạm với thành
+    // miệng núi và sườn dốc mà lưới độ cao không biểu diễn được
+    const SparseSdf* collider = nullptr;
+    // Bật: hạt dung nham nảy/lăn tới khi nằm yên thì tan vào dòng chảy (thay vì
+    // ngủ), vị trí và nhiệt độ được ghi vào landings để main chuyển cho mô
+    // phỏng dòng dung nham
+    bool collectLandings = false;
+    std::vector<LavaLanding> landings;
+    // Vị trí các hạt đã đông cứng để main bồi lên địa hình/sườn núi
+    std::vector<ParticleVec3> solidified;
+
+    LavaThermalParams thermal;
+
+    // Khoảng cách từ camera tới miệng núi (đã chia cho zoom), main gán mỗi frame.
+    // Càng xa thì khói càng được chia nhiều nhóm cập nhật xen kẽ.
+    float viewDistance = 0.0f;
+    // Vị trí mắt trong không gian model và zoom, main gán mỗi frame. Khói xa
+    // hơn smokeClusterDistance (đã chia cho zoom) được gộp theo lưới ô cạnh
+    // smokeClusterCell thành một cụm lớn mỗi ô, lại gần thì tách ra.
+    // smokeClusterDistance <= 0: không gộp (backend GPU khỏi đọc khói về CPU).
+    ParticleVec3 viewEye;
+    float viewZoom = 1.0f;
+    float smokeClusterDistance = 15.0f;
+    float smokeClusterCell = 0.5f;  // ô ở đúng smokeClusterDistance, xa hơn thì to theo
+
+    // > 1: đang vẽ vào pass độ phân giải 1/renderDownsample (LowResPass): kích
+    // thước điểm chia theo, alpha của đích giữ độ trong suốt còn lại để ghép lại
+    int renderDownsample = 1;
+
+    // Gió + xoáy đẩy khói (cả 2 backend), khởi tạo trong init()
+    WindField wind;
+
+    // Tua nhanh dung nham bằng lời giải giải tích: hạt đang bay và
+    // hạt phun trong khoảng seconds được giải theo sự kiện, kết quả chạm đất/đông
+    // cứng đổ vào landings/solidified, hạt còn sống lúc cuối trở lại update()
+    void fastForward(float seconds, float volcanoX, float volcanoY, float volcanoZ);
+    // Xem lại dung nham ở thời điểm t của các lần tua nhanh, trên trục thời gian
+    // của bộ giải (chỉ gồm các khoảng đã tua, giới hạn trong
+    // ballistic.historyStart()..ballistic.time()); trong lúc xem update() dừng,
+    // endScrub() trả lại trạng thái trước đó
+    void scrubTo(float t);
+    void endScrub();
+    bool isScrubbing() const { return scrubbing; }
+    float scrubPosition() const { return scrubTime; }
+    BallisticSolver ballistic;
+
+    // Thêm vào out mọi hạt dung nham (đang bay + nằm yên), màu lấy từ cùng
+    // bảng vật đen với lúc vẽ hạt. Backend GPU đọc ngược vùng dung nham.
+    void collectGlow(std::vector<LavaGlow> &out);
+
+    // Khói để vẽ: hạt gần hơn smokeClusterDistance giữ nguyên (vị
+    // trí ngoại suy tới hiện tại), hạt ở xa cùng ô lưới gộp thành một cụm.
+    // viewportHeight (pixel) để đổi độ tản của cụm ra kích thước điểm.
+    void clusterSmoke(const float* transformMatrix, int viewportHeight, std::vector<SmokeSprite> &out);
+
+    // Đếm hạt + hộp bao (phím I, kiểm tra); backend GPU đọc ngược cả buffer nên
+    // chỉ dùng để kiểm tra/so sánh, không gọi mỗi frame
+    void stats(ParticleStats &out);
 
 private:
     std::vector<Particle> lavaParticles;
     std::vector<Particle> smokeParticles;
     
+    ParticleSdfBatch sdfBatch;
+    SmokeSchedule smokeSchedule;
+    std::vector<std::pair<uint64_t, uint32_t>> smokeCells;  // (ô lưới, chỉ số hạt) của khói ở xa
+    std::vector<SmokeSprite> smokeSprites;
+    int smokeClustered = 0, smokePuffs = 0;                  // frame vẽ gần nhất, cho phím I
+    std::vector<SleepingLava> sleeping;
+    size_t sleepCursor = 0;  // vị trí kiểm tra mặt đất tiếp theo trong sleeping
+    int lavaAwake = 0;       // số hạt dung nham đang được tích phân (frame trước)
+    std::vector<BallisticEvent> ballisticEvents;
+    std::vector<uint32_t> ballisticIds;
+    std::vector<Particle> scrubSaved;  // dung nham lúc bắt đầu xem lại
+    bool scrubbing = false;
+    float scrubTime = 0.0f;
+
     const int MAX_PARTICLES = 3000;
     const int MAX_SMOKE = 1500;
     
     void emitLava(Particle &p, float volcanoX, float volcanoY, float volcanoZ);
     void emitSmoke(Particle &p, float volcanoX, float volcanoY, float volcanoZ);
     float randFloat(float a, float b);
+    void spawn(Particle &p, ParticleType type);
+    void spawnGroundSmoke(const ParticleVec3 &pos);
+    void uploadTypeTable(const ParticleUniforms &u);
+    float typeSizeMul(int type) const;
+    void setupBlend() const;
+    void updateSleeping(float dt);
+    void updateSmokeGroup(int group, int groups, float dt);
+    void backdateSmoke(Particle &s);
+    float lavaMaxTemp() const { return thermal.eruptionTemp + thermal.eruptionSpread; }
+
+    // Backend GPU (particle_system_gpu.cpp)
+    GpuParticleBackend gpu;
+    void initGpu();
+    void updateGpu(float dt, float volcanoX, float volcanoZ);
+    void stepGpu(float lavaDt, int group, int groups, float smokeDt);
+    void renderGpu(const float* transformMatrix, bool smoke);
+    void updateGpuGround(float dt, float centerX, float centerZ);
+    void updateGpuSdf();
+    Particle &gpuSlot(int slot);
+    int gpuSlotOf(const Particle &p) const;
+    void markGpuDirty(const Particle &p);
+    void flushGpu();
+    void downloadGpu(int first, int count);
 };
 
+// Dùng chung giữa backend CPU và GPU (định nghĩa trong particle_system.cpp)
+extern const char* particleCommonGlsl;
+extern const char* particleFragmentShaderSrc;
+unsigned int compileParticleShader(unsigned int type, const char* src, const char* common);
+// Màu phát xạ (đã mã hóa gamma) của vật đen ở nhiệt độ temp (°C)
+void blackbodyColor(float temp, float rgb[3]);
+// Gắn quad đơn vị (vec2 góc) vào thuộc tính location của VAO đang bind
+void bindParticleQuad(unsigned int location);
+
 extern ParticleSystem particleSystem;
 
 #endif
@@ -0,0 +1,667 @@
+
+#include "particle_system.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// Backend mô phỏng hạt trên GPU bằng transform feedback.
+//
+// Một buffer chứa mọi slot: [0, L) dung nham, [L, L+S) khói (cả khói miệng
+// núi và khói mặt đất, chung một vòng như đường CPU). lavaParticles/smokeParticles
+// vẫn là bản sao của từng slot: cờ alive, loại, seed luôn đúng, vị trí/vận tốc
+// chỉ đúng sau downloadGpu(). Mọi hạt mới (phun, khói mặt đất, hạt ngủ thức
+// dậy, tua nhanh) vẫn do code CPU sinh vào slot chết đầu tiên như đường CPU,
+// slot đó được đánh dấu và ghi đè lên buffer trước lần cập nhật/vẽ sau (flushGpu()).
+// Mỗi bước vertex shader tích phân mọi slot sang buffer đích rồi một pass
+// geometry shader gom các slot có sự kiện (chạm đất mạnh, nằm yên, đông cứng,
+// khói hết tuổi, bay xa) vào buffer sự kiện nhỏ để đọc về CPU, CPU xử lý giống
+// hệt vòng lặp của update(). Vẽ thẳng từ buffer đích.
+// Mặt đất và SDF được lấy mẫu trên CPU thành texture (xem updateGpuGround(),
+// updateGpuSdf()); khác biệt còn lại với đường CPU ghi ở GpuParticleBackend.
+
+// Lưới độ cao mặt đất: GPU_GROUND_RES^2 điểm phủ ô vuông nửa cạnh
+// GPU_GROUND_EXTENT quanh miệng núi, lấy mẫu lại mỗi GPU_GROUND_REFRESH giây vì
+// dòng dung nham làm mặt đất đổi dần. Dung nham xa tâm hơn GPU_GROUND_FAR * nửa
+// cạnh được báo về: quá GPU_GROUND_EDGE thì ô nới gấp đôi ngay (ô lưới to theo),
+// không còn hạt nào xa thì lần lấy mẫu sau thu lại một nửa
+static const int GPU_GROUND_RES = 512;
+static const float GPU_GROUND_EXTENT = 32.0f;
+static const float GPU_GROUND_REFRESH = 0.5f;
+static const float GPU_GROUND_FAR = 0.4f;
+static const float GPU_GROUND_EDGE = 0.8f;
+// SDF lấy mẫu lại với ô bằng nửa bề dày dải band của SparseSdf (để dải không
+// bị nội suy mất), trục dài nhất không quá GPU_SDF_MAX_RES điểm
+static const int GPU_SDF_MAX_RES = 128;
+
+// Sự kiện của một slot trong bước vừa rồi, lưu ở w của vận tốc (* 16384, giống shader)
+enum GpuParticleEvent {
+    GPU_EVENT_IMPACT = 1,  // dung nham va chạm đủ mạnh: sinh khói mặt đất
+    GPU_EVENT_REST = 2,    // dung nham nằm yên (chết), w của vị trí = -(nhiệt độ - đông đặc)
+    GPU_EVENT_SOLID = 4,   // dung nham đông cứng (chết)
+    GPU_EVENT_DIED = 8,    // khói hết thời gian sống
+    GPU_EVENT_FAR = 16     // dung nham xa tâm lưới mặt đất hơn uGroundFar
+};
+// Bản ghi sự kiện: vec4(pos, w của vị trí) + vec2(slot, mã)
+static const int GPU_EVENT_FLOATS = 6;
+
+const char* particleUpdateShaderSrc = R"(
+layout(location = 0) in vec4 aPosLife;  // xyz = vị trí, w = thời gian sống còn lại
+                                        // (dung nham: nhiệt độ trên mức đông đặc)
+layout(location = 1) in vec4 aVelSeed;  // xyz = vận tốc, w = seed + 64 * loại + 256 * mức kích thước
+                                        // (+ 16384 * sự kiện)
+
+uniform int uLavaCount;
+uniform float uLavaDt;         // 0: không bước dung nham (chỉ bắt kịp một nhóm khói)
+uniform int uSmokeGroups;      // slot khói thứ i thuộc nhóm i % uSmokeGroups (SmokeSchedule)
+uniform int uSmokeGroup;       // nhóm khói được cập nhật lần này
+uniform float uSmokeDt;
+uniform vec2 uLavaCooling;     // hệ số bức xạ, hệ số tiếp xúc
+uniform float uAmbientTemp;
+uniform sampler3D uWind;       // lưới gió của WindField
+uniform vec3 uWindMin;
+uniform vec3 uWindInvCell;
+uniform float uWindRes;
+uniform sampler2D uGround;     // độ cao mặt đất (groundHeight lấy mẫu trên lưới)
+uniform vec2 uGroundMin;
+uniform float uGroundInvCell;
+uniform float uGroundRes;
+uniform vec2 uGroundCenter;
+uniform float uGroundFar;
+uniform int uHasSdf;
+uniform sampler3D uSdf;        // SDF của núi lửa: xyz = gradient, w = khoảng cách
+uniform vec3 uSdfMin;
+uniform float uSdfInvCell;
+uniform vec3 uSdfRes;
+
+out vec4 outPosLife;
+out vec4 outVelSeed;
+
+const float GRAVITY = -8.0;  // Giảm trọng lực cho 3D
+// Giống particle_system.cpp
+const float SMOKE_WIND_COUPLING = 1.5;
+const float LAVA_REST_SPEED = 0.25;
+const float GROUND_SMOKE_SPEED = 1.0;
+const float SDF_SKIN = 0.01;
+// Giống GpuParticleEvent
+const int EVENT_IMPACT = 1;
+const int EVENT_REST = 2;
+const int EVENT_SOLID = 4;
+const int EVENT_DIED = 8;
+const int EVENT_FAR = 16;
+
+float groundAt(vec2 xz) {
+    return texture(uGround, ((xz - uGroundMin) * uGroundInvCell + 0.5) / uGroundRes).r;
+}
+
+// Như resolveSdfContact() của đường CPU: đẩy ra khỏi lớp da theo gradient,
+// phản xạ thành phần vận tốc hướng vào bề mặt
+bool sdfContact(inout vec3 pos, inout vec3 vel, float restitution, float friction) {
+    if (uHasSdf == 0) return false;
+    vec3 uvw = ((pos - uSdfMin) * uSdfInvCell + 0.5) / uSdfRes;
+    if (any(lessThan(uvw, vec3(0.0))) || any(greaterThan(uvw, vec3(1.0)))) return false;
+    vec4 s = texture(uSdf, uvw);
+    if (s.w >= SDF_SKIN || dot(s.xyz, s.xyz) < 1e-8) return false;
+    vec3 n = normalize(s.xyz);
+    pos += n * (SDF_SKIN - s.w);
+    float vn = dot(vel, n);
+    if (vn < 0.0) vel = (vel - n * vn) * friction - n * vn * restitution;
+    return true;
+}
+
+// Một bước của vòng lặp dung nham trong ParticleSystem::update().
+// heat = nhiệt độ - nhiệt độ đông đặc; trả về các sự kiện EVENT_*
+int stepLava(inout vec3 pos, inout vec3 vel, inout float heat, float dt) {
+    vel.y += GRAVITY * dt;
+    pos += vel * dt;
+
+    // Nguội do bức xạ
+    float temp = heat + uLavaHeatRange.x;
+    float tk = temp + 273.15, ta = uAmbientTemp + 273.15;
+    temp -= uLavaCooling.x * (tk * tk * tk * tk - ta * ta * ta * ta) * dt;
+
+    // Va chạm với thành miệng/sườn núi (SDF), rồi với mặt đất
+    float impactSpeed = length(vel);
+    bool contact = sdfContact(pos, vel, 0.2, 0.3);
+    float ground = groundAt(pos.xz);
+    if (pos.y < ground) {
+        pos.y = ground;
+        vel.y *= -0.2;  // Giảm độ nảy
+        vel.xz *= 0.3;
+        contact = true;
+    }
+    int events = contact && impactSpeed >= GROUND_SMOKE_SPEED ? EVENT_IMPACT : 0;
+    // Nằm trên mặt đất thì nguội nhanh hơn nhiều
+    if (contact || pos.y < ground + 0.02) temp -= uLavaCooling.y * (temp - uAmbientTemp) * dt;
+
+    heat = temp - uLavaHeatRange.x;
+    if (heat <= 0.0) {
+        heat = 0.0;
+        return events | EVENT_SOLID;
+    }
+    // Gần như đứng yên: CPU đưa vào tập hạt ngủ hoặc dòng chảy, nhiệt độ gửi kèm
+    if (contact && dot(vel, vel) < LAVA_REST_SPEED * LAVA_REST_SPEED) {
+        heat = -heat;
+        return events | EVENT_REST;
+    }
+    vec2 d = abs(pos.xz - uGroundCenter);
+    if (max(d.x, d.y) > uGroundFar) events |= EVENT_FAR;
+    return events;
+}
+
+void stepSmoke(inout vec3 pos, inout vec3 vel, float dt) {
+    vec3 w = texture(uWind, ((pos - uWindMin) * uWindInvCell + 0.5) / uWindRes).xyz;
+    float drag = SMOKE_WIND_COUPLING * dt;
+    vel.y += 0.5 * dt + w.y * drag;  // Khói bay lên, gió dọc cộng thêm
+    pos += vel * dt;
+    vel.xz += (w.xz - vel.xz) * drag;
+    // Khói trượt dọc thành miệng/sườn núi thay vì xuyên qua
+    sdfContact(pos, vel, 0.0, 1.0);
+}
+
+void main() {
+    vec3 pos = aPosLife.xyz;
+    float life = aPosLife.w;
+    vec3 vel = aVelSeed.xyz;
+    int code = int(aVelSeed.w) & 16383;  // bỏ sự kiện của bước trước
+    int events = 0;
+
+    if (gl_VertexID < uLavaCount) {
+        if (life > 0.0 && uLavaDt > 0.0) events = stepLava(pos, vel, life, uLavaDt);
+    }
+    else if (life > 0.0 && (gl_VertexID - uLavaCount) % uSmokeGroups == uSmokeGroup) {
+        life -= uSmokeDt;
+        if (life <= 0.0) {
+            life = 0.0;
+            events = EVENT_DIED;
+        } else {
+            stepSmoke(pos, vel, uSmokeDt);
+        }
+    }
+
+    outPosLife = vec4(pos, life);
+    outVelSeed = vec4(vel, float(code + events * 16384));
+}
+)";
+
+// Pass gom sự kiện: mỗi slot một điểm, geometry shader chỉ giữ slot có sự kiện.
+// Transform feedback ghi liền nhau theo thứ tự slot như vòng lặp trên CPU
+const char* particleEventVertexShaderSrc = R"(
+#version 330 core
+layout(location = 0) in vec4 aPosLife;
+layout(location = 1) in vec4 aVelSeed;
+out vec4 vPosLife;
+out vec2 vSlotCode;
+void main() {
+    vPosLife = aPosLife;
+    vSlotCode = vec2(float(gl_VertexID), aVelSeed.w);
+}
+)";
+
+const char* particleEventGeometryShaderSrc = R"(
+#version 330 core
+layout(points) in;
+layout(points, max_vertices = 1) out;
+in vec4 vPosLife[];
+in vec2 vSlotCode[];
+out vec4 outEventPosLife;
+out vec2 outEventSlotCode;
+void main() {
+    if (vSlotCode[0].y < 16384.0) return;
+    outEventPosLife = vPosLife[0];
+    outEventSlotCode = vSlotCode[0];
+    EmitVertex();
+    EndPrimitive();
+}
+)";
+
+const char* particleGpuVertexShaderSrc = R"(
+layout(location = 0) in vec4 aPosLife;
+layout(location = 1) in vec4 aVelSeed;
+layout(location = 3) in vec2 aCorner;  // góc quad, 2 thuộc tính trên theo instance (slot)
+
+uniform mat4 uTransform;
+uniform int uLavaCount;
+uniform int uSmokeGroups;
+uniform float uSmokeLag[4];  // MAX_SMOKE_GROUPS: thời gian chờ của mỗi nhóm khói
+
+out vec4 vColor;
+out vec2 vCoord;
+
+void main() {
+    vec3 pos = aPosLife.xyz;
+    float life = aPosLife.w;
+    vCoord = aCorner;
+    if (life <= 0.0) {
+        // Slot chết: đẩy ra ngoài vùng cắt
+        vColor = vec4(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    int code = int(aVelSeed.w);
+    uint type = uint(code >> 6) & 3u;
+    uint seed = uint(code) & 63u;
+    uint sizeLevel = uint(code >> 8) & 63u;
+    float age;
+    if (type == 0u) {
+        age = clamp(life / (uLavaHeatRange.y - uLavaHeatRange.x), 0.0, 1.0);
+    } else {
+        // Khói cập nhật theo nhóm: ngoại suy tới hiện tại như đường CPU
+        float lag = uSmokeLag[(gl_InstanceID - uLavaCount) % uSmokeGroups];
+        pos += aVelSeed.xyz * lag;
+        age = clamp(1.0 - (life - lag) / particleMaxLife(type, seed), 0.0, 1.0);
+    }
+
+    float size;
+    vColor = particleAppearance(type, seed, sizeLevel, age, size);
+    gl_Position = spriteVertex(uTransform * vec4(pos, 1.0), aCorner, size * uPointScale);
+}
+)";
+
+// second: fragment hoặc geometry shader (0 nếu không có); varyings: 2 biến
+// transform feedback ghi xen kẽ, nullptr nếu không ghi
+static GLuint linkParticleProgram(GLuint vs, GLuint second, const char* const* varyings) {
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    if (second) glAttachShader(prog, second);
+    if (varyings) glTransformFeedbackVaryings(prog, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(prog);
+
+    GLint ok;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[2048];
+        glGetProgramInfoLog(prog, 2048, nullptr, log);
+        cerr << "Particle Program error: " << log << endl;
+    }
+    glDeleteShader(vs);
+    if (second) glDeleteShader(second);
+    return prog;
+}
+
+void ParticleSystem::initGpu() {
+    const char* stateVaryings[2] = { "outPosLife", "outVelSeed" };
+    const char* eventVaryings[2] = { "outEventPosLife", "outEventSlotCode" };
+    gpu.updateProgram = linkParticleProgram(
+        compileParticleShader(GL_VERTEX_SHADER, particleUpdateShaderSrc, particleCommonGlsl), 0, stateVaryings);
+    gpu.renderProgram = linkParticleProgram(
+        compileParticleShader(GL_VERTEX_SHADER, particleGpuVertexShaderSrc, particleCommonGlsl),
+        compileParticleShader(GL_FRAGMENT_SHADER, particleFragmentShaderSrc, nullptr), nullptr);
+    gpu.eventProgram = linkParticleProgram(
+        compileParticleShader(GL_VERTEX_SHADER, particleEventVertexShaderSrc, nullptr),
+        compileParticleShader(GL_GEOMETRY_SHADER, particleEventGeometryShaderSrc, nullptr), eventVaryings);
+    gpu.updateUniforms.locate(gpu.updateProgram);
+    gpu.renderUniforms.locate(gpu.renderProgram);
+
+    int total = MAX_PARTICLES + MAX_SMOKE;
+    glGenBuffers(2, gpu.buffers);
+    glGenVertexArrays(2, gpu.vaos);
+    for (int i = 0; i < 2; i++) {
+        glBindVertexArray(gpu.vaos[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, total * 8 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+
+        // Cấu trúc: vec4(pos, life) + vec4(vel, seed) = 8 floats
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+    }
+    // Cùng buffer nhưng đọc theo instance để vẽ quad
+    glGenVertexArrays(2, gpu.renderVaos);
+    for (int i = 0; i < 2; i++) {
+        glBindVertexArray(gpu.renderVaos[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glVertexAttribDivisor(0, 1);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+        glVertexAttribDivisor(1, 1);
+        bindParticleQuad(3);
+    }
+    glBindVertexArray(0);
+
+    // Mọi slot có thể có sự kiện trong cùng một bước
+    glGenBuffers(1, &gpu.eventBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.eventBuffer);
+    glBufferData(GL_ARRAY_BUFFER, total * GPU_EVENT_FLOATS * sizeof(float), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenQueries(1, &gpu.eventQuery);
+
+    // Trạng thái hiện có (CPU) lên buffer ở flushGpu() đầu tiên
+    gpu.src = 0;
+    gpu.uploadAll = true;
+    gpu.dirty.clear();
+
+    cout << "GPU particle backend initialized (" << total << " slots)" << endl;
+}
+
+void GpuParticleBackend::destroy() {
+    if (updateProgram) glDeleteProgram(updateProgram);
+    if (renderProgram) glDeleteProgram(renderProgram);
+    if (eventProgram) glDeleteProgram(eventProgram);
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(2, vaos);
+    glDeleteVertexArrays(2, renderVaos);
+    if (eventBuffer) glDeleteBuffers(1, &eventBuffer);
+    if (eventQuery) glDeleteQueries(1, &eventQuery);
+    if (groundTexture) glDeleteTextures(1, &groundTexture);
+    if (sdfTexture) glDeleteTextures(1, &sdfTexture);
+    *this = GpuParticleBackend();
+}
+
+Particle &ParticleSystem::gpuSlot(int slot) {
+    return slot < MAX_PARTICLES ? lavaParticles[slot] : smokeParticles[slot - MAX_PARTICLES];
+}
+
+// Slot của p nếu p nằm trong lavaParticles/smokeParticles, không thì -1
+int ParticleSystem::gpuSlotOf(const Particle &p) const {
+    uintptr_t a = (uintptr_t)&p;
+    uintptr_t lava = (uintptr_t)lavaParticles.data(), smoke = (uintptr_t)smokeParticles.data();
+    if (a >= lava && a < lava + lavaParticles.size() * sizeof(Particle))
+        return (int)((a - lava) / sizeof(Particle));
+    if (a >= smoke && a < smoke + smokeParticles.size() * sizeof(Particle))
+        return MAX_PARTICLES + (int)((a - smoke) / sizeof(Particle));
+    return -1;
+}
+
+void ParticleSystem::markGpuDirty(const Particle &p) {
+    int slot = gpuSlotOf(p);
+    if (slot >= 0) gpu.dirty.push_back((uint32_t)slot);
+}
+
+// Ghi các slot CPU đã sửa (hoặc tất cả) lên buffer hiện tại
+void ParticleSystem::flushGpu() {
+    if (gpu.updateProgram == 0 || (!gpu.uploadAll && gpu.dirty.empty())) return;
+    auto pack = [&](const Particle &p, float* s) {
+        s[0] = p.pos.x; s[1] = p.pos.y; s[2] = p.pos.z;
+        s[3] = 0.0f;
+        if (p.alive) {
+            s[3] = p.type == PARTICLE_LAVA
+                 ? max(p.heat * (1.0f / PARTICLE_HEAT_SCALE) - thermal.solidusTemp, 1e-3f)
+                 : p.life;
+        }
+        s[4] = p.vel.x; s[5] = p.vel.y; s[6] = p.vel.z;
+        s[7] = (float)((p.sizeLevel << 8) | (p.type << 6) | (p.seed & 63));
+    };
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[gpu.src]);
+    if (gpu.uploadAll) {
+        int total = MAX_PARTICLES + MAX_SMOKE;
+        gpu.scratch.resize((size_t)total * 8);
+        for (int i = 0; i < total; i++) pack(gpuSlot(i), &gpu.scratch[(size_t)i * 8]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, gpu.scratch.size() * sizeof(float), gpu.scratch.data());
+    } else {
+        float s[8];
+        for (uint32_t slot : gpu.dirty) {
+            pack(gpuSlot(slot), s);
+            glBufferSubData(GL_ARRAY_BUFFER, slot * sizeof(s), sizeof(s), s);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gpu.dirty.clear();
+    gpu.uploadAll = false;
+}
+
+// Đọc vị trí, vận tốc, nhiệt độ/thời gian sống của các slot first..first+count
+// về bản sao trên CPU
+void ParticleSystem::downloadGpu(int first, int count) {
+    if (gpu.updateProgram == 0) return;
+    flushGpu();
+    gpu.scratch.resize((size_t)count * 8);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.buffers[gpu.src]);
+    glGetBufferSubData(GL_ARRAY_BUFFER, (size_t)first * 8 * sizeof(float), gpu.scratch.size() * sizeof(float),
+                       gpu.scratch.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (int k = 0; k < count; k++) {
+        Particle &p = gpuSlot(first + k);
+        const float* s = &gpu.scratch[(size_t)k * 8];
+        p.alive = s[3] > 0.0f;
+        if (!p.alive) continue;
+        p.pos = ParticleVec3(s[0], s[1], s[2]);
+        p.vel = ParticleVec3(s[4], s[5], s[6]);
+        if (p.type == PARTICLE_LAVA) p.heat = (uint16_t)((s[3] + thermal.solidusTemp) * PARTICLE_HEAT_SCALE + 0.5f);
+        else p.life = s[3];
+    }
+}
+
+// Lấy mẫu groundHeight (không gán thì y = -0.5 như đường CPU) trên lưới quanh núi
+void ParticleSystem::updateGpuGround(float dt, float centerX, float centerZ) {
+    gpu.groundAge += dt;
+    bool nearEdge = gpu.groundFarthest > GPU_GROUND_EDGE * gpu.groundExtent;
+    if (gpu.groundTexture != 0 && gpu.groundAge < GPU_GROUND_REFRESH && !nearEdge) return;
+    gpu.groundAge = 0.0f;
+
+    // Không có hạt nào báo xa thì mọi hạt đều trong GPU_GROUND_FAR của ô cũ
+    float farthest = max(gpu.groundFarthest, GPU_GROUND_FAR * gpu.groundExtent);
+    float extent = GPU_GROUND_EXTENT;
+    while (farthest > GPU_GROUND_EDGE * extent) extent *= 2.0f;
+    gpu.groundExtent = extent;
+    gpu.groundFarthest = 0.0f;
+    gpu.groundCenter[0] = centerX;
+    gpu.groundCenter[1] = centerZ;
+
+    const float cell = 2.0f * extent / (GPU_GROUND_RES - 1);
+    vector<float> heights((size_t)GPU_GROUND_RES * GPU_GROUND_RES);
+    for (int j = 0; j < GPU_GROUND_RES; j++) {
+        for (int i = 0; i < GPU_GROUND_RES; i++) {
+            float x = centerX - extent + i * cell, z = centerZ - extent + j * cell;
+            heights[(size_t)j * GPU_GROUND_RES + i] = groundHeight ? groundHeight(x, z) : -0.5f;
+        }
+    }
+
+    if (gpu.groundTexture == 0) {
+        glGenTextures(1, &gpu.groundTexture);
+        glBindTexture(GL_TEXTURE_2D, gpu.groundTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, GPU_GROUND_RES, GPU_GROUND_RES, 0, GL_RED, GL_FLOAT, heights.data());
+    } else {
+        glBindTexture(GL_TEXTURE_2D, gpu.groundTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GPU_GROUND_RES, GPU_GROUND_RES, GL_RED, GL_FLOAT, heights.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// SDF thưa -> texture 3D dày, làm lại khi đổi collider (SDF không đổi lúc chạy)
+void ParticleSystem::updateGpuSdf() {
+    if (collider == gpu.sdfSource) return;
+    gpu.sdfSource = collider;
+    if (!collider || collider->empty()) {
+        if (gpu.sdfTexture) glDeleteTextures(1, &gpu.sdfTexture);
+        gpu.sdfTexture = 0;
+        return;
+    }
+
+    float bmin[3], bmax[3];
+    collider->bounds(bmin, bmax);
+    float extent = max(max(bmax[0] - bmin[0], bmax[1] - bmin[1]), bmax[2] - bmin[2]);
+    float cell = max(0.5f * collider->band(), extent / (GPU_SDF_MAX_RES - 1));
+    for (int k = 0; k < 3; k++) {
+        gpu.sdfMin[k] = bmin[k];
+        gpu.sdfRes[k] = (int)ceilf((bmax[k] - bmin[k]) / cell) + 1;
+    }
+    gpu.sdfInvCell = 1.0f / cell;
+
+    const int rx = gpu.sdfRes[0], ry = gpu.sdfRes[1], rz = gpu.sdfRes[2];
+    vector<float> texels((size_t)rx * ry * rz * 4);
+    for (int z = 0; z < rz; z++) {
+        for (int y = 0; y < ry; y++) {
+            for (int x = 0; x < rx; x++) {
+                float* t = &texels[(((size_t)z * ry + y) * rx + x) * 4];
+                t[3] = collider->sample(bmin[0] + x * cell, bmin[1] + y * cell, bmin[2] + z * cell, t);
+            }
+        }
+    }
+
+    if (gpu.sdfTexture == 0) glGenTextures(1, &gpu.sdfTexture);
+    glBindTexture(GL_TEXTURE_3D, gpu.sdfTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, rx, ry, rz, 0, GL_RGBA, GL_FLOAT, texels.data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    cout << "GPU particle SDF: " << rx << "x" << ry << "x" << rz << endl;
+}
+
+// Phần của update() sau khi phun: tích phân trên GPU, sự kiện xử lý trên CPU
+void ParticleSystem::updateGpu(float dt, float volcanoX, float volcanoZ) {
+    if (gpu.updateProgram == 0) initGpu();
+    updateGpuGround(dt, volcanoX, volcanoZ);
+    updateGpuSdf();
+
+    // Khói chia nhóm như đường CPU; đổi số nhóm thì các nhóm cũ được bắt kịp
+    // bằng các bước chỉ có khói
+    smokeSchedule.regroup(SmokeSchedule::groupsFor(viewDistance),
+                          [this](int g, int groups, float t) { stepGpu(0.0f, g, groups, t); });
+    float groupDt = dt;
+    int group = smokeSchedule.next(groupDt);
+    stepGpu(dt, group, smokeSchedule.groups, groupDt);
+
+    lavaAwake = (int)count_if(lavaParticles.begin(), lavaParticles.end(), [](const Particle &p) { return p.alive; });
+    updateSleeping(dt);
+}
+
+// Một bước transform feedback: dung nham với lavaDt (0 = giữ nguyên), nhóm
+// khói group trong groups với smokeDt; sau đó đọc và xử lý sự kiện
+void ParticleSystem::stepGpu(float lavaDt, int group, int groups, float smokeDt) {
+    flushGpu();
+
+    const ParticleUniforms &u = gpu.updateUniforms;
+    glUseProgram(gpu.updateProgram);
+    uploadTypeTable(u);
+    glUniform1i(u.lavaCount, MAX_PARTICLES);
+    glUniform1f(u.lavaDt, lavaDt);
+    glUniform1i(u.smokeGroups, groups);
+    glUniform1i(u.smokeGroup, group);
+    glUniform1f(u.smokeDt, smokeDt);
+    glUniform2f(u.lavaCooling, thermal.emissivity, thermal.contactCooling);
+    glUniform1f(u.ambientTemp, thermal.ambientTemp);
+    const WindFieldParams &wp = wind.getParams();
+    const float* windInvCell = wind.invCellSize();
+    glUniform1i(u.wind, 1);
+    glUniform3f(u.windMin, wp.boundsMin[0], wp.boundsMin[1], wp.boundsMin[2]);
+    glUniform3f(u.windInvCell, windInvCell[0], windInvCell[1], windInvCell[2]);
+    glUniform1f(u.windRes, (float)wp.resolution);
+    const float groundCell = 2.0f * gpu.groundExtent / (GPU_GROUND_RES - 1);
+    glUniform1i(u.ground, 2);
+    glUniform2f(u.groundMin, gpu.groundCenter[0] - gpu.groundExtent, gpu.groundCenter[1] - gpu.groundExtent);
+    glUniform1f(u.groundInvCell, 1.0f / groundCell);
+    glUniform1f(u.groundRes, (float)GPU_GROUND_RES);
+    glUniform2f(u.groundCenter, gpu.groundCenter[0], gpu.groundCenter[1]);
+    glUniform1f(u.groundFar, GPU_GROUND_FAR * gpu.groundExtent);
+    glUniform1i(u.sdf, 3);
+    glUniform1i(u.hasSdf, gpu.sdfTexture != 0 ? 1 : 0);
+    glUniform3f(u.sdfMin, gpu.sdfMin[0], gpu.sdfMin[1], gpu.sdfMin[2]);
+    glUniform1f(u.sdfInvCell, gpu.sdfInvCell);
+    glUniform3f(u.sdfRes, (float)gpu.sdfRes[0], (float)gpu.sdfRes[1], (float)gpu.sdfRes[2]);
+
+    const int total = MAX_PARTICLES + MAX_SMOKE;
+    int src = gpu.src, dst = 1 - gpu.src;
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, wind.texture());
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, gpu.groundTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_3D, gpu.sdfTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(gpu.vaos[src]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, gpu.buffers[dst]);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, total);
+    glEndTransformFeedback();
+
+    // Gom sự kiện từ buffer vừa ghi
+    glUseProgram(gpu.eventProgram);
+    glBindVertexArray(gpu.vaos[dst]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, gpu.eventBuffer);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, gpu.eventQuery);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, total);
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+    gpu.src = dst;
+
+    GLuint count = 0;
+    glGetQueryObjectuiv(gpu.eventQuery, GL_QUERY_RESULT, &count);
+    gpu.events.resize((size_t)count * GPU_EVENT_FLOATS);
+    if (count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.eventBuffer);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, gpu.events.size() * sizeof(float), gpu.events.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Xử lý theo thứ tự slot giống vòng lặp dung nham của update(): khói mặt
+    // đất lấy slot khói chết đầu tiên (trước khi tính khói chết ở bước này)
+    for (GLuint k = 0; k < count; k++) {
+        const float* e = &gpu.events[(size_t)k * GPU_EVENT_FLOATS];
+        int slot = (int)e[4];
+        int events = (int)e[5] >> 14;
+        ParticleVec3 pos(e[0], e[1], e[2]);
+        if (slot >= MAX_PARTICLES) {
+            if (events & GPU_EVENT_DIED) smokeParticles[slot - MAX_PARTICLES].alive = false;
+            continue;
+        }
+        Particle &p = lavaParticles[slot];
+        if (events & GPU_EVENT_IMPACT) spawnGroundSmoke(pos);
+        if (events & GPU_EVENT_SOLID) {
+            solidified.push_back(pos);
+            p.alive = false;
+        } else if (events & GPU_EVENT_REST) {
+            float temp = thermal.solidusTemp - e[3];
+            if (collectLandings) landings.push_back({pos, temp});
+            else sleeping.push_back({pos, groundHeight ? groundHeight(pos.x, pos.z) : -0.5f, temp, p.seed, p.sizeLevel});
+            p.alive = false;
+        }
+        if (events & GPU_EVENT_FAR) {
+            float d = max(fabsf(pos.x - gpu.groundCenter[0]), fabsf(pos.z - gpu.groundCenter[1]));
+            gpu.groundFarthest = max(gpu.groundFarthest, d);
+        }
+    }
+}
+
+// Vẽ các slot dung nham (và khói nếu smoke) thẳng từ buffer hiện tại
+void ParticleSystem::renderGpu(const float* transformMatrix, bool smoke) {
+    if (gpu.renderProgram == 0) initGpu();
+    flushGpu();
+
+    const ParticleUniforms &u = gpu.renderUniforms;
+    glUseProgram(gpu.renderProgram);
+    uploadTypeTable(u);
+    glUniformMatrix4fv(u.transform, 1, GL_FALSE, transformMatrix);
+    glUniform1i(u.lavaCount, MAX_PARTICLES);
+    glUniform1i(u.smokeGroups, smokeSchedule.groups);
+    float lags[MAX_SMOKE_GROUPS];
+    for (int g = 0; g < MAX_SMOKE_GROUPS; g++) lags[g] = smokeSchedule.lag(g);
+    glUniform1fv(u.smokeLag, MAX_SMOKE_GROUPS, lags);
+
+    setupBlend();
+
+    glBindVertexArray(gpu.renderVaos[gpu.src]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, smoke ? MAX_PARTICLES + MAX_SMOKE : MAX_PARTICLES);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,391 @@
+
+#include "sdf.h"
+#include "vmath.h"
+#include "mesh_cache.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+const uint32_t SDF_CACHE_VERSION = 1;
+
+struct SdfCacheHeader {
+    char magic[4];          // "VSDF"
+    uint32_t version;
+    uint64_t key;           // hash lưới + tham số SDF
+    float origin[3];
+    float voxelSize;
+    float band;
+    int32_t dims[3];
+    uint64_t brickCount;    // số brick trong dải
+};
+
+static uint64_t cacheKey(uint64_t meshHash, const SdfParams &p) {
+    uint64_t h = hashValue(SDF_CACHE_VERSION, meshHash);
+    h = hashValue(p.voxelSize, h);
+    return hashValue(p.band, h);
+}
+
+// ---------------------------------------------------------------------------
+// Tính
+
+// Điểm gần p nhất trên tam giác abc (Ericson, Real-Time Collision Detection 5.1.5)
+static Vec3 closestOnTriangle(const Vec3 &p, const Vec3 &a, const Vec3 &b, const Vec3 &c) {
+    Vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    Vec3 bp = p - b;
+    float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    Vec3 cp = p - c;
+    float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+struct SdfTriangle {
+    Vec3 a, b, c, n;
+};
+
+void SparseSdf::bake(const float* positions, size_t vertexCount, const SdfParams &p) {
+    params = p;
+    invVoxel = 1.0f / p.voxelSize;
+    brickIndex.clear();
+    pool.clear();
+
+    size_t triCount = vertexCount / 3;
+    if (triCount == 0) return;
+
+    vector<SdfTriangle> tris(triCount);
+    float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+    for (size_t t = 0; t < triCount; t++) {
+        const float* v = positions + t * 9;
+        SdfTriangle &tri = tris[t];
+        tri.a = vec3(v[0], v[1], v[2]);
+        tri.b = vec3(v[3], v[4], v[5]);
+        tri.c = vec3(v[6], v[7], v[8]);
+        Vec3 n = cross(tri.b - tri.a, tri.c - tri.a);
+        tri.n = dot(n, n) > 0.0f ? normalize(n) : vec3(0.0f, 0.0f, 0.0f);
+        for (int k = 0; k < 9; k++) {
+            lo[k % 3] = min(lo[k % 3], v[k]);
+            hi[k % 3] = max(hi[k % 3], v[k]);
+        }
+    }
+
+    // Chừa 1 brick trống quanh lưới để loang dấu từ biên miền
+    float brickSize = BRICK * p.voxelSize;
+    for (int k = 0; k < 3; k++) {
+        origin[k] = lo[k] - brickSize;
+        dims[k] = (int)ceil((hi[k] - lo[k]) / brickSize) + 2;
+    }
+    size_t total = (size_t)dims[0] * dims[1] * dims[2];
+
+
+    // Phân tam giác vào các brick mà hộp bao (nở thêm band) chạm tới, dạng CSR
+    auto forEachBrick = [&](const SdfTriangle &t, auto fn) {
+        int bmin[3], bmax[3];
+        for (int k = 0; k < 3; k++) {
+            float tlo = min(min((&t.a.x)[k], (&t.b.x)[k]), (&t.c.x)[k]) - p.band;
+            float thi = max(max((&t.a.x)[k], (&t.b.x)[k]), (&t.c.x)[k]) + p.band;
+            bmin[k] = max((int)floor((tlo - origin[k]) / brickSize), 0);
+            bmax[k] = min((int)floor((thi - origin[k]) / brickSize), dims[k] - 1);
+        }
+        for (int z = bmin[2]; z <= bmax[2]; z++)
+            for (int y = bmin[1]; y <= bmax[1]; y++)
+                for (int x = bmin[0]; x <= bmax[0]; x++)
+                    fn(((size_t)z * dims[1] + y) * dims[0] + x);
+    };
+    vector<uint32_t> start(total + 1, 0);
+    for (size_t t = 0; t < triCount; t++) forEachBrick(tris[t], [&](size_t b) { start[b + 1]++; });
+    for (size_t b = 0; b < total; b++) start[b + 1] += start[b];
+    vector<uint32_t> brickTris(start[total]);
+    vector<uint32_t> cursor(start.begin(), start.end() - 1);
+    for (size_t t = 0; t < triCount; t++) forEachBrick(tris[t], [&](size_t b) { brickTris[cursor[b]++] = (uint32_t)t; });
+
+    // Brick có tam giác ở gần thì nằm trong dải, được cấp chỗ trong pool
+    brickIndex.assign(total, FAR_OUTSIDE);
+    vector<uint32_t> bandBricks;
+    for (size_t b = 0; b < total; b++) {
+        if (start[b + 1] > start[b]) {
+            brickIndex[b] = (int32_t)bandBricks.size();
+            bandBricks.push_back((uint32_t)b);
+        }
+    }
+    pool.assign(bandBricks.size() * NODES3, p.band);
+
+    // Mỗi nút: khoảng cách tới tam giác gần nhất, dấu theo normal của tam giác đó.
+    // Nhiều tam giác cùng gần nhất (nút gần cạnh/đỉnh chung) thì chọn tam giác có
+    // normal thẳng hàng nhất với hướng từ bề mặt tới nút.
+    auto bakeBrick = [&](size_t slot) {
+        uint32_t b = bandBricks[slot];
+        int bx = (int)(b % dims[0]), by = (int)(b / dims[0] % dims[1]), bz = (int)(b / ((size_t)dims[0] * dims[1]));
+        float* out = pool.data() + slot * NODES3;
+        for (int k = 0; k < NODES; k++) {
+            for (int j = 0; j < NODES; j++) {
+                for (int i = 0; i < NODES; i++) {
+                    Vec3 q = vec3(origin[0] + (bx * BRICK + i) * p.voxelSize,
+                                  origin[1] + (by * BRICK + j) * p.voxelSize,
+                                  origin[2] + (bz * BRICK + k) * p.voxelSize);
+                    float best = 1e30f, bestAlign = 0.0f, bestSide = 1.0f;
+                    for (uint32_t c = start[b]; c < start[b + 1]; c++) {
+                        const SdfTriangle &t = tris[brickTris[c]];
+                        Vec3 d = q - closestOnTriangle(q, t.a, t.b, t.c);
+                        float dist2 = dot(d, d);
+                        float side = dot(d, t.n);
+                        float dist = sqrtf(dist2);
+                        float align = dist > 0.0f ? fabsf(side) / dist : 1.0f;
+                        bool tie = fabsf(dist - best) <= 1e-5f + best * 1e-4f;
+                        if ((tie && align > bestAlign) || (!tie && dist < best)) {
+                            best = min(best, dist);
+                            bestAlign = align;
+                            bestSide = side;
+                        }
+                    }
+                    float v = min(best, p.band);
+                    out[(k * NODES + j) * NODES + i] = bestSide < 0.0f ? -v : v;
+                }
+            }
+        }
+    };
+    int threadCount = max(1, min((int)thread::hardware_concurrency(), (int)bandBricks.size()));
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t s = next++; s < bandBricks.size(); s = next++) bakeBrick(s);
+    };
+    vector<thread> workers;
+    for (int t = 1; t < threadCount; t++) workers.emplace_back(worker);
+    worker();
+    for (thread &t : workers) t.join();
+
+    // Brick xa: loang từ biên miền qua các brick trống là bên ngoài, còn lại bị
+    // dải bề mặt bao kín là bên trong
+    vector<uint32_t> queue;
+    vector<char> visited(total, 0);
+    for (size_t b = 0; b < total; b++) {
+        int x = (int)(b % dims[0]), y = (int)(b / dims[0] % dims[1]), z = (int)(b / ((size_t)dims[0] * dims[1]));
+        bool border = x == 0 || y == 0 || z == 0 || x == dims[0] - 1 || y == dims[1] - 1 || z == dims[2] - 1;
+        if (border && brickIndex[b] < 0) { visited[b] = 1; queue.push_back((uint32_t)b); }
+    }
+    const int step[3] = {1, dims[0], dims[0] * dims[1]};
+    for (size_t q = 0; q < queue.size(); q++) {
+        uint32_t b = queue[q];
+        int coord[3] = {(int)(b % dims[0]), (int)(b / dims[0] % dims[1]), (int)(b / ((size_t)dims[0] * dims[1]))};
+        for (int k = 0; k < 3; k++) {
+            for (int s = -1; s <= 1; s += 2) {
+                int c = coord[k] + s;
+                if (c < 0 || c >= dims[k]) continue;
+                uint32_t nb = b + s * step[k];
+                if (visited[nb] || brickIndex[nb] >= 0) continue;
+                visited[nb] = 1;
+                queue.push_back(nb);
+            }
+        }
+    }
+    for (size_t b = 0; b < total; b++)
+        if (brickIndex[b] < 0 && !visited[b]) brickIndex[b] = FAR_INSIDE;
+}
+
+// ---------------------------------------------------------------------------
+// Truy vấn
+
+bool SparseSdf::locate(float x, float y, float z, const float* &corner, float t[3], float &farDist) const {
+    float f[3] = {(x - origin[0]) * invVoxel, (y - origin[1]) * invVoxel, (z - origin[2]) * invVoxel};
+    int brick[3], local[3];
+    for (int k = 0; k < 3; k++) {
+        // Ngoài miền (hoặc NaN) coi như ở xa bên ngoài
+        if (!(f[k] >= 0.0f && f[k] < (float)(dims[k] * BRICK))) { farDist = params.band; return false; }
+        int i = (int)f[k];
+        brick[k] = i / BRICK;
+        local[k] = i - brick[k] * BRICK;
+        t[k] = f[k] - i;
+    }
+    int32_t idx = brickIndex[((size_t)brick[2] * dims[1] + brick[1]) * dims[0] + brick[0]];
+    if (idx < 0) {
+        farDist = idx == FAR_INSIDE ? -params.band : params.band;
+        return false;
+    }
+    corner = pool.data() + (size_t)idx * NODES3 + (local[2] * NODES + local[1]) * NODES + local[0];
+    return true;
+}
+
+void SparseSdf::bounds(float bmin[3], float bmax[3]) const {
+    for (int k = 0; k < 3; k++) {
+        bmin[k] = origin[k];
+        bmax[k] = origin[k] + dims[k] * BRICK * params.voxelSize;
+    }
+}
+
+float SparseSdf::sample(float x, float y, float z, float grad[3]) const {
+    grad[0] = grad[1] = grad[2] = 0.0f;
+    if (brickIndex.empty()) return params.band;
+    const float* c;
+    float t[3], far;
+    if (!locate(x, y, z, c, t, far)) return far;
+
+    const int sy = NODES, sz = NODES * NODES;
+    float c000 = c[0], c100 = c[1], c010 = c[sy], c110 = c[sy + 1];
+    float c001 = c[sz], c101 = c[sz + 1], c011 = c[sz + sy], c111 = c[sz + sy + 1];
+    float c00 = c000 + (c100 - c000) * t[0], c10 = c010 + (c110 - c010) * t[0];
+    float c01 = c001 + (c101 - c001) * t[0], c11 = c011 + (c111 - c011) * t[0];
+    float c0 = c00 + (c10 - c00) * t[1], c1 = c01 + (c11 - c01) * t[1];
+    float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * t[1];
+    float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * t[1];
+    grad[0] = (dx0 + (dx1 - dx0) * t[2]) * invVoxel;
+    grad[1] = ((c10 - c00) + ((c11 - c01) - (c10 - c00)) * t[2]) * invVoxel;
+    grad[2] = (c1 - c0) * invVoxel;
+    return c0 + (c1 - c0) * t[2];
+}
+
+void SparseSdf::sampleBatch(const float* x, const float* y, const float* z, size_t n,
+                            float* dist, float* gx, float* gy, float* gz) const {
+#if defined(VMATH_SSE)
+    if (brickIndex.empty()) {
+        for (size_t i = 0; i < n; i++) { dist[i] = params.band; gx[i] = gy[i] = gz[i] = 0.0f; }
+        return;
+    }
+    const int sy = NODES, sz = NODES * NODES;
+    const int offset[8] = {0, 1, sy, sy + 1, sz, sz + 1, sz + sy, sz + sy + 1};
+    __m128 scale = _mm_set1_ps(invVoxel);
+    for (size_t i = 0; i < n; i += 4) {
+        size_t lanes = min(n - i, (size_t)4);
+        // Gom 8 nút góc của 4 điểm thành 8 thanh ghi, điểm ở brick xa thì cả
+        // 8 góc bằng khoảng cách mặc định (gradient = 0)
+        alignas(16) float corner[8][4];
+        alignas(16) float t[3][4];
+        for (size_t l = 0; l < 4; l++) {
+            size_t src = i + min(l, lanes - 1);
+            const float* c;
+            float tl[3], far;
+            if (locate(x[src], y[src], z[src], c, tl, far)) {
+                for (int k = 0; k < 8; k++) corner[k][l] = c[offset[k]];
+            } else {
+                for (int k = 0; k < 8; k++) corner[k][l] = far;
+                tl[0] = tl[1] = tl[2] = 0.0f;
+            }
+            t[0][l] = tl[0]; t[1][l] = tl[1]; t[2][l] = tl[2];
+        }
+        __m128 tx = _mm_load_ps(t[0]), ty = _mm_load_ps(t[1]), tz = _mm_load_ps(t[2]);
+        __m128 c000 = _mm_load_ps(corner[0]), c100 = _mm_load_ps(corner[1]);
+        __m128 c010 = _mm_load_ps(corner[2]), c110 = _mm_load_ps(corner[3]);
+        __m128 c001 = _mm_load_ps(corner[4]), c101 = _mm_load_ps(corner[5]);
+        __m128 c011 = _mm_load_ps(corner[6]), c111 = _mm_load_ps(corner[7]);
+
+        __m128 e00 = _mm_sub_ps(c100, c000), e10 = _mm_sub_ps(c110, c010);
+        __m128 e01 = _mm_sub_ps(c101, c001), e11 = _mm_sub_ps(c111, c011);
+        __m128 c00 = _mm_add_ps(c000, _mm_mul_ps(e00, tx)), c10 = _mm_add_ps(c010, _mm_mul_ps(e10, tx));
+        __m128 c01 = _mm_add_ps(c001, _mm_mul_ps(e01, tx)), c11 = _mm_add_ps(c011, _mm_mul_ps(e11, tx));
+        __m128 fy0 = _mm_sub_ps(c10, c00), fy1 = _mm_sub_ps(c11, c01);
+        __m128 c0 = _mm_add_ps(c00, _mm_mul_ps(fy0, ty)), c1 = _mm_add_ps(c01, _mm_mul_ps(fy1, ty));
+        __m128 dx0 = _mm_add_ps(e00, _mm_mul_ps(_mm_sub_ps(e10, e00), ty));
+        __m128 dx1 = _mm_add_ps(e01, _mm_mul_ps(_mm_sub_ps(e11, e01), ty));
+        __m128 dz = _mm_sub_ps(c1, c0);
+
+        alignas(16) float out[4][4];
+        _mm_store_ps(out[0], _mm_add_ps(c0, _mm_mul_ps(dz, tz)));
+        _mm_store_ps(out[1], _mm_mul_ps(_mm_add_ps(dx0, _mm_mul_ps(_mm_sub_ps(dx1, dx0), tz)), scale));
+        _mm_store_ps(out[2], _mm_mul_ps(_mm_add_ps(fy0, _mm_mul_ps(_mm_sub_ps(fy1, fy0), tz)), scale));
+        _mm_store_ps(out[3], _mm_mul_ps(dz, scale));
+        for (size_t l = 0; l < lanes; l++) {
+            dist[i + l] = out[0][l];
+            gx[i + l] = out[1][l];
+            gy[i + l] = out[2][l];
+            gz[i + l] = out[3][l];
+        }
+    }
+#else
+    for (size_t i = 0; i < n; i++) {
+        float g[3];
+        dist[i] = sample(x[i], y[i], z[i], g);
+        gx[i] = g[0]; gy[i] = g[1]; gz[i] = g[2];
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Cache
+
+bool SparseSdf::load(const string &path, uint64_t meshHash, const SdfParams &p) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    SdfCacheHeader h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1
+           && memcmp(h.magic, "VSDF", 4) == 0
+           && h.version == SDF_CACHE_VERSION
+           && h.key == cacheKey(meshHash, p)
+           && h.dims[0] > 0 && h.dims[1] > 0 && h.dims[2] > 0;
+    if (ok) {
+        size_t total = (size_t)h.dims[0] * h.dims[1] * h.dims[2];
+        brickIndex.resize(total);
+        pool.resize((size_t)h.brickCount * NODES3);
+        ok = fread(brickIndex.data(), sizeof(int32_t), total, f) == total
+          && fread(pool.data(), sizeof(float), pool.size(), f) == pool.size();
+        for (size_t b = 0; ok && b < total; b++)
+            ok = brickIndex[b] >= FAR_INSIDE && brickIndex[b] < (int64_t)h.brickCount;
+    }
+    fclose(f);
+    if (!ok) {
+        cout << "SDF cache cu hoac hong: " << path << endl;
+        brickIndex.clear();
+        pool.clear();
+        return false;
+    }
+    params = p;
+    invVoxel = 1.0f / p.voxelSize;
+    for (int k = 0; k < 3; k++) { origin[k] = h.origin[k]; dims[k] = h.dims[k]; }
+    return true;
+}
+
+// Ghi ra file tạm rồi đổi tên như mesh cache
+bool SparseSdf::save(const string &path, uint64_t meshHash) const {
+    SdfCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "VSDF", 4);
+    h.version = SDF_CACHE_VERSION;
+    h.key = cacheKey(meshHash, params);
+    for (int k = 0; k < 3; k++) { h.origin[k] = origin[k]; h.dims[k] = dims[k]; }
+    h.voxelSize = params.voxelSize;
+    h.band = params.band;
+    h.brickCount = brickCount();
+
+    string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        cerr << "Khong ghi duoc SDF cache: " << tmp << endl;
+        return false;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+           && fwrite(brickIndex.data(), sizeof(int32_t), brickIndex.size(), f) == brickIndex.size()
+           && fwrite(pool.data(), sizeof(float), pool.size(), f) == pool.size();
+    ok = (fclose(f) == 0) && ok;
+    if (ok) {
+#ifdef _WIN32
+        remove(path.c_str());
+#endif
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(tmp.c_str());
+        cerr << "Khong ghi duoc SDF cache: " << path << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef SDF_H
+#define SDF_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Trường khoảng cách có dấu (SDF) thưa của một lưới tam giác rời, dùng cho va
+// chạm của hạt với những chỗ lưới độ cao không biểu diễn được (thành miệng núi).
+// - Không gian chia thành brick BRICK^3 ô; chỉ brick nằm trong dải band quanh
+//   bề mặt mới lưu khoảng cách (BRICK+1)^3 nút, kể cả nút biên chung với brick
+//   bên cạnh, nên một lần nội suy tam tuyến tính chỉ đọc trong một brick.
+// - Brick ở xa bề mặt chỉ lưu dấu (trong/ngoài, tìm bằng loang từ biên miền),
+//   khoảng cách coi như ±band và gradient = 0.
+// - Dấu trong dải lấy theo normal của tam giác gần nhất: lưới phải có các tam
+//   giác quay mặt trước (thứ tự đỉnh ngược chiều kim đồng hồ) ra phía ngoài vật rắn.
+// Âm = bên trong vật rắn.
+
+struct SdfParams {
+    float voxelSize = 0.04f;
+    float band = 0.16f;       // lớn hơn quãng đường một hạt đi được trong một bước
+};
+
+class SparseSdf {
+public:
+    static const int BRICK = 8;
+
+    // positions: vertexCount đỉnh (bội của 3), mỗi 3 đỉnh là một tam giác
+    void bake(const float* positions, size_t vertexCount, const SdfParams &params = SdfParams());
+    // Cache nhị phân, khóa bằng hash lưới + tham số SDF; load trả về false nếu
+    // file không có hoặc đã cũ
+    bool load(const std::string &path, uint64_t meshHash, const SdfParams &params = SdfParams());
+    bool save(const std::string &path, uint64_t meshHash) const;
+    bool empty() const { return brickIndex.empty(); }
+
+    float sample(float x, float y, float z, float grad[3]) const;
+    // Khoảng cách + gradient (theo đơn vị thế giới, chưa chuẩn hóa) cho n điểm,
+    // mỗi lần 4 điểm bằng SSE
+    void sampleBatch(const float* x, const float* y, const float* z, size_t n,
+                     float* dist, float* gx, float* gy, float* gz) const;
+
+    size_t brickCount() const { return pool.size() / NODES3; }
+    // Hộp chứa mọi brick (ngoài hộp sample() trả về +band, gradient 0)
+    void bounds(float bmin[3], float bmax[3]) const;
+    float band() const { return params.band; }
+
+private:
+    static const int NODES = BRICK + 1;
+    static const int NODES3 = NODES * NODES * NODES;
+    enum : int32_t { FAR_OUTSIDE = -1, FAR_INSIDE = -2 };
+
+    SdfParams params;
+    float origin[3] = {0, 0, 0};
+    int dims[3] = {0, 0, 0};          // số brick mỗi trục
+    float invVoxel = 1.0f;
+    std::vector<int32_t> brickIndex;  // >= 0: vị trí brick trong pool, < 0: FAR_*
+    std::vector<float> pool;
+
+    // Tìm brick + 8 nút góc cho một điểm; trả về false nếu ở brick xa (khi đó
+    // farDist là khoảng cách mặc định)
+    bool locate(float x, float y, float z, const float* &corner, float t[3], float &farDist) const;
+};
+
+#endif
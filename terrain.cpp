@@ -0,0 +1,399 @@
+
+#include "terrain.h"
+#include "noise.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+Terrain::~Terrain() {
+    shutdown();
+}
+
+void Terrain::init(const TerrainParams &p) {
+    if (initialized) shutdown();
+    params = p;
+
+    // Mọi tile dùng chung một index buffer vì cùng topo lưới
+    int n = params.tileResolution + 1;
+    vector<uint16_t> indices;
+    indices.reserve(params.tileResolution * params.tileResolution * 6);
+    for (int z = 0; z < params.tileResolution; z++) {
+        for (int x = 0; x < params.tileResolution; x++) {
+            uint16_t i0 = z * n + x, i1 = i0 + 1, i2 = i0 + n, i3 = i2 + 1;
+            indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+        }
+    }
+    indexCount = (int)indices.size();
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    quit = false;
+    int threadCount = max(1, (int)thread::hardware_concurrency() - 1);
+    for (int i = 0; i < threadCount; i++) workers.emplace_back(&Terrain::workerLoop, this);
+
+    initialized = true;
+    cout << "Terrain initialized (" << threadCount << " worker threads)" << endl;
+}
+
+void Terrain::shutdown() {
+    if (!initialized) return;
+    {
+        lock_guard<mutex> lock(mtx);
+        quit = true;
+        jobs.clear();
+    }
+    cv.notify_all();
+    for (auto &w : workers) w.join();
+    workers.clear();
+    results.clear();
+    pending.clear();
+    edits.clear();
+
+    for (auto &kv : tiles) freeTile(kv.second);
+    tiles.clear();
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    indexBuffer = 0;
+    initialized = false;
+}
+
+// ---------------------------------------------------------------------------
+// Hàm độ cao: simplex fBm có domain warping, liền mạch giữa các tile vì chỉ
+// phụ thuộc tọa độ thế giới
+
+static NoiseParams terrainNoise(const TerrainParams &p) {
+    NoiseParams n;
+    n.seed = p.seed;
+    n.octaves = 5;
+    n.frequency = p.frequency;
+    n.warpStrength = p.warpStrength;
+    n.warpFrequency = p.frequency * 0.5f;
+    return n;
+}
+
+// Mặt nạ: vùng phẳng quanh núi lửa -> nhấp nhô dần ra xa
+static float heightMask(const TerrainParams &p, float x, float z) {
+    float dist = sqrtf(x * x + z * z);
+    float t = (dist - p.flatRadius) / max(p.blendRadius - p.flatRadius, 1e-3f);
+    t = min(max(t, 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+float Terrain::heightAt(float x, float z) const {
+    float mask = heightMask(params, x, z);
+    if (mask <= 0.0f) return -0.01f;
+    return -0.01f + mask * params.amplitude * (fbm2(x, z, terrainNoise(params)) + 1.0f);
+}
+
+void Terrain::heightBatch(const float* x, const float* z, float* out, size_t count) const {
+    fbm2Batch(x, z, out, count, terrainNoise(params));
+    for (size_t i = 0; i < count; i++) {
+        float mask = heightMask(params, x[i], z[i]);
+        out[i] = mask <= 0.0f ? -0.01f : -0.01f + mask * params.amplitude * (out[i] + 1.0f);
+    }
+}
+
+void Terrain::generateTile(int tx, int tz, vector<float> &heights, vector<float> &out) const {
+    int res = params.tileResolution;
+    int n = res + 1;
+    float cell = params.tileSize / res;
+    float x0 = tx * params.tileSize, z0 = tz * params.tileSize;
+
+    // Lưới độ cao có thêm viền 1 ô để tính normal bằng sai phân trung tâm,
+    // nhiễu của cả lưới tính trong một lần gọi
+    int g = n + 2;
+    vector<float> px(g * g), pz(g * g);
+    heights.resize(g * g);
+    for (int z = 0; z < g; z++) {
+        for (int x = 0; x < g; x++) {
+            px[z * g + x] = x0 + (x - 1) * cell;
+            pz[z * g + x] = z0 + (z - 1) * cell;
+        }
+    }
+    heightBatch(px.data(), pz.data(), heights.data(), heights.size());
+
+    out.resize(n * n * 6);
+    buildVertices(tx, tz, heights, out, 0, 0, n - 1, n - 1);
+}
+
+// Đỉnh (vị trí + normal) cho vùng đỉnh [vx0..vx1] x [vz0..vz1] của tile
+void Terrain::buildVertices(int tx, int tz, const vector<float> &h, vector<float> &out,
+                            int vx0, int vz0, int vx1, int vz1) const {
+    int res = params.tileResolution;
+    int n = res + 1;
+    int g = n + 2;
+    float cell = params.tileSize / res;
+    float x0 = tx * params.tileSize, z0 = tz * params.tileSize;
+
+    for (int z = vz0; z <= vz1; z++) {
+        for (int x = vx0; x <= vx1; x++) {
+            int gi = (z + 1) * g + (x + 1);
+            float nx = h[gi - 1] - h[gi + 1];
+            float nz = h[gi - g] - h[gi + g];
+            float ny = 2.0f * cell;
+            float len = sqrtf(nx * nx + ny * ny + nz * nz);
+
+            float* v = &out[(z * n + x) * 6];
+            v[0] = x0 + x * cell;
+            v[1] = h[gi];
+            v[2] = z0 + z * cell;
+            v[3] = nx / len;
+            v[4] = ny / len;
+            v[5] = nz / len;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Biến dạng: độ lệch độ cao lưu theo tile (cả viền) và giữ lại khi tile bị
+// giải phóng. Tile đang trên GPU chỉ tính lại vùng đỉnh bị ảnh hưởng.
+
+void Terrain::deform(float x, float z, float radius, float amount) {
+    if (!initialized || radius <= 0.0f) return;
+    int res = params.tileResolution;
+    int n = res + 1;
+    int g = n + 2;
+    float cell = params.tileSize / res;
+    float r2 = radius * radius;
+
+    // Lưới của tile có viền 1 ô nên tile kề cũng phải cập nhật viền
+    int tx0 = (int)floorf((x - radius - cell) / params.tileSize);
+    int tx1 = (int)floorf((x + radius + cell) / params.tileSize);
+    int tz0 = (int)floorf((z - radius - cell) / params.tileSize);
+    int tz1 = (int)floorf((z + radius + cell) / params.tileSize);
+    for (int tz = tz0; tz <= tz1; tz++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            float ox = tx * params.tileSize - cell, oz = tz * params.tileSize - cell;
+            int gx0 = max((int)ceilf((x - radius - ox) / cell), 0);
+            int gx1 = min((int)floorf((x + radius - ox) / cell), g - 1);
+            int gz0 = max((int)ceilf((z - radius - oz) / cell), 0);
+            int gz1 = min((int)floorf((z + radius - oz) / cell), g - 1);
+            if (gx0 > gx1 || gz0 > gz1) continue;
+
+            int64_t k = key(tx, tz);
+            vector<float> &offset = edits[k];
+            if (offset.empty()) offset.assign(g * g, 0.0f);
+            auto it = tiles.find(k);
+            GpuTile* t = it != tiles.end() ? &it->second : nullptr;
+
+            for (int gz = gz0; gz <= gz1; gz++) {
+                for (int gx = gx0; gx <= gx1; gx++) {
+                    float dx = ox + gx * cell - x, dz = oz + gz * cell - z;
+                    float d2 = dx * dx + dz * dz;
+                    if (d2 >= r2) continue;
+                    float w = 1.0f - d2 / r2;
+                    float delta = amount * w * w;
+                    offset[gz * g + gx] += delta;
+                    if (t) t->heights[gz * g + gx] += delta;
+                }
+            }
+
+            // Đỉnh gx-1 của tile, nới thêm 1 vì normal dùng độ cao lân cận
+            if (t) {
+                int vx0 = max(gx0 - 2, 0), vx1 = min(gx1, n - 1);
+                int vz0 = max(gz0 - 2, 0), vz1 = min(gz1, n - 1);
+                if (vx0 > vx1 || vz0 > vz1) continue;
+                if (!t->dirty) {
+                    t->dirtyX0 = vx0; t->dirtyX1 = vx1;
+                    t->dirtyZ0 = vz0; t->dirtyZ1 = vz1;
+                } else {
+                    t->dirtyX0 = min(t->dirtyX0, vx0); t->dirtyX1 = max(t->dirtyX1, vx1);
+                    t->dirtyZ0 = min(t->dirtyZ0, vz0); t->dirtyZ1 = max(t->dirtyZ1, vz1);
+                }
+                t->dirty = true;
+            }
+        }
+    }
+}
+
+// Tính lại vùng bẩn và chỉ upload các hàng đỉnh trong vùng đó
+void Terrain::flushDirty(int tx, int tz, GpuTile &t) {
+    int n = params.tileResolution + 1;
+    buildVertices(tx, tz, t.heights, t.data, t.dirtyX0, t.dirtyZ0, t.dirtyX1, t.dirtyZ1);
+    glBindBuffer(GL_ARRAY_BUFFER, t.vbo);
+    size_t rowBytes = (size_t)(t.dirtyX1 - t.dirtyX0 + 1) * 6 * sizeof(float);
+    for (int z = t.dirtyZ0; z <= t.dirtyZ1; z++) {
+        size_t first = (size_t)(z * n + t.dirtyX0) * 6;
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(float), rowBytes, &t.data[first]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    t.dirty = false;
+}
+
+// ---------------------------------------------------------------------------
+// Worker
+
+void Terrain::workerLoop() {
+    vector<float> heights, data;
+    while (true) {
+        pair<int, int> job;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (quit) return;
+            job = jobs.front();
+            jobs.pop_front();
+            busyWorkers++;
+        }
+
+        generateTile(job.first, job.second, heights, data);
+
+        {
+            lock_guard<mutex> lock(mtx);
+            results.push_back({job.first, job.second, heights, data});
+            busyWorkers--;
+        }
+        doneCv.notify_all();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Thread chính
+
+bool Terrain::inRange(int tx, int tz, int margin) const {
+    int r = params.viewRadius + margin;
+    return abs(tx - centerX) <= r && abs(tz - centerZ) <= r;
+}
+
+void Terrain::uploadTile(TileResult &r) {
+    // Tile đã từng bị biến dạng: cộng độ lệch đã lưu rồi dựng lại đỉnh
+    auto e = edits.find(key(r.tx, r.tz));
+    if (e != edits.end()) {
+        int n = params.tileResolution + 1;
+        for (size_t i = 0; i < r.heights.size(); i++) r.heights[i] += e->second[i];
+        buildVertices(r.tx, r.tz, r.heights, r.data, 0, 0, n - 1, n - 1);
+    }
+
+    GpuTile t;
+    glGenVertexArrays(1, &t.vao);
+    glGenBuffers(1, &t.vbo);
+    glBindVertexArray(t.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, t.vbo);
+    glBufferData(GL_ARRAY_BUFFER, r.data.size() * sizeof(float), r.data.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBindVertexArray(0);
+
+    t.lastUsed = frame;
+    t.heights = move(r.heights);
+    t.data = move(r.data);
+    tiles[key(r.tx, r.tz)] = move(t);
+}
+
+void Terrain::freeTile(GpuTile &t) {
+    if (t.vbo) glDeleteBuffers(1, &t.vbo);
+    if (t.vao) glDeleteVertexArrays(1, &t.vao);
+    t.vbo = t.vao = 0;
+}
+
+void Terrain::uploadFinished(int limit) {
+    vector<TileResult> ready;
+    {
+        lock_guard<mutex> lock(mtx);
+        int count = min((int)results.size(), limit);
+        for (int i = 0; i < count; i++) ready.push_back(move(results[i]));
+        results.erase(results.begin(), results.begin() + count);
+    }
+    for (auto &r : ready) {
+        pending.erase(key(r.tx, r.tz));
+        // Camera có thể đã đi xa trong lúc sinh tile
+        if (inRange(r.tx, r.tz, 1)) uploadTile(r);
+    }
+}
+
+void Terrain::update(float camX, float camZ) {
+    if (!initialized) return;
+    frame++;
+    centerX = (int)floorf(camX / params.tileSize);
+    centerZ = (int)floorf(camZ / params.tileSize);
+
+    uploadFinished(params.maxUploadsPerFrame);
+
+    // Giải phóng tile ra ngoài tầm (có lề 1 tile để tránh tải lại liên tục)
+    for (auto it = tiles.begin(); it != tiles.end();) {
+        int tx = (int)(it->first >> 32), tz = (int)(int32_t)(uint32_t)it->first;
+        if (!inRange(tx, tz, 1)) {
+            freeTile(it->second);
+            it = tiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Yêu cầu tile còn thiếu, gần camera trước
+    vector<pair<int, int>> wanted;
+    int r = params.viewRadius;
+    for (int dz = -r; dz <= r; dz++) {
+        for (int dx = -r; dx <= r; dx++) {
+            int tx = centerX + dx, tz = centerZ + dz;
+            int64_t k = key(tx, tz);
+            auto it = tiles.find(k);
+            if (it != tiles.end()) { it->second.lastUsed = frame; continue; }
+            if (pending.count(k)) continue;
+            wanted.push_back({tx, tz});
+        }
+    }
+    sort(wanted.begin(), wanted.end(), [this](const pair<int, int> &a, const pair<int, int> &b) {
+        int da = (a.first - centerX) * (a.first - centerX) + (a.second - centerZ) * (a.second - centerZ);
+        int db = (b.first - centerX) * (b.first - centerX) + (b.second - centerZ) * (b.second - centerZ);
+        return da < db;
+    });
+
+    {
+        lock_guard<mutex> lock(mtx);
+        // Bỏ các job chưa chạy mà đã ra ngoài tầm
+        for (auto it = jobs.begin(); it != jobs.end();) {
+            if (!inRange(it->first, it->second, 1)) {
+                pending.erase(key(it->first, it->second));
+                it = jobs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto &w : wanted) {
+            jobs.push_back(w);
+            pending.insert(key(w.first, w.second));
+        }
+    }
+    if (!wanted.empty()) cv.notify_all();
+
+    // Giới hạn bộ nhớ GPU: bỏ tile lâu không dùng nhất
+    while ((int)tiles.size() > params.maxResidentTiles) {
+        auto oldest = tiles.begin();
+        for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        freeTile(oldest->second);
+        tiles.erase(oldest);
+    }
+}
+
+void Terrain::finishPending() {
+    if (!initialized) return;
+    while (!pending.empty()) {
+        {
+            unique_lock<mutex> lock(mtx);
+            doneCv.wait(lock, [this] { return !results.empty() || (jobs.empty() && busyWorkers == 0); });
+        }
+        size_t before = pending.size();
+        uploadFinished(1 << 30);
+        if (pending.size() == before) break;  // không còn gì để chờ
+    }
+}
+
+void Terrain::render() {
+    if (!initialized) return;
+    for (auto &kv : tiles) {
+        if (kv.second.dirty) flushDirty((int)(kv.first >> 32), (int)(int32_t)(uint32_t)kv.first, kv.second);
+        glBindVertexArray(kv.second.vao);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void*)0);
+    }
+    glBindVertexArray(0);
+}
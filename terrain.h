@@ -0,0 +1,111 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Địa hình heightfield lớn quanh núi lửa, chia thành các tile vuông.
+// Tile được sinh trên các thread nền khi camera di chuyển, thread chính chỉ
+// upload lên GPU (giới hạn số tile mỗi frame). Số tile trên GPU có giới hạn (LRU),
+// tile ra ngoài tầm nhìn bị giải phóng.
+// Gần núi lửa địa hình phẳng ở y = -0.01 (mặt dung nham cũ), xa dần thì nhấp nhô.
+
+struct TerrainParams {
+    float tileSize = 16.0f;       // cạnh tile (đơn vị thế giới)
+    int tileResolution = 32;      // số ô lưới mỗi cạnh tile
+    int viewRadius = 6;           // bán kính tải tile (tính theo tile)
+    int maxResidentTiles = 256;   // giới hạn LRU tile trên GPU
+    int maxUploadsPerFrame = 8;   // số tile upload tối đa mỗi frame
+    float flatRadius = 5.0f;      // vùng phẳng quanh núi lửa
+    float blendRadius = 15.0f;    // khoảng chuyển từ phẳng sang nhấp nhô
+    float amplitude = 1.5f;
+    float frequency = 0.04f;
+    float warpStrength = 12.0f;   // độ lệch domain warping (đơn vị thế giới)
+    uint32_t seed = 1337;
+};
+
+class Terrain {
+public:
+    ~Terrain();
+
+    void init(const TerrainParams &params = TerrainParams());
+    void shutdown();
+
+    // Yêu cầu các tile quanh camera (tọa độ trong không gian model), upload tile
+    // đã sinh xong và giải phóng tile ngoài tầm
+    void update(float camX, float camZ);
+    // Chờ tới khi mọi tile đang yêu cầu đã được upload (dùng cho render headless)
+    void finishPending();
+    // Vẽ bằng shader đang dùng (aPos location 0, aNormal location 1)
+    void render();
+
+    // Nâng/hạ địa hình quanh (x, z) (tro, dung nham đông...). Chỉ vùng đỉnh
+    // bị ảnh hưởng được tính lại và upload ở lần render() kế tiếp.
+    void deform(float x, float z, float radius, float amount);
+
+    // Độ cao gốc (chưa tính biến dạng)
+    float heightAt(float x, float z) const;
+    // Như heightAt cho cả mảng điểm (nhiễu tính theo lô)
+    void heightBatch(const float* x, const float* z, float* out, size_t count) const;
+
+    int residentTiles() const { return (int)tiles.size(); }
+
+private:
+    struct TileResult {
+        int tx, tz;
+        std::vector<float> heights;  // lưới độ cao (n+2)^2, có viền
+        std::vector<float> data;     // pos3 + normal3 xen kẽ
+    };
+
+    struct GpuTile {
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        uint64_t lastUsed = 0;
+        // Bản CPU để sửa cục bộ
+        std::vector<float> heights;
+        std::vector<float> data;
+        // Vùng đỉnh cần upload lại
+        bool dirty = false;
+        int dirtyX0 = 0, dirtyZ0 = 0, dirtyX1 = 0, dirtyZ1 = 0;
+    };
+
+    TerrainParams params;
+    bool initialized = false;
+
+    unsigned int indexBuffer = 0;
+    int indexCount = 0;
+    std::unordered_map<int64_t, GpuTile> tiles;
+    std::unordered_set<int64_t> pending;  // đã xếp hàng hoặc đang sinh
+    std::unordered_map<int64_t, std::vector<float>> edits;  // độ lệch độ cao theo tile
+    uint64_t frame = 0;
+    int centerX = 0, centerZ = 0;
+
+    // Worker
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::condition_variable doneCv;
+    std::deque<std::pair<int, int>> jobs;
+    std::vector<TileResult> results;
+    int busyWorkers = 0;
+    bool quit = false;
+
+    static int64_t key(int tx, int tz) { return ((int64_t)tx << 32) ^ (uint32_t)tz; }
+    bool inRange(int tx, int tz, int margin) const;
+    void workerLoop();
+    void generateTile(int tx, int tz, std::vector<float> &heights, std::vector<float> &out) const;
+    void buildVertices(int tx, int tz, const std::vector<float> &heights, std::vector<float> &out,
+                       int vx0, int vz0, int vx1, int vz1) const;
+    void flushDirty(int tx, int tz, GpuTile &t);
+    void uploadTile(TileResult &r);
+    void freeTile(GpuTile &t);
+    void uploadFinished(int limit);
+};
+
+#endif
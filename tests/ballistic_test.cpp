@@ -0,0 +1,131 @@
+
+#include "ballistic.h"
+#include "particle_system.h"
+#include "sdf.h"
+#include "test_util.h"
+#include <vector>
+
+using namespace std;
+
+// Hộp [x0, x1] x [0, h] x [z0, z1], tam giác quay mặt trước ra ngoài
+static void boxMesh(float x0, float x1, float h, float z0, float z1, vector<float> &out) {
+    float c[8][3];
+    for (int i = 0; i < 8; i++) {
+        c[i][0] = (i & 1) ? x1 : x0;
+        c[i][1] = (i & 2) ? h : 0.0f;
+        c[i][2] = (i & 4) ? z1 : z0;
+    }
+    // Mỗi mặt 4 góc theo thứ tự ngược chiều kim đồng hồ nhìn từ ngoài
+    const int faces[6][4] = {
+        {0, 4, 6, 2}, {1, 3, 7, 5},  // -x, +x
+        {0, 1, 5, 4}, {2, 6, 7, 3},  // -y, +y
+        {0, 2, 3, 1}, {4, 5, 7, 6},  // -z, +z
+    };
+    for (const auto &f : faces) {
+        const int tri[6] = {f[0], f[1], f[2], f[0], f[2], f[3]};
+        for (int v : tri) out.insert(out.end(), c[v], c[v] + 3);
+    }
+}
+
+static void initSolver(BallisticSolver &solver, const BallisticParams &params = BallisticParams()) {
+    LavaThermalParams thermal;
+    solver.init(thermal, params);
+    solver.groundHeight = [](float, float) { return 0.0f; };
+}
+
+// Hạt bay thẳng vào thành hộp phải nảy lại, không xuyên qua
+static void testSdfBounce() {
+    vector<float> mesh;
+    boxMesh(-1.0f, 1.0f, 3.0f, -1.0f, 1.0f, mesh);
+    SparseSdf sdf;
+    sdf.bake(mesh.data(), mesh.size() / 3);
+
+    const float pos[3] = {-4.0f, 1.5f, 0.0f}, vel[3] = {8.0f, 1.0f, 0.0f};
+    float endX[2];
+    for (int useSdf = 0; useSdf < 2; useSdf++) {
+        BallisticSolver solver;
+        initSolver(solver);
+        solver.collider = useSdf ? &sdf : nullptr;
+        uint32_t id = solver.launch(0.0f, pos, vel, 1150.0f, 0, 16);
+        solver.advanceTo(3.0f);
+
+        float minDist = 1e9f;
+        BallisticState st;
+        for (float t = 0.0f; t <= 3.0f; t += 1.0f / 120.0f) {
+            if (!solver.evaluate(id, t, st)) break;
+            float grad[3];
+            minDist = min(minDist, sdf.sample(st.pos[0], st.pos[1], st.pos[2], grad));
+            endX[useSdf] = st.pos[0];
+        }
+        if (useSdf) CHECK(minDist > -0.05f);  // không vào trong hộp
+        else CHECK(minDist < -0.1f);          // không có SDF thì bay xuyên qua
+    }
+    CHECK(endX[0] > 1.0f);   // rơi xuống phía bên kia hộp
+    CHECK(endX[1] < -1.0f);  // bật lại phía trước hộp
+}
+
+// Hạt rơi lên nóc hộp nằm yên trên nóc (LANDED khi landOnRest)
+static void testSdfRest() {
+    vector<float> mesh;
+    boxMesh(-1.0f, 1.0f, 1.0f, -1.0f, 1.0f, mesh);
+    SparseSdf sdf;
+    sdf.bake(mesh.data(), mesh.size() / 3);
+
+    BallisticParams params;
+    params.landOnRest = true;
+    BallisticSolver solver;
+    initSolver(solver, params);
+    solver.collider = &sdf;
+    const float pos[3] = {0.0f, 3.0f, 0.0f}, vel[3] = {0.1f, 0.0f, 0.0f};
+    solver.launch(0.0f, pos, vel, 1150.0f, 0, 16);
+    vector<BallisticEvent> events;
+    solver.advanceTo(5.0f, &events);
+    CHECK(events.size() == 1);
+    if (events.size() == 1) {
+        CHECK(events[0].type == BallisticEvent::LANDED);
+        CHECK_NEAR(events[0].pos[1], 1.0f, 0.05f);
+    }
+}
+
+// Lịch sử chỉ giữ historySeconds: số hạt không tăng mãi, hạt cũ không còn
+// truy vấn được, hạt mới vẫn đúng
+static void testHistoryWindow() {
+    BallisticParams params;
+    params.historySeconds = 10.0f;
+    BallisticSolver solver;
+    initSolver(solver, params);
+
+    const float pos[3] = {0.0f, 2.0f, 0.0f}, vel[3] = {1.0f, 3.0f, 0.0f};
+    uint32_t first = 0, last = 0;
+    size_t peak = 0;
+    for (int i = 0; i < 2000; i++) {
+        float t = i * 0.1f;
+        solver.advanceTo(t);
+        last = solver.launch(t, pos, vel, 1150.0f, (uint8_t)i, (uint8_t)(i % 64));
+        if (i == 0) first = last;
+        peak = max(peak, solver.particleCount());
+    }
+    float end = 200.0f;
+    solver.advanceTo(end);
+
+    // Mỗi hạt sống vài chục giây (nằm nguội trên đất), 10 hạt/giây
+    CHECK(peak < 1500);
+    CHECK(solver.historyStart() > 100.0f);
+    BallisticState st;
+    CHECK(!solver.evaluate(first, 0.05f, st));
+    CHECK(solver.evaluate(last, end, st));
+    CHECK(st.seed == (uint8_t)1999 && st.sizeLevel == 1999 % 64);
+
+    // aliveAt chỉ trả về id còn giữ, và khớp với evaluate
+    vector<uint32_t> ids;
+    solver.aliveAt(end, ids);
+    CHECK(!ids.empty());
+    for (uint32_t id : ids) CHECK(solver.evaluate(id, end, st));
+}
+
+int main() {
+    testSdfBounce();
+    testSdfRest();
+    testHistoryWindow();
+    return testResult("ballistic_test");
+}
@@ -0,0 +1,211 @@
+
+#include "lava_lights.h"
+#include "test_util.h"
+#include <vector>
+#include <map>
+#include <tuple>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+// build() chỉ chạy trên CPU nên không cần context OpenGL
+
+static mt19937 rng(49);
+
+static float randf(float lo, float hi) {
+    return uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static float brightness(const LavaLights::Light &l) {
+    return l.color.x + l.color.y + l.color.z;
+}
+
+static Mat4 perspectiveCamera() {
+    return multiply(lookAt(vec3(3.0f, 4.0f, 12.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                    perspective(0.9f, 16.0f / 9.0f, 0.01f, 100.0f));
+}
+
+// Gộp theo ô bằng map, cộng các điểm theo đúng thứ tự thêm vào
+static vector<LavaLights::Light> bruteForceMerge(const vector<pair<Vec3, Vec3>> &points, const LavaLightsParams &p) {
+    struct Acc { Vec3 center, color; float weight; int count; };
+    map<tuple<int, int, int>, Acc> cells;
+    for (const auto &pt : points) {
+        auto key = make_tuple((int)floorf(pt.first.x / p.mergeCell), (int)floorf(pt.first.y / p.mergeCell),
+                              (int)floorf(pt.first.z / p.mergeCell));
+        auto it = cells.find(key);
+        if (it == cells.end()) it = cells.insert({key, Acc{vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f, 0}}).first;
+        float w = pt.second.x + pt.second.y + pt.second.z;
+        it->second.center = it->second.center + pt.first * w;
+        it->second.color = it->second.color + pt.second;
+        it->second.weight += w;
+        it->second.count++;
+    }
+    vector<LavaLights::Light> out;
+    for (const auto &c : cells) {
+        const Acc &a = c.second;
+        if (a.weight < 1e-3f) continue;
+        out.push_back({a.center * (1.0f / a.weight), a.color * p.pointIntensity,
+                       min(p.pointRadius * sqrtf((float)a.count), p.maxRadius)});
+    }
+    return out;
+}
+
+static bool lessPos(const LavaLights::Light &a, const LavaLights::Light &b) {
+    if (a.pos.x != b.pos.x) return a.pos.x < b.pos.x;
+    if (a.pos.y != b.pos.y) return a.pos.y < b.pos.y;
+    return a.pos.z < b.pos.z;
+}
+
+static bool sameLight(const LavaLights::Light &a, const LavaLights::Light &b) {
+    const float eps = 1e-4f;
+    return fabsf(a.pos.x - b.pos.x) < eps && fabsf(a.pos.y - b.pos.y) < eps && fabsf(a.pos.z - b.pos.z) < eps &&
+           fabsf(a.color.x - b.color.x) < eps && fabsf(a.color.y - b.color.y) < eps &&
+           fabsf(a.color.z - b.color.z) < eps && fabsf(a.radius - b.radius) < eps;
+}
+
+static void fillPoints(LavaLights &lights, vector<pair<Vec3, Vec3>> &points, int count) {
+    points.clear();
+    for (int i = 0; i < count; i++) {
+        Vec3 pos = vec3(randf(-6.0f, 6.0f), randf(-1.0f, 3.0f), randf(-6.0f, 6.0f));
+        // Một phần là dung nham đã nguội (không sáng)
+        Vec3 color = i % 5 == 0 ? vec3(0.0f, 0.0f, 0.0f) : vec3(randf(0.2f, 1.0f), randf(0.0f, 0.5f), randf(0.0f, 0.1f));
+        points.push_back({pos, color});
+        lights.addPoint(pos, color);
+    }
+}
+
+static void testMerge() {
+    LavaLights lights;
+    lights.params.maxLights = 1 << 20;  // không cắt bớt, xem testMaxLights
+    vector<pair<Vec3, Vec3>> points;
+    fillPoints(lights, points, 3000);
+    lights.addLight(vec3(0.0f, 2.0f, 0.0f), 3.0f, vec3(1.0f, 0.4f, 0.1f));
+    lights.addLight(vec3(1.0f, 0.0f, 0.0f), 1.0f, vec3(0.5f, 0.2f, 0.0f));
+    lights.build(perspectiveCamera(), true, 0.01f, 100.0f, 1600, 900);
+
+    const vector<LavaLights::Light> &got = lights.lightList();
+    vector<LavaLights::Light> expected = bruteForceMerge(points, lights.params);
+    CHECK(got.size() == expected.size() + 2);
+    if (got.size() != expected.size() + 2) return;
+
+    // Đèn riêng giữ nguyên, đứng trước, theo thứ tự thêm vào
+    CHECK(got[0].pos.x == 0.0f && got[0].radius == 3.0f);
+    CHECK(got[1].pos.x == 1.0f && got[1].radius == 1.0f);
+
+    vector<LavaLights::Light> merged(got.begin() + 2, got.end());
+    sort(merged.begin(), merged.end(), lessPos);
+    sort(expected.begin(), expected.end(), lessPos);
+    int mismatches = 0;
+    for (size_t i = 0; i < merged.size(); i++) mismatches += sameLight(merged[i], expected[i]) ? 0 : 1;
+    CHECK(mismatches == 0);
+}
+
+// Quá maxLights: giữ đúng các đèn gộp sáng nhất, đèn riêng không bị bỏ
+static void testMaxLights() {
+    LavaLights lights;
+    lights.params.maxLights = 12;
+    vector<pair<Vec3, Vec3>> points;
+    fillPoints(lights, points, 3000);
+    lights.addLight(vec3(0.0f, 2.0f, 0.0f), 3.0f, vec3(0.01f, 0.0f, 0.0f));
+    lights.addLight(vec3(1.0f, 0.0f, 0.0f), 1.0f, vec3(0.01f, 0.0f, 0.0f));
+    lights.build(perspectiveCamera(), true, 0.01f, 100.0f, 1600, 900);
+
+    const vector<LavaLights::Light> &got = lights.lightList();
+    CHECK(got.size() == 12);
+    if (got.size() != 12) return;
+    CHECK(got[0].radius == 3.0f && got[1].radius == 1.0f);
+
+    vector<LavaLights::Light> expected = bruteForceMerge(points, lights.params);
+    sort(expected.begin(), expected.end(),
+         [](const LavaLights::Light &a, const LavaLights::Light &b) { return brightness(a) > brightness(b); });
+    float dimmestKept = 1e30f;
+    for (size_t i = 2; i < got.size(); i++) dimmestKept = min(dimmestKept, brightness(got[i]));
+    CHECK_NEAR(dimmestKept, brightness(expected[9]), 1e-4f);
+}
+
+// Cụm của một điểm, giống fragment shader trong main.cpp. Trả về -1 nếu điểm
+// nằm ngoài frustum
+static int clusterOf(const Mat4 &transform, bool persp, float zNear, float zFar, float sliceNear, Vec3 p) {
+    Vec4 clip = transformPoint(transform, p);
+    if (clip.w <= 0.0f) return -1;
+    float x = clip.x / clip.w, y = clip.y / clip.w, z = clip.z / clip.w;
+    if (fabsf(x) > 1.0f || fabsf(y) > 1.0f || fabsf(z) > 1.0f) return -1;
+    const int nx = LavaLights::CLUSTER_X, ny = LavaLights::CLUSTER_Y, nz = LavaLights::CLUSTER_Z;
+    int tx = min(max((int)((x * 0.5f + 0.5f) * nx), 0), nx - 1);
+    int ty = min(max((int)((y * 0.5f + 0.5f) * ny), 0), ny - 1);
+    float depth = persp ? clip.w : zNear + (z * 0.5f + 0.5f) * (zFar - zNear);
+    float logScale = (nz - 1) / logf(zFar / sliceNear);
+    int slice = depth <= sliceNear ? 0 : min(nz - 1, 1 + (int)(logf(depth / sliceNear) * logScale));
+    return (slice * ny + ty) * nx + tx;
+}
+
+// Mọi điểm trong bán kính của đèn (và trong frustum) phải thấy đèn đó trong
+// danh sách cụm của mình; bảng (offset, số đèn) khớp với mảng chỉ số
+static void checkClusters(const Mat4 &transform, bool persp, float zNear, float zFar) {
+    LavaLights lights;
+    for (int i = 0; i < 200; i++) {
+        lights.addLight(vec3(randf(-15.0f, 15.0f), randf(-2.0f, 6.0f), randf(-30.0f, 14.0f)), randf(0.2f, 3.0f),
+                        vec3(1.0f, 0.5f, 0.1f));
+    }
+    lights.build(transform, persp, zNear, zFar, 1600, 900);
+
+    const vector<LavaLights::Light> &list = lights.lightList();
+    const vector<uint32_t> &table = lights.clusterTable();
+    const vector<uint32_t> &indices = lights.lightIndices();
+    const int total = LavaLights::CLUSTER_X * LavaLights::CLUSTER_Y * LavaLights::CLUSTER_Z;
+    CHECK((int)table.size() == total * 2);
+    uint32_t next = 0;
+    bool contiguous = true;
+    for (int c = 0; c < total; c++) {
+        contiguous = contiguous && table[c * 2] == next;
+        next += table[c * 2 + 1];
+    }
+    CHECK(contiguous);
+    CHECK(next == indices.size());
+
+    int missing = 0, tested = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        const LavaLights::Light &l = list[i];
+        for (int n = 0; n < 200; n++) {
+            Vec3 d = vec3(randf(-1.0f, 1.0f), randf(-1.0f, 1.0f), randf(-1.0f, 1.0f));
+            if (d.x * d.x + d.y * d.y + d.z * d.z > 1.0f) continue;
+            int c = clusterOf(transform, persp, zNear, zFar, lights.params.sliceNear, l.pos + d * l.radius);
+            if (c < 0) continue;
+            tested++;
+            const uint32_t* begin = indices.data() + table[c * 2];
+            const uint32_t* end = begin + table[c * 2 + 1];
+            if (find(begin, end, (uint32_t)i) == end) missing++;
+        }
+    }
+    printf("  %s: %d points tested, %zu assignments\n", persp ? "perspective" : "ortho", tested, indices.size());
+    CHECK(tested > 1000);
+    CHECK(missing == 0);
+    // Gán bảo thủ nhưng không phải mọi đèn vào mọi cụm
+    CHECK(indices.size() < list.size() * (size_t)total / 20);
+}
+
+static void testClusters() {
+    checkClusters(perspectiveCamera(), true, 0.01f, 100.0f);
+    Mat4 orthoCamera = multiply(lookAt(vec3(3.0f, 4.0f, 12.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                                ortho(-12.0f, 12.0f, -6.75f, 6.75f, 0.01f, 100.0f));
+    checkClusters(orthoCamera, false, 0.01f, 100.0f);
+}
+
+// Đèn sau lưng camera hoặc quá xa không được gán vào cụm nào
+static void testOutside() {
+    LavaLights lights;
+    lights.addLight(vec3(6.0f, 8.0f, 40.0f), 2.0f, vec3(1.0f, 0.5f, 0.1f));  // sau camera
+    lights.addLight(vec3(-60.0f, 0.0f, -120.0f), 2.0f, vec3(1.0f, 0.5f, 0.1f));  // sau mặt phẳng xa
+    lights.build(perspectiveCamera(), true, 0.01f, 100.0f, 1600, 900);
+    CHECK(lights.lightCount() == 2);
+    CHECK(lights.assignmentCount() == 0);
+}
+
+int main() {
+    testMerge();
+    testMaxLights();
+    testClusters();
+    testOutside();
+    return testResult("lava_lights_test");
+}
@@ -0,0 +1,174 @@
+
+#include "lowres_pass.h"
+#include "offscreen.h"
+#include "test_util.h"
+#include <GL/glew.h>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+// Cảnh 64x16: bức tường gần (độ sâu 0.3) ở cột x < EDGE, có khe hở rộng 2 pixel
+// ở cột SLIT, phía sau là nền xa (độ sâu 1.0). Một "hạt" phủ kín màn hình ở độ
+// sâu 0.5 vẽ qua LowResPass: phải hiện đủ ở phía nền và trong khe, không lem
+// sang tường kể cả ở sát mép
+static const int W = 64, H = 16, EDGE = 30, SLIT = 12;
+static const float WALL[3] = {0.2f, 0.2f, 0.8f};
+static const float BACKGROUND[3] = {0.0f, 0.6f, 0.2f};
+static const float SMOKE[3] = {0.8f, 0.4f, 0.0f};
+static const float SMOKE_ALPHA = 0.5f;
+
+static const char* smokeVertexSrc = R"(
+#version 330 core
+void main() {
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* smokeFragmentSrc = R"(
+#version 330 core
+uniform vec4 uColor;
+out vec4 FragColor;
+void main() { FragColor = uColor; }
+)";
+
+static GLuint smokeProgram() {
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER), fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(vs, 1, &smokeVertexSrc, nullptr);
+    glShaderSource(fs, 1, &smokeFragmentSrc, nullptr);
+    glCompileShader(vs);
+    glCompileShader(fs);
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    CHECK(ok);
+    return prog;
+}
+
+static bool isFar(int x) {
+    return x >= EDGE || (x >= SLIT && x < SLIT + 2);
+}
+
+static void drawScene() {
+    glViewport(0, 0, W, H);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, EDGE, H);
+    glClearColor(WALL[0], WALL[1], WALL[2], 1.0f);
+    glClearDepth(0.3);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(BACKGROUND[0], BACKGROUND[1], BACKGROUND[2], 1.0f);
+    glClearDepth(1.0);
+    glScissor(EDGE, 0, W - EDGE, H);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glScissor(SLIT, 0, 2, H);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.1f, 0.2f, 0.3f, 0.4f);  // begin()/end() phải trả lại giá trị này
+}
+
+// Giống ParticleSystem::setupBlend() khi vẽ vào FBO nhỏ
+static void drawSmoke(GLuint prog, GLuint vao) {
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(prog);
+    glUniform4f(glGetUniformLocation(prog, "uColor"), SMOKE[0], SMOKE[1], SMOKE[2], SMOKE_ALPHA);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+}
+
+static int toByte(float v) {
+    return (int)(v * 255.0f + 0.5f);
+}
+
+static void checkFactor(int factor, GLuint prog, GLuint vao) {
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, W, H));
+    drawScene();
+
+    LowResPass pass;
+    pass.factor = factor;
+    CHECK(pass.begin(W, H, false, 0.1f, 10.0f));
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    CHECK(viewport[2] == W / factor && viewport[3] == H / factor);
+    drawSmoke(prog, vao);
+    pass.end();
+
+    GLint fbo = 0;
+    GLfloat clear[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+    CHECK(fbo == (GLint)target.fbo);
+    CHECK(viewport[0] == 0 && viewport[1] == 0 && viewport[2] == W && viewport[3] == H);
+    CHECK(clear[0] == 0.1f && clear[3] == 0.4f);
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    vector<unsigned char> pixels;
+    readOffscreenPixels(target, pixels);
+    int badWall = 0, badSmoke = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const unsigned char* p = &pixels[((size_t)y * W + x) * 4];
+            for (int k = 0; k < 3; k++) {
+                if (!isFar(x)) {
+                    badWall += abs(p[k] - toByte(WALL[k])) > 2 ? 1 : 0;
+                } else {
+                    float expected = BACKGROUND[k] * (1.0f - SMOKE_ALPHA) + SMOKE[k] * SMOKE_ALPHA;
+                    badSmoke += abs(p[k] - toByte(expected)) > 2 ? 1 : 0;
+                }
+            }
+        }
+    }
+    const unsigned char* edge = &pixels[(size_t)(H / 2 * W + EDGE - 1) * 4];
+    printf("  factor %d: wall pixel next to the edge = (%d, %d, %d)\n", factor, edge[0], edge[1], edge[2]);
+    CHECK(badWall == 0);
+    CHECK(badSmoke == 0);
+
+    pass.shutdown();
+    destroyOffscreenTarget(target);
+}
+
+// Đủ độ phân giải thì không làm gì
+static void testFullResolution() {
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, W, H));
+    LowResPass pass;
+    CHECK(!pass.begin(W, H, true, 0.1f, 10.0f));
+    GLint fbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    CHECK(fbo == (GLint)target.fbo);
+    destroyOffscreenTarget(target);
+}
+
+int main() {
+    if (!createOffscreenContext(64, 64)) {
+        printf("lowres_pass_test: no OpenGL 3.3 context, skipped\n");
+        return TEST_SKIPPED;
+    }
+    GLuint prog = smokeProgram();
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+
+    testFullResolution();
+    // factor 2: mép trùng ranh giới khối, pixel sát mép phía tường cần bilateral
+    // để không lấy màu hạt của texel bên cạnh. factor 4: khối 12..15 và 28..31
+    // lẫn cả tường và nền, phải lấy độ sâu xa nhất thì hạt mới hiện trong khe
+    checkFactor(2, prog, vao);
+    checkFactor(4, prog, vao);
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(prog);
+    destroyOffscreenContext();
+    return testResult("lowres_pass_test");
+}
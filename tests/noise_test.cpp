@@ -0,0 +1,85 @@
+#include "noise.h"
+#include "test_util.h"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Hàm *Batch (SSE2 trên x86) phải cho kết quả giống hệt từng bit bản vô hướng,
+// kể cả dấu của số 0, để địa hình/bề mặt núi không đổi theo cách gọi
+
+static bool sameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Điểm ngẫu nhiên (cả âm, cả xa gốc) và các điểm dễ lệch: tọa độ nguyên,
+// x = y = z (hòa khi chọn simplex), sát biên ô lưới. Số điểm lẻ để có phần dư
+static void makePoints(vector<float> &x, vector<float> &y, vector<float> &z) {
+    uint32_t state = 12345u;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / 16777216.0f;
+    };
+    for (int i = 0; i < 4001; i++) {
+        float scale = i % 7 == 0 ? 900.0f : 8.0f;
+        x.push_back((next() * 2.0f - 1.0f) * scale);
+        y.push_back((next() * 2.0f - 1.0f) * scale);
+        z.push_back((next() * 2.0f - 1.0f) * scale);
+    }
+    for (int i = -6; i <= 6; i++) {
+        float v = i * 0.5f;
+        const float pts[6][3] = {
+            {v, v, v}, {v, v, -v}, {(float)i, 0.0f, 0.0f}, {v, 0.0f, v}, {v + 1e-6f, v, v - 1e-6f}, {0.0f, v, v},
+        };
+        for (const auto &p : pts) { x.push_back(p[0]); y.push_back(p[1]); z.push_back(p[2]); }
+    }
+    x.push_back(0.0f); y.push_back(0.0f); z.push_back(0.0f);
+}
+
+static void testSimplex(const vector<float> &x, const vector<float> &y, const vector<float> &z) {
+    size_t n = x.size();
+    vector<float> out(n);
+    for (uint32_t seed : {0u, 7u, 0xDEADBEEFu}) {
+        simplex2Batch(x.data(), y.data(), out.data(), n, seed);
+        int bad2 = 0;
+        for (size_t k = 0; k < n; k++) bad2 += sameBits(out[k], simplex2(x[k], y[k], seed)) ? 0 : 1;
+        simplex3Batch(x.data(), y.data(), z.data(), out.data(), n, seed);
+        int bad3 = 0;
+        for (size_t k = 0; k < n; k++) bad3 += sameBits(out[k], simplex3(x[k], y[k], z[k], seed)) ? 0 : 1;
+        if (bad2 || bad3) printf("  seed %u: %d / %d of %zu points differ (2D / 3D)\n", seed, bad2, bad3, n);
+        CHECK(bad2 == 0);
+        CHECK(bad3 == 0);
+    }
+}
+
+static void testFbm(const vector<float> &x, const vector<float> &y, const vector<float> &z) {
+    size_t n = x.size();
+    vector<float> out(n);
+    NoiseParams plain;
+    plain.seed = 3;
+    plain.octaves = 4;
+    plain.frequency = 0.7f;
+    NoiseParams warped = plain;
+    warped.warpStrength = 0.4f;
+    warped.warpFrequency = 0.3f;
+    for (const NoiseParams &p : {plain, warped}) {
+        fbm2Batch(x.data(), y.data(), out.data(), n, p);
+        int bad2 = 0;
+        for (size_t k = 0; k < n; k++) bad2 += sameBits(out[k], fbm2(x[k], y[k], p)) ? 0 : 1;
+        fbm3Batch(x.data(), y.data(), z.data(), out.data(), n, p);
+        int bad3 = 0;
+        for (size_t k = 0; k < n; k++) bad3 += sameBits(out[k], fbm3(x[k], y[k], z[k], p)) ? 0 : 1;
+        if (bad2 || bad3) printf("  fbm warp %.1f: %d / %d points differ (2D / 3D)\n", p.warpStrength, bad2, bad3);
+        CHECK(bad2 == 0);
+        CHECK(bad3 == 0);
+    }
+}
+
+int main() {
+    vector<float> x, y, z;
+    makePoints(x, y, z);
+    testSimplex(x, y, z);
+    testFbm(x, y, z);
+    return testResult("noise_test");
+}
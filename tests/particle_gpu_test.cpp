@@ -0,0 +1,293 @@
+
+#include "particle_system.h"
+#include "offscreen.h"
+#include "sdf.h"
+#include "test_util.h"
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+// Hai backend phun bằng cùng code (cùng seed), nhưng GPU lấy mẫu mặt đất/SDF
+// qua texture và sinh khói mặt đất chậm một bước nên chỉ so được về mặt thống
+// kê: số hạt, hộp bao, số hạt chạm đất/đông cứng sau cùng một thời gian
+
+static const int FRAMES = 360;
+static const float DT = 1.0f / 60.0f;
+
+struct RunResult {
+    ParticleStats stats;
+    size_t landings = 0;
+    size_t solidified = 0;
+    size_t glow = 0;
+};
+
+struct RunOptions {
+    bool collectLandings = false;
+    float viewDistance = 0.0f;  // > SMOKE_LOD_DISTANCE: khói chia nhóm cập nhật
+};
+
+static void run(bool gpu, const function<float(float, float)> &ground, const SparseSdf* sdf, RunResult &out,
+                const RunOptions &opt = RunOptions()) {
+    ParticleSystem ps;
+    ps.setSeed(7);
+    ps.init();
+    ps.useGpu = gpu;
+    ps.groundHeight = ground;
+    ps.collider = sdf;
+    ps.collectLandings = opt.collectLandings;
+    ps.viewDistance = opt.viewDistance;
+    for (int f = 0; f < FRAMES; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+    ps.stats(out.stats);
+    out.landings = ps.landings.size();
+    out.solidified = ps.solidified.size();
+    vector<LavaGlow> glow;
+    ps.collectGlow(glow);
+    out.glow = glow.size();
+    ps.shutdown();
+}
+
+static void print(const char* name, const ParticleStats &s) {
+    printf("  %s: lava %d [%.2f %.2f %.2f]..[%.2f %.2f %.2f], smoke %d [%.2f %.2f %.2f]..[%.2f %.2f %.2f]\n", name,
+           s.lava, s.lavaMin[0], s.lavaMin[1], s.lavaMin[2], s.lavaMax[0], s.lavaMax[1], s.lavaMax[2],
+           s.smoke, s.smokeMin[0], s.smokeMin[1], s.smokeMin[2], s.smokeMax[0], s.smokeMax[1], s.smokeMax[2]);
+}
+
+static bool within(float value, float reference, float tolerance) {
+    return fabsf(value - reference) <= tolerance * reference;
+}
+
+static void compare(const RunResult &cpuRun, const RunResult &gpuRun) {
+    const ParticleStats &cpu = cpuRun.stats, &gpu = gpuRun.stats;
+    print("CPU", cpu);
+    print("GPU", gpu);
+    printf("  landings %zu / %zu, solidified %zu / %zu, glow %zu / %zu\n", cpuRun.landings, gpuRun.landings,
+           cpuRun.solidified, gpuRun.solidified, cpuRun.glow, gpuRun.glow);
+    CHECK(cpu.lava > 0 && gpu.lava > 0);
+    CHECK(within((float)gpu.lava, (float)cpu.lava, 0.15f));
+    CHECK(within((float)gpu.smoke, (float)cpu.smoke, 0.15f));
+    CHECK(within((float)gpuRun.landings, (float)cpuRun.landings, 0.15f));
+    CHECK(within((float)gpuRun.solidified, (float)cpuRun.solidified, 0.15f));
+    // Đèn gồm mọi hạt dung nham, cả hạt đang ngủ
+    CHECK(cpuRun.glow == (size_t)cpu.lava);
+    CHECK(gpuRun.glow == (size_t)gpu.lava);
+    // Hạt bay xa/cao nhất là hiếm nên các biên đó lệch được cả mét, riêng
+    // đáy (mặt đất/SDF) phải gần như trùng
+    for (int k = 0; k < 3; k++) {
+        CHECK_NEAR(gpu.lavaMin[k], cpu.lavaMin[k], k == 1 ? 0.25f : 2.0f);
+        CHECK_NEAR(gpu.lavaMax[k], cpu.lavaMax[k], 2.0f);
+    }
+    CHECK_NEAR(gpu.smokeMin[1], cpu.smokeMin[1], 0.5f);
+}
+
+// Mặt đất dốc (không phải y = -0.5): dung nham phía thấp nằm dưới -1.5
+static void testSlopedGround() {
+    auto ground = [](float x, float) { return 0.15f * x - 0.5f; };
+    RunResult cpu, gpu;
+    run(false, ground, nullptr, cpu);
+    run(true, ground, nullptr, gpu);
+    compare(cpu, gpu);
+    CHECK(cpu.stats.lavaMin[1] < -1.5f);
+    CHECK(gpu.stats.lavaMin[1] < -1.5f);
+}
+
+// Hạt nằm yên tan vào dòng chảy (landings) thay vì ngủ; khói ở xa chia 4 nhóm
+static void testLandingsAndSmokeGroups() {
+    auto ground = [](float x, float z) { return 0.05f * x - 0.03f * z - 0.5f; };
+    RunOptions opt;
+    opt.collectLandings = true;
+    opt.viewDistance = 30.0f;
+    RunResult cpu, gpu;
+    run(false, ground, nullptr, cpu, opt);
+    run(true, ground, nullptr, gpu, opt);
+    compare(cpu, gpu);
+    // Dung nham nằm yên tan vào dòng chảy trước khi kịp đông cứng
+    CHECK(gpu.landings > 100);
+}
+
+// Tấm SDF phủ hết vùng rơi, mặt trên y = SLAB_TOP cao hơn mặt đất
+static const float SLAB_TOP = 0.5f;
+
+static void bakeSlab(SparseSdf &sdf) {
+    const float x0 = -16.0f, x1 = 16.0f, y0 = -3.0f, y1 = SLAB_TOP;
+    float c[8][3];
+    for (int i = 0; i < 8; i++) {
+        c[i][0] = (i & 1) ? x1 : x0;
+        c[i][1] = (i & 2) ? y1 : y0;
+        c[i][2] = (i & 4) ? x1 : x0;
+    }
+    // Mặt quay ra ngoài, ngược chiều kim đồng hồ nhìn từ ngoài
+    const int faces[6][4] = {{0, 4, 6, 2}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 2, 3, 1}, {4, 5, 7, 6}};
+    vector<float> mesh;
+    for (const auto &f : faces) {
+        const int tri[6] = {f[0], f[1], f[2], f[0], f[2], f[3]};
+        for (int v : tri) mesh.insert(mesh.end(), c[v], c[v] + 3);
+    }
+    SdfParams params;
+    params.voxelSize = 0.1f;
+    params.band = 0.4f;
+    sdf.bake(mesh.data(), mesh.size() / 3, params);
+}
+
+// Dung nham và khói phải nằm trên tấm
+static void testSdfSlab(const SparseSdf &sdf) {
+    const float y1 = SLAB_TOP;
+    auto ground = [](float, float) { return -1.5f; };
+    RunResult cpu, gpu;
+    run(false, ground, &sdf, cpu);
+    run(true, ground, &sdf, gpu);
+    compare(cpu, gpu);
+    CHECK(cpu.stats.lavaMin[1] > y1 - 0.1f);
+    CHECK(gpu.stats.lavaMin[1] > y1 - 0.1f);
+    CHECK(gpu.stats.smokeMin[1] > y1 - 0.1f);
+}
+
+// Phun mạnh: dung nham bay quá ô lưới mặt đất cơ sở (nửa cạnh 32) mà vẫn chạm
+// đúng mặt đất dốc ở đó
+static void testFarGround() {
+    auto ground = [](float x, float) { return -0.02f * x * x / 8.0f - 0.5f; };
+    auto runFar = [&](bool gpu, ParticleStats &out) {
+        ParticleSystem ps;
+        ps.setSeed(11);
+        ps.init();
+        ps.useGpu = gpu;
+        ps.groundHeight = ground;
+        ps.eruptionPower = 3.0f;
+        ps.baseEmitRate = 60;
+        for (int f = 0; f < FRAMES; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+        ps.stats(out);
+        ps.shutdown();
+    };
+    ParticleStats cpu, gpu;
+    runFar(false, cpu);
+    runFar(true, gpu);
+    print("CPU", cpu);
+    print("GPU", gpu);
+    CHECK(cpu.lavaMax[0] > 40.0f);
+    CHECK(within((float)gpu.lava, (float)cpu.lava, 0.15f));
+    CHECK_NEAR(gpu.lavaMin[1], cpu.lavaMin[1], 0.05f * fabsf(cpu.lavaMin[1]));
+    CHECK_NEAR(gpu.lavaMax[0], cpu.lavaMax[0], 0.1f * cpu.lavaMax[0]);
+}
+
+// Chuyển backend giữa chừng giữ nguyên hạt; tua nhanh và xem lại chạy trên
+// backend GPU như trên CPU
+static void testSwitchAndFastForward() {
+    auto ground = [](float x, float) { return 0.1f * x - 0.5f; };
+    ParticleSystem ps;
+    ps.setSeed(5);
+    ps.init();
+    ps.groundHeight = ground;
+    for (int f = 0; f < 120; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+    ParticleStats onCpu, onGpu, back;
+    ps.stats(onCpu);
+    ps.handleInput(GLFW_KEY_G);
+    ps.update(0.0f, 0.0f, 2.5f, 0.0f);  // khởi tạo GPU, tải hạt lên, không tích phân
+    ps.stats(onGpu);
+    printf("  switch: lava %d -> %d, smoke %d -> %d\n", onCpu.lava, onGpu.lava, onCpu.smoke, onGpu.smoke);
+    CHECK(onGpu.lava == onCpu.lava && onGpu.smoke == onCpu.smoke);
+    for (int k = 0; k < 3; k++) CHECK_NEAR(onGpu.lavaMin[k], onCpu.lavaMin[k], 1e-3f);
+
+    for (int f = 0; f < 60; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+    ps.stats(onGpu);
+    ps.handleInput(GLFW_KEY_G);
+    ps.stats(back);
+    CHECK(back.lava == onGpu.lava && back.smoke == onGpu.smoke);
+    for (int k = 0; k < 3; k++) CHECK_NEAR(back.lavaMax[k], onGpu.lavaMax[k], 1e-3f);
+
+    ps.handleInput(GLFW_KEY_G);
+    ps.collectLandings = true;
+    ps.landings.clear();
+    ps.fastForward(3.0f, 0.0f, 2.5f, 0.0f);
+    ParticleStats ff;
+    ps.stats(ff);
+    printf("  GPU fast forward: %zu landings, lava %d alive\n", ps.landings.size(), ff.lava);
+    CHECK(ps.landings.size() > 100);
+    CHECK(ff.lava > 0);
+    for (int f = 0; f < 10; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+
+    ps.scrubTo(ps.ballistic.time() - 1.0f);
+    CHECK(ps.isScrubbing());
+    ParticleStats scrub;
+    ps.stats(scrub);
+    CHECK(scrub.lava > 0);
+    ps.render();
+    ps.endScrub();
+    ps.render();
+    CHECK(glGetError() == GL_NO_ERROR);
+    ps.shutdown();
+}
+
+// Đếm đối tượng GL đang tồn tại (tên 1..4095) theo từng loại
+static void liveObjects(int count[4]) {
+    for (int k = 0; k < 4; k++) count[k] = 0;
+    for (GLuint id = 1; id < 4096; id++) {
+        count[0] += glIsBuffer(id) ? 1 : 0;
+        count[1] += glIsVertexArray(id) ? 1 : 0;
+        count[2] += glIsTexture(id) ? 1 : 0;
+        // Program đã xóa nhưng driver còn giữ (đang dùng, transform feedback
+        // vừa chạy) vẫn "tồn tại" tới khi được nhả, chỉ đếm program chưa xóa
+        GLint deleted = GL_TRUE;
+        if (glIsProgram(id)) glGetProgramiv(id, GL_DELETE_STATUS, &deleted);
+        count[3] += deleted ? 0 : 1;
+    }
+}
+
+// shutdown() xóa hết những gì 2 backend tạo ra (kể cả texture mặt đất, SDF,
+// gió); phím G về CPU thì bỏ hết phần của GPU
+static void testShutdown(const SparseSdf &sdf) {
+    int before[4], after[4];
+    liveObjects(before);
+    {
+        ParticleSystem ps;
+        ps.setSeed(7);
+        ps.init();
+        ps.collider = &sdf;
+        for (int f = 0; f < 10; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+        ps.render();
+        ps.handleInput(GLFW_KEY_G);
+        for (int f = 0; f < 10; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+        ps.render();
+        ps.handleInput(GLFW_KEY_G);
+        liveObjects(after);
+        // Đã quay về CPU: chỉ còn program/VAO/VBO của đường CPU, quad và gió
+        CHECK(after[3] == before[3] + 1);
+        CHECK(after[1] == before[1] + 1);
+        CHECK(after[2] == before[2] + 1);
+        for (int f = 0; f < 10; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+        ps.handleInput(GLFW_KEY_G);
+        for (int f = 0; f < 10; f++) ps.update(DT, 0.0f, 2.5f, 0.0f);
+        ps.render();
+        ps.shutdown();
+    }
+    liveObjects(after);
+    printf("  after shutdown: %d buffers, %d VAOs, %d textures, %d programs (before %d, %d, %d, %d)\n",
+           after[0], after[1], after[2], after[3], before[0], before[1], before[2], before[3]);
+    for (int k = 0; k < 4; k++) CHECK(after[k] == before[k]);
+    CHECK(glGetError() == GL_NO_ERROR);
+}
+
+int main() {
+    if (!createOffscreenContext(64, 64)) {
+        printf("particle_gpu_test: no OpenGL 3.3 context, skipped\n");
+        return TEST_SKIPPED;
+    }
+    // Surfaceless context không có framebuffer mặc định, draw call (kể cả với
+    // GL_RASTERIZER_DISCARD) cần một FBO hoàn chỉnh
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, 64, 64));
+
+    SparseSdf slab;
+    bakeSlab(slab);
+    testSlopedGround();
+    testLandingsAndSmokeGroups();
+    testSdfSlab(slab);
+    testFarGround();
+    testSwitchAndFastForward();
+    testShutdown(slab);
+
+    destroyOffscreenTarget(target);
+    destroyOffscreenContext();
+    return testResult("particle_gpu_test");
+}
@@ -0,0 +1,116 @@
+
+#include "particle_system.h"
+#include "offscreen.h"
+#include "test_util.h"
+#include "vmath.h"
+#include <GL/glew.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Hạt vẽ bằng quad theo instance: kích thước không bị chặn bởi
+// GL_POINT_SIZE_RANGE và hạt có tâm ngoài màn hình vẫn hiện phần còn lại
+
+static const int SIZE = 1024;
+// sizeMin, sizeMax của dung nham trong PARTICLE_TYPES (particle_system.cpp)
+static const float LAVA_SIZE_MIN = 0.1f, LAVA_SIZE_MAX = 0.3f;
+
+// Số cột có ít nhất một pixel không đen, và cột trái nhất
+static int coveredColumns(const vector<unsigned char> &pixels, int &first) {
+    int count = 0;
+    first = -1;
+    for (int x = 0; x < SIZE; x++) {
+        bool covered = false;
+        for (int y = 0; y < SIZE && !covered; y++) {
+            const unsigned char* p = &pixels[((size_t)y * SIZE + x) * 4];
+            covered = p[0] + p[1] + p[2] > 0;
+        }
+        if (!covered) continue;
+        if (first < 0) first = x;
+        count++;
+    }
+    return count;
+}
+
+static void renderOnce(ParticleSystem &ps, const Mat4 &transform, const OffscreenTarget &target, vector<unsigned char> &pixels) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glViewport(0, 0, SIZE, SIZE);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ps.render(transform.m);
+    readOffscreenPixels(target, pixels);
+}
+
+static void checkBackend(bool gpu, float pointMax) {
+    // Đường kính nhỏ nhất của hạt dung nham lớn hơn giới hạn điểm (nếu khung
+    // ảnh đủ chỗ), lớn nhất gấp 3 (sizeMin..sizeMax) vẫn nằm trong khung
+    float minDiameter = 1.2f * min(pointMax, 270.0f);
+    float maxDiameter = minDiameter * LAVA_SIZE_MAX / LAVA_SIZE_MIN;
+
+    // Backend GPU cập nhật bằng draw call: cần FBO bind sẵn (xem particle_gpu_test)
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, SIZE, SIZE));
+
+    ParticleSystem ps;
+    ps.setSeed(47);
+    ps.init();
+    ps.useGpu = gpu;
+    ps.smokeClusterDistance = 0.0f;
+    ps.globalSizeMul = minDiameter / (LAVA_SIZE_MIN * 50.0f);
+    for (int f = 0; f < 3; f++) ps.update(1.0f / 60.0f, 0.0f, 2.5f, 0.0f);
+
+    Mat4 viewProj = multiply(lookAt(vec3(0.0f, 2.5f, 10.0f), vec3(0.0f, 2.5f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                             perspective(0.9f, 1.0f, 0.1f, 100.0f));
+    vector<unsigned char> pixels;
+
+    renderOnce(ps, viewProj, target, pixels);
+    int first = 0;
+    int width = coveredColumns(pixels, first);
+    ParticleStats st;
+    ps.stats(st);
+    printf("  %s: %d lava sprites cover %d px (diameter %.0f..%.0f, point size max %.0f)\n", gpu ? "GPU" : "CPU",
+           st.lava, width, minDiameter, maxDiameter, pointMax);
+    // Đủ nhiều hạt nên hạt lớn nhất gần sizeMax; tâm các hạt lệch nhau vài chục
+    // pixel sau 3 frame
+    CHECK(st.lava >= 10);
+    CHECK(width >= 0.5f * maxDiameter);
+    CHECK(width <= maxDiameter + 150.0f);
+    if (minDiameter > pointMax) CHECK(width > pointMax);
+
+    // Hệ số kích thước lấy theo lúc phun: đổi globalSizeMul không đổi hạt đang bay
+    float sizeMul = ps.globalSizeMul;
+    ps.globalSizeMul = sizeMul * 0.25f;
+    renderOnce(ps, viewProj, target, pixels);
+    CHECK(coveredColumns(pixels, first) == width);
+    ps.globalSizeMul = sizeMul;
+
+    // Dời cả cảnh sang trái để tâm mọi hạt ra ngoài mép trái 100 pixel (x_clip
+    // += k * w): điểm (GL_POINTS) sẽ bị bỏ hẳn, quad thì phần còn lại vẫn hiện
+    Mat4 shift = Mat4::identity();
+    shift.m[12] = -1.0f - 100.0f * 2.0f / SIZE;
+    renderOnce(ps, multiply(viewProj, shift), target, pixels);
+    int shiftedWidth = coveredColumns(pixels, first);
+    printf("  %s: centres off-screen, %d columns still covered\n", gpu ? "GPU" : "CPU", shiftedWidth);
+    CHECK(shiftedWidth > 0 && first == 0);
+    CHECK(shiftedWidth >= 0.25f * maxDiameter - 100.0f);
+    CHECK(shiftedWidth <= maxDiameter / 2.0f);
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    destroyOffscreenTarget(target);
+}
+
+int main() {
+    if (!createOffscreenContext(64, 64)) {
+        printf("particle_sprite_test: no OpenGL 3.3 context, skipped\n");
+        return TEST_SKIPPED;
+    }
+    GLfloat range[2] = {1.0f, 1.0f};
+    glGetFloatv(GL_POINT_SIZE_RANGE, range);
+
+    checkBackend(false, range[1]);
+    checkBackend(true, range[1]);
+
+    destroyOffscreenContext();
+    return testResult("particle_sprite_test");
+}
@@ -0,0 +1,170 @@
+
+#include "particle_system.h"
+#include "test_util.h"
+#include "vmath.h"
+#include <vector>
+#include <map>
+#include <tuple>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+// Chỉ backend CPU, không cần context OpenGL
+
+static void testGroupsFor() {
+    CHECK(SmokeSchedule::groupsFor(-5.0f) == 1);
+    CHECK(SmokeSchedule::groupsFor(0.0f) == 1);
+    CHECK(SmokeSchedule::groupsFor(7.9f) == 1);
+    CHECK(SmokeSchedule::groupsFor(8.0f) == 2);
+    CHECK(SmokeSchedule::groupsFor(20.0f) == 3);
+    CHECK(SmokeSchedule::groupsFor(1000.0f) == MAX_SMOKE_GROUPS);
+}
+
+// Với dt thay đổi và số nhóm đổi giữa chừng: thời gian đã tích phân của mỗi
+// hạt cộng thời gian còn chờ luôn bằng tổng thời gian, mỗi nhóm được cập nhật
+// đúng một lần mỗi `groups` bước và không chờ quá `groups` bước
+static void testSchedule() {
+    const size_t N = 37;
+    mt19937 rng(44);
+    uniform_real_distribution<float> dtDist(1.0f / 120.0f, 1.0f / 30.0f);
+    SmokeSchedule schedule;
+    vector<double> integrated(N, 0.0);
+    double total = 0.0;
+    auto integrate = [&](int group, int groups, float t) {
+        for (size_t i = group; i < N; i += groups) integrated[i] += t;
+    };
+
+    const int groupPlan[] = {1, 4, 4, 2, 3, 1, 4};
+    int badTime = 0, badLag = 0, badTurn = 0;
+    for (int block = 0; block < 7; block++) {
+        int groups = groupPlan[block];
+        schedule.regroup(groups, integrate);
+        CHECK(schedule.groups == groups);
+        for (size_t i = 0; i < N; i++) badTime += fabs(integrated[i] + schedule.lag(i) - total) > 1e-4 ? 1 : 0;
+
+        vector<int> updates(groups, 0);
+        const int steps = 12 * groups;
+        for (int s = 0; s < steps; s++) {
+            float dt = dtDist(rng);
+            total += dt;
+            float groupDt = dt;
+            int group = schedule.next(groupDt);
+            CHECK(group >= 0 && group < groups);
+            updates[group]++;
+            badTurn += group == s % groups ? 0 : 1;
+            integrate(group, groups, groupDt);
+            for (size_t i = 0; i < N; i++) {
+                badTime += fabs(integrated[i] + schedule.lag(i) - total) > 1e-4 ? 1 : 0;
+                badLag += schedule.lag(i) <= (groups - 1) * (1.0f / 30.0f) + 1e-6f ? 0 : 1;
+            }
+        }
+        for (int g = 0; g < groups; g++) CHECK(updates[g] == 12);
+    }
+    CHECK(badTime == 0);
+    CHECK(badLag == 0);
+    CHECK(badTurn == 0);
+}
+
+static void run(float viewDistance, ParticleStats &out) {
+    ParticleSystem ps;
+    ps.setSeed(44);
+    ps.init();
+    ps.viewDistance = viewDistance;
+    for (int f = 0; f < 300; f++) ps.update(1.0f / 60.0f, 0.0f, 2.5f, 0.0f);
+    ps.stats(out);
+}
+
+// Chia nhóm chỉ làm thưa việc cập nhật khói: dung nham giống hệt, khói gần
+// như cùng số hạt và cùng vùng
+static void testGroupedSmokeMatches() {
+    ParticleStats near, far;
+    run(0.0f, near);
+    run(30.0f, far);
+    printf("  smoke: %d (1 group) vs %d (%d groups)\n", near.smoke, far.smoke, SmokeSchedule::groupsFor(30.0f));
+    CHECK(near.lava == far.lava);
+    for (int k = 0; k < 3; k++) {
+        CHECK(near.lavaMin[k] == far.lavaMin[k]);
+        CHECK(near.lavaMax[k] == far.lavaMax[k]);
+    }
+    CHECK(near.smoke > 0);
+    CHECK(abs(near.smoke - far.smoke) <= near.smoke / 20);
+    for (int k = 0; k < 3; k++) {
+        CHECK_NEAR(far.smokeMin[k], near.smokeMin[k], 1.0f);
+        CHECK_NEAR(far.smokeMax[k], near.smokeMax[k], 1.0f);
+    }
+}
+
+// Khói ở xa gộp theo ô: so với gộp bằng map trên danh sách hạt không gộp
+static void testFarSmokeClusters() {
+    ParticleSystem ps;
+    ps.setSeed(45);
+    ps.init();
+    for (int f = 0; f < 300; f++) ps.update(1.0f / 60.0f, 0.0f, 2.5f, 0.0f);
+    ParticleStats st;
+    ps.stats(st);
+
+    Vec3 eye = vec3(0.0f, 10.0f, 20.0f);
+    Mat4 transform = multiply(lookAt(eye, vec3(0.0f, 8.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                              perspective(0.9f, 1.5f, 0.01f, 100.0f));
+    ps.viewEye = ParticleVec3(eye.x, eye.y, eye.z);
+    ps.viewDistance = sqrtf(7.5f * 7.5f + 20.0f * 20.0f);  // tới miệng núi
+    ps.viewZoom = 1.0f;
+
+    vector<SmokeSprite> raw, sprites;
+    ps.smokeClusterDistance = 0.0f;
+    ps.clusterSmoke(transform.m, 800, raw);
+    CHECK((int)raw.size() == st.smoke);
+    bool anyPuff = false;
+    for (const SmokeSprite &s : raw) anyPuff = anyPuff || s.type == PARTICLE_SMOKE_PUFF;
+    CHECK(!anyPuff);
+
+    ps.smokeClusterDistance = 15.0f;
+    ps.clusterSmoke(transform.m, 800, sprites);
+
+    float cell = ps.smokeClusterCell * ps.viewDistance / ps.smokeClusterDistance;
+    auto key = [&](float x, float y, float z) {
+        return make_tuple((int)floorf(x / cell), (int)floorf(y / cell), (int)floorf(z / cell));
+    };
+    map<tuple<int, int, int>, int> cells;
+    int near = 0;
+    for (const SmokeSprite &s : raw) {
+        float dx = s.x - eye.x, dy = s.y - eye.y, dz = s.z - eye.z;
+        if (dx * dx + dy * dy + dz * dz < 15.0f * 15.0f) near++;
+        else cells[key(s.x, s.y, s.z)]++;
+    }
+    int lone = 0, groups = 0;
+    for (const auto &c : cells) (c.second == 1 ? lone : groups)++;
+
+    int singles = 0, puffs = 0, badPuff = 0;
+    for (const SmokeSprite &s : sprites) {
+        if (s.type != PARTICLE_SMOKE_PUFF) { singles++; continue; }
+        puffs++;
+        // Trọng tâm nằm trong ô của nó, ô đó có từ 2 hạt
+        auto it = cells.find(key(s.x, s.y, s.z));
+        if (it == cells.end() || it->second < 2) badPuff++;
+        if (!(s.age > 0.0f && s.age <= 0.95f) || s.seed > 63) badPuff++;
+    }
+    printf("  far smoke: %zu particles -> %zu sprites (%d near, %d lone, %d puffs from %d cells)\n",
+           raw.size(), sprites.size(), near, lone, puffs, groups);
+    CHECK(near > 0 && groups > 0);
+    CHECK(singles == near + lone);
+    // Cụm mà mọi hạt đã trong suốt hẳn thì bỏ
+    CHECK(puffs <= groups && puffs >= groups * 9 / 10);
+    CHECK(badPuff == 0);
+    CHECK(sprites.size() < raw.size());
+
+    // Phóng to (zoom) thì ngưỡng gộp xa ra theo, không còn cụm nào
+    ps.viewZoom = 10.0f;
+    ps.clusterSmoke(transform.m, 800, sprites);
+    CHECK(sprites.size() == raw.size());
+    for (size_t i = 0; i < sprites.size() && i < raw.size(); i++) CHECK(sprites[i].x == raw[i].x);
+}
+
+int main() {
+    testGroupsFor();
+    testSchedule();
+    testGroupedSmokeMatches();
+    testFarSmokeClusters();
+    return testResult("smoke_test");
+}
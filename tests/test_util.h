@@ -0,0 +1,38 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <cmath>
+#include <cstdio>
+
+// Kiểm tra tối giản cho các bài test: CHECK in ra vị trí sai và đếm lỗi,
+// main() trả về testResult() để ctest biết đạt hay không.
+
+static int g_testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_testFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+    do { \
+        double va_ = (a), vb_ = (b); \
+        if (!(std::fabs(va_ - vb_) <= (eps))) { \
+            std::printf("%s:%d: CHECK_NEAR failed: %s = %g, %s = %g\n", __FILE__, __LINE__, #a, va_, #b, vb_); \
+            g_testFailures++; \
+        } \
+    } while (0)
+
+// ctest coi mã 77 là bỏ qua (SKIP_RETURN_CODE), dùng khi máy không tạo được context GL
+static const int TEST_SKIPPED = 77;
+
+inline int testResult(const char* name) {
+    if (g_testFailures == 0) std::printf("%s: OK\n", name);
+    else std::printf("%s: %d check(s) failed\n", name, g_testFailures);
+    return g_testFailures == 0 ? 0 : 1;
+}
+
+#endif
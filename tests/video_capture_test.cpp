@@ -0,0 +1,173 @@
+
+#include "video_capture.h"
+#include "offscreen.h"
+#include "test_util.h"
+#include <GL/glew.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Frame k: nền một màu theo k, nửa trên (theo ảnh) trắng để kiểm tra chiều dọc
+static void fillColor(int k, unsigned char rgb[3]) {
+    rgb[0] = (unsigned char)(k * 37 % 256);
+    rgb[1] = (unsigned char)(255 - k * 11 % 256);
+    rgb[2] = (unsigned char)(k * 5 % 256);
+}
+
+static void drawFrame(int k, int w, int h) {
+    unsigned char c[3];
+    fillColor(k, c);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, h - h / 2, w, h / 2);  // gốc OpenGL ở dưới: đây là nửa trên ảnh
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+static int lumaOf(const unsigned char c[3]) {
+    return (int)(0.299f * c[0] + 0.587f * c[1] + 0.114f * c[2] + 0.5f);
+}
+
+// Đọc hết luồng Y4M, kiểm tra header, thứ tự frame và nội dung
+static void checkY4M(FILE* f, int w, int h, int frames, chrono::milliseconds delay = chrono::milliseconds(0)) {
+    char header[128];
+    CHECK(fgets(header, sizeof(header), f) != nullptr);
+    char expected[128];
+    snprintf(expected, sizeof(expected), "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", w, h);
+    CHECK(strcmp(header, expected) == 0);
+
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    vector<unsigned char> yuv((size_t)w * h + 2 * (size_t)cw * ch);
+    int got = 0, badLuma = 0, badChroma = 0;
+    char tag[8];
+    while (fread(tag, 1, 6, f) == 6) {
+        if (memcmp(tag, "FRAME\n", 6) != 0) { CHECK(!"FRAME tag"); break; }
+        if (fread(yuv.data(), 1, yuv.size(), f) != yuv.size()) { CHECK(!"frame truncated"); break; }
+        got++;
+        unsigned char c[3];
+        fillColor(got, c);
+        const unsigned char* Y = yuv.data();
+        const unsigned char* U = Y + (size_t)w * h;
+        // Dòng đầu là nửa trắng, dòng cuối là màu nền
+        badLuma += abs(Y[0] - 255) > 1 ? 1 : 0;
+        badLuma += abs(Y[(size_t)(h - 1) * w + w - 1] - lumaOf(c)) > 1 ? 1 : 0;
+        float u = 128.0f - 0.168736f * c[0] - 0.331264f * c[1] + 0.5f * c[2];
+        badChroma += abs(U[0] - 128) > 1 ? 1 : 0;
+        badChroma += fabsf(U[(size_t)(ch - 1) * cw] - u) > 1.5f ? 1 : 0;
+        if (delay.count() > 0) this_thread::sleep_for(delay);
+    }
+    CHECK(got == frames);
+    CHECK(badLuma == 0);
+    CHECK(badChroma == 0);
+}
+
+// Kích thước lẻ: mặt phẳng màu làm tròn lên
+static void testY4MFile() {
+    const int w = 33, h = 17, frames = 12;
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, w, h));
+    const string path = "video_capture_test.y4m";
+    VideoCapture capture;
+    CHECK(capture.start(path, w, h));
+    for (int k = 1; k <= frames; k++) {
+        drawFrame(k, w, h);
+        capture.captureFrame();
+    }
+    capture.stop();
+    destroyOffscreenTarget(target);
+
+    FILE* f = fopen(path.c_str(), "rb");
+    CHECK(f != nullptr);
+    if (!f) return;
+    checkY4M(f, w, h, frames);
+    fclose(f);
+    remove(path.c_str());
+}
+
+static void testPngSequence() {
+    const int w = 16, h = 8, frames = 5;
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, w, h));
+    VideoCapture capture;
+    CHECK(capture.start("video_capture_test", w, h));
+    for (int k = 1; k <= frames; k++) {
+        drawFrame(k, w, h);
+        capture.captureFrame();
+    }
+    capture.stop();
+    destroyOffscreenTarget(target);
+    for (int k = 1; k <= frames + 1; k++) {
+        char name[64];
+        snprintf(name, sizeof(name), "video_capture_test_%05d.png", k);
+        FILE* f = fopen(name, "rb");
+        CHECK((f != nullptr) == (k <= frames));
+        if (!f) continue;
+        unsigned char sig[8];
+        CHECK(fread(sig, 1, 8, f) == 8 && sig[1] == 'P' && sig[2] == 'N' && sig[3] == 'G');
+        fclose(f);
+        remove(name);
+    }
+}
+
+// Encoder ghi vào FIFO mà bên đọc chậm: thread render phải chờ (backpressure),
+// không mất hay đảo frame nào
+static void testBackpressure() {
+#if defined(__linux__)
+    const int w = 320, h = 240, frames = 30;
+    const string path = "video_capture_test_fifo.y4m";
+    remove(path.c_str());
+    if (mkfifo(path.c_str(), 0600) != 0) {
+        printf("  mkfifo failed, backpressure test skipped\n");
+        return;
+    }
+    // Mỗi frame ~115 KB, lớn hơn buffer của pipe nên encoder bị chặn theo bên đọc
+    thread reader([&] {
+        FILE* f = fopen(path.c_str(), "rb");
+        CHECK(f != nullptr);
+        if (!f) return;
+        checkY4M(f, w, h, frames, chrono::milliseconds(15));
+        fclose(f);
+    });
+
+    OffscreenTarget target;
+    CHECK(createOffscreenTarget(target, w, h));
+    VideoCapture capture;
+    CHECK(capture.start(path, w, h));
+    for (int k = 1; k <= frames; k++) {
+        drawFrame(k, w, h);
+        capture.captureFrame();
+    }
+    capture.stop();
+    reader.join();
+    destroyOffscreenTarget(target);
+    unlink(path.c_str());
+    printf("  backpressure: render thread waited %d times\n", capture.encoderWaits());
+    CHECK(capture.encoderWaits() > 0);
+#endif
+}
+
+int main() {
+    if (!createOffscreenContext(64, 64)) {
+        printf("video_capture_test: no OpenGL 3.3 context, skipped\n");
+        return TEST_SKIPPED;
+    }
+    testY4MFile();
+    testPngSequence();
+    testBackpressure();
+    destroyOffscreenContext();
+    return testResult("video_capture_test");
+}
@@ -0,0 +1,249 @@
+
+#include "vmath.h"
+#include "test_util.h"
+#include <vector>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+// Bản sao nguyên văn phần ma trận của main.cpp trước khi chuyển sang vmath.h
+// (commit baseline) làm chuẩn để so
+namespace baseline {
+
+struct Vec3 { float x, y, z; };
+
+Vec3 normalize(Vec3 v) {
+    float len = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
+    if (len > 0.0f) return {v.x / len, v.y / len, v.z / len};
+    return v;
+}
+
+Vec3 cross(Vec3 a, Vec3 b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+float dot(Vec3 a, Vec3 b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+struct Matrix4x4 {
+    float m[16];
+    Matrix4x4() {
+        m[0]=1; m[1]=0; m[2]=0; m[3]=0;
+        m[4]=0; m[5]=1; m[6]=0; m[7]=0;
+        m[8]=0; m[9]=0; m[10]=1; m[11]=0;
+        m[12]=0; m[13]=0; m[14]=0; m[15]=1;
+    }
+};
+
+Matrix4x4 multiply(const Matrix4x4 &a,const Matrix4x4 &b){
+    Matrix4x4 r;
+    for(int i=0;i<4;i++){
+        for(int j=0;j<4;j++){
+            r.m[i*4+j] = a.m[i*4+0]*b.m[0*4+j] + a.m[i*4+1]*b.m[1*4+j]
+                        + a.m[i*4+2]*b.m[2*4+j] + a.m[i*4+3]*b.m[3*4+j];
+        }
+    }
+    return r;
+}
+
+Matrix4x4 rotateXY(float ax,float ay){
+    Matrix4x4 rx, ry;
+    float cx=cosf(ax), sx=sinf(ax);
+    rx.m[5]=cx; rx.m[6]=-sx; rx.m[9]=sx; rx.m[10]=cx;
+    float cy=cosf(ay), sy=sinf(ay);
+    ry.m[0]=cy; ry.m[2]=sy; ry.m[8]=-sy; ry.m[10]=cy;
+    return multiply(ry, rx);
+}
+
+Matrix4x4 ortho(float left, float right, float bottom, float top, float nearVal, float farVal) {
+    Matrix4x4 r;
+    r.m[0] = 2.0f / (right - left);
+    r.m[5] = 2.0f / (top - bottom);
+    r.m[10] = -2.0f / (farVal - nearVal);
+    r.m[12] = -(right + left) / (right - left);
+    r.m[13] = -(top + bottom) / (top - bottom);
+    r.m[14] = -(farVal + nearVal) / (farVal - nearVal);
+    r.m[15] = 1.0f;
+    return r;
+}
+
+Matrix4x4 perspective(float fovy, float aspect, float nearVal, float farVal) {
+    Matrix4x4 r;
+    float f = 1.0f / tanf(fovy / 2.0f);
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (farVal + nearVal) / (nearVal - farVal);
+    r.m[11] = -1.0f;
+    r.m[14] = (2.0f * farVal * nearVal) / (nearVal - farVal);
+    r.m[15] = 0.0f;
+    return r;
+}
+
+Matrix4x4 lookAt(Vec3 eye, Vec3 center, Vec3 up) {
+    Vec3 f = normalize({center.x - eye.x, center.y - eye.y, center.z - eye.z});
+    Vec3 s = normalize(cross(f, up));
+    Vec3 u = cross(s, f);
+    Matrix4x4 r;
+    r.m[0] = s.x; r.m[4] = s.y; r.m[8] = s.z; r.m[12] = -dot(s, eye);
+    r.m[1] = u.x; r.m[5] = u.y; r.m[9] = u.z; r.m[13] = -dot(u, eye);
+    r.m[2] = -f.x; r.m[6] = -f.y; r.m[10] = -f.z; r.m[14] = dot(f, eye);
+    r.m[3] = 0; r.m[7] = 0; r.m[11] = 0; r.m[15] = 1;
+    return r;
+}
+
+} // namespace baseline
+
+static mt19937 rng(1234);
+
+static float randf(float lo, float hi) {
+    return uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static void randomMatrix(Mat4 &a, baseline::Matrix4x4 &b) {
+    for (int i = 0; i < 16; i++) a.m[i] = b.m[i] = randf(-4.0f, 4.0f);
+}
+
+// Sai số tương đối: x86 cho kết quả trùng từng bit, chừa chỗ cho FMA trên ARM
+static bool matches(const Mat4 &a, const baseline::Matrix4x4 &b, float eps = 1e-5f) {
+    for (int i = 0; i < 16; i++) {
+        float tol = eps * fmaxf(1.0f, fabsf(b.m[i]));
+        if (!(fabsf(a.m[i] - b.m[i]) <= tol)) {
+            printf("  m[%d]: %.9g vs baseline %.9g\n", i, a.m[i], b.m[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testMultiply() {
+    for (int n = 0; n < 200; n++) {
+        Mat4 a, b;
+        baseline::Matrix4x4 ra, rb;
+        randomMatrix(a, ra);
+        randomMatrix(b, rb);
+        CHECK(matches(multiply(a, b), baseline::multiply(ra, rb)));
+    }
+}
+
+static void testRotateXY() {
+    for (int n = 0; n < 200; n++) {
+        float ax = randf(-7.0f, 7.0f), ay = randf(-7.0f, 7.0f);
+        CHECK(matches(rotateXY(ax, ay), baseline::rotateXY(ax, ay)));
+    }
+}
+
+static void testProjection() {
+    for (int n = 0; n < 100; n++) {
+        float fovy = randf(0.2f, 2.5f), aspect = randf(0.5f, 3.0f);
+        float zNear = randf(0.01f, 1.0f), zFar = zNear + randf(1.0f, 500.0f);
+        CHECK(matches(perspective(fovy, aspect, zNear, zFar), baseline::perspective(fovy, aspect, zNear, zFar)));
+
+        float l = randf(-10.0f, -0.1f), r = randf(0.1f, 10.0f), b = randf(-10.0f, -0.1f), t = randf(0.1f, 10.0f);
+        CHECK(matches(ortho(l, r, b, t, zNear, zFar), baseline::ortho(l, r, b, t, zNear, zFar)));
+    }
+}
+
+static void testLookAt() {
+    for (int n = 0; n < 200; n++) {
+        float e[3], c[3];
+        for (int k = 0; k < 3; k++) { e[k] = randf(-20.0f, 20.0f); c[k] = randf(-5.0f, 5.0f); }
+        Mat4 m = lookAt(vec3(e[0], e[1], e[2]), vec3(c[0], c[1], c[2]), vec3(0.0f, 1.0f, 0.0f));
+        baseline::Matrix4x4 r = baseline::lookAt({e[0], e[1], e[2]}, {c[0], c[1], c[2]}, {0.0f, 1.0f, 0.0f});
+        CHECK(matches(m, r));
+    }
+}
+
+static bool nearIdentity(const Mat4 &m, float eps) {
+    Mat4 id = Mat4::identity();
+    for (int i = 0; i < 16; i++) {
+        if (!(fabsf(m.m[i] - id.m[i]) <= eps)) {
+            printf("  m[%d] = %.9g\n", i, m.m[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testInverse() {
+    // Ma trận ngẫu nhiên chéo trội (khả nghịch, điều kiện tốt)
+    for (int n = 0; n < 200; n++) {
+        Mat4 a, inv;
+        baseline::Matrix4x4 unused;
+        randomMatrix(a, unused);
+        for (int k = 0; k < 4; k++) a.m[k * 5] += (a.m[k * 5] < 0.0f ? -20.0f : 20.0f);
+        CHECK(inverse(a, inv));
+        CHECK(nearIdentity(multiply(a, inv), 1e-5f));
+        CHECK(nearIdentity(multiply(inv, a), 1e-5f));
+    }
+
+    // Ma trận camera thật: model * view * proj (near 0.01 / far 100 nên điều
+    // kiện kém, sai số float cỡ 1e-4)
+    Mat4 mvp = multiply(multiply(multiply(translate(0.0f, -0.5f, 0.0f), rotateXY(0.3f, 1.1f)),
+                                 lookAt(vec3(0.0f, 4.0f, 12.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f))),
+                        perspective(0.8f, 1.5f, 0.01f, 100.0f));
+    Mat4 inv;
+    CHECK(inverse(mvp, inv));
+    CHECK(nearIdentity(multiply(mvp, inv), 1e-3f));
+
+    // Suy biến: trả về false và giữ nguyên out
+    Mat4 sentinel;
+    for (int i = 0; i < 16; i++) sentinel.m[i] = 42.0f;
+    Mat4 singular[3] = {scale(1.0f, 0.0f, 1.0f), Mat4::identity(), Mat4::identity()};
+    for (int i = 0; i < 16; i++) singular[1].m[i] = 0.0f;
+    for (int k = 0; k < 4; k++) singular[2].m[8 + k] = singular[2].m[k] * 2.0f;  // hàng 2 = 2 * hàng 0
+    for (const Mat4 &s : singular) {
+        Mat4 out = sentinel;
+        CHECK(!inverse(s, out));
+        bool untouched = true;
+        for (int i = 0; i < 16; i++) untouched = untouched && out.m[i] == 42.0f;
+        CHECK(untouched);
+    }
+}
+
+// cullSpheres (4 cầu một lần + phần dư) phải chọn đúng những cầu mà
+// sphereInFrustum chọn, kể cả khi số cầu không chia hết cho 4
+static void testCullSpheres() {
+    Vec4 planes[6];
+    Mat4 viewProj = multiply(lookAt(vec3(3.0f, 4.0f, 12.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                             perspective(0.9f, 1.5f, 0.01f, 100.0f));
+    extractFrustumPlanes(viewProj, planes);
+
+    const size_t counts[] = {0, 1, 2, 3, 5, 6, 7, 9, 13, 1001};
+    for (size_t count : counts) {
+        vector<Vec4> spheres(count);
+        for (Vec4 &s : spheres) s = vec4(randf(-40.0f, 40.0f), randf(-20.0f, 20.0f), randf(-40.0f, 40.0f), randf(0.0f, 3.0f));
+        vector<uint32_t> visible(count + 1, 0xFFFFFFFFu);
+        size_t n = cullSpheres(planes, spheres.data(), visible.data(), count);
+
+        vector<uint32_t> expected;
+        for (size_t i = 0; i < count; i++) {
+            if (sphereInFrustum(planes, vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) expected.push_back((uint32_t)i);
+        }
+        CHECK(n == expected.size());
+        CHECK(equal(expected.begin(), expected.end(), visible.begin()));
+        CHECK(visible[count] == 0xFFFFFFFFu);  // không ghi quá count phần tử
+    }
+
+    // Cầu nằm đúng trên mặt phẳng (khoảng cách = -r) vẫn được giữ ở cả 2 đường
+    Vec4 edge[5];
+    for (int i = 0; i < 5; i++) {
+        const Vec4 &p = planes[i];
+        float r = 0.5f, d = -r - p.w;
+        edge[i] = vec4(p.x * d, p.y * d, p.z * d, r);
+    }
+    uint32_t visible[5];
+    size_t n = cullSpheres(planes, edge, visible, 5);
+    size_t scalar = 0;
+    for (const Vec4 &s : edge) scalar += sphereInFrustum(planes, vec3(s.x, s.y, s.z), s.w) ? 1 : 0;
+    CHECK(n == scalar);
+}
+
+int main() {
+    testMultiply();
+    testRotateXY();
+    testProjection();
+    testLookAt();
+    testInverse();
+    testCullSpheres();
+    return testResult("vmath_test");
+}
@@ -0,0 +1,155 @@
+
+#include "volcano_field.h"
+#include "test_util.h"
+#include <vector>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+// generate() và cull() chỉ chạy trên CPU nên không cần context OpenGL
+
+static const float PI = 3.14159265358979323846f;
+
+static float ground(float x, float z) {
+    return 0.4f * sinf(0.3f * x) * cosf(0.2f * z) - 0.5f;
+}
+
+// Nón đơn giản thay cho lưới núi lửa: đáy bán kính 3 ở y = 0, đỉnh y = 2.5
+static vector<float> coneMesh() {
+    const int segments = 48;
+    vector<float> out;
+    for (int i = 0; i < segments; i++) {
+        float a0 = 2.0f * PI * i / segments, a1 = 2.0f * PI * (i + 1) / segments;
+        const float tri[3][3] = {{3.0f * cosf(a0), 0.0f, 3.0f * sinf(a0)},
+                                 {0.0f, 2.5f, 0.0f},
+                                 {3.0f * cosf(a1), 0.0f, 3.0f * sinf(a1)}};
+        for (const auto &v : tri) out.insert(out.end(), v, v + 3);
+    }
+    return out;
+}
+
+// Giống vertex shader của VolcanoField
+static Vec3 place(const VolcanoField::Instance &in, const float* p) {
+    float c = cosf(in.yaw), s = sinf(in.yaw);
+    float x = p[0] * in.scale, y = p[1] * in.height, z = p[2] * in.scale;
+    return vec3(c * x + s * z + in.x, y + in.y, -s * x + c * z + in.z);
+}
+
+static void testPlacement(const VolcanoField &field, const VolcanoFieldParams &params) {
+    const vector<VolcanoField::Instance> &list = field.instanceList();
+    CHECK((int)list.size() == params.count);
+    int bad = 0;
+    for (const auto &in : list) {
+        float r = sqrtf(in.x * in.x + in.z * in.z);
+        bad += (r < params.innerRadius - 1e-3f || r > params.outerRadius + 1e-3f) ? 1 : 0;
+        bad += (in.scale < params.minScale || in.scale > params.maxScale) ? 1 : 0;
+        bad += (in.height < in.scale * params.minHeight - 1e-5f || in.height > in.scale * params.maxHeight + 1e-5f) ? 1 : 0;
+        bad += fabsf(in.y - (ground(in.x, in.z) - 0.05f * in.scale)) > 1e-5f ? 1 : 0;
+    }
+    CHECK(bad == 0);
+}
+
+// Hình cầu bao chứa mọi đỉnh của instance sau khi biến đổi
+static void testBounds(const VolcanoField &field, const vector<float> &mesh) {
+    const vector<VolcanoField::Instance> &list = field.instanceList();
+    const vector<Vec4> &spheres = field.boundingSpheres();
+    CHECK(spheres.size() == list.size());
+    int outside = 0;
+    for (size_t i = 0; i < list.size() && i < spheres.size(); i++) {
+        const Vec4 &b = spheres[i];
+        for (size_t v = 0; v < mesh.size(); v += 3) {
+            Vec3 p = place(list[i], &mesh[v]);
+            float dx = p.x - b.x, dy = p.y - b.y, dz = p.z - b.z;
+            if (sqrtf(dx * dx + dy * dy + dz * dz) > b.w * (1.0f + 1e-5f)) outside++;
+        }
+    }
+    CHECK(outside == 0);
+}
+
+static bool sameInstance(const VolcanoField::Instance &a, const VolcanoField::Instance &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.yaw == b.yaw && a.scale == b.scale && a.height == b.height;
+}
+
+// Kết quả lọc trùng với sphereInFrustum theo đúng thứ tự, và không bỏ instance
+// nào có đỉnh nằm trong khối nhìn
+static void testCull(VolcanoField &field, const vector<float> &mesh) {
+    mt19937 rng(48);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const vector<VolcanoField::Instance> &list = field.instanceList();
+    const vector<Vec4> &spheres = field.boundingSpheres();
+    for (uint32_t revision = 1; revision <= 6; revision++) {
+        float angle = unit(rng) * 2.0f * PI, dist = 10.0f + 60.0f * unit(rng);
+        Vec3 eye = vec3(dist * cosf(angle), 2.0f + 20.0f * unit(rng), dist * sinf(angle));
+        Vec3 target = vec3(40.0f * unit(rng) - 20.0f, 0.0f, 40.0f * unit(rng) - 20.0f);
+        Mat4 viewProj = multiply(lookAt(eye, target, vec3(0.0f, 1.0f, 0.0f)), perspective(0.9f, 1.5f, 0.01f, 100.0f));
+        Vec4 planes[6];
+        extractFrustumPlanes(viewProj, planes);
+
+        CHECK(field.cull(planes, revision));
+        vector<size_t> expected;
+        for (size_t i = 0; i < spheres.size(); i++) {
+            if (sphereInFrustum(planes, vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) expected.push_back(i);
+        }
+        const vector<VolcanoField::Instance> &visible = field.visibleList();
+        CHECK(visible.size() == expected.size());
+        bool same = visible.size() == expected.size();
+        for (size_t k = 0; same && k < expected.size(); k++) same = sameInstance(visible[k], list[expected[k]]);
+        CHECK(same);
+        CHECK(field.visibleCount() == visible.size());
+
+        size_t e = 0;
+        int missed = 0;
+        for (size_t i = 0; i < list.size(); i++) {
+            bool kept = e < expected.size() && expected[e] == i;
+            if (kept) { e++; continue; }
+            for (size_t v = 0; v < mesh.size(); v += 3) {
+                Vec4 clip = transformPoint(viewProj, place(list[i], &mesh[v]));
+                if (clip.w > 0.0f && fabsf(clip.x) < clip.w && fabsf(clip.y) < clip.w && fabsf(clip.z) < clip.w) {
+                    missed++;
+                    break;
+                }
+            }
+        }
+        CHECK(missed == 0);
+        CHECK(!expected.empty() && expected.size() < list.size());
+    }
+}
+
+// Cùng revision thì dùng lại kết quả cũ dù planes khác; generate() làm mất hiệu lực
+static void testRevisionCache(VolcanoField &field) {
+    Vec4 planes[6];
+    extractFrustumPlanes(multiply(lookAt(vec3(0.0f, 5.0f, 30.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)),
+                                  perspective(0.9f, 1.5f, 0.01f, 100.0f)), planes);
+    Vec4 away[6];
+    extractFrustumPlanes(multiply(lookAt(vec3(0.0f, 500.0f, 0.0f), vec3(0.0f, 1000.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f)),
+                                  perspective(0.9f, 1.5f, 0.01f, 100.0f)), away);
+
+    CHECK(field.cull(planes, 100));
+    size_t n = field.visibleCount();
+    CHECK(n > 0);
+    CHECK(!field.cull(away, 100));
+    CHECK(field.visibleCount() == n);
+    CHECK(field.cull(away, 101));
+    CHECK(field.visibleCount() == 0);
+
+    VolcanoFieldParams params;
+    params.count = 500;
+    field.generate(ground, params);
+    CHECK(field.cull(away, 101));
+}
+
+int main() {
+    vector<float> mesh = coneMesh();
+    VolcanoField field;
+    field.init(mesh.data(), mesh.size() / 3, nullptr);
+    VolcanoFieldParams params;
+    params.count = 3000;
+    field.generate(ground, params);
+
+    testPlacement(field, params);
+    testBounds(field, mesh);
+    testCull(field, mesh);
+    testRevisionCache(field);
+    return testResult("volcano_field_test");
+}
@@ -0,0 +1,216 @@
+
+#include "video_capture.h"
+#include "offscreen.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+VideoCapture::~VideoCapture() {
+    stop();
+}
+
+bool VideoCapture::start(const string &path, int width, int height, int fps) {
+    if (recording) stop();
+
+    outPath = path;
+    frameWidth = width;
+    frameHeight = height;
+    y4m = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+
+    if (y4m) {
+        file = fopen(path.c_str(), "wb");
+        if (!file) {
+            cerr << "Khong mo duoc file: " << path << endl;
+            return false;
+        }
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    size_t frameBytes = (size_t)width * height * 4;
+
+    glGenBuffers(PBO_COUNT, pbos);
+    for (int i = 0; i < PBO_COUNT; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+        pboFrame[i] = -1;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Cấp phát trước toàn bộ bộ nhớ frame - không cấp phát trong lúc ghi
+    framePool.assign(QUEUE_SIZE + 1, Frame());
+    freeFrames.clear();
+    for (auto &f : framePool) {
+        f.pixels.resize(frameBytes);
+        freeFrames.push_back(&f);
+    }
+    queue.clear();
+
+    nextPbo = 0;
+    frameCounter = 0;
+    renderThreadMs = 0.0;
+    maxRenderThreadMs = 0.0;
+    waitedFrames = 0;
+    quit = false;
+    recording = true;
+    encoder = thread(&VideoCapture::encoderLoop, this);
+
+    cout << "Ghi hinh: " << path << " (" << width << "x" << height << ")" << endl;
+    return true;
+}
+
+// Map PBO i, copy sang một frame trống rồi đẩy vào hàng đợi encoder
+void VideoCapture::drainPbo(int i) {
+    if (pboFrame[i] < 0) return;
+
+    Frame* f = nullptr;
+    {
+        unique_lock<mutex> lock(mtx);
+        if (freeFrames.empty()) waitedFrames++;
+        cv.wait(lock, [this] { return !freeFrames.empty(); });
+        f = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+    const void* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, f->pixels.size(), GL_MAP_READ_BIT);
+    if (src) {
+        memcpy(f->pixels.data(), src, f->pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    f->index = pboFrame[i];
+    pboFrame[i] = -1;
+
+    {
+        lock_guard<mutex> lock(mtx);
+        if (src) queue.push_back(f);
+        else freeFrames.push_back(f);
+    }
+    cv.notify_all();
+}
+
+void VideoCapture::captureFrame() {
+    if (!recording) return;
+    auto t0 = chrono::steady_clock::now();
+
+    // PBO sắp được ghi đè đang giữ frame từ PBO_COUNT frame trước - lấy nó ra trước
+    int i = nextPbo;
+    drainPbo(i);
+
+    // Copy framebuffer -> PBO, chạy bất đồng bộ trên GPU
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, frameWidth, frameHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pboFrame[i] = ++frameCounter;
+    nextPbo = (nextPbo + 1) % PBO_COUNT;
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    renderThreadMs += ms;
+    maxRenderThreadMs = max(maxRenderThreadMs, ms);
+}
+
+void VideoCapture::stop() {
+    if (!recording) return;
+
+    // Lấy nốt các frame còn trong PBO theo đúng thứ tự
+    for (int k = 0; k < PBO_COUNT; k++) drainPbo((nextPbo + k) % PBO_COUNT);
+
+    {
+        lock_guard<mutex> lock(mtx);
+        quit = true;
+    }
+    cv.notify_all();
+    encoder.join();
+
+    glDeleteBuffers(PBO_COUNT, pbos);
+    for (int i = 0; i < PBO_COUNT; i++) pbos[i] = 0;
+    if (file) { fclose(file); file = nullptr; }
+    framePool.clear();
+    freeFrames.clear();
+    recording = false;
+
+    cout << "Dung ghi hinh: " << frameCounter << " frame -> " << outPath
+         << ", render thread " << (frameCounter ? renderThreadMs / frameCounter : 0.0)
+         << " ms/frame (max " << maxRenderThreadMs << " ms), cho encoder " << waitedFrames << " lan" << endl;
+}
+
+void VideoCapture::encoderLoop() {
+    vector<unsigned char> scratch;
+    while (true) {
+        Frame* f = nullptr;
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this] { return quit || !queue.empty(); });
+            if (queue.empty()) break;  // quit và đã hết việc
+            f = queue.front();
+            queue.pop_front();
+        }
+
+        if (y4m) writeY4MFrame(*f, scratch);
+        else writePNGFrame(*f, scratch);
+
+        {
+            lock_guard<mutex> lock(mtx);
+            freeFrames.push_back(f);
+        }
+        cv.notify_all();
+    }
+}
+
+// RGBA (dòng dưới cùng trước) -> YUV 4:2:0 full range (BT.601, "C420jpeg")
+void VideoCapture::writeY4MFrame(const Frame &f, vector<unsigned char> &yuv) {
+    int w = frameWidth, h = frameHeight;
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    yuv.resize((size_t)w * h + 2 * (size_t)cw * ch);
+    unsigned char* Y = yuv.data();
+    unsigned char* U = Y + (size_t)w * h;
+    unsigned char* V = U + (size_t)cw * ch;
+
+    auto px = [&](int x, int y) { return &f.pixels[((size_t)(h - 1 - y) * w + x) * 4]; };
+    auto clamp8 = [](float v) { return (unsigned char)min(max(v + 0.5f, 0.0f), 255.0f); };
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const unsigned char* p = px(x, y);
+            Y[(size_t)y * w + x] = clamp8(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
+        }
+    }
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            // Trung bình khối 2x2
+            float r = 0, g = 0, b = 0;
+            int n = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int x = min(cx * 2 + dx, w - 1), y = min(cy * 2 + dy, h - 1);
+                    const unsigned char* p = px(x, y);
+                    r += p[0]; g += p[1]; b += p[2];
+                    n++;
+                }
+            }
+            r /= n; g /= n; b /= n;
+            U[(size_t)cy * cw + cx] = clamp8(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+            V[(size_t)cy * cw + cx] = clamp8(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+        }
+    }
+
+    fputs("FRAME\n", file);
+    fwrite(yuv.data(), 1, yuv.size(), file);
+}
+
+void VideoCapture::writePNGFrame(const Frame &f, vector<unsigned char> &rgba) {
+    // Lật lại dòng trên cùng trước
+    size_t rowBytes = (size_t)frameWidth * 4;
+    rgba.resize(f.pixels.size());
+    for (int y = 0; y < frameHeight; y++) {
+        memcpy(&rgba[y * rowBytes], &f.pixels[(frameHeight - 1 - y) * rowBytes], rowBytes);
+    }
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%05d.png", f.index);
+    writePNG(outPath + suffix, frameWidth, frameHeight, rgba.data());
+}
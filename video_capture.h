@@ -0,0 +1,72 @@
+#ifndef VIDEO_CAPTURE_H
+#define VIDEO_CAPTURE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+
+// Ghi hình bất đồng bộ: glReadPixels vào một vòng PBO, map PBO sau vài frame
+// (khi GPU đã copy xong) rồi chuyển pixel cho thread encoder ghi ra đĩa.
+// Đường dẫn kết thúc bằng ".y4m" -> video Y4M (YUV 4:2:0), ngược lại là tiền tố
+// cho chuỗi ảnh PNG (prefix_00001.png, ...).
+// Hàng đợi có giới hạn: nếu encoder chậm hơn render, thread render sẽ chờ
+// (backpressure) thay vì cấp phát thêm bộ nhớ.
+class VideoCapture {
+public:
+    ~VideoCapture();
+
+    bool start(const std::string &path, int width, int height, int fps = 60);
+    // Gọi sau khi vẽ xong frame, trước khi swap; đọc từ read framebuffer đang bind
+    void captureFrame();
+    void stop();
+
+    bool isRecording() const { return recording; }
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+    // Số lần thread render phải chờ encoder trong lần ghi gần nhất
+    int encoderWaits() const { return waitedFrames; }
+
+private:
+    static const int PBO_COUNT = 3;   // độ trễ map = PBO_COUNT - 1 frame
+    static const int QUEUE_SIZE = 4;  // số frame tối đa chờ encoder
+
+    struct Frame {
+        std::vector<unsigned char> pixels;  // RGBA, dòng dưới cùng trước (như OpenGL)
+        int index = 0;
+    };
+
+    bool recording = false;
+    bool y4m = false;
+    std::string outPath;
+    FILE* file = nullptr;
+    int frameWidth = 0, frameHeight = 0;
+
+    unsigned int pbos[PBO_COUNT] = {0, 0, 0};
+    int pboFrame[PBO_COUNT] = {-1, -1, -1};  // frame đang nằm trong PBO, -1 = trống
+    int nextPbo = 0;
+    int frameCounter = 0;
+
+    // Thống kê chi phí trên thread render
+    double renderThreadMs = 0.0;
+    double maxRenderThreadMs = 0.0;
+    int waitedFrames = 0;  // số lần phải chờ encoder (backpressure)
+
+    std::vector<Frame> framePool;
+    std::vector<Frame*> freeFrames;
+    std::deque<Frame*> queue;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool quit = false;
+    std::thread encoder;
+
+    void drainPbo(int i);
+    void encoderLoop();
+    void writeY4MFrame(const Frame &f, std::vector<unsigned char> &yuv);
+    void writePNGFrame(const Frame &f, std::vector<unsigned char> &rgba);
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef VMATH_H
+#define VMATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Thư viện toán vector/ma trận (chỉ header) dùng chung cho camera, culling, instancing.
+// Quy ước giống code cũ trong main.cpp: vector hàng, ma trận lưu theo hàng
+// (p' = p * M, phần tịnh tiến nằm ở m[12..14]), upload lên GLSL với transpose = GL_FALSE.
+// Ma trận ghép theo thứ tự model * view * proj.
+// Vec3/Vec4/Mat4 căn lề 16 byte để nạp thẳng vào thanh ghi SSE/NEON.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VMATH_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VMATH_NEON 1
+#endif
+
+struct alignas(16) Vec3 {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    float pad = 0.0f;  // để đủ 16 byte, không dùng
+};
+
+struct alignas(16) Vec4 {
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+};
+
+// Không có constructor: khai báo không khởi tạo, dùng Mat4::identity() khi cần
+struct alignas(16) Mat4 {
+    float m[16];
+
+    static constexpr Mat4 identity() {
+        return Mat4{{1, 0, 0, 0,
+                     0, 1, 0, 0,
+                     0, 0, 1, 0,
+                     0, 0, 0, 1}};
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Vector
+
+constexpr Vec3 vec3(float x, float y, float z) { return Vec3{x, y, z, 0.0f}; }
+constexpr Vec4 vec4(float x, float y, float z, float w) { return Vec4{x, y, z, w}; }
+
+constexpr Vec3 operator+(Vec3 a, Vec3 b) { return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+constexpr Vec3 operator-(Vec3 a, Vec3 b) { return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+constexpr Vec3 operator*(Vec3 a, float s) { return vec3(a.x * s, a.y * s, a.z * s); }
+
+constexpr float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+constexpr Vec3 cross(Vec3 a, Vec3 b) {
+    return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline Vec3 normalize(Vec3 v) {
+    float len = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (len > 0.0f) return vec3(v.x / len, v.y / len, v.z / len);
+    return v;
+}
+
+// ---------------------------------------------------------------------------
+// Ma trận cơ bản
+
+constexpr Mat4 translate(float tx, float ty, float tz) {
+    return Mat4{{1, 0, 0, 0,
+                 0, 1, 0, 0,
+                 0, 0, 1, 0,
+                 tx, ty, tz, 1}};
+}
+
+constexpr Mat4 scale(float sx, float sy, float sz) {
+    return Mat4{{sx, 0, 0, 0,
+                 0, sy, 0, 0,
+                 0, 0, sz, 0,
+                 0, 0, 0, 1}};
+}
+
+constexpr Mat4 transpose(const Mat4 &a) {
+    return Mat4{{a.m[0], a.m[4], a.m[8],  a.m[12],
+                 a.m[1], a.m[5], a.m[9],  a.m[13],
+                 a.m[2], a.m[6], a.m[10], a.m[14],
+                 a.m[3], a.m[7], a.m[11], a.m[15]}};
+}
+
+// r = a * b. Thứ tự cộng giống bản vô hướng nên kết quả trùng từng bit.
+inline Mat4 multiply(const Mat4 &a, const Mat4 &b) {
+    Mat4 r;
+#if defined(VMATH_SSE)
+    __m128 b0 = _mm_load_ps(b.m), b1 = _mm_load_ps(b.m + 4);
+    __m128 b2 = _mm_load_ps(b.m + 8), b3 = _mm_load_ps(b.m + 12);
+    for (int i = 0; i < 4; i++) {
+        const float* row = a.m + i * 4;
+        __m128 v = _mm_mul_ps(_mm_set1_ps(row[0]), b0);
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(row[1]), b1));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(row[2]), b2));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(row[3]), b3));
+        _mm_store_ps(r.m + i * 4, v);
+    }
+#elif defined(VMATH_NEON)
+    float32x4_t b0 = vld1q_f32(b.m), b1 = vld1q_f32(b.m + 4);
+    float32x4_t b2 = vld1q_f32(b.m + 8), b3 = vld1q_f32(b.m + 12);
+    for (int i = 0; i < 4; i++) {
+        const float* row = a.m + i * 4;
+        float32x4_t v = vmulq_n_f32(b0, row[0]);
+        v = vaddq_f32(v, vmulq_n_f32(b1, row[1]));
+        v = vaddq_f32(v, vmulq_n_f32(b2, row[2]));
+        v = vaddq_f32(v, vmulq_n_f32(b3, row[3]));
+        vst1q_f32(r.m + i * 4, v);
+    }
+#else
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i * 4 + j] = a.m[i * 4 + 0] * b.m[0 * 4 + j] + a.m[i * 4 + 1] * b.m[1 * 4 + j]
+                           + a.m[i * 4 + 2] * b.m[2 * 4 + j] + a.m[i * 4 + 3] * b.m[3 * 4 + j];
+        }
+    }
+#endif
+    return r;
+}
+
+// Xoay quanh X rồi quanh Y (ry * rx như code cũ), dựng thẳng không qua phép nhân
+inline Mat4 rotateXY(float ax, float ay) {
+    float cx = cosf(ax), sx = sinf(ax);
+    float cy = cosf(ay), sy = sinf(ay);
+    return Mat4{{cy,  sy * sx, sy * cx, 0,
+                 0,   cx,      -sx,     0,
+                 -sy, cy * sx, cy * cx, 0,
+                 0,   0,       0,       1}};
+}
+
+constexpr Mat4 ortho(float left, float right, float bottom, float top, float nearVal, float farVal) {
+    return Mat4{{2.0f / (right - left), 0, 0, 0,
+                 0, 2.0f / (top - bottom), 0, 0,
+                 0, 0, -2.0f / (farVal - nearVal), 0,
+                 -(right + left) / (right - left), -(top + bottom) / (top - bottom),
+                 -(farVal + nearVal) / (farVal - nearVal), 1}};
+}
+
+inline Mat4 perspective(float fovy, float aspect, float nearVal, float farVal) {
+    float f = 1.0f / tanf(fovy / 2.0f);
+    return Mat4{{f / aspect, 0, 0, 0,
+                 0, f, 0, 0,
+                 0, 0, (farVal + nearVal) / (nearVal - farVal), -1.0f,
+                 0, 0, (2.0f * farVal * nearVal) / (nearVal - farVal), 0}};
+}
+
+inline Mat4 lookAt(Vec3 eye, Vec3 center, Vec3 up) {
+    Vec3 f = normalize(center - eye);
+    Vec3 s = normalize(cross(f, up));
+    Vec3 u = cross(s, f);
+    return Mat4{{s.x, u.x, -f.x, 0,
+                 s.y, u.y, -f.y, 0,
+                 s.z, u.z, -f.z, 0,
+                 -dot(s, eye), -dot(u, eye), dot(f, eye), 1}};
+}
+
+// Nghịch đảo tổng quát bằng phần phụ đại số. Trả về false (và không sửa out)
+// nếu ma trận suy biến.
+inline bool inverse(const Mat4 &a, Mat4 &out) {
+    const float* m = a.m;
+    float inv[16];
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15]
+             + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15]
+             - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15]
+             + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14]
+             - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15]
+             - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15]
+             + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15]
+             - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14]
+             + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15]
+             + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15]
+             - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15]
+             + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14]
+             - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11]
+             - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7]  =  m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11]
+             + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11]
+             - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] =  m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10]
+             + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0f || !std::isfinite(det)) return false;
+    float invDet = 1.0f / det;
+    for (int i = 0; i < 16; i++) out.m[i] = inv[i] * invDet;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Biến đổi theo lô
+
+// p' = (x, y, z, 1) * M
+inline Vec4 transformPoint(const Mat4 &m, Vec3 p) {
+    return vec4(p.x * m.m[0] + p.y * m.m[4] + p.z * m.m[8] + m.m[12],
+                p.x * m.m[1] + p.y * m.m[5] + p.z * m.m[9] + m.m[13],
+                p.x * m.m[2] + p.y * m.m[6] + p.z * m.m[10] + m.m[14],
+                p.x * m.m[3] + p.y * m.m[7] + p.z * m.m[11] + m.m[15]);
+}
+
+// out[i] = (in[i], 1) * M cho cả mảng (tọa độ clip chưa chia w nếu M có phép chiếu)
+inline void transformPoints(const Mat4 &m, const Vec3* in, Vec4* out, size_t count) {
+#if defined(VMATH_SSE)
+    __m128 r0 = _mm_load_ps(m.m), r1 = _mm_load_ps(m.m + 4);
+    __m128 r2 = _mm_load_ps(m.m + 8), r3 = _mm_load_ps(m.m + 12);
+    for (size_t i = 0; i < count; i++) {
+        __m128 v = _mm_mul_ps(_mm_set1_ps(in[i].x), r0);
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(in[i].y), r1));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(in[i].z), r2));
+        _mm_store_ps(&out[i].x, _mm_add_ps(v, r3));
+    }
+#elif defined(VMATH_NEON)
+    float32x4_t r0 = vld1q_f32(m.m), r1 = vld1q_f32(m.m + 4);
+    float32x4_t r2 = vld1q_f32(m.m + 8), r3 = vld1q_f32(m.m + 12);
+    for (size_t i = 0; i < count; i++) {
+        float32x4_t v = vmulq_n_f32(r0, in[i].x);
+        v = vaddq_f32(v, vmulq_n_f32(r1, in[i].y));
+        v = vaddq_f32(v, vmulq_n_f32(r2, in[i].z));
+        vst1q_f32(&out[i].x, vaddq_f32(v, r3));
+    }
+#else
+    for (size_t i = 0; i < count; i++) out[i] = transformPoint(m, in[i]);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Frustum
+
+// 6 mặt phẳng (trái, phải, dưới, trên, gần, xa) dạng (n, d), n hướng vào trong,
+// đã chuẩn hóa: dot(n, p) + d = khoảng cách có dấu. viewProj có thể gồm cả model
+// để lấy mặt phẳng trong không gian model.
+inline void extractFrustumPlanes(const Mat4 &viewProj, Vec4 planes[6]) {
+    const float* m = viewProj.m;
+    // Với vector hàng, thành phần clip thứ j = dot((p, 1), cột j)
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2 + 0] = vec4(m[3] + m[i], m[7] + m[4 + i], m[11] + m[8 + i], m[15] + m[12 + i]);
+        planes[i * 2 + 1] = vec4(m[3] - m[i], m[7] - m[4 + i], m[11] - m[8 + i], m[15] - m[12 + i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        Vec4 &p = planes[i];
+        float len = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        if (len > 0.0f) { p.x /= len; p.y /= len; p.z /= len; p.w /= len; }
+    }
+}
+
+inline bool sphereInFrustum(const Vec4 planes[6], Vec3 c, float radius) {
+    for (int i = 0; i < 6; i++) {
+        if (planes[i].x * c.x + planes[i].y * c.y + planes[i].z * c.z + planes[i].w < -radius) return false;
+    }
+    return true;
+}
+
+// Lọc mảng hình cầu (xyz = tâm, w = bán kính): ghi chỉ số các cầu nằm trong
+// (hoặc cắt) frustum vào visible, trả về số lượng
+inline size_t cullSpheres(const Vec4 planes[6], const Vec4* spheres, uint32_t* visible, size_t count) {
+    size_t n = 0;
+#if defined(VMATH_SSE)
+    // Xử lý 4 cầu một lần: chuyển AoS -> SoA rồi so với từng mặt phẳng
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_load_ps(&spheres[i].x), y = _mm_load_ps(&spheres[i + 1].x);
+        __m128 z = _mm_load_ps(&spheres[i + 2].x), r = _mm_load_ps(&spheres[i + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            // Cộng theo đúng thứ tự của sphereInFrustum để cầu nằm sát mặt phẳng
+            // cho cùng kết quả ở cả 2 đường
+            __m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y)));
+            d = _mm_add_ps(_mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(planes[p].z))), _mm_set1_ps(planes[p].w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_sub_ps(_mm_setzero_ps(), r)));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++) {
+            if (mask & (1 << k)) visible[n++] = (uint32_t)(i + k);
+        }
+    }
+    for (; i < count; i++) {
+        if (sphereInFrustum(planes, vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) visible[n++] = (uint32_t)i;
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        if (sphereInFrustum(planes, vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w)) visible[n++] = (uint32_t)i;
+    }
+#endif
+    return n;
+}
+
+#endif
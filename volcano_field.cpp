@@ -0,0 +1,183 @@
+
+#include "volcano_field.h"
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Lưới núi lửa dùng chung (location 0, chỉ vị trí) + tham số từng instance
+// (location 2, 3). Normal phẳng do fragment shader suy ra (uFlatNormals = 1)
+static const char* volcanoFieldVertexShaderSrc = R"(
+#version 330 core
+layout(location=0) in vec3 aPos;
+layout(location=2) in vec4 aBaseYaw;   // chân núi (x, y, z), góc xoay quanh Y
+layout(location=3) in vec2 aScale;     // tỉ lệ ngang, tỉ lệ dọc
+uniform mat4 uTransform;
+out vec3 vNormal;
+out vec3 vPos;
+out vec3 vWorldPos;
+void main(){
+    float c = cos(aBaseYaw.w), s = sin(aBaseYaw.w);
+    vec3 p = aPos * aScale.xyx;
+    p = vec3(c * p.x + s * p.z, p.y, -s * p.x + c * p.z) + aBaseYaw.xyz;
+    vNormal = vec3(0.0, 1.0, 0.0);
+    vPos = aPos;
+    vWorldPos = p;
+    gl_Position = uTransform * vec4(p, 1.0);
+}
+)";
+
+VolcanoField::~VolcanoField() {
+    shutdown();
+}
+
+void VolcanoField::init(const float* positions, size_t count, const char* fragmentShaderSrc) {
+    vertexCount = count;
+    fragmentSrc = fragmentShaderSrc;
+    meshData = positions;
+    meshRadius = 0.0f;
+    meshTop = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const float* p = positions + i * 3;
+        meshRadius = max(meshRadius, sqrtf(p[0] * p[0] + p[2] * p[2]));
+        meshTop = max(meshTop, p[1]);
+    }
+}
+
+void VolcanoField::generate(const GroundFn &ground, const VolcanoFieldParams &p) {
+    params = p;
+    instances.clear();
+    bounds.clear();
+    instances.reserve(params.count);
+    bounds.reserve(params.count);
+
+    mt19937 rng(params.seed);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float r0 = params.innerRadius * params.innerRadius, r1 = params.outerRadius * params.outerRadius;
+    for (int i = 0; i < params.count; i++) {
+        // Phân bố đều theo diện tích của vành khăn
+        float r = sqrtf(r0 + (r1 - r0) * unit(rng));
+        float angle = unit(rng) * 2.0f * (float)M_PI;
+        Instance in;
+        in.x = r * cosf(angle);
+        in.z = r * sinf(angle);
+        in.yaw = unit(rng) * 2.0f * (float)M_PI;
+        in.scale = params.minScale + (params.maxScale - params.minScale) * unit(rng);
+        in.height = in.scale * (params.minHeight + (params.maxHeight - params.minHeight) * unit(rng));
+        // Lún chân núi xuống một chút để không hở đáy trên sườn dốc
+        in.y = ground(in.x, in.z) - 0.05f * in.scale;
+        instances.push_back(in);
+
+        float halfHeight = 0.5f * meshTop * in.height;
+        float radius = sqrtf(meshRadius * in.scale * meshRadius * in.scale + halfHeight * halfHeight);
+        bounds.push_back(vec4(in.x, in.y + halfHeight, in.z, radius));
+    }
+    visible.resize(instances.size());
+    cullValid = false;
+}
+
+void VolcanoField::clear() {
+    instances.clear();
+    bounds.clear();
+    visible.clear();
+    visibleInstances.clear();
+    cullValid = false;
+}
+
+void VolcanoField::initGpu() {
+    auto compile = [](GLenum type, const char* src) {
+        GLuint s = glCreateShader(type);
+        glShaderSource(s, 1, &src, nullptr);
+        glCompileShader(s);
+        GLint ok;
+        glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[2048];
+            glGetShaderInfoLog(s, 2048, nullptr, log);
+            cerr << "Volcano field shader error: " << log << endl;
+        }
+        return s;
+    };
+    GLuint vs = compile(GL_VERTEX_SHADER, volcanoFieldVertexShaderSrc);
+    GLuint fs = compile(GL_FRAGMENT_SHADER, fragmentSrc);
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &meshVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), meshData, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, x));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, scale));
+    glVertexAttribDivisor(3, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Lưới đã nằm trên GPU
+    meshData = nullptr;
+}
+
+bool VolcanoField::cull(const Vec4 planes[6], uint32_t revision) {
+    if (cullValid && revision == cullRevision) return false;
+    size_t n = cullSpheres(planes, bounds.data(), visible.data(), bounds.size());
+    visibleInstances.resize(n);
+    for (size_t i = 0; i < n; i++) visibleInstances[i] = instances[visible[i]];
+    cullValid = true;
+    cullRevision = revision;
+    uploaded = false;
+    return true;
+}
+
+void VolcanoField::render(const float* transformMatrix, const Vec4 planes[6], uint32_t revision) {
+    if (instances.empty() || vertexCount == 0) return;
+    if (program == 0) initGpu();
+
+    cull(planes, revision);
+    if (visibleInstances.empty()) return;
+
+    glBindVertexArray(vao);
+    if (!uploaded) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, visibleInstances.size() * sizeof(Instance), visibleInstances.data(), GL_STREAM_DRAW);
+        uploaded = true;
+    }
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uTransform"), 1, GL_FALSE, transformMatrix);
+    glUniform1i(glGetUniformLocation(program, "uFlatNormals"), 1);
+    if (onBind) onBind(program);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)vertexCount, (GLsizei)visibleInstances.size());
+    glBindVertexArray(0);
+}
+
+void VolcanoField::shutdown() {
+    if (program == 0) return;
+    glDeleteProgram(program);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &meshVBO);
+    glDeleteBuffers(1, &instanceVBO);
+    program = vao = meshVBO = instanceVBO = 0;
+    uploaded = false;
+}
@@ -0,0 +1,94 @@
+#ifndef VOLCANO_FIELD_H
+#define VOLCANO_FIELD_H
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "vmath.h"
+
+// Cánh đồng núi lửa phụ: nhiều bản sao của lưới núi lửa (bản gốc, chưa biến
+// dạng) rải quanh núi chính, vẽ bằng một lần glDrawArraysInstanced.
+// - Mỗi instance: vị trí chân núi, góc xoay quanh Y, tỉ lệ ngang và tỉ lệ dọc;
+//   vertex shader dựng phép biến đổi từ các tham số này.
+// - Mỗi frame CPU lọc các instance theo frustum (hình cầu bao, cullSpheres) và
+//   chỉ upload instance nhìn thấy; camera không đổi thì dùng lại kết quả cũ.
+// Màu/ánh sáng dùng chung fragment shader với núi lửa chính (vPos là tọa độ
+// trước biến đổi nên dải màu theo độ cao giống hệt).
+
+struct VolcanoFieldParams {
+    int count = 10000;
+    float innerRadius = 8.0f;     // không đặt núi gần núi chính hơn
+    float outerRadius = 90.0f;
+    float minScale = 0.15f;       // tỉ lệ ngang so với núi chính
+    float maxScale = 0.6f;
+    float minHeight = 0.6f;       // tỉ lệ dọc so với tỉ lệ ngang
+    float maxHeight = 1.4f;
+    uint32_t seed = 2024;
+};
+
+class VolcanoField {
+public:
+    typedef std::function<float(float, float)> GroundFn;
+
+    ~VolcanoField();
+
+    // positions: vertexCount đỉnh của lưới núi lửa, không chép lại nên phải
+    // sống tới lần render() đầu tiên (lúc upload lên GPU);
+    // fragmentShaderSrc: shader màu của núi lửa chính (nhận vNormal, vPos, vWorldPos)
+    void init(const float* positions, size_t vertexCount, const char* fragmentShaderSrc);
+    void shutdown();
+
+    // Rải params.count núi, chân núi đặt theo ground(x, z)
+    void generate(const GroundFn &ground, const VolcanoFieldParams &params = VolcanoFieldParams());
+    void clear();
+
+    // planes: 6 mặt phẳng frustum trong không gian model; revision: đổi khi
+    // transform đổi (Camera::revision) để biết kết quả lọc cũ còn dùng được
+    void render(const float* transformMatrix, const Vec4 planes[6], uint32_t revision);
+    // Phần lọc của render() (chỉ CPU): trả về false nếu dùng lại kết quả cũ
+    bool cull(const Vec4 planes[6], uint32_t revision);
+
+    // Gọi sau glUseProgram mỗi lần vẽ, để gán thêm uniform mà fragment shader
+    // dùng chung cần (vd. đèn dung nham)
+    std::function<void(unsigned int program)> onBind;
+
+    size_t instanceCount() const { return instances.size(); }
+    size_t visibleCount() const { return visibleInstances.size(); }
+
+    // Dữ liệu một instance trên GPU (location 2, 3)
+    struct Instance {
+        float x, y, z, yaw;
+        float scale, height;  // tỉ lệ ngang, tỉ lệ dọc (tuyệt đối)
+    };
+    // Để kiểm tra: mọi instance, hình cầu bao của chúng (cùng thứ tự) và các
+    // instance còn lại sau lần lọc gần nhất
+    const std::vector<Instance> &instanceList() const { return instances; }
+    const std::vector<Vec4> &boundingSpheres() const { return bounds; }
+    const std::vector<Instance> &visibleList() const { return visibleInstances; }
+
+private:
+    VolcanoFieldParams params;
+    const float* meshData = nullptr;  // vị trí (của người gọi), upload một lần rồi bỏ
+    size_t vertexCount = 0;
+    const char* fragmentSrc = nullptr;
+    float meshRadius = 0.0f;       // bán kính ngang lớn nhất của lưới
+    float meshTop = 0.0f;
+
+    std::vector<Instance> instances;
+    std::vector<Vec4> bounds;      // hình cầu bao (xyz = tâm, w = bán kính)
+    std::vector<uint32_t> visible;
+    std::vector<Instance> visibleInstances;
+    bool cullValid = false;
+    uint32_t cullRevision = 0;
+
+    unsigned int program = 0;
+    unsigned int vao = 0;
+    unsigned int meshVBO = 0;
+    unsigned int instanceVBO = 0;
+    bool uploaded = false;         // visibleInstances đã nằm trong instanceVBO
+
+    void initGpu();
+};
+
+#endif
@@ -0,0 +1,146 @@
+
+#include "wind_field.h"
+#include "noise.h"
+#include <GL/glew.h>
+#include <cmath>
+
+using namespace std;
+
+// Salt cho 3 kênh của thế vector ψ, để 3 kênh không tương quan
+static const uint32_t PSI_SALT[3] = {0, 101, 211};
+
+WindField::~WindField() {
+    shutdown();
+}
+
+void WindField::init(const WindFieldParams &p) {
+    params = p;
+    res = max(p.resolution, 2);
+    tilesPerSide = (res + p.tileSize - 1) / p.tileSize;
+    for (int k = 0; k < 3; k++) {
+        cell[k] = (p.boundsMax[k] - p.boundsMin[k]) / (res - 1);
+        invCell[k] = 1.0f / cell[k];
+    }
+
+    size_t halo = (size_t)(p.tileSize + 2) * (p.tileSize + 2) * (p.tileSize + 2);
+    px.resize(halo); py.resize(halo); pz.resize(halo);
+    for (int c = 0; c < 3; c++) psi[c].resize(halo);
+
+    // Lưới đầu tiên tính đủ ngay, lưới sau bắt đầu tính cho thời điểm kế tiếp
+    for (int i = 0; i < 2; i++) grids[i].assign((size_t)res * res * res, Vec4());
+    time = 0.0f;
+    front = 0;
+    bakeAll(grids[front], 0.0f);
+    bakeTime = p.refreshPeriod;
+    nextTile = 0;
+    tileBudget = 0.0f;
+    gpuDirty = true;
+    initialized = true;
+}
+
+void WindField::shutdown() {
+    if (gpuTexture) glDeleteTextures(1, &gpuTexture);
+    gpuTexture = 0;
+    initialized = false;
+}
+
+void WindField::bakeAll(vector<Vec4> &grid, float t) {
+    for (int tile = 0; tile < tilesPerSide * tilesPerSide * tilesPerSide; tile++) bakeTile(grid, tile, t);
+}
+
+// Tính ψ tại các nút của tile cộng viền 1 nút, rồi lấy curl bằng sai phân trung tâm
+void WindField::bakeTile(vector<Vec4> &grid, int tile, float t) {
+    const int T = params.tileSize;
+    const int H = T + 2;
+    int x0 = (tile % tilesPerSide) * T;
+    int y0 = (tile / tilesPerSide % tilesPerSide) * T;
+    int z0 = (tile / (tilesPerSide * tilesPerSide)) * T;
+
+    float f = params.noiseFrequency;
+    float scroll = t * params.evolveSpeed;
+    size_t n = 0;
+    for (int k = 0; k < H; k++) {
+        for (int j = 0; j < H; j++) {
+            for (int i = 0; i < H; i++, n++) {
+                px[n] = (params.boundsMin[0] + (x0 + i - 1) * cell[0]) * f;
+                py[n] = (params.boundsMin[1] + (y0 + j - 1) * cell[1]) * f - scroll;
+                pz[n] = (params.boundsMin[2] + (z0 + k - 1) * cell[2]) * f;
+            }
+        }
+    }
+    NoiseParams np;
+    np.octaves = params.noiseOctaves;
+    for (int c = 0; c < 3; c++) {
+        np.seed = params.seed + PSI_SALT[c];
+        fbm3Batch(px.data(), py.data(), pz.data(), psi[c].data(), n, np);
+    }
+
+    const float* ax = psi[0].data();
+    const float* ay = psi[1].data();
+    const float* az = psi[2].data();
+    float sx = params.turbulence * 0.5f * invCell[0];
+    float sy = params.turbulence * 0.5f * invCell[1];
+    float sz = params.turbulence * 0.5f * invCell[2];
+    const int dj = H, dk = H * H;
+    for (int k = 0; k < T && z0 + k < res; k++) {
+        for (int j = 0; j < T && y0 + j < res; j++) {
+            float y = params.boundsMin[1] + (y0 + j) * cell[1];
+            float shear = min(max(y / params.shearHeight, 0.0f), 1.0f);
+            Vec4* out = grid.data() + ((size_t)(z0 + k) * res + (y0 + j)) * res + x0;
+            for (int i = 0; i < T && x0 + i < res; i++) {
+                int c = ((k + 1) * H + (j + 1)) * H + (i + 1);
+                // curl ψ = (dψz/dy - dψy/dz, dψx/dz - dψz/dx, dψy/dx - dψx/dy)
+                float vx = (az[c + dj] - az[c - dj]) * sy - (ay[c + dk] - ay[c - dk]) * sz;
+                float vy = (ax[c + dk] - ax[c - dk]) * sz - (az[c + 1] - az[c - 1]) * sx;
+                float vz = (ay[c + 1] - ay[c - 1]) * sx - (ax[c + dj] - ax[c - dj]) * sy;
+                out[i] = vec4(vx + params.prevailing[0] * shear,
+                              vy + params.prevailing[1] * shear,
+                              vz + params.prevailing[2] * shear, 0.0f);
+            }
+        }
+    }
+}
+
+void WindField::update(float dt) {
+    if (!initialized) return;
+    time += dt;
+
+    int total = tilesPerSide * tilesPerSide * tilesPerSide;
+    tileBudget += total * dt / params.refreshPeriod;
+    int count = min((int)tileBudget, total);
+    tileBudget -= (int)tileBudget;
+
+    vector<Vec4> &back = grids[1 - front];
+    for (int i = 0; i < count; i++) {
+        bakeTile(back, nextTile, bakeTime);
+        if (++nextTile == total) {
+            front = 1 - front;
+            nextTile = 0;
+            bakeTime += params.refreshPeriod;
+            gpuDirty = true;
+            break;
+        }
+    }
+}
+
+unsigned int WindField::texture() {
+    if (!initialized) return 0;
+    if (gpuTexture == 0) {
+        glGenTextures(1, &gpuTexture);
+        glBindTexture(GL_TEXTURE_3D, gpuTexture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, res, res, res, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        gpuDirty = true;
+    }
+    if (gpuDirty) {
+        glBindTexture(GL_TEXTURE_3D, gpuTexture);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, res, res, res, GL_RGBA, GL_FLOAT, grids[front].data());
+        glBindTexture(GL_TEXTURE_3D, 0);
+        gpuDirty = false;
+    }
+    return gpuTexture;
+}
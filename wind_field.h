@@ -0,0 +1,130 @@
+#ifndef WIND_FIELD_H
+#define WIND_FIELD_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "vmath.h"
+
+// Trường gió 3D cho khói: gió thịnh hành + nhiễu xoáy (curl noise).
+// - Vận tốc = curl của thế vector ψ (3 kênh fBm simplex), nên không có nguồn/giếng
+//   (div = 0), khói cuộn xoáy chứ không tụ lại một chỗ.
+// - Tính sẵn vào lưới nút res^3 (mỗi nút một Vec4), hạt chỉ cần một lần
+//   nội suy tam tuyến tính thay vì tính nhiễu.
+// - Nhiễu trôi theo thời gian: lưới sau được tính dần từng tile qua nhiều frame
+//   (refreshPeriod giây cho cả lưới), xong thì đổi chỗ với lưới đang dùng.
+// Ngoài hộp bounds thì lấy giá trị ở biên.
+
+struct WindFieldParams {
+    int resolution = 32;                       // số nút mỗi cạnh, chia hết cho tileSize
+    int tileSize = 8;                          // số nút mỗi cạnh tile khi tính lại
+    float boundsMin[3] = {-12.0f, -1.0f, -12.0f};
+    float boundsMax[3] = {12.0f, 23.0f, 12.0f};
+    float prevailing[3] = {0.6f, 0.0f, 0.25f}; // gió thịnh hành ở trên cao (đơn vị/giây)
+    float shearHeight = 8.0f;                  // gió thịnh hành tăng tuyến tính từ mặt đất tới độ cao này
+    float turbulence = 2.5f;                   // hệ số nhân vận tốc xoáy
+    float noiseFrequency = 0.22f;
+    int noiseOctaves = 2;
+    float evolveSpeed = 0.12f;                 // tốc độ trôi của nhiễu (đơn vị nhiễu/giây), xoáy bốc lên theo cột khói
+    float refreshPeriod = 1.0f;                // thời gian tính lại cả lưới
+    uint32_t seed = 11;
+};
+
+class WindField {
+public:
+    ~WindField();
+
+    void init(const WindFieldParams &params = WindFieldParams());
+    void shutdown();
+
+    // Tăng thời gian, tính thêm một phần lưới sau, đổi lưới khi xong
+    void update(float dt);
+
+    // Vận tốc gió tại (x, y, z): out[0..2], out[3] = 0
+    inline void sample(float x, float y, float z, float out[4]) const;
+
+    // Texture 3D (RGBA32F) của lưới đang dùng cho backend GPU, tạo lúc gọi lần
+    // đầu và upload lại sau mỗi lần đổi lưới. Tọa độ texture của điểm p:
+    // ((p - boundsMin) * invCellSize + 0.5) / resolution
+    unsigned int texture();
+    const float* invCellSize() const { return invCell; }
+    const WindFieldParams &getParams() const { return params; }
+
+private:
+    WindFieldParams params;
+    bool initialized = false;
+    int res = 0;
+    int tilesPerSide = 0;
+    float cell[3] = {1, 1, 1};
+    float invCell[3] = {1, 1, 1};
+
+    std::vector<Vec4> grids[2];
+    int front = 0;
+    int nextTile = 0;         // tile kế tiếp của lưới sau
+    float tileBudget = 0.0f;  // phần lẻ số tile cần tính
+    float time = 0.0f;
+    float bakeTime = 0.0f;    // thời điểm nhiễu của lưới sau
+
+    // Bộ nhớ tạm cho một tile (kể cả viền 1 nút để lấy đạo hàm)
+    std::vector<float> px, py, pz, psi[3];
+
+    unsigned int gpuTexture = 0;
+    bool gpuDirty = true;
+
+    void bakeTile(std::vector<Vec4> &grid, int tile, float t);
+    void bakeAll(std::vector<Vec4> &grid, float t);
+};
+
+inline void WindField::sample(float x, float y, float z, float out[4]) const {
+    if (!initialized) { out[0] = out[1] = out[2] = out[3] = 0.0f; return; }
+    float lim = (float)(res - 1) - 1e-4f;
+    float fx = std::min(std::max((x - params.boundsMin[0]) * invCell[0], 0.0f), lim);
+    float fy = std::min(std::max((y - params.boundsMin[1]) * invCell[1], 0.0f), lim);
+    float fz = std::min(std::max((z - params.boundsMin[2]) * invCell[2], 0.0f), lim);
+    int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+    float tx = fx - ix, ty = fy - iy, tz = fz - iz;
+
+    const Vec4* g = grids[front].data() + ((size_t)iz * res + iy) * res + ix;
+    size_t sy = res, sz = (size_t)res * res;
+#if defined(VMATH_SSE)
+    __m128 vx = _mm_set1_ps(tx), vy = _mm_set1_ps(ty), vz = _mm_set1_ps(tz);
+    __m128 c00 = _mm_load_ps(&g[0].x), c10 = _mm_load_ps(&g[1].x);
+    __m128 c01 = _mm_load_ps(&g[sy].x), c11 = _mm_load_ps(&g[sy + 1].x);
+    __m128 d00 = _mm_load_ps(&g[sz].x), d10 = _mm_load_ps(&g[sz + 1].x);
+    __m128 d01 = _mm_load_ps(&g[sz + sy].x), d11 = _mm_load_ps(&g[sz + sy + 1].x);
+    __m128 c0 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), vx));
+    __m128 c1 = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), vx));
+    __m128 d0 = _mm_add_ps(d00, _mm_mul_ps(_mm_sub_ps(d10, d00), vx));
+    __m128 d1 = _mm_add_ps(d01, _mm_mul_ps(_mm_sub_ps(d11, d01), vx));
+    __m128 c = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), vy));
+    __m128 d = _mm_add_ps(d0, _mm_mul_ps(_mm_sub_ps(d1, d0), vy));
+    _mm_storeu_ps(out, _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), vz)));
+#elif defined(VMATH_NEON)
+    float32x4_t c00 = vld1q_f32(&g[0].x), c10 = vld1q_f32(&g[1].x);
+    float32x4_t c01 = vld1q_f32(&g[sy].x), c11 = vld1q_f32(&g[sy + 1].x);
+    float32x4_t d00 = vld1q_f32(&g[sz].x), d10 = vld1q_f32(&g[sz + 1].x);
+    float32x4_t d01 = vld1q_f32(&g[sz + sy].x), d11 = vld1q_f32(&g[sz + sy + 1].x);
+    float32x4_t c0 = vmlaq_n_f32(c00, vsubq_f32(c10, c00), tx);
+    float32x4_t c1 = vmlaq_n_f32(c01, vsubq_f32(c11, c01), tx);
+    float32x4_t d0 = vmlaq_n_f32(d00, vsubq_f32(d10, d00), tx);
+    float32x4_t d1 = vmlaq_n_f32(d01, vsubq_f32(d11, d01), tx);
+    float32x4_t c = vmlaq_n_f32(c0, vsubq_f32(c1, c0), ty);
+    float32x4_t d = vmlaq_n_f32(d0, vsubq_f32(d1, d0), ty);
+    vst1q_f32(out, vmlaq_n_f32(c, vsubq_f32(d, c), tz));
+#else
+    const float* corner[8] = {&g[0].x, &g[1].x, &g[sy].x, &g[sy + 1].x,
+                              &g[sz].x, &g[sz + 1].x, &g[sz + sy].x, &g[sz + sy + 1].x};
+    for (int k = 0; k < 4; k++) {
+        float c0 = corner[0][k] + (corner[1][k] - corner[0][k]) * tx;
+        float c1 = corner[2][k] + (corner[3][k] - corner[2][k]) * tx;
+        float d0 = corner[4][k] + (corner[5][k] - corner[4][k]) * tx;
+        float d1 = corner[6][k] + (corner[7][k] - corner[6][k]) * tx;
+        float c = c0 + (c1 - c0) * ty;
+        float d = d0 + (d1 - d0) * ty;
+        out[k] = c + (d - c) * tz;
+    }
+#endif
+}
+
+#endif